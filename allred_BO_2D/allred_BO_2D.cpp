@@ -1,14 +1,14 @@
+#include <chrono>
 #include <tt-metalium/device.hpp>
 #include "allred_helper.hpp"
-
-void get_swing_block_comm_indexes(int, int, uint32_t*, bool, int, int);
-void get_recdub_block_comm_indexes(int, int, uint32_t*, bool, int, int, int, uint32_t&);
+#include "allred_tuning.hpp"
 
 int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+
     IDevice* device = CreateDevice(0);
 
     CommandQueue& cq = device->command_queue();
-    Program program = CreateProgram();
     /*
     Arg 1: is swing version? 0 1 (0 = recdub)
     Arg 2: Run the kernel? 0 1
@@ -17,254 +17,55 @@ int main(int argc, char** argv) {
     arg 5: Number of tiles, 1-5
     arg 6: Acceptible calculation error (due to bfloat16 rounding  )
     Arg 7: Which core should copy results to host
-    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)*/
+    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)
+    "auto" as arg 1 and/or arg 8: the algorithm (and variant, allred_mem_2D included) with the lowest time
+    predicted by the --tuning table (allred_tuning.txt by default), arg 5 is then the tiles of the whole vector
+    --repeat=N: run the allreduce N times through the program cache, timing the first and the later runs*/
 
     int SIDE_LENGTH = (argc >= 4) ? highest_power_of_two(std::stoi(argv[3])) : 1;
+    std::string tuning_path = options.GetString("tuning", "allred_tuning.txt");
+    std::vector<std::string> auto_args;  // The args that replace "auto" in argv
+    AlgorithmChoice choice;
+    if (resolve_auto_args(argc, argv, SIDE_LENGTH, SIDE_LENGTH, tuning_path, auto_args, choice)) {
+        if (choice.predicted_cycles < 0) {
+            printf("No variant fits the vector in L1\n");
+            CloseDevice(device);
+            return 1;
+        }
+        printf(
+            "auto: %s (%s kernel), %s, arg 5 = %d, %.0f cycles predicted\n",
+            choice.variant.c_str(),
+            choice.kernel.c_str(),
+            choice.swing_version ? "swing" : "recdub",
+            choice.data_size,
+            choice.predicted_cycles);
+        options.Set("tuning", tuning_path);  // So AllredConfig takes the same crossover
+    }
     int PRINT_CORE = (argc >= 8) ? std::stoi(argv[7]) : 0;
     bool BANDWIDTH_OPTIMAL = (argc >= 9) ? (bool) std::stoi(argv[8]) : false;
 
     CoreRange cores({0, 0}, {SIDE_LENGTH - 1, SIDE_LENGTH - 1});
 
     // Initialize the allreduce parameters
-    AllredConfig arCfg(argc, argv, device, cq, program, cores, SIDE_LENGTH, BANDWIDTH_OPTIMAL);
-
-    /*NOC kernel arg initialization*/
-    std::vector<uint32_t> dataflow_args(14 + 2 * arCfg.SWING_ALGO_STEPS + 8 + 4 * arCfg.SWING_ALGO_STEPS);
-    /*args for NoC kernel:
-    0-5 : src + dst dram
-    6: num steps
-    7-8: core x, y
-    9: core i (x+ y*side length)
-    10: is_SE
-    11: step_directions
-    12: num_tiles
-    13: tiles_per_node
-    14-25: core x, y for each step
-    26-33: semaphores for each step
-    34-45: block indexes to send at each step
-    */
-
-    // Fixed arguments common for all cores
-    dataflow_args[1] = arCfg.dst_dram_buffer->address();
-    dataflow_args[3] = PRINT_CORE;
-    dataflow_args[4] = arCfg.dst_bank_id;
-    dataflow_args[5] = BANDWIDTH_OPTIMAL;
-    dataflow_args[6] = arCfg.SWING_ALGO_STEPS;
-    dataflow_args[12] = arCfg.NUM_TILES;
-    dataflow_args[13] = arCfg.NUM_TILES / arCfg.TOTAL_NODES == 0 ? 1 : arCfg.NUM_TILES / arCfg.TOTAL_NODES;  // tiles per node
-    for (int i = 0; i < 8; i++) {
-        dataflow_args[14 + 2 * arCfg.SWING_ALGO_STEPS + i] = (uint32_t)tt_metal::CreateSemaphore(program, cores, INVALID);
-    }
-
-    /*Compute kernel arg initialization*/
-    std::vector<uint32_t> compute_args(6 + 2 * arCfg.SWING_ALGO_STEPS);
-    compute_args[0] = arCfg.SWING_ALGO_STEPS;
-    compute_args[1] = BANDWIDTH_OPTIMAL;
-    compute_args[4] = arCfg.NUM_TILES;
-    compute_args[5] = arCfg.NUM_TILES / arCfg.TOTAL_NODES == 0 ? 1 : arCfg.NUM_TILES / arCfg.TOTAL_NODES;  // tiles per node
-
-    /*reused variable initialization*/
-    KernelHandle dataflow_0_kernel, dataflow_1_kernel, compute_kernel;
-    CoreCoord logical_core, physical_core;
-    bool horizontal_step,sending_SE;
-    uint32_t step_directions = 0b00000;
-    uint32_t dummy_step_directions = 0b00000;
-    int node_position, node_other_position, message_pass_depth, recv_node, comm_partner_idx;
-
-    /*create kernels for each core*/
-    for (int core_i = 0; core_i < arCfg.core_array.size(); core_i++) {
-        // Calculates physical core coordinates from logical core coordinates
-        physical_core = device->worker_core_from_logical_core(arCfg.core_array[core_i]);
-        dataflow_args[9] = (uint32_t)core_i;  // Added core_i
-        if (arCfg.core_array[core_i].x % 2 == 0) {
-            dataflow_args[0] = arCfg.src_1_dram_buffer->address();
-            dataflow_args[2] = arCfg.src_1_bank_id;
-        } else {
-            dataflow_args[0] = arCfg.src_0_dram_buffer->address();
-            dataflow_args[2] = arCfg.src_0_bank_id;
-        }
-
-        /* set block to send/recv indexes to 0 */
-        for (int i = 0; i < 2 * arCfg.SWING_ALGO_STEPS; i++) {
-            dataflow_args[22 + 2 * arCfg.SWING_ALGO_STEPS + i] = 0;
-        }
-        for (int i = 0; i < 2 * arCfg.SWING_ALGO_STEPS; i++) {
-            compute_args[6 + i] = 0;
-        }
-
-        horizontal_step = true;  // Start calcs on hrz step
-        if (!arCfg.SWING_VERSION) {
-            /*Recursive doubling algo partner node calculations*/
-            message_pass_depth = 1;
-            // Calculate communication partners for each step
-            for (int algo_step = 0; algo_step < arCfg.SWING_ALGO_STEPS; algo_step++) {
-                //Get linear index of comm partner
-                comm_partner_idx = get_comm_partner_recdub_2D(
-                    core_i, algo_step, horizontal_step, message_pass_depth, step_directions, SIDE_LENGTH);
-                
-                logical_core = arCfg.core_array[comm_partner_idx]; // 2d coordinates of comm partner
-                physical_core = device->worker_core_from_logical_core(logical_core); // Actual core coords
-                dataflow_args[14 + 2 * algo_step] = (uint32_t)physical_core.x;
-                dataflow_args[15 + 2 * algo_step] = (uint32_t)physical_core.y;
-                
-                uint32_t* blocks_to_send = &dataflow_args[22 + 2 * arCfg.SWING_ALGO_STEPS + 2 * algo_step];
-                // Set this core's block_to_send bit to 1
-                if (comm_partner_idx < 32) {
-                    *blocks_to_send = *blocks_to_send | (1 << comm_partner_idx);
-                } else {
-                    *(blocks_to_send + 1) = *(blocks_to_send + 1) | (1 << (comm_partner_idx - 32));
-                }
-
-                // Set the partner core's block_to_recv bit to 1
-                uint32_t* blocks_to_recv = &compute_args[6 + 2 * algo_step];
-                if (core_i < 32) {
-                    *blocks_to_recv = *blocks_to_recv | (1 << core_i);
-                } else {
-                    *(blocks_to_recv + 1) = *(blocks_to_recv + 1) | (1 << (core_i - 32));
-                }
-
-                message_pass_depth = horizontal_step ? message_pass_depth : 2 * message_pass_depth;
-                horizontal_step = !horizontal_step;
+    AllredConfig arCfg(argc, argv, device, cq, SIDE_LENGTH, BANDWIDTH_OPTIMAL, options);
 
-                //actually calculate the blocks to send
-                get_recdub_block_comm_indexes(
-                    comm_partner_idx,
-                    algo_step + 1,
-                    blocks_to_send,
-                    horizontal_step,
-                    SIDE_LENGTH,
-                    arCfg.TOTAL_NODES,
-                    message_pass_depth,
-                    dummy_step_directions);
+    // CBs, semaphores, runtime args and kernels of every core, built on the first Get only
+    AllredProgramCache programs;
+    std::string variant = !choice.variant.empty() ? choice.variant : BANDWIDTH_OPTIMAL ? "allred_BO_2D" : "allred_LO_2D";
+    int REPEATS = std::max(1, options.GetInt("repeat", 1));
 
-                get_recdub_block_comm_indexes(
-                    core_i,
-                    algo_step + 1,
-                    blocks_to_recv,
-                    horizontal_step,
-                    SIDE_LENGTH,
-                    arCfg.TOTAL_NODES,
-                    message_pass_depth,
-                    dummy_step_directions);
-                
-                // Copy the receiving block coords to the dataflow args as well
-                dataflow_args[22 + 4 * arCfg.SWING_ALGO_STEPS + 2 * algo_step] = compute_args[6 + 2 * algo_step];
-                dataflow_args[23 + 4 * arCfg.SWING_ALGO_STEPS + 2 * algo_step] = compute_args[7 + 2 * algo_step];
-            }
-        } else {
-            /*Swing communication partner calculations*/
-            for (int algo_step = 0; algo_step < arCfg.SWING_ALGO_STEPS; algo_step++) {
-                //Get linear index of comm partner
-                comm_partner_idx =
-                    get_comm_partner_swing_2D(core_i, algo_step, horizontal_step, SIDE_LENGTH, arCfg.TOTAL_NODES);
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    arCfg.Execute(cq, programs.Get(variant, arCfg, device, cores, PRINT_CORE), device);
+    double first_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
 
-                logical_core = arCfg.core_array[comm_partner_idx];// 2d coordinates of comm partner
-                physical_core = device->worker_core_from_logical_core(logical_core); // Actual core coords
-                dataflow_args[14 + 2 * algo_step] = (uint32_t)physical_core.x;
-                dataflow_args[15 + 2 * algo_step] = (uint32_t)physical_core.y;
-
-                uint32_t* blocks_to_send = &dataflow_args[22 + 2 * arCfg.SWING_ALGO_STEPS + 2 * algo_step];
-                blocks_to_send[0] = 0;
-                blocks_to_send[1] = 0;
-                // Set this core's block_to_send bit to 1
-                if (comm_partner_idx < 32) {
-                    *blocks_to_send = *blocks_to_send | (1 << comm_partner_idx);
-                } else {
-                    *(blocks_to_send + 1) = *(blocks_to_send + 1) | (1 << (comm_partner_idx - 32));
-                }
-
-                uint32_t* blocks_to_recv = &compute_args[6 + 2 * algo_step];
-                blocks_to_recv[0] = 0;
-                blocks_to_recv[1] = 0;
-                // Set the partner core's block_to_recv bit to 1
-                if (core_i < 32) {
-                    *blocks_to_recv = *blocks_to_recv | (1 << core_i);
-                } else {
-                    *(blocks_to_recv + 1) = *(blocks_to_recv + 1) | (1 << (core_i - 32));
-                }
-
-                horizontal_step = !horizontal_step;
-                // Calc the other indexes to send/recieve
-                get_swing_block_comm_indexes(
-                    comm_partner_idx, algo_step + 1, blocks_to_send, horizontal_step, SIDE_LENGTH, arCfg.TOTAL_NODES);
-                get_swing_block_comm_indexes(
-                    core_i, algo_step + 1, blocks_to_recv, horizontal_step, SIDE_LENGTH, arCfg.TOTAL_NODES);
-                //copy the recv also to dataflow from compute
-                dataflow_args[22 + 4 * arCfg.SWING_ALGO_STEPS + 2 * algo_step] = compute_args[6 + 2 * algo_step];
-                dataflow_args[23 + 4 * arCfg.SWING_ALGO_STEPS + 2 * algo_step] = compute_args[7 + 2 * algo_step];
-            }
-            //Set the step directions according to core posn
-            step_directions = get_step_directions(arCfg.core_array[core_i].x, arCfg.core_array[core_i].y);
-        }
-
-        dataflow_args[11] = step_directions;
-        compute_args[3] = step_directions;
-
-        // The Latency Optimal algorithm uses a different kernel when the vector is smaller than 128kB
-        std::string dataflow_kernel_path = arCfg.NUM_TILES >= 64 ? "allred_BO_2D" : "allred_LOO_2D";
-        /*SE Kernel*/
-        dataflow_args[10] = (uint32_t)true;
-        dataflow_0_kernel = CreateDataflowKernel(program, arCfg.core_array[core_i], dataflow_args, true, dataflow_kernel_path);  // SE kernel
-        /*NW Kernel*/
-        dataflow_args[10] = (uint32_t)false;
-        dataflow_1_kernel = CreateDataflowKernel(program, arCfg.core_array[core_i], dataflow_args, false, dataflow_kernel_path); // NW kernel
-        compute_kernel = CreateComputeKernel(program, arCfg.core_array[core_i], compute_args,"allred_BO_2D");
-    }
-    
-    arCfg.RunProgram(cq, program, device);
-}
-
-// Function to get the indexes of the blocks that need to be communicated.
-// Recursively checks which blocks will be sent by all the nodes that a given node will communicate 
-// with in future steps, and sets all of those chunks of data to be sent. Swing version.
-void get_swing_block_comm_indexes(
-    int node, int step, uint32_t* blocks, bool horizontal_step, int SIDE_LENGTH, int TOTAL_NODES) {
-    int num_steps = (int)log2((double)TOTAL_NODES);
-    if (step >= num_steps) {
-        return;
-    }
-    for (int s = step; s < num_steps; s++) {
-        int peer = get_comm_partner_swing_2D(node, s, horizontal_step, SIDE_LENGTH, TOTAL_NODES);
-        if (peer < 32) {
-            *blocks = *blocks | (1 << peer);
-        } else {
-            *(blocks + 1) = *(blocks + 1) | (1 << (peer - 32));
-        }
-        horizontal_step = !horizontal_step;
-        get_swing_block_comm_indexes(peer, s + 1, blocks, horizontal_step, SIDE_LENGTH, TOTAL_NODES);
-    }
-    return;
-}
-
-// Function to get the indexes of the blocks that need to be communicated.
-// Recursively checks which blocks will be sent by all the nodes that a given node will communicate 
-// with in future steps, and sets all of those chunks of data to be sent. Recursive doubling version.
-void get_recdub_block_comm_indexes(
-    int node,
-    int step,
-    uint32_t* blocks,
-    bool horizontal_step,
-    int SIDE_LENGTH,
-    int TOTAL_NODES,
-    int message_pass_depth,
-    uint32_t& step_directions) {
-    int num_steps = (int)log2((double)TOTAL_NODES);
-    if (step >= num_steps) {
-        return;
+    start = clock::now();
+    for (int r = 1; r < REPEATS; r++) {
+        arCfg.Execute(cq, programs.Get(variant, arCfg, device, cores, PRINT_CORE), device);
     }
-    for (int s = step; s < num_steps; s++) {
-        int peer =
-            get_comm_partner_recdub_2D(node, s, horizontal_step, message_pass_depth, step_directions, SIDE_LENGTH);
-        if (peer < 32) {
-            *blocks = *blocks | (1 << peer);
-        } else {
-            *(blocks + 1) = *(blocks + 1) | (1 << (peer - 32));
-        }
-
-        message_pass_depth = horizontal_step ? message_pass_depth : 2 * message_pass_depth;
-        horizontal_step = !horizontal_step;
-        get_recdub_block_comm_indexes(
-            peer, s + 1, blocks, horizontal_step, SIDE_LENGTH, TOTAL_NODES, message_pass_depth, step_directions);
+    if (REPEATS > 1) {
+        double repeat_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count() / (REPEATS - 1);
+        printf("Time to first allreduce: %.1f ms, per later allreduce: %.1f ms (including validation)\n", first_ms, repeat_ms);
     }
-    return;
+    CloseDevice(device);
 }
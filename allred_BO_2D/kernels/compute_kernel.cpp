@@ -6,6 +6,14 @@
 #include "compute_kernel_api/eltwise_binary.h"
 #include "compute_kernel_api/tile_move_copy.h"
 #include "debug/dprint.h"  // required in all kernels using DPRINT
+#include "third_party/tracy/public/tracy/Tracy.hpp"
+
+// Zones of every step (--step-zones), for allred_critical_path. Off by default, they fill the profiler buffer
+#ifdef ALLRED_STEP_ZONES
+#define StepZone(name) DeviceZoneScopedN(name)
+#else
+#define StepZone(name)
+#endif
 
 namespace NAMESPACE {
 void MAIN {
@@ -13,7 +21,10 @@ void MAIN {
     bool bandwidth_optimal = (bool) get_arg_val<uint32_t>(1);
     uint32_t num_tiles = get_arg_val<uint32_t>(4);
     uint32_t num_tiles_per_node = get_arg_val<uint32_t>(5);
-    uint32_t total_nodes = bandwidth_optimal ? 64 : num_tiles < 64 ? num_tiles : 64;
+    uint32_t num_chunks = get_arg_val<uint32_t>(6 + 2 * algo_steps); // Chunks reduced per run when streaming
+    uint32_t recv_tiles = get_arg_val<uint32_t>(7 + 2 * algo_steps); // Pages of cb_recv
+    // Tiles added per DST acquire (at most the 8 of half DST), within a block and a sync, see reduce_batch_tiles
+    uint32_t batch_tiles = get_arg_val<uint32_t>(8 + 2 * algo_steps);
 
     constexpr uint32_t cb_id_recv = tt::CBIndex::c_3;
     constexpr uint32_t cb_id_local = tt::CBIndex::c_16;
@@ -30,39 +41,58 @@ void MAIN {
     binary_op_init_common(cb_id_local, cb_id_recv, cb_id_local);
     add_tiles_init(cb_id_local, cb_id_recv);
 
-    bool recv_block = true;
-    for (uint32_t j = 0; j < 1; j++) { // This loop simply repeats the algorithm to get accurate timings
+    // Warmup and timed runs of the allreduce, see the dataflow kernel
+    constexpr uint32_t iterations = get_compile_time_arg_val(0);
+    constexpr uint32_t warmup = get_compile_time_arg_val(1);
+
+    for (uint32_t j = 0; j < (warmup + iterations) * num_chunks; j++) { // This loop simply repeats the algorithm to get accurate timings
         for (uint32_t i = 0; i < algo_steps; i++) {
-            uint32_t reg_index = 0;
+            StepZone("AR_REDUCE");
 
-            // Iterate through each block of tiles
-            for (uint32_t n_block = 0; n_block < total_nodes; n_block++) {
+            // The empty pages the dataflow kernel pushes before the received ones
+            uint32_t padding_tiles =
+                bandwidth_optimal ? recv_tiles - num_tiles_per_node * __builtin_popcountll(block_indexes[i]) : 0;
+            cb_wait_front(cb_id_recv, padding_tiles);
+            cb_pop_front(cb_id_recv, padding_tiles);
 
-                //For the BO version, determine if we need to perform computation on this block of tiles
-                //For the LO version, every block is computed
-                if (bandwidth_optimal)
-                    recv_block = (block_indexes[i] >> n_block) & 1;  // Extract bit i
+            // Iterate through the tiles a batch at a time. The batch fills batch_tiles DST registers, which are
+            // packed together once its adds are done
+            for (uint32_t tile_num = 0; tile_num < num_tiles; tile_num += batch_tiles) {
 
-                //Iterate through each tile in the block
-                for (uint32_t tile_num = n_block * num_tiles_per_node; tile_num < (n_block + 1) * num_tiles_per_node;
-                     tile_num++) {
-                    cb_wait_front(cb_id_recv, 1); // Await blocks to be exchanged
-                    cb_wait_front(cb_id_local, 1);                   // Unpack
-
-                    //Perform computation only if this block is marked for computation (BO version)
-                    if (recv_block) {
-                        tile_regs_acquire();
-                        add_tiles(cb_id_local, cb_id_recv, 0, 0, reg_index);
-                        tile_regs_commit();
-                        tile_regs_wait();
-                        pack_tile<true>(reg_index, cb_id_local, tile_num);
-                        tile_regs_release();
+                //For the BO version, the blocks not received in this step are skipped up to the next received one,
+                //with a single wait and pop of cb_local. The dataflow kernel pushes the whole vector at once
+                //For the LO version, every block is computed
+                if (bandwidth_optimal) {
+                    uint64_t later_blocks = block_indexes[i] >> (tile_num / num_tiles_per_node);
+                    uint32_t skip_tiles = later_blocks ? num_tiles_per_node * __builtin_ctzll(later_blocks)
+                                                       : num_tiles - tile_num;
+                    if (skip_tiles > 0) {
+                        cb_wait_front(cb_id_local, skip_tiles);
+                        cb_pop_front(cb_id_local, skip_tiles);
+                        tile_num += skip_tiles;
+                        if (tile_num == num_tiles) {
+                            break;
+                        }
                     }
+                }
+
+                cb_wait_front(cb_id_recv, batch_tiles); // Await blocks to be exchanged
+                cb_wait_front(cb_id_local, batch_tiles);                   // Unpack
 
-                    //Pop the blocks after computation
-                    cb_pop_front(cb_id_recv, 1);
-                    cb_pop_front(cb_id_local, 1);
+                tile_regs_acquire();
+                for (uint32_t n_tile = 0; n_tile < batch_tiles; n_tile++) {
+                    add_tiles(cb_id_local, cb_id_recv, n_tile, n_tile, n_tile);
                 }
+                tile_regs_commit();
+                tile_regs_wait();
+                for (uint32_t n_tile = 0; n_tile < batch_tiles; n_tile++) {
+                    pack_tile<true>(n_tile, cb_id_local, tile_num + n_tile);
+                }
+                tile_regs_release();
+
+                //Pop the blocks after computation
+                cb_pop_front(cb_id_recv, batch_tiles);
+                cb_pop_front(cb_id_local, batch_tiles);
             }
         }
     }
@@ -6,6 +6,14 @@
 #include "dataflow_api.h"
 #include "debug/dprint.h"
 #include "third_party/tracy/public/tracy/Tracy.hpp"
+#include "kernel_stats.h"
+
+// Zones of every step (--step-zones), for allred_critical_path. Off by default, they fill the profiler buffer
+#ifdef ALLRED_STEP_ZONES
+#define StepZone(name) DeviceZoneScopedN(name)
+#else
+#define StepZone(name)
+#endif
 
 //Function to synchronize two NOC cores using their circular buffers
 void sync_NOC(int cb_id_this, int cb_id_that) {
@@ -28,6 +36,23 @@ bool shouldSendBlock(bool bandwidth_optimal,
     }
 }
 
+// Number of blocks of mask below n_block. In bandwidth optimal mode the blocks received in a step are packed at the
+// end of cb_recv, after the empty pages, so block n_block of the send mask lands at this index among them
+uint32_t blocksBelow(uint64_t mask, uint32_t n_block) {
+    return __builtin_popcountll(n_block >= 64 ? mask : mask & ((1ull << n_block) - 1));
+}
+
+// Number of syncs of a step the partner sends data in, the strides of sync_stride blocks holding a received block.
+// It doesn't sync the others in bandwidth optimal mode
+uint32_t syncsWithData(bool bandwidth_optimal, uint64_t recv_mask, uint32_t num_syncs, uint32_t sync_stride) {
+    uint32_t syncs = 0;
+    for (uint32_t n_sync = 0; n_sync < num_syncs; n_sync++) {
+        syncs += !bandwidth_optimal ||
+                 blocksBelow(recv_mask, (n_sync + 1) * sync_stride) != blocksBelow(recv_mask, n_sync * sync_stride);
+    }
+    return syncs;
+}
+
 void kernel_main() {
     uint32_t src0_addr = get_arg_val<uint32_t>(0); // Where to read from shared mem
     uint32_t dst0_addr = get_arg_val<uint32_t>(1); // Where to write to shared mem
@@ -37,7 +62,9 @@ void kernel_main() {
     uint32_t bandwidth_optimal = (bool) get_arg_val<uint32_t>(5); // Which algorithm to use
 
     uint32_t algo_steps = get_arg_val<uint32_t>(6); // Number of communication steps
-    uint32_t num_tiles = get_arg_val<uint32_t>(12); //  Total number of tiles involved in the allreduce
+    uint32_t this_core_x = get_arg_val<uint32_t>(7); // Physical coordinates of this core
+    uint32_t this_core_y = get_arg_val<uint32_t>(8);
+    uint32_t num_tiles = get_arg_val<uint32_t>(12); //  Total number of tiles involved in the allreduce (of a chunk)
     uint32_t num_tiles_per_node = get_arg_val<uint32_t>(13); // Number of tiles per NOC node (== tiles/block)
     uint32_t total_nodes = num_tiles / num_tiles_per_node;
     uint32_t side_length;
@@ -62,6 +89,7 @@ void kernel_main() {
     constexpr uint32_t cb_id_NW = tt::CBIndex::c_1; // used as semaphore
     constexpr uint32_t cb_id_SE = tt::CBIndex::c_2; // used as semaphore
     constexpr uint32_t cb_id_recv = tt::CBIndex::c_3; // recieve buffer
+    constexpr uint32_t cb_id_prefetch = tt::CBIndex::c_4; // Next chunk, only created when streaming
     constexpr uint32_t cb_id_local = tt::CBIndex::c_16; // Local data
 
     uint32_t cb_id_this; // Represents the semaphore for this core
@@ -91,6 +119,25 @@ void kernel_main() {
     uint64_t send_block_indexes[algo_steps];
     uint64_t recv_block_indexes[algo_steps];
 
+    // Streaming: the vector in DRAM is num_chunks chunks of num_tiles tiles, reduced one after the other
+    uint32_t num_chunks = get_arg_val<uint32_t>(22 + 6 * algo_steps);
+    uint32_t recv_tiles = get_arg_val<uint32_t>(23 + 6 * algo_steps); // Pages of cb_recv
+    // Synchronizations with the partner per step, chosen by the host (a power of two that divides the blocks)
+    uint32_t num_syncs = get_arg_val<uint32_t>(24 + 6 * algo_steps);
+
+    // Place of each block in L1. The host orders the blocks so that every step sends one contiguous range
+    uint32_t block_position[total_nodes];
+    for (uint32_t n_block = 0; n_block < total_nodes; n_block++) {
+        block_position[n_block] = get_arg_val<uint32_t>(25 + 6 * algo_steps + n_block);
+    }
+
+    // --stats: the stats DRAM buffer. Slots 0 to algo_steps - 1 count the reduce scatter (or allreduce) steps, the
+    // next algo_steps the allgather steps
+    uint32_t stats_addr = get_arg_val<uint32_t>(25 + 6 * algo_steps + total_nodes);
+    uint32_t stats_bank_id = get_arg_val<uint32_t>(26 + 6 * algo_steps + total_nodes);
+    KernelStats stats;
+    stats.Init(2 * algo_steps, this_core_SE);
+
     for (uint32_t i = 0; i < algo_steps; i++) {
         dst_core_x[i] = get_arg_val<uint32_t>(14 + 2 * i);
         dst_core_y[i] = get_arg_val<uint32_t>(15 + 2 * i);
@@ -122,35 +169,24 @@ void kernel_main() {
         semaphore_1_ptr[i] = reinterpret_cast<volatile tt_l1_ptr uint32_t*>(semaphore_1[i]);
     }
 
-    // read data from shared DRAM to local SRAM
-    if (!this_core_SE) {
-        noc_async_read(src0_noc_addr, l1_write_addr_local, tile_size_bytes * num_tiles);
-        noc_async_read_barrier();
-        uint64_t dst0_noc_addr = get_noc_addr_from_bank_id<true>(dst0_bank_id, dst0_addr );
-    }
+    // Number of timed runs of the allreduce, preceded by untimed warmup runs
+    constexpr uint32_t iterations = get_compile_time_arg_val(0);
+    constexpr uint32_t warmup = get_compile_time_arg_val(1);
 
     uint64_t dst_noc_semaphore_0, dst_noc_semaphore_1, dst_noc_addr;
-    bool direction_SE, send_block;
-    uint32_t num_syncs = 32;  // Number of synchronizations performed between the different nodes
-    uint32_t sync_stride = total_nodes / num_syncs;
-    if (num_tiles < 64 && num_tiles > 2) {
-        num_syncs = num_tiles / 2;
-    } else if (num_tiles == 2) {
-        num_syncs = 2;
-        sync_stride = 1;
-    } else if (num_tiles <= 1) {
-        num_syncs = 1;
-        sync_stride = 1;
-    }
+    bool direction_SE = false, send_block;
+    uint32_t sync_stride = total_nodes / num_syncs;  // Blocks between synchronizations
 
-    for (uint32_t j = 0; j < 1; j++) { // # repeats of algorithm to get accurate timings
-        DeviceZoneScopedN("ALL_RED_LOOP");
-        {
+    auto allreduce = [&](uint32_t j) {
+        stats.Run(j >= warmup * num_chunks);
         sync_NOC(cb_id_this, cb_id_that);
         noc_semaphore_set(semaphore_1_ptr[0], 0); // reset semaphores
+        // Syncs of the partners before this step, both RISCs count those of every step as they share semaphore_1
+        uint32_t syncs_received = 0;
         // if bandwidth optimal -> reduce scatter else latency optimal -> allreduce
         for (uint32_t i = 0; i < algo_steps; i++) {
             direction_SE = (packed_direction_bools >> i) & 1;  //Get the communication direction for this step
+            stats.Begin(i);
             sync_NOC(cb_id_this, cb_id_that);
 
             uint32_t n_block_sync = sync_stride;
@@ -161,23 +197,40 @@ void kernel_main() {
                 dst_noc_semaphore_1 = get_noc_addr(dst_core_x[i], dst_core_y[i], semaphore_1[0]);
 
                 // Reserves the entire circular buffer, can only be reserved once computation core is finished
-                cb_reserve_back(cb_id_local, num_tiles);
+                {
+                    StepZone("AR_COMPUTE_WAIT");
+                    stats.CBWait([&] { cb_reserve_back(cb_id_local, num_tiles); });
+                }
+                // In bandwidth optimal mode compute only packs the received blocks, which this core doesn't send in
+                // the same step, so it gets the whole vector at once and skips the other blocks in bulk
+                if (bandwidth_optimal) {
+                    cb_push_back(cb_id_local, num_tiles);
+                }
 
                 // await first sem from comm partner
-                noc_semaphore_inc(dst_noc_semaphore_0, 1);
-                int semaphore_wait_count = bandwidth_optimal ? 2 * j + 1 : j + 1;
-                noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], semaphore_wait_count);
+                {
+                    StepZone("AR_PARTNER_WAIT");
+                    noc_semaphore_inc(dst_noc_semaphore_0, 1);
+                    int semaphore_wait_count = bandwidth_optimal ? 2 * j + 1 : j + 1;
+                    stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], semaphore_wait_count); });
+                }
 
+                StepZone("AR_SEND");
                 // Iterate through the blocks of tiles and send the appropriate ones
+                bool sent_since_sync = false;
                 for (uint32_t n_block = 0; n_block < total_nodes; ) {
                     send_block = shouldSendBlock(bandwidth_optimal, send_block_indexes[i],
                         n_block, num_tiles);
                     uint32_t blocks_to_send = 0;
                     if (send_block) { // true, send all the tiles in this block
                         uint32_t offset = block_size_bytes * n_block;
+                        uint32_t recv_offset = bandwidth_optimal
+                            ? block_size_bytes * (recv_tiles / num_tiles_per_node - blocksBelow(send_block_indexes[i], 64) +
+                                                  blocksBelow(send_block_indexes[i], n_block))
+                            : offset;
 
                         //address to write to
-                        dst_noc_addr = get_noc_addr(dst_core_x[i], dst_core_y[i], l1_write_addr_recv + offset);
+                        dst_noc_addr = get_noc_addr(dst_core_x[i], dst_core_y[i], l1_write_addr_recv + recv_offset);
                         //  Loop to calculate how many contiguous blocks to send
                         while (send_block && n_block < total_nodes && n_block < n_block_sync) { 
                             blocks_to_send++;
@@ -187,15 +240,23 @@ void kernel_main() {
                         }
                         //write to remote node
                         noc_async_write(l1_write_addr_local + offset, dst_noc_addr, block_size_bytes * blocks_to_send);
+                        stats.Write(block_size_bytes * blocks_to_send);
+                        sent_since_sync = true;
                     } else {
                         n_block++;
                     }
                     if (n_block >= n_block_sync) {
                         // Periodically (every num_tiles/num_sync blocks) synchronize the nodes and
-                        // increment the the circular buffers, allowing computation to proceed
-                        noc_async_write_barrier();
-                        noc_semaphore_inc(dst_noc_semaphore_1, 1);
-                        cb_push_back(cb_id_local, num_tiles / num_syncs);
+                        // increment the the circular buffers, allowing computation to proceed. A stride with
+                        // nothing sent is not synchronized, the partner knows from its recv mask
+                        if (sent_since_sync) {
+                            noc_async_write_barrier();
+                            noc_semaphore_inc(dst_noc_semaphore_1, 1);
+                        }
+                        if (!bandwidth_optimal) {
+                            cb_push_back(cb_id_local, num_tiles / num_syncs);
+                        }
+                        sent_since_sync = false;
                         n_block_sync = n_block_sync + sync_stride;
                         if (n_block > num_tiles) {
                             n_block += total_nodes;
@@ -203,17 +264,36 @@ void kernel_main() {
                     }
                 }
             } else { // This core is monitoring the semaphores and passing data to compute asap
-                cb_reserve_back(cb_id_recv, num_tiles);
+                StepZone("AR_RECV");
+                stats.CBWait([&] { cb_reserve_back(cb_id_recv, recv_tiles); });
+                // Empty pages fill the start of the CB, so every step ends where the next one is written. Compute pops
+                // them before the received ones, which it must have all consumed before the partner's next write
+                uint32_t padding_tiles =
+                    bandwidth_optimal ? recv_tiles - num_tiles_per_node * blocksBelow(recv_block_indexes[i], 64) : 0;
+                cb_push_back(cb_id_recv, padding_tiles);
                 // idle core monitors semaphore and pushes data to compute for greater parallelism
+                uint32_t sync_count = syncs_received;
                 for (uint32_t n_block = 0; n_block < num_syncs; n_block++) {
-                    noc_semaphore_wait_min(semaphore_1_ptr[0], i * num_syncs + n_block + 1);
-                    cb_push_back(cb_id_recv, num_tiles / num_syncs);
+                    // In bandwidth optimal mode only the received blocks of this sync's stride arrived, the partner
+                    // doesn't sync the strides without any
+                    uint32_t sync_tiles = bandwidth_optimal
+                        ? num_tiles_per_node * (blocksBelow(recv_block_indexes[i], (n_block + 1) * sync_stride) -
+                                                blocksBelow(recv_block_indexes[i], n_block * sync_stride))
+                        : num_tiles / num_syncs;
+                    if (sync_tiles == 0) {
+                        continue;
+                    }
+                    sync_count++;
+                    stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_1_ptr[0], sync_count); });
+                    cb_push_back(cb_id_recv, sync_tiles);
                 }
             }
+            syncs_received += syncsWithData(bandwidth_optimal, recv_block_indexes[i], num_syncs, sync_stride);
+            stats.End();
         }
-        if (this_core_SE){ // Reserves full buffer to ensure compute has finished
-            cb_reserve_back(cb_id_recv, num_tiles);
-        }
+        // Reserves full buffer to ensure compute has finished. Both RISCs wait, the one that received in the last
+        // step may still be pushing when the other gets here
+        cb_reserve_back(cb_id_recv, recv_tiles);
 
         //This second allgather loop is only performed for the bandwidth optimal algorithm
         if (bandwidth_optimal){
@@ -223,6 +303,7 @@ void kernel_main() {
             //all gather
             for (uint32_t i = algo_steps; i-- > 0; ) {
                 direction_SE = (packed_direction_bools >> i) & 1;  // Extract bit i
+                stats.Begin(algo_steps + i);
                 sync_NOC(cb_id_this, cb_id_that);
                 
                 // If this core is sending/recieving, note the other core is fully idle here.
@@ -231,51 +312,144 @@ void kernel_main() {
                     dst_noc_semaphore_1 = get_noc_addr(dst_core_x[i], dst_core_y[i], semaphore_1[i % num_sem_1]);
 
                     // await first sem from comm partner
-                    noc_semaphore_inc(dst_noc_semaphore_0, 1);
-                    noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], 2 * j + 2);
-
-                    // More or less the same as the scatter loop but in reverse
-                    for (uint32_t n_block = 0; n_block < total_nodes; ) {
-                        //determine if it's necessary to send this block)
-                        send_block = (recv_block_indexes[i] >> n_block) & 1;  
-                        if (send_block) {
-                            uint32_t offset = block_size_bytes * n_block;
-                            dst_noc_addr = get_noc_addr(dst_core_x[i], dst_core_y[i], l1_write_addr_local + offset);
-                            uint32_t tiles_to_send = 0;
-                            // Checks if next block(s) also need to be sent, to reduce number of remote writes
-                            do {
-                                tiles_to_send++;
+                    {
+                        StepZone("AR_GATHER_PARTNER_WAIT");
+                        noc_semaphore_inc(dst_noc_semaphore_0, 1);
+                        stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], 2 * j + 2); });
+                    }
+
+                    {
+                        StepZone("AR_GATHER_SEND");
+                        // More or less the same as the scatter loop but in reverse
+                        for (uint32_t n_block = 0; n_block < total_nodes; ) {
+                            //determine if it's necessary to send this block)
+                            send_block = (recv_block_indexes[i] >> n_block) & 1;  
+                            if (send_block) {
+                                uint32_t offset = block_size_bytes * n_block;
+                                dst_noc_addr = get_noc_addr(dst_core_x[i], dst_core_y[i], l1_write_addr_local + offset);
+                                uint32_t tiles_to_send = 0;
+                                // Checks if next block(s) also need to be sent, to reduce number of remote writes
+                                do {
+                                    tiles_to_send++;
+                                    n_block++;
+                                    if (n_block < total_nodes) {
+                                        send_block = (recv_block_indexes[i] >> n_block) & 1;
+                                    } else {
+                                        send_block = 0;  // Prevent reading past the mask
+                                    }
+                                } while (send_block && n_block < total_nodes);
+                                noc_async_write(l1_write_addr_local + offset, dst_noc_addr, block_size_bytes * tiles_to_send);
+                                stats.Write(block_size_bytes * tiles_to_send);
+                            } else {
                                 n_block++;
-                                if (n_block < total_nodes) {
-                                    send_block = (recv_block_indexes[i] >> n_block) & 1;
-                                } else {
-                                    send_block = 0;  // Prevent reading past the mask
-                                }
-                            } while (send_block && n_block < total_nodes);
-                            noc_async_write(l1_write_addr_local + offset, dst_noc_addr, block_size_bytes * tiles_to_send);
-                        } else {
-                            n_block++;
+                            }
                         }
+                        // Once write has finished, signal the remote core, then await its signal
+                        noc_async_write_barrier();
+                        noc_semaphore_inc(dst_noc_semaphore_1, 1);
+                    }
+                    {
+                        StepZone("AR_GATHER_DATA_WAIT");
+                        uint32_t sem_value = ((algo_steps - i)+1)/2;
+                        stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_1_ptr[i%2], sem_value); });
                     }
-                    // Once write has finished, signal the remote core and await signal.
-                    noc_async_write_barrier();
-                    noc_semaphore_inc(dst_noc_semaphore_1, 1);
-                    uint32_t sem_value = ((algo_steps - i)+1)/2;
-                    noc_semaphore_wait_min(semaphore_1_ptr[i%2], sem_value);
                 }
+                stats.End();
+            }
+        }
+    };
+
+    uint64_t dst0_noc_addr = get_noc_addr_from_bank_id<true>(dst0_bank_id, dst0_addr);
+
+    // Moves a vector between DRAM, where the blocks are in order, and L1, where they are at block_position.
+    // Blocks that stay next to each other are moved together
+    auto move_blocks = [&](uint64_t dram_noc_addr, uint32_t l1_addr, bool to_dram) {
+        for (uint32_t n_block = 0; n_block < total_nodes;) {
+            uint32_t blocks = 1;
+            while (n_block + blocks < total_nodes && block_position[n_block + blocks] == block_position[n_block] + blocks) {
+                blocks++;
             }
+            uint64_t dram_block_addr = dram_noc_addr + block_size_bytes * n_block;
+            uint32_t l1_block_addr = l1_addr + block_size_bytes * block_position[n_block];
+            if (to_dram) {
+                noc_async_write(l1_block_addr, dram_block_addr, block_size_bytes * blocks);
+            } else {
+                noc_async_read(dram_block_addr, l1_block_addr, block_size_bytes * blocks);
+            }
+            n_block += blocks;
+        }
+    };
+
+    // One run over all the chunks. The NW RISC reads the first chunk, then prefetches chunk c + 1 into the
+    // prefetch CB while chunk c is reduced. Once a chunk is reduced every core writes its own block of it back
+    // to dst, and the prefetched chunk is copied into the local CB (as the compute kernel packs in place there)
+    auto stream = [&](uint32_t j) {
+        uint32_t l1_addr_prefetch = get_write_ptr(cb_id_prefetch);
+        uint64_t prefetch_noc_addr = get_noc_addr(this_core_x, this_core_y, l1_addr_prefetch);
+        if (!this_core_SE) {
+            move_blocks(src0_noc_addr, l1_write_addr_local, false);
+            noc_async_read_barrier();
+            move_blocks(src0_noc_addr + total_vector_size_bytes, l1_addr_prefetch, false);
+        }
+        for (uint32_t c = 0; c < num_chunks; c++) {
+            allreduce(j * num_chunks + c);
+            // Both RISCs are done with the chunk, and so are the partners' writes into it
+            sync_NOC(cb_id_this, cb_id_that);
+            if (this_core_SE) {
+                continue;
+            }
+            uint64_t chunk_offset = (uint64_t)total_vector_size_bytes * c;
+            noc_async_write(
+                l1_write_addr_local + block_size_bytes * block_position[this_core_i],
+                dst0_noc_addr + chunk_offset + block_size_bytes * this_core_i,
+                block_size_bytes);
+            if (c + 1 < num_chunks) {
+                noc_async_write_barrier();
+                noc_async_read_barrier();
+                noc_async_read(prefetch_noc_addr, l1_write_addr_local, total_vector_size_bytes);
+                noc_async_read_barrier();
+                if (c + 2 < num_chunks) {
+                    move_blocks(src0_noc_addr + chunk_offset + 2 * total_vector_size_bytes, l1_addr_prefetch, false);
+                }
+            }
+        }
+        if (!this_core_SE) {
+            noc_async_write_barrier();
+        }
+    };
+
+    for (uint32_t j = 0; j < warmup + iterations; j++) { // # repeats of algorithm to get accurate timings
+        // Every run starts from the source data, once both NoC cores are done with the previous run
+        sync_NOC(cb_id_this, cb_id_that);
+        if (num_chunks > 1) {
+            // The DRAM traffic is part of a streamed run, so it is timed
+            if (j >= warmup) {
+                DeviceZoneScopedN("ALL_RED_LOOP");
+                stream(j);
+            } else {
+                stream(j);
+            }
+            continue;
+        }
+        if (!this_core_SE) {
+            move_blocks(src0_noc_addr, l1_write_addr_local, false);
+            noc_async_read_barrier();
         }
+        if (j >= warmup) {
+            DeviceZoneScopedN("ALL_RED_LOOP");
+            allreduce(j);
+        } else {
+            allreduce(j);
         }
     }
-    //Sync, then write data back to shared DRAM
+    //Sync, then write data back to shared DRAM (already done chunk by chunk when streaming)
     sync_NOC(cb_id_this, cb_id_that);
-    if (this_core_SE == direction_SE && this_core_i == print_core) {
-        uint32_t offset = block_size_bytes * total_nodes * this_core_i;
-        uint64_t dst0_noc_addr = get_noc_addr_from_bank_id<true>(dst0_bank_id, dst0_addr);
-        noc_async_write(l1_write_addr_local, dst0_noc_addr, total_vector_size_bytes);
+    if (num_chunks == 1 && this_core_SE == direction_SE && this_core_i == print_core) {
+        move_blocks(dst0_noc_addr, l1_write_addr_local, true);
         noc_async_write_barrier();
         DPRINT << "NOC SE finished" << ENDL();
     } else {
         DPRINT << "NOC NW finished" << ENDL();
     }
+    stats.Flush(stats_addr, stats_bank_id, this_core_i, this_core_SE);
 }
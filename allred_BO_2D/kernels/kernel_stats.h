@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: © 2024 Tenstorrent Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Per step counters of the dataflow kernels (--stats, built with ALLRED_STATS): bytes and number of NoC writes,
+// and wall clock cycles spent waiting on semaphores and CBs, over the timed runs. A RISC keeps its counters in its
+// half of the stats CB and writes them to its region of the stats DRAM buffer once done, see allred_stats.hpp for
+// the layout. Without ALLRED_STATS every call compiles to nothing but the wait itself.
+//
+// No include guard: the shim includes every kernel, and so this file, in a namespace of its own.
+
+#ifdef ALLRED_STATS
+constexpr bool stats_enabled = true;
+#else
+constexpr bool stats_enabled = false;
+#endif
+
+struct StepCounters {
+    uint64_t bytes;            // Written to other cores (or DRAM)
+    uint64_t writes;           // noc_async_write calls
+    uint64_t sem_wait_cycles;  // In noc_semaphore_wait_min
+    uint64_t cb_wait_cycles;   // In cb_reserve_back (or waiting for compute)
+    uint64_t step_cycles;      // From the start of the step to its end on this RISC
+};
+
+class KernelStats {
+public:
+    static constexpr uint32_t cb_id = tt::CBIndex::c_5;
+
+    // Bytes of the region of one RISC: runs and slot count, then the slots, padded to a DRAM write
+    static uint32_t RegionBytes(uint32_t num_slots) {
+        return (2 * sizeof(uint64_t) + num_slots * sizeof(StepCounters) + 31) & ~31u;
+    }
+
+    // Zeroes the region of RISC is_SE (NW first) in the stats CB
+    void Init(uint32_t num_slots, bool is_SE) {
+        if constexpr (stats_enabled) {
+            region_bytes = RegionBytes(num_slots);
+            region_addr = get_write_ptr(cb_id) + (is_SE ? region_bytes : 0);
+            header = reinterpret_cast<tt_l1_ptr uint64_t*>(region_addr);
+            slots = reinterpret_cast<tt_l1_ptr StepCounters*>(region_addr + 2 * sizeof(uint64_t));
+            header[0] = 0;
+            header[1] = num_slots;
+            for (uint32_t slot = 0; slot < num_slots; slot++) {
+                slots[slot] = StepCounters{0, 0, 0, 0, 0};
+            }
+        }
+    }
+
+    // Starts a run of the allreduce, only timed runs are counted
+    void Run(bool timed) {
+        if constexpr (stats_enabled) {
+            counting = timed;
+            header[0] += timed;
+        }
+    }
+
+    // The step counted in slot until End
+    void Begin(uint32_t slot) {
+        if constexpr (stats_enabled) {
+            current = counting ? &slots[slot] : nullptr;
+            step_start = Now();
+        }
+    }
+
+    void End() {
+        if constexpr (stats_enabled) {
+            if (current) {
+                current->step_cycles += Now() - step_start;
+            }
+            current = nullptr;
+        }
+    }
+
+    void Write(uint32_t bytes) {
+        if constexpr (stats_enabled) {
+            if (current) {
+                current->bytes += bytes;
+                current->writes++;
+            }
+        }
+    }
+
+    // Runs wait, a semaphore or CB wait, and counts its cycles
+    template <typename Wait>
+    void SemaphoreWait(Wait wait) {
+        uint32_t start = Now();
+        wait();
+        if constexpr (stats_enabled) {
+            if (current) {
+                current->sem_wait_cycles += Now() - start;
+            }
+        }
+    }
+
+    template <typename Wait>
+    void CBWait(Wait wait) {
+        uint32_t start = Now();
+        wait();
+        if constexpr (stats_enabled) {
+            if (current) {
+                current->cb_wait_cycles += Now() - start;
+            }
+        }
+    }
+
+    // Writes the region to the slab of core core_i in the stats buffer, after this RISC's last write
+    void Flush(uint32_t stats_addr, uint32_t stats_bank_id, uint32_t core_i, bool is_SE) {
+        if constexpr (stats_enabled) {
+            uint32_t offset = (2 * core_i + is_SE) * region_bytes;
+            noc_async_write(region_addr, get_noc_addr_from_bank_id<true>(stats_bank_id, stats_addr + offset), region_bytes);
+            noc_async_write_barrier();
+        }
+    }
+
+private:
+    // The low word of the wall clock, differences are right as long as a step takes less than 2^32 cycles
+    static uint32_t Now() {
+        if constexpr (stats_enabled) {
+            return reg_read(RISCV_DEBUG_REG_WALL_CLOCK_L);
+        }
+        return 0;
+    }
+
+    uint32_t region_addr = 0;
+    uint32_t region_bytes = 0;
+    tt_l1_ptr uint64_t* header = nullptr;
+    tt_l1_ptr StepCounters* slots = nullptr;
+    tt_l1_ptr StepCounters* current = nullptr;  // Null in untimed runs and between steps
+    uint32_t step_start = 0;
+    bool counting = false;
+};
@@ -6,6 +6,7 @@
 #include "dataflow_api.h"
 #include "debug/dprint.h"
 #include "third_party/tracy/public/tracy/Tracy.hpp"
+#include "../../allred_BO_2D/kernels/kernel_stats.h"
 
 void sync_NOC(int cb_id_this, int cb_id_that) {
     cb_reserve_back(cb_id_that, 1);
@@ -84,6 +85,15 @@ void kernel_main() {
         dst_core_y[i] = get_arg_val<uint32_t>(15 + 2 * i);
     }
 
+    // Synchronizations with the partner per step, chosen by the host (a power of two that divides the vector)
+    uint32_t num_syncs = get_arg_val<uint32_t>(24 + 6 * algo_steps);
+
+    // --stats: the stats DRAM buffer, after the BO kernel's args (one block position per node). Slot i counts step i
+    uint32_t stats_addr = get_arg_val<uint32_t>(25 + 6 * algo_steps + (1u << algo_steps));
+    uint32_t stats_bank_id = get_arg_val<uint32_t>(26 + 6 * algo_steps + (1u << algo_steps));
+    KernelStats stats;
+    stats.Init(2 * algo_steps, this_core_SE);
+
     // Read and setup semaphores
     const uint32_t num_sem_0 = 6;
     const uint32_t num_sem_1 = 8 - num_sem_0;
@@ -102,36 +112,22 @@ void kernel_main() {
         semaphore_1_ptr[i] = reinterpret_cast<volatile tt_l1_ptr uint32_t*>(semaphore_1[i]);
     }
 
-    // read ublocks from src to local
-    if (!this_core_SE) {
-        noc_async_read(src0_noc_addr, l1_write_addr_local, ublock_size_bytes_data * num_tiles);
-        noc_async_read_barrier();
-        uint64_t dst0_noc_addr = get_noc_addr_from_bank_id<true>(dst0_bank_id, dst0_addr );
-    }
+    // Number of timed runs of the allreduce, preceded by untimed warmup runs
+    constexpr uint32_t iterations = get_compile_time_arg_val(0);
+    constexpr uint32_t warmup = get_compile_time_arg_val(1);
 
     uint64_t dst_noc_semaphore_0, dst_noc_semaphore_1, dst_noc_addr;
-    bool direction_SE;
-    uint32_t num_syncs = 32;  // Default max synchronizations
-    uint32_t sync_stride = num_tiles / num_syncs;
-    if (num_tiles < 64 && num_tiles > 2) {
-        num_syncs = num_tiles / 2;
-        sync_stride = num_tiles / num_syncs;
-    } else if (num_tiles == 2) {
-        num_syncs = 2;
-        sync_stride = 1;
-    } else if (num_tiles <= 1) {
-        num_syncs = 1;
-        sync_stride = 1;
-    }
+    bool direction_SE = false;
+    uint32_t sync_stride = num_tiles / num_syncs;  // Tiles between synchronizations
     uint32_t total_sem_iters = 0;
-    for (uint32_t j = 0; j < 1; j++) { // # repeats of algorithm to get accurate timings
-        DeviceZoneScopedN("ALL_RED_LOOP");
-        {
+    auto allreduce = [&](uint32_t j) {
+        stats.Run(j + 1 > warmup);
         sync_NOC(cb_id_this, cb_id_that);
         noc_semaphore_set(semaphore_1_ptr[0], 0);
         // bandwidth optimal ? reduce scatter : allreduce
         for (uint32_t i = 0; i < algo_steps; i++) {
             direction_SE = (packed_direction_bools >> i) & 1;  // Extract bit i
+            stats.Begin(i);
             sync_NOC(cb_id_this, cb_id_that);
             int total_tiles_pushed = 0;
             
@@ -139,16 +135,17 @@ void kernel_main() {
                 dst_noc_semaphore_0 = get_noc_addr(dst_core_x[i], dst_core_y[i], semaphore_0[i % num_sem_0]);
                 dst_noc_semaphore_1 = get_noc_addr(dst_core_x[i], dst_core_y[i], semaphore_1[0]);
 
-                cb_reserve_back(cb_id_local, num_tiles);
+                stats.CBWait([&] { cb_reserve_back(cb_id_local, num_tiles); });
 
                 // await first sem from comm partner
                 noc_semaphore_inc(dst_noc_semaphore_0, 1);
-                noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], j + 1);
+                stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], j + 1); });
 
                 for (uint32_t n_sync = 0; n_sync < num_syncs; n_sync++) {
-                    uint32_t offset = tile_block_size * n_sync * sync_stride;
+                    uint32_t offset = ublock_size_bytes_data * n_sync * sync_stride;
                     dst_noc_addr = get_noc_addr(dst_core_x[i], dst_core_y[i], l1_write_addr_recv + offset);
                     noc_async_write(l1_write_addr_local + offset, dst_noc_addr, ublock_size_bytes_data * sync_stride);
+                    stats.Write(ublock_size_bytes_data * sync_stride);
                     noc_async_write_barrier();
                     noc_semaphore_inc(dst_noc_semaphore_1, 1);
                     total_sem_iters++;
@@ -157,21 +154,36 @@ void kernel_main() {
                     // DPRINT << "Core itered sem to " << total_sem_iters << " and pushed " << total_tiles_pushed << ENDL();
                 }
             } else {
-                cb_reserve_back(cb_id_recv, num_tiles);
+                stats.CBWait([&] { cb_reserve_back(cb_id_recv, num_tiles); });
                 // idle core monitors semaphore and pushes data to compute for greater parallelism
                 for (uint32_t n_sync = 0; n_sync < num_syncs; n_sync++) {
-                    noc_semaphore_wait_min(semaphore_1_ptr[0], i * num_syncs + n_sync + 1);
+                    stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_1_ptr[0], i * num_syncs + n_sync + 1); });
                     cb_push_back(cb_id_recv, sync_stride);
                     total_sem_iters++;
                     total_tiles_pushed += sync_stride;
                     // DPRINT << "Core waited sem to " << i * num_syncs + n_sync + 1 << " and pushed " << total_tiles_pushed << ENDL();
                 }
             }
+            stats.End();
         }
-        }
-    }
-    if (this_core_SE){
+        // Reserves full buffer to ensure compute has finished. Both RISCs wait, the one that received in the last
+        // step may still be pushing when the other gets here
         cb_reserve_back(cb_id_recv, num_tiles);
+    };
+
+    for (uint32_t j = 0; j < warmup + iterations; j++) { // # repeats of algorithm to get accurate timings
+        // Every run starts from the source data, once both NoC cores are done with the previous run
+        sync_NOC(cb_id_this, cb_id_that);
+        if (!this_core_SE) {
+            noc_async_read(src0_noc_addr, l1_write_addr_local, ublock_size_bytes_data * num_tiles);
+            noc_async_read_barrier();
+        }
+        if (j >= warmup) {
+            DeviceZoneScopedN("ALL_RED_LOOP");
+            allreduce(j);
+        } else {
+            allreduce(j);
+        }
     }
     sync_NOC(cb_id_this, cb_id_that);
     if (this_core_SE == direction_SE && this_core_i == print_core) {
@@ -183,4 +195,5 @@ void kernel_main() {
     } else {
         DPRINT << "NOC NW finished" << ENDL();
     }
+    stats.Flush(stats_addr, stats_bank_id, this_core_i, this_core_SE);
 }
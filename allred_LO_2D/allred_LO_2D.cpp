@@ -7,6 +7,8 @@
 #include "allred_helper.hpp"
 
 int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+
     IDevice* device = CreateDevice(0);
 
     CommandQueue& cq = device->command_queue();
@@ -16,7 +18,16 @@ int main(int argc, char** argv) {
     CoreRange cores({0, 0}, {SIDE_LENGTH - 1, SIDE_LENGTH - 1});
 
     // Initialize the allreduce  setup
-    AllredConfig arCfg(argc, argv, device, cq, program, cores, SIDE_LENGTH, false);
+    AllredConfig arCfg(argc, argv, device, cq, SIDE_LENGTH, false, options);
+    if (arCfg.NUM_CHUNKS > 1) {
+        printf("allred_LO_2D holds the whole vector in L1, allred_BO_2D with arg 8 = 0 streams larger vectors\n");
+        CloseDevice(device);
+        return 1;
+    }
+    arCfg.CreateCircularBuffers(program, cores);
+    if (arCfg.ITERATIONS > 1 || arCfg.WARMUP > 0) {
+        printf("allred_LO_2D runs the allreduce once, --iterations and --warmup are ignored\n");
+    }
 
     /*NOC kernel arg initialization*/
     std::vector<uint32_t> dataflow_args(12 + 8 + 2 * arCfg.SWING_ALGO_STEPS);
@@ -49,13 +60,7 @@ int main(int argc, char** argv) {
         dataflow_args[8] = (uint32_t)physical_core.y;
         compute_args[1] = (uint32_t)physical_core.x;
         compute_args[2] = (uint32_t)physical_core.y;
-        if (arCfg.core_array[core_i].x % 2 == 0) {
-            dataflow_args[0] = arCfg.src_1_dram_buffer->address();
-            dataflow_args[2] = arCfg.src_1_bank_id;
-        } else {
-            dataflow_args[0] = arCfg.src_0_dram_buffer->address();
-            dataflow_args[2] = arCfg.src_0_bank_id;
-        }
+        arCfg.SetSourceArgs(core_i, dataflow_args);
 
         horizontal_step = true;  // Start calcs on hrz step
         if (!arCfg.SWING_VERSION) {
@@ -65,7 +70,7 @@ int main(int argc, char** argv) {
                 int comm_partner_id = get_comm_partner_recdub_2D(
                     core_i, recdub_step, horizontal_step, message_pass_depth, step_directions, SIDE_LENGTH);
 
-                logical_core = {comm_partner_id % SIDE_LENGTH, comm_partner_id / SIDE_LENGTH};
+                logical_core = arCfg.core_array[comm_partner_id];
 
                 physical_core = device->worker_core_from_logical_core(logical_core);
                 dataflow_args[12 + 2 * recdub_step] = (uint32_t)physical_core.x;
@@ -87,7 +92,8 @@ int main(int argc, char** argv) {
                 dataflow_args[13 + 2 * swing_step] = (uint32_t)physical_core.y;
                 horizontal_step = !horizontal_step;
             }
-            step_directions = get_step_directions(arCfg.core_array[core_i].x, arCfg.core_array[core_i].y);
+            // Directions follow the rank, like the partners, so they stay consistent under --placement
+            step_directions = get_step_directions(core_i % SIDE_LENGTH, core_i / SIDE_LENGTH);
         }
 
         dataflow_args[10] = step_directions;
@@ -95,11 +101,11 @@ int main(int argc, char** argv) {
 
         /*SE Kernel*/
         dataflow_args[9] = (uint32_t)true;
-        dataflow_0_kernel = CreateDataflowKernel(program, arCfg.core_array[core_i], dataflow_args, true,"allred_LO_2D");  // SE kernel
+        dataflow_0_kernel = CreateDataflowKernel(program, arCfg.core_array[core_i], dataflow_args, true,"allred_LO_2D", arCfg.KernelCompileArgs());  // SE kernel
         /*NW Kernel*/
         dataflow_args[9] = (uint32_t)false;
-        dataflow_1_kernel = CreateDataflowKernel(program, arCfg.core_array[core_i], dataflow_args, false,"allred_LO_2D"); // NW kernel
-        compute_kernel = CreateComputeKernel(program, arCfg.core_array[core_i], compute_args,"allred_LO_2D");
+        dataflow_1_kernel = CreateDataflowKernel(program, arCfg.core_array[core_i], dataflow_args, false,"allred_LO_2D", arCfg.KernelCompileArgs()); // NW kernel
+        compute_kernel = CreateComputeKernel(program, arCfg.core_array[core_i], compute_args,"allred_LO_2D", arCfg.KernelCompileArgs());
     }
 
     arCfg.RunProgram(cq, program, device);
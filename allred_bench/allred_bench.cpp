@@ -0,0 +1,488 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <tt-metalium/bfloat16.hpp>
+#include "allred_bf16.hpp"
+#include "allred_emulator.hpp"
+#include "allred_reference.hpp"
+#include "allred_schedule.hpp"
+#include "allred_tile_ring.hpp"
+#include "allred_validate.hpp"
+
+// Host microbenchmarks for the allreduce helpers. Arg 1 selects the benchmark, all are run by default.
+
+namespace {
+
+// Runs fn repeatedly for at least min_ms and returns the mean time per call in microseconds
+template <typename Fn>
+double time_us(Fn&& fn, double min_ms = 200.0) {
+    using clock = std::chrono::steady_clock;
+    uint64_t calls = 0;
+    auto start = clock::now();
+    double elapsed_ms = 0.0;
+    do {
+        fn();
+        calls++;
+        elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    } while (elapsed_ms < min_ms);
+    return elapsed_ms * 1000.0 / calls;
+}
+
+// Block masks of all cores and steps, the way allred_BO_2D computed them before the planner
+void recursive_block_masks(bool swing_version, int SIDE_LENGTH, std::vector<uint32_t>& masks) {
+    int total_nodes = SIDE_LENGTH * SIDE_LENGTH;
+    uint32_t algo_steps = SchedulePlanner::Get(swing_version, SIDE_LENGTH).algo_steps;
+    masks.assign(4 * algo_steps * total_nodes, 0);
+    uint32_t dummy_step_directions = 0;
+    for (int core_i = 0; core_i < total_nodes; core_i++) {
+        bool horizontal_step = true;
+        int message_pass_depth = 1;
+        uint32_t step_directions = 0;
+        for (uint32_t algo_step = 0; algo_step < algo_steps; algo_step++) {
+            int comm_partner_idx = swing_version
+                ? get_comm_partner_swing_2D(core_i, algo_step, horizontal_step, SIDE_LENGTH, total_nodes)
+                : get_comm_partner_recdub_2D(
+                      core_i, algo_step, horizontal_step, message_pass_depth, step_directions, SIDE_LENGTH);
+            uint32_t* blocks_to_send = &masks[4 * (algo_step * total_nodes + core_i)];
+            uint32_t* blocks_to_recv = blocks_to_send + 2;
+            blocks_to_send[comm_partner_idx / 32] |= 1u << (comm_partner_idx % 32);
+            blocks_to_recv[core_i / 32] |= 1u << (core_i % 32);
+            message_pass_depth = horizontal_step ? message_pass_depth : 2 * message_pass_depth;
+            horizontal_step = !horizontal_step;
+            if (swing_version) {
+                get_swing_block_comm_indexes(
+                    comm_partner_idx, algo_step + 1, blocks_to_send, horizontal_step, SIDE_LENGTH, total_nodes);
+                get_swing_block_comm_indexes(
+                    core_i, algo_step + 1, blocks_to_recv, horizontal_step, SIDE_LENGTH, total_nodes);
+            } else {
+                get_recdub_block_comm_indexes(
+                    comm_partner_idx, algo_step + 1, blocks_to_send, horizontal_step, SIDE_LENGTH, total_nodes,
+                    message_pass_depth, dummy_step_directions);
+                get_recdub_block_comm_indexes(
+                    core_i, algo_step + 1, blocks_to_recv, horizontal_step, SIDE_LENGTH, total_nodes,
+                    message_pass_depth, dummy_step_directions);
+            }
+        }
+    }
+}
+
+// Compares the recursive block mask computation against the closed form planner
+bool bench_planner() {
+    bool all_match = true;
+    printf("%-8s %-6s %14s %14s %14s\n", "algo", "side", "recursive[us]", "planner[us]", "cached[us]");
+    for (int swing_version = 0; swing_version < 2; swing_version++) {
+        for (int SIDE_LENGTH = 2; SIDE_LENGTH <= 8; SIDE_LENGTH *= 2) {
+            std::vector<uint32_t> masks;
+            recursive_block_masks(swing_version, SIDE_LENGTH, masks);
+            SchedulePlan plan = SchedulePlanner::Build(swing_version, SIDE_LENGTH, SIDE_LENGTH);
+            for (uint32_t step = 0; step < plan.algo_steps; step++) {
+                for (uint32_t core = 0; core < plan.total_nodes; core++) {
+                    const uint32_t* expected = &masks[4 * (step * plan.total_nodes + core)];
+                    uint64_t send = ((uint64_t)expected[1] << 32) | expected[0];
+                    uint64_t recv = ((uint64_t)expected[3] << 32) | expected[2];
+                    if (plan.send(core, step).word64(0) != send || plan.recv(core, step).word64(0) != recv) {
+                        printf("Mismatch: algo %d side %d core %u step %u\n", swing_version, SIDE_LENGTH, core, step);
+                        all_match = false;
+                    }
+                }
+            }
+            for (uint32_t core = 0; core < plan.total_nodes && swing_version; core++) {
+                uint32_t step_mask = (1u << plan.algo_steps) - 1;
+                uint32_t expected = get_step_directions(core % SIDE_LENGTH, core / SIDE_LENGTH) & step_mask;
+                if (plan.step_directions[core] != expected) {
+                    printf("Step direction mismatch: side %d core %u\n", SIDE_LENGTH, core);
+                    all_match = false;
+                }
+            }
+
+            double recursive_us = time_us([&] { recursive_block_masks(swing_version, SIDE_LENGTH, masks); });
+            double planner_us = time_us([&] { plan = SchedulePlanner::Build(swing_version, SIDE_LENGTH, SIDE_LENGTH); });
+            double cached_us = time_us([&] { SchedulePlanner::Get(swing_version, SIDE_LENGTH); });
+            printf(
+                "%-8s %-6d %14.2f %14.2f %14.3f\n",
+                swing_version ? "swing" : "recdub",
+                SIDE_LENGTH,
+                recursive_us,
+                planner_us,
+                cached_us);
+        }
+    }
+    return all_match;
+}
+
+// Mask generation and runtime arg packing for grids larger than one chip
+bool bench_wide_masks() {
+    const int grids[][2] = {{16, 8}, {2, 64}, {16, 16}, {32, 16}};
+    bool success = true;
+    printf("%-8s %-8s %6s %6s %12s %14s %14s\n", "algo", "grid", "nodes", "words", "args/core", "planner[us]", "packing[us]");
+    for (int swing_version = 0; swing_version < 2; swing_version++) {
+        for (const auto& grid : grids) {
+            int width = grid[0], height = grid[1];
+            SchedulePlan plan = SchedulePlanner::Build(swing_version, width, height);
+            BOArgLayout layout(plan.algo_steps, plan.total_nodes);
+            std::vector<uint32_t> dataflow_args(layout.dataflow_size());
+            std::vector<uint32_t> compute_args(layout.compute_size());
+            PhysicalCoreFn physical_core = [&](int core_i) {
+                return std::make_pair((uint32_t)(core_i % width), (uint32_t)(core_i / width));
+            };
+
+            // After the reduce-scatter every core must own exactly its own block
+            for (uint32_t core = 0; core < plan.total_nodes; core++) {
+                const BlockSet& last_recv = plan.recv(core, plan.algo_steps - 1);
+                if (last_recv.count() != 1 || !last_recv.test(core)) {
+                    printf("Core %u does not end up owning its block on %dx%d\n", core, width, height);
+                    success = false;
+                    break;
+                }
+            }
+
+            double planner_us = time_us([&] { plan = SchedulePlanner::Build(swing_version, width, height); });
+            double packing_us = time_us([&] {
+                for (uint32_t core_i = 0; core_i < plan.total_nodes; core_i++) {
+                    fill_BO_schedule_args(core_i, plan, physical_core, dataflow_args, compute_args);
+                }
+            });
+            printf(
+                "%-8s %3dx%-4d %6u %6u %12u %14.2f %14.2f\n",
+                swing_version ? "swing" : "recdub",
+                width,
+                height,
+                plan.total_nodes,
+                layout.mask_words,
+                layout.dataflow_size(),
+                planner_us,
+                packing_us);
+        }
+    }
+    return success;
+}
+
+// Validation the way validate_result_vector did it before allred_validate: unpack every buffer into
+// bfloat16 vectors, then compare element by element
+ValidationResult unpacked_validate(
+    const std::vector<uint32_t>& result_vec,
+    const std::vector<uint32_t>& src_vec_0,
+    const std::vector<uint32_t>& src_vec_1,
+    float error,
+    float scale) {
+    std::vector<bfloat16> result_vec_b16 = unpack_uint32_vec_into_bfloat16_vec(result_vec);
+    std::vector<bfloat16> src_vec_0_b16 = unpack_uint32_vec_into_bfloat16_vec(src_vec_0);
+    std::vector<bfloat16> src_vec_1_b16 = unpack_uint32_vec_into_bfloat16_vec(src_vec_1);
+    std::vector<bfloat16> trgt_vec_b16 = unpack_uint32_vec_into_bfloat16_vec(src_vec_1);
+
+    ValidationResult validation;
+    validation.num_values = result_vec_b16.size();
+    for (size_t i = 0; i < result_vec_b16.size(); i++) {
+        trgt_vec_b16[i] = static_cast<bfloat16>((src_vec_0_b16[i].to_float() + src_vec_1_b16[i].to_float()) * scale);
+        float diff = std::fabs(result_vec_b16[i].to_float() - trgt_vec_b16[i].to_float());
+        if (diff <= error) {
+            validation.num_matches++;
+        }
+        if (diff > validation.max_error) {
+            validation.max_error = diff;
+            validation.max_error_index = i;
+        }
+    }
+    return validation;
+}
+
+// Compares validate_allreduce against an element by element reference and times it against the
+// unpacking version, on the vector size of a 64 core run with 320 tiles
+bool bench_validate() {
+    const size_t num_words = 320 * 512;
+    const float error = 32.0f;
+    const float scale = 32.0f;
+    std::vector<uint32_t> src_vec_0(num_words), src_vec_1(num_words), result_vec(num_words);
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> dist(0.0f, 100.0f);
+    for (size_t i = 0; i < num_words; i++) {
+        src_vec_0[i] = float_to_bf16(dist(rng)) | (uint32_t)float_to_bf16(dist(rng)) << 16;
+        src_vec_1[i] = float_to_bf16(dist(rng)) | (uint32_t)float_to_bf16(dist(rng)) << 16;
+        uint16_t lo = float_to_bf16(expected_allreduce_value(src_vec_0[i] & 0xffff, src_vec_1[i] & 0xffff, scale));
+        uint16_t hi = float_to_bf16(expected_allreduce_value(src_vec_0[i] >> 16, src_vec_1[i] >> 16, scale));
+        result_vec[i] = lo | (uint32_t)hi << 16;
+    }
+    // A few wrong values, in the middle and the tail of tiles
+    for (size_t word : {1000ul, 1001ul, 70000ul, num_words - 1}) {
+        result_vec[word] += 0x00400000;
+    }
+
+    ValidationResult expected;
+    expected.num_values = 2 * num_words;
+    for (size_t i = 0; i < 2 * num_words; i++) {
+        uint32_t shift = 16 * (i % 2);
+        float actual = bf16_to_float(result_vec[i / 2] >> shift);
+        float diff = std::fabs(actual - expected_allreduce_value(src_vec_0[i / 2] >> shift, src_vec_1[i / 2] >> shift, scale));
+        if (diff <= error) {
+            expected.num_matches++;
+        } else if (expected.mismatch_tiles.empty() || expected.mismatch_tiles.back() != i / VALIDATE_TILE_ELEMENTS) {
+            expected.first_mismatch_index = expected.mismatch_tiles.empty() ? i : expected.first_mismatch_index;
+            expected.mismatch_tiles.push_back(i / VALIDATE_TILE_ELEMENTS);
+        }
+        if (diff > expected.max_error) {
+            expected.max_error = diff;
+            expected.max_error_index = i;
+        }
+    }
+
+    ValidationResult validation =
+        validate_allreduce(result_vec.data(), src_vec_0.data(), src_vec_1.data(), num_words, error, scale);
+    bool success = validation.num_matches == expected.num_matches && validation.max_error == expected.max_error &&
+                   validation.max_error_index == expected.max_error_index &&
+                   validation.first_mismatch_index == expected.first_mismatch_index &&
+                   validation.mismatch_tiles == expected.mismatch_tiles;
+    if (!success) {
+        printf("validate_allreduce disagrees with the reference\n");
+    }
+
+    double unpacked_us = time_us([&] { unpacked_validate(result_vec, src_vec_0, src_vec_1, error, scale); });
+    double fused_us = time_us([&] {
+        validate_allreduce(result_vec.data(), src_vec_0.data(), src_vec_1.data(), num_words, error, scale);
+    });
+    printf("%-10s %10s %14s %14s %10s\n", "impl", "bytes", "unpacked[us]", "fused[us]", "speedup");
+    printf(
+        "%-10s %10zu %14.1f %14.1f %9.1fx\n",
+        validate_implementation(),
+        num_words * sizeof(uint32_t),
+        unpacked_us,
+        fused_us,
+        unpacked_us / fused_us);
+    return success;
+}
+
+// Random bfloat16 values in [0, 100), packed two per word
+std::vector<uint32_t> random_packed_vector(size_t num_words, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(0.0f, 100.0f);
+    std::vector<uint32_t> vec(num_words);
+    for (uint32_t& word : vec) {
+        word = float_to_bf16(dist(rng)) | (uint32_t)float_to_bf16(dist(rng)) << 16;
+    }
+    return vec;
+}
+
+// Checks the device order reference bit for bit against the emulator on distinct per-core inputs,
+// then times both reference orders on 64 cores x 320 tiles
+bool bench_reference() {
+    const int SIDE_LENGTH = 8;
+    const uint32_t NUM_TILES = 320;
+    const size_t num_words = NUM_TILES * 512;
+    bool success = true;
+
+    std::vector<std::vector<uint32_t>> core_inputs;
+    std::vector<const uint32_t*> inputs;
+    for (int core_i = 0; core_i < SIDE_LENGTH * SIDE_LENGTH; core_i++) {
+        core_inputs.push_back(random_packed_vector(num_words, core_i));
+    }
+    for (const std::vector<uint32_t>& input : core_inputs) {
+        inputs.push_back(input.data());
+    }
+
+    for (int swing_version = 0; swing_version < 2; swing_version++) {
+        for (int bandwidth_optimal = 0; bandwidth_optimal < 2; bandwidth_optimal++) {
+            const SchedulePlan& plan = SchedulePlanner::Get(swing_version, SIDE_LENGTH);
+            std::vector<std::pair<uint32_t, uint32_t>> physical_cores(plan.total_nodes);
+            for (uint32_t core_i = 0; core_i < plan.total_nodes; core_i++) {
+                physical_cores[core_i] = wormhole_worker_core(core_i % SIDE_LENGTH, core_i / SIDE_LENGTH);
+            }
+            PhysicalCoreFn physical_core = [&](int core_i) { return physical_cores[core_i]; };
+
+            AllredArgTables args = build_BO_arg_tables(plan, physical_core, bandwidth_optimal, NUM_TILES);
+            AllredEmulator emulator(physical_cores);
+            for (uint32_t core_i = 0; core_i < plan.total_nodes; core_i++) {
+                emulator.SetCoreArgs(core_i, args.dataflow[core_i], args.compute[core_i]);
+                emulator.SetCoreInput(core_i, core_inputs[core_i]);
+            }
+            EmulatorResult result = emulator.Run();
+            if (!result.success) {
+                printf("Emulation failed (algo %d mode %d): %s\n", swing_version, bandwidth_optimal, result.error.c_str());
+                return false;
+            }
+
+            AllredReference reference(plan, bandwidth_optimal);
+            for (uint32_t core_i = 0; core_i < plan.total_nodes; core_i++) {
+                std::vector<uint32_t> golden = reference.Run(inputs, num_words, ReferenceOrder::Device, core_i);
+                if (golden != emulator.CoreResult(core_i)) {
+                    printf(
+                        "Device order reference differs from the emulator: algo %d mode %d core %u\n",
+                        swing_version,
+                        bandwidth_optimal,
+                        core_i);
+                    success = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    const SchedulePlan& plan = SchedulePlanner::Get(true, SIDE_LENGTH);
+    std::vector<unsigned> thread_counts = {1};
+    if (std::thread::hardware_concurrency() > 1) {
+        thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+    printf("%-8s %8s %16s %16s\n", "order", "threads", "time[ms]", "max err vs float");
+    std::vector<uint32_t> float_golden = AllredReference(plan, true).Run(inputs, num_words, ReferenceOrder::Float);
+    for (ReferenceOrder order : {ReferenceOrder::Float, ReferenceOrder::Device}) {
+        for (unsigned threads : thread_counts) {
+            AllredReference reference(plan, true, threads);
+            std::vector<uint32_t> golden;
+            double elapsed_us = time_us([&] { golden = reference.Run(inputs, num_words, order); }, 500.0);
+            ValidationResult validation = validate_against_golden(golden.data(), float_golden.data(), num_words, 0.0f);
+            printf(
+                "%-8s %8u %16.2f %16.1f\n",
+                order == ReferenceOrder::Float ? "float" : "device",
+                threads,
+                elapsed_us / 1000.0,
+                validation.max_error);
+        }
+    }
+    return success;
+}
+
+// Cost of building the runtime arg tables of a program against that of the DRAM arg patch of a cached one,
+// see AllredProgramCache
+bool bench_arg_tables() {
+    const int SIDE_LENGTH = 8;
+    const uint32_t NUM_TILES = 320;
+    PhysicalCoreFn physical_core = [](int core_i) {
+        return wormhole_worker_core(core_i % SIDE_LENGTH, core_i / SIDE_LENGTH);
+    };
+    printf("%-8s %-10s %14s %14s\n", "algo", "variant", "build[us]", "patch[us]");
+    for (int swing_version = 0; swing_version < 2; swing_version++) {
+        const SchedulePlan& plan = SchedulePlanner::Get(swing_version, SIDE_LENGTH);
+        for (const char* variant : {"BO", "LO", "mem"}) {
+            bool mem = std::string(variant) == "mem";
+            auto build = [&] {
+                return mem ? build_mem_arg_tables(plan, physical_core, NUM_TILES)
+                           : build_BO_arg_tables(plan, physical_core, std::string(variant) == "BO", NUM_TILES);
+            };
+            AllredArgTables args = build();
+            double build_us = time_us([&] { args = build(); });
+            uint32_t address = 0;
+            double patch_us = time_us([&] {
+                address += 2048;
+                for (std::vector<uint32_t>& dataflow_args : args.dataflow) {
+                    dataflow_args[0] = dataflow_args[1] = address;
+                }
+            });
+            printf("%-8s %-10s %14.2f %14.3f\n", swing_version ? "swing" : "recdub", variant, build_us, patch_us);
+        }
+    }
+    return true;
+}
+
+// Handoff latency between a producer and a consumer thread through TileRings, and the time to move one BO step
+// of tiles through cb_recv when it is pushed in num_syncs chunks, as the dataflow kernels do, with the consumer
+// adding every tile like the compute kernel
+bool bench_tile_ring() {
+    using clock = std::chrono::steady_clock;
+    const uint32_t TILE_SIZE = 2048;
+    const uint32_t TILE_WORDS = TILE_SIZE / sizeof(uint32_t);
+
+    // One page each way, so every round trip is two handoffs
+    const uint32_t ROUND_TRIPS = 20000;
+    TileRing ping(TILE_SIZE, TILE_SIZE);
+    TileRing pong(TILE_SIZE, TILE_SIZE);
+    std::thread echo([&] {
+        for (uint32_t i = 0; i < ROUND_TRIPS; i++) {
+            ping.WaitFront(1);
+            ping.Pop(1);
+            pong.ReserveBack(1);
+            pong.Push(1);
+        }
+    });
+    auto start = clock::now();
+    for (uint32_t i = 0; i < ROUND_TRIPS; i++) {
+        ping.ReserveBack(1);
+        ping.Push(1);
+        pong.WaitFront(1);
+        pong.Pop(1);
+    }
+    double handoff_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (2.0 * ROUND_TRIPS);
+    echo.join();
+    printf("Handoff latency: %.0f ns (%u hardware threads)\n", handoff_ns, std::thread::hardware_concurrency());
+
+    const uint32_t NUM_TILES = 64;
+    const uint32_t STEPS = 100;
+    std::vector<uint32_t> source(NUM_TILES * TILE_WORDS);
+    std::mt19937 rng(13);
+    for (uint32_t& word : source) {
+        word = (rng() & 0x3fff3fff) | 0x3c003c00;  // bfloat16 values in [1, 4)
+    }
+    printf("%-10s %12s %14s\n", "num_syncs", "step[us]", "vs 1 sync");
+    double one_sync_us = 0.0;
+    bool success = true;
+    for (uint32_t num_syncs = 1; num_syncs <= NUM_TILES; num_syncs *= 2) {
+        uint32_t chunk = NUM_TILES / num_syncs;
+        std::vector<uint32_t> ring_memory(NUM_TILES * TILE_WORDS);
+        std::vector<uint32_t> sum(TILE_WORDS, 0);
+        TileRing ring(NUM_TILES * TILE_SIZE, TILE_SIZE);
+        std::thread consumer([&] {
+            uint32_t rd_offset = 0;
+            for (uint32_t n = 0; n < STEPS * num_syncs; n++) {
+                ring.WaitFront(chunk);
+                for (uint32_t tile = 0; tile < chunk; tile++) {
+                    const uint32_t* in = &ring_memory[(rd_offset / TILE_SIZE + tile) * TILE_WORDS];
+                    for (uint32_t w = 0; w < TILE_WORDS; w++) {
+                        sum[w] = bf16_add_packed(sum[w], in[w]);
+                    }
+                }
+                ring.Pop(chunk);
+                rd_offset = ring.Advance(rd_offset, chunk);
+            }
+        });
+        auto step_start = clock::now();
+        uint32_t wr_offset = 0;
+        for (uint32_t n = 0; n < STEPS * num_syncs; n++) {
+            ring.ReserveBack(chunk);
+            const uint32_t* in = &source[(n % num_syncs) * chunk * TILE_WORDS];
+            std::memcpy(&ring_memory[wr_offset / sizeof(uint32_t)], in, chunk * TILE_SIZE);
+            ring.Push(chunk);
+            wr_offset = ring.Advance(wr_offset, chunk);
+        }
+        consumer.join();
+        double step_us = std::chrono::duration<double, std::micro>(clock::now() - step_start).count() / STEPS;
+        one_sync_us = num_syncs == 1 ? step_us : one_sync_us;
+        success = success && ring.PagesInUse() == 0;
+        printf("%-10u %12.1f %13.2fx\n", num_syncs, step_us, one_sync_us / step_us);
+    }
+    return success;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string benchmark = (argc >= 2) ? argv[1] : "all";
+    bool success = true;
+
+    if (benchmark == "all" || benchmark == "planner") {
+        printf("== Block mask planner ==\n");
+        success = bench_planner() && success;
+    }
+    if (benchmark == "all" || benchmark == "wide") {
+        printf("== Wide block masks ==\n");
+        success = bench_wide_masks() && success;
+    }
+    if (benchmark == "all" || benchmark == "validate") {
+        printf("== Result validation ==\n");
+        success = bench_validate() && success;
+    }
+    if (benchmark == "all" || benchmark == "reference") {
+        printf("== Reference allreduce ==\n");
+        success = bench_reference() && success;
+    }
+    if (benchmark == "all" || benchmark == "args") {
+        printf("== Runtime arg tables ==\n");
+        success = bench_arg_tables() && success;
+    }
+    if (benchmark == "all" || benchmark == "ring") {
+        printf("== Tile ring ==\n");
+        success = bench_tile_ring() && success;
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include "allred_critical_path.hpp"
+#include "allred_options.hpp"
+#include "allred_placement.hpp"
+#include "allred_profile.hpp"
+#include "allred_schedule.hpp"
+
+namespace {
+
+// Timed iteration of run_id whose ALL_RED_LOOP zones span the most cycles, from the first start to the last end
+uint32_t slowest_iteration(const std::vector<RiscZones>& riscs, uint64_t run_id) {
+    std::vector<std::pair<uint64_t, uint64_t>> spans;
+    for (const RiscZones& risc : riscs) {
+        if (risc.run_id != run_id) {
+            continue;
+        }
+        size_t k = 0;
+        for (const ZoneSpan& zone : risc.zones) {
+            if (zone.name != "ALL_RED_LOOP") {
+                continue;
+            }
+            if (spans.size() <= k) {
+                spans.push_back({std::numeric_limits<uint64_t>::max(), 0});
+            }
+            spans[k].first = std::min(spans[k].first, zone.start);
+            spans[k].second = std::max(spans[k].second, zone.end);
+            k++;
+        }
+    }
+    uint32_t slowest = 0;
+    for (uint32_t k = 0; k < spans.size(); k++) {
+        if (spans[k].second - spans[k].first > spans[slowest].second - spans[slowest].first) {
+            slowest = k;
+        }
+    }
+    return slowest;
+}
+
+}  // namespace
+
+// Reads a device profiler log of the BO kernels run with --step-zones (or allred_shim built with ALLRED_STEP_ZONES)
+// and prints the critical path of one timed run: the chain of step zones, over all cores, that the end of the
+// allreduce waited on, and the cores and steps that took most of it. Needs neither a device nor tt-metal.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: Path of profile_log_device.csv, defaults to the one under $TT_METAL_HOME
+    --swing=0|1: algorithm of the run (1 = swing), 0 by default
+    --side=N: size of node array 1,2,4,8 (arg 3 of the run), 8 by default
+    --placement=PATH: placement table the run was given, row major by default
+    --run=ID: run host ID to analyze, the last one by default
+    --iteration=K: timed iteration (of --iterations) to analyze, the slowest by default
+    --top=N: cores and steps to list, 5 by default*/
+    std::string log_path = (argc >= 2) ? argv[1] : default_profile_log_path();
+    bool SWING_VERSION = options.GetInt("swing", 0) == 1;
+    int SIDE_LENGTH = highest_power_of_two(options.GetInt("side", 8));
+
+    std::ifstream log(log_path);
+    if (!log) {
+        printf("Could not open %s\n", log_path.c_str());
+        return 1;
+    }
+    std::vector<RiscZones> riscs;
+    std::string error;
+    if (!read_profile_zones(log, riscs, error)) {
+        printf("%s: %s\n", log_path.c_str(), error.c_str());
+        return 1;
+    }
+    if (riscs.empty()) {
+        printf("No zones in %s\n", log_path.c_str());
+        return 1;
+    }
+
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, SIDE_LENGTH);
+    Placement placement = row_major_placement(SIDE_LENGTH, SIDE_LENGTH);
+    if (options.Has("placement")) {
+        std::string placement_path = options.GetString("placement", "");
+        std::ifstream table(placement_path);
+        if (!table) {
+            printf("Could not open %s\n", placement_path.c_str());
+            return 1;
+        }
+        if (!read_placement(table, SIDE_LENGTH, SIDE_LENGTH, placement, error)) {
+            printf("%s: %s\n", placement_path.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    PhysicalCoreFn physical_core = [&](int core_i) {
+        return wormhole_worker_core(placement[core_i].first, placement[core_i].second);
+    };
+
+    uint64_t run_id = options.Has("run") ? (uint64_t)std::max(0, options.GetInt("run", 0)) : riscs.back().run_id;
+    uint32_t iteration = options.Has("iteration") ? std::max(0, options.GetInt("iteration", 0))
+                                                   : slowest_iteration(riscs, run_id);
+    std::vector<StepZone> zones;
+    if (!collect_step_zones(riscs, run_id, plan, physical_core, iteration, zones, error)) {
+        printf("Run %lu: %s\n", (unsigned long)run_id, error.c_str());
+        return 1;
+    }
+    std::vector<CriticalPathLink> path = critical_path(plan, zones);
+    uint64_t path_start = path.front().start;
+    uint64_t path_end = path.back().end;
+    printf(
+        "Critical path of run %lu, iteration %u (%s on %dx%d cores): %lu cycles\n",
+        (unsigned long)run_id,
+        iteration,
+        SWING_VERSION ? "swing" : "recdub",
+        SIDE_LENGTH,
+        SIDE_LENGTH,
+        (unsigned long)(path_end - path_start));
+    printf("%10s %10s %6s %8s %6s %5s  %-24s %s\n", "at", "cycles", "core", "(x,y)", "chunk", "step", "zone", "released by");
+
+    std::map<std::string, uint64_t> phase_cycles;
+    std::map<std::pair<uint32_t, uint32_t>, uint64_t> step_cycles;  // (core, step)
+    uint64_t on_zones = 0;
+    for (const CriticalPathLink& link : path) {
+        auto [x, y] = physical_core(link.zone.core);
+        uint64_t cycles = link.end - link.start;
+        std::string coords = "(" + std::to_string(x) + "," + std::to_string(y) + ")";
+        std::string released = link.released_by < 0 ? "" : "core " + std::to_string(link.released_by);
+        printf(
+            "%10lu %10lu %6u %8s %6u %5u  %-24s %s\n",
+            (unsigned long)(link.start - path_start),
+            (unsigned long)cycles,
+            link.zone.core,
+            coords.c_str(),
+            link.zone.chunk,
+            link.zone.step,
+            step_zone_name(link.zone.phase),
+            released.c_str());
+        phase_cycles[step_zone_name(link.zone.phase)] += cycles;
+        step_cycles[{link.zone.core, link.zone.step}] += cycles;
+        on_zones += cycles;
+    }
+
+    double total = std::max<double>(1.0, (double)(path_end - path_start));
+    printf("\nCycles on the critical path by phase:\n");
+    for (const auto& [phase, cycles] : phase_cycles) {
+        printf("  %-24s %10lu %5.1f%%\n", phase.c_str(), (unsigned long)cycles, 100.0 * cycles / total);
+    }
+    // Gaps between the links, e.g. the sync_NOC of the two dataflow RISCs at every step
+    uint64_t between = path_end - path_start - on_zones;
+    printf("  %-24s %10lu %5.1f%%\n", "between zones", (unsigned long)between, 100.0 * between / total);
+
+    std::vector<std::pair<uint64_t, std::pair<uint32_t, uint32_t>>> ranked;
+    for (const auto& [core_step, cycles] : step_cycles) {
+        ranked.push_back({cycles, core_step});
+    }
+    std::sort(ranked.rbegin(), ranked.rend());
+    size_t top = std::min<size_t>(ranked.size(), std::max(1, options.GetInt("top", 5)));
+    printf("\nCores and steps that gate completion, by cycles on the critical path:\n");
+    for (size_t i = 0; i < top; i++) {
+        auto [core, step] = ranked[i].second;
+        auto [x, y] = physical_core(core);
+        printf(
+            "  core %2u (%u,%u) step %u: %10lu %5.1f%%\n",
+            core,
+            x,
+            y,
+            step,
+            (unsigned long)ranked[i].first,
+            100.0 * ranked[i].first / total);
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include "allred_helper.hpp"
+#include "allred_emulator.hpp"
+#include "allred_placement.hpp"
+#include "allred_reference.hpp"
+
+// Runs the allred_BO_2D schedule on the host, without a device. Takes the same args as allred_BO_2D
+// (arg 2 is ignored) and checks the result the way the device run would. Args 9 and 10 optionally set the
+// width and height of a larger or rectangular virtual grid, which can be planned but not run on one n150.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    bool PER_CORE_INPUTS = options.GetString("inputs", "pair") == "per-core";
+    uint32_t ITERATIONS = std::max(1, options.GetInt("iterations", 1));
+    uint32_t WARMUP = std::max(0, options.GetInt("warmup", 0));
+    /*
+    Arg 1: is swing version? 0 1 (0 = recdub)
+    Arg 2: unused
+    Arg 3: Size of node array 1,2,4,8
+    Arg 4: Random source, -1, or any I
+    arg 5: Number of tiles, 1-5
+    arg 6: Acceptible calculation error (due to bfloat16 rounding  )
+    Arg 7: Which core's result is checked
+    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)
+    Arg 9, 10: Width and height of the grid (powers of 2, override arg 3)
+    --placement=PATH: place the ranks as in a table of allred_placement instead of row major
+    --num-syncs=N: syncs per step of the send loops, the host programs' default (model_num_syncs) otherwise*/
+
+    bool SWING_VERSION = (argc >= 2) && std::stoi(argv[1]) == 1;
+    int SIDE_LENGTH = (argc >= 4) ? highest_power_of_two(std::stoi(argv[3])) : 1;
+    int RND_SRC = (argc >= 5) ? std::stoi(argv[4]) : 0;
+    int ERROR = (argc >= 7) ? std::stoi(argv[6]) : 1;
+    int PRINT_CORE = (argc >= 8) ? std::stoi(argv[7]) : 0;
+    bool BANDWIDTH_OPTIMAL = (argc >= 9) ? (bool) std::stoi(argv[8]) : false;
+
+    int GRID_WIDTH = (argc >= 10) ? highest_power_of_two(std::stoi(argv[9]), 1 << 16) : SIDE_LENGTH;
+    int GRID_HEIGHT = (argc >= 11) ? highest_power_of_two(std::stoi(argv[10]), 1 << 16) : GRID_WIDTH;
+    bool on_chip_grid = GRID_WIDTH <= 8 && GRID_HEIGHT <= 8;
+
+    uint32_t TOTAL_NODES = GRID_WIDTH * GRID_HEIGHT;
+    uint32_t SWING_ALGO_STEPS = static_cast<uint32_t>(std::log2(TOTAL_NODES));
+    int NUM_TILES = normalize_num_tiles((argc >= 6) ? std::stoi(argv[5]) : 1, BANDWIDTH_OPTIMAL, TOTAL_NODES);
+    uint32_t single_tile_size = 2048;
+    PRINT_CORE = PRINT_CORE < (int)TOTAL_NODES ? PRINT_CORE : 0;
+
+    if (TOTAL_NODES < 2) {
+        printf("Nothing to emulate on a single core\n");
+        return 0;
+    }
+
+    // Same source data as AllredConfig
+    int num_els = single_tile_size * NUM_TILES / sizeof(uint32_t);
+    std::vector<uint32_t> src_vec_0, src_vec_1, core_inputs;
+    std::vector<const uint32_t*> inputs(TOTAL_NODES);
+    if (PER_CORE_INPUTS) {
+        auto generate_start = std::chrono::steady_clock::now();
+        core_inputs = generate_core_inputs(TOTAL_NODES, num_els, RND_SRC);
+        double generate_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generate_start).count();
+        printf(
+            "Per-core inputs: %u x %u bytes, generated in %.1f ms (%.2f GB/s)\n",
+            TOTAL_NODES,
+            single_tile_size * NUM_TILES,
+            generate_ms,
+            core_inputs.size() * sizeof(uint32_t) / generate_ms / 1e6);
+        for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+            inputs[core_i] = &core_inputs[core_i * num_els];
+        }
+    } else {
+        if (RND_SRC < 0) {
+            src_vec_0 = create_constant_vector_of_bfloat16(single_tile_size * NUM_TILES, 1.0f);
+            src_vec_1 = src_vec_0;
+        } else {
+            src_vec_0 = create_random_vector_of_bfloat16(single_tile_size * NUM_TILES, 100, RND_SRC);
+            src_vec_1 = create_random_vector_of_bfloat16(single_tile_size * NUM_TILES, 100, RND_SRC + 1);
+        }
+        for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+            inputs[core_i] = core_i % 2 == 0 ? src_vec_1.data() : src_vec_0.data();
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Placement placement = row_major_placement(GRID_WIDTH, GRID_HEIGHT);
+    if (options.Has("placement")) {
+        std::string placement_path = options.GetString("placement", ""), error;
+        std::ifstream table(placement_path);
+        if (!table) {
+            printf("Could not open %s\n", placement_path.c_str());
+            return 1;
+        }
+        if (!read_placement(table, GRID_WIDTH, GRID_HEIGHT, placement, error)) {
+            printf("%s: %s\n", placement_path.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> physical_cores(TOTAL_NODES);
+    for (uint32_t i = 0; i < TOTAL_NODES; i++) {
+        // Virtual grids that don't fit on the chip use the logical coordinates
+        physical_cores[i] = on_chip_grid ? wormhole_worker_core(placement[i].first, placement[i].second) : placement[i];
+    }
+    PhysicalCoreFn physical_core = [&](int core_i) { return physical_cores[core_i]; };
+
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, GRID_WIDTH, GRID_HEIGHT);
+    AllredArgTables args = build_BO_arg_tables(
+        plan, physical_core, BANDWIDTH_OPTIMAL, NUM_TILES, 1, std::max(0, options.GetInt("num-syncs", 0)));
+    AllredEmulator emulator(physical_cores);
+    for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+        emulator.SetCoreArgs(core_i, args.dataflow[core_i], args.compute[core_i]);
+        emulator.SetCoreInput(core_i, std::vector<uint32_t>(inputs[core_i], inputs[core_i] + num_els));
+    }
+
+    EmulatorResult result = emulator.Run(WARMUP + ITERATIONS);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (!result.success) {
+        printf("Emulation failed: %s\n", result.error.c_str());
+        return 1;
+    }
+
+    printf(
+        "Emulated %dx%d cores, %d tiles, %u syncs per step, %u runs in %.2f ms\n",
+        GRID_WIDTH,
+        GRID_HEIGHT,
+        NUM_TILES,
+        args.dataflow[0][BOArgLayout(SWING_ALGO_STEPS, TOTAL_NODES).num_syncs()],
+        WARMUP + ITERATIONS,
+        elapsed_ms);
+    for (uint32_t i = 0; i < result.scatter_steps.size(); i++) {
+        const EmulatorStepCost& cost = result.scatter_steps[i];
+        printf(
+            "%s step %u: max %u bytes in %u writes per core (%u with the blocks in order), %lu bytes total\n",
+            BANDWIDTH_OPTIMAL ? "Reduce-scatter" : "Allreduce",
+            i,
+            cost.max_bytes,
+            cost.max_writes,
+            cost.max_block_order_writes,
+            (unsigned long)cost.total_bytes);
+    }
+    for (uint32_t i = 0; i < result.gather_steps.size(); i++) {
+        const EmulatorStepCost& cost = result.gather_steps[i];
+        printf(
+            "Allgather step %u: max %u bytes in %u writes per core (%u with the blocks in order), %lu bytes total\n",
+            SWING_ALGO_STEPS - 1 - i,
+            cost.max_bytes,
+            cost.max_writes,
+            cost.max_block_order_writes,
+            (unsigned long)cost.total_bytes);
+    }
+
+    // The kernels only run on the chip, for larger virtual grids the semaphore errors are informative
+    for (const std::string& error : result.sync_errors) {
+        printf("%s: %s\n", on_chip_grid ? "Semaphore error" : "Semaphore note", error.c_str());
+    }
+    if (result.sync_errors.empty()) {
+        printf("Semaphore counts consistent over %u runs\n", WARMUP + ITERATIONS);
+    } else if (on_chip_grid) {
+        return 1;
+    }
+
+    if (PER_CORE_INPUTS) {
+        validate_against_reference(emulator.CoreResult(PRINT_CORE), inputs, num_els, ERROR, plan);
+    } else {
+        validate_result_vector(emulator.CoreResult(PRINT_CORE), src_vec_0, src_vec_1, num_els, ERROR, TOTAL_NODES);
+    }
+
+    // The emulator must also match the device summation order bit for bit
+    AllredReference reference(plan, BANDWIDTH_OPTIMAL);
+    std::vector<uint32_t> golden = reference.Run(inputs, num_els, ReferenceOrder::Device, PRINT_CORE);
+    ValidationResult exact = validate_against_golden(emulator.CoreResult(PRINT_CORE).data(), golden.data(), num_els, 0.0f);
+    if (exact.all_match()) {
+        printf("Bit exact against the device order reference\n");
+    } else {
+        printf(
+            "%zu of %zu values differ from the device order reference, first at index %zu\n",
+            exact.num_values - exact.num_matches,
+            exact.num_values,
+            exact.first_mismatch_index);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Host-side bfloat16 helpers operating on the packed uint32 layout used by the DRAM buffers
+// (element 2*i in the low half of word i, element 2*i+1 in the high half)
+
+inline float bf16_to_float(uint16_t value) {
+    uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Round to nearest even, as done by the packer when writing Float16_b tiles
+inline uint16_t float_to_bf16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40);  // quiet NaN
+    }
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+// Adds two packed words (two bfloat16 each) element-wise
+inline uint32_t bf16_add_packed(uint32_t a, uint32_t b) {
+    uint16_t lo = float_to_bf16(bf16_to_float(a & 0xffff) + bf16_to_float(b & 0xffff));
+    uint16_t hi = float_to_bf16(bf16_to_float(a >> 16) + bf16_to_float(b >> 16));
+    return static_cast<uint32_t>(lo) | (static_cast<uint32_t>(hi) << 16);
+}
@@ -0,0 +1,315 @@
+#include "allred_critical_path.hpp"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace {
+
+constexpr StepPhase all_phases[] = {
+    StepPhase::ComputeWait,
+    StepPhase::PartnerWait,
+    StepPhase::Send,
+    StepPhase::Recv,
+    StepPhase::Reduce,
+    StepPhase::GatherPartnerWait,
+    StepPhase::GatherSend,
+    StepPhase::GatherDataWait,
+};
+
+bool gather_phase(StepPhase phase) {
+    return phase == StepPhase::GatherPartnerWait || phase == StepPhase::GatherSend ||
+           phase == StepPhase::GatherDataWait;
+}
+
+std::string core_name(std::pair<uint32_t, uint32_t> core) {
+    return "core (" + std::to_string(core.first) + "," + std::to_string(core.second) + ")";
+}
+
+// The event that ends a wait: the start or the end of another zone
+struct Release {
+    const StepZone* zone = nullptr;
+    bool at_start = false;
+
+    uint64_t time() const { return at_start ? zone->start : zone->end; }
+};
+
+class StepZoneIndex {
+public:
+    explicit StepZoneIndex(const std::vector<StepZone>& zones) {
+        for (const StepZone& zone : zones) {
+            index[{(int)zone.phase, zone.core, zone.chunk, zone.step}] = &zone;
+        }
+    }
+
+    const StepZone* Find(StepPhase phase, uint32_t core, uint32_t chunk, uint32_t step) const {
+        auto it = index.find({(int)phase, core, chunk, step});
+        return it == index.end() ? nullptr : it->second;
+    }
+
+private:
+    std::map<std::tuple<int, uint32_t, uint32_t, uint32_t>, const StepZone*> index;
+};
+
+Release release_of(const SchedulePlan& plan, const StepZoneIndex& index, const StepZone& zone) {
+    uint32_t partner = plan.partner(zone.core, zone.step);
+    Release release;
+    switch (zone.phase) {
+        case StepPhase::ComputeWait:
+            // cb_local is free once compute has reduced the previous step, of this chunk or the one before
+            if (zone.step > 0) {
+                release.zone = index.Find(StepPhase::Reduce, zone.core, zone.chunk, zone.step - 1);
+            } else if (zone.chunk > 0) {
+                release.zone = index.Find(StepPhase::Reduce, zone.core, zone.chunk - 1, plan.algo_steps - 1);
+            }
+            break;
+        case StepPhase::PartnerWait:
+            release = {index.Find(StepPhase::PartnerWait, partner, zone.chunk, zone.step), true};
+            break;
+        case StepPhase::Recv:
+            release.zone = index.Find(StepPhase::Send, partner, zone.chunk, zone.step);
+            break;
+        case StepPhase::Reduce: {
+            // The last received tile or the last local one, whichever is pushed later
+            const StepZone* recv = index.Find(StepPhase::Recv, zone.core, zone.chunk, zone.step);
+            const StepZone* send = index.Find(StepPhase::Send, zone.core, zone.chunk, zone.step);
+            release.zone = !recv || (send && send->end > recv->end) ? send : recv;
+            break;
+        }
+        case StepPhase::GatherPartnerWait:
+            release = {index.Find(StepPhase::GatherPartnerWait, partner, zone.chunk, zone.step), true};
+            break;
+        case StepPhase::GatherDataWait:
+            release.zone = index.Find(StepPhase::GatherSend, partner, zone.chunk, zone.step);
+            break;
+        case StepPhase::Send:
+        case StepPhase::GatherSend:
+            break;
+    }
+    return release;
+}
+
+}  // namespace
+
+const char* step_zone_name(StepPhase phase) {
+    switch (phase) {
+        case StepPhase::ComputeWait: return "AR_COMPUTE_WAIT";
+        case StepPhase::PartnerWait: return "AR_PARTNER_WAIT";
+        case StepPhase::Send: return "AR_SEND";
+        case StepPhase::Recv: return "AR_RECV";
+        case StepPhase::Reduce: return "AR_REDUCE";
+        case StepPhase::GatherPartnerWait: return "AR_GATHER_PARTNER_WAIT";
+        case StepPhase::GatherSend: return "AR_GATHER_SEND";
+        case StepPhase::GatherDataWait: return "AR_GATHER_DATA_WAIT";
+    }
+    return "";
+}
+
+bool collect_step_zones(
+    const std::vector<RiscZones>& riscs,
+    uint64_t run_id,
+    const SchedulePlan& plan,
+    const PhysicalCoreFn& physical_core,
+    uint32_t iteration,
+    std::vector<StepZone>& zones,
+    std::string& error) {
+    std::map<std::string, StepPhase> phases;
+    for (StepPhase phase : all_phases) {
+        phases[step_zone_name(phase)] = phase;
+    }
+    uint32_t steps = plan.algo_steps;
+
+    for (uint32_t core = 0; core < plan.total_nodes; core++) {
+        std::pair<uint32_t, uint32_t> coords = physical_core(core);
+        std::vector<const RiscZones*> dataflow, compute;
+        for (const RiscZones& risc : riscs) {
+            if (risc.run_id == run_id && risc.x == coords.first && risc.y == coords.second) {
+                (risc.risc.rfind("TRISC", 0) == 0 ? compute : dataflow).push_back(&risc);
+            }
+        }
+
+        // The timed iteration spans from the first dataflow RISC entering ALL_RED_LOOP to the last leaving it
+        uint64_t window_start = std::numeric_limits<uint64_t>::max(), window_end = 0;
+        uint32_t num_iterations = std::numeric_limits<uint32_t>::max();
+        for (const RiscZones* risc : dataflow) {
+            uint32_t k = 0;
+            for (const ZoneSpan& zone : risc->zones) {
+                if (zone.name != "ALL_RED_LOOP") {
+                    continue;
+                }
+                if (k++ == iteration) {
+                    window_start = std::min(window_start, zone.start);
+                    window_end = std::max(window_end, zone.end);
+                }
+            }
+            num_iterations = std::min(num_iterations, k);
+        }
+        if (dataflow.empty() || num_iterations <= iteration) {
+            error = core_name(coords) + " has no ALL_RED_LOOP zone for iteration " + std::to_string(iteration);
+            return false;
+        }
+
+        // Dataflow zones of a phase come one per step (reduce-scatter) or per allgather step, in order
+        std::vector<ZoneSpan> window;
+        for (const RiscZones* risc : dataflow) {
+            for (const ZoneSpan& zone : risc->zones) {
+                if (phases.count(zone.name) && zone.start >= window_start && zone.end <= window_end) {
+                    window.push_back(zone);
+                }
+            }
+        }
+        std::sort(window.begin(), window.end(), [](const ZoneSpan& a, const ZoneSpan& b) { return a.start < b.start; });
+        std::map<StepPhase, uint32_t> counts;
+        for (const ZoneSpan& zone : window) {
+            StepPhase phase = phases[zone.name];
+            uint32_t k = counts[phase]++;
+            uint32_t step = gather_phase(phase) ? steps - 1 - k % steps : k % steps;
+            zones.push_back(StepZone{phase, core, k / steps, step, zone.start, zone.end});
+        }
+        uint32_t sends = counts[StepPhase::Send];
+        if (sends == 0) {
+            error = core_name(coords) + " has no step zones, run the kernels with --step-zones";
+            return false;
+        }
+        uint32_t num_chunks = sends / steps;
+        for (StepPhase phase : {StepPhase::ComputeWait, StepPhase::PartnerWait, StepPhase::Send, StepPhase::Recv}) {
+            if (counts[phase] != num_chunks * steps || sends % steps) {
+                error = core_name(coords) + " has " + std::to_string(counts[phase]) + " " + step_zone_name(phase) +
+                        " zones in iteration " + std::to_string(iteration) + " for " + std::to_string(steps) +
+                        " steps, the profiler buffer may have filled up (use fewer iterations)";
+                return false;
+            }
+        }
+
+        // The compute kernel runs warmup + iterations runs of num_chunks * steps steps, the timed ones last
+        uint32_t run_steps = num_chunks * steps;
+        std::vector<StepZone> reduces;
+        for (const RiscZones* risc : compute) {
+            std::vector<const ZoneSpan*> risc_reduces;
+            for (const ZoneSpan& zone : risc->zones) {
+                if (zone.name == step_zone_name(StepPhase::Reduce)) {
+                    risc_reduces.push_back(&zone);
+                }
+            }
+            uint32_t runs = risc_reduces.size() / run_steps;
+            if (risc_reduces.size() % run_steps || runs < num_iterations) {
+                error = core_name(coords) + " " + risc->risc + " has " + std::to_string(risc_reduces.size()) + " " +
+                        step_zone_name(StepPhase::Reduce) + " zones for " + std::to_string(num_iterations) +
+                        " timed runs of " + std::to_string(run_steps) +
+                        " steps, the profiler buffer may have filled up (use fewer iterations)";
+                return false;
+            }
+            size_t first = (size_t)(runs - num_iterations + iteration) * run_steps;
+            for (uint32_t k = 0; k < run_steps; k++) {
+                const ZoneSpan& zone = *risc_reduces[first + k];
+                if (reduces.size() <= k) {
+                    reduces.push_back(StepZone{StepPhase::Reduce, core, k / steps, k % steps, zone.start, zone.end});
+                }
+                reduces[k].start = std::min(reduces[k].start, zone.start);
+                reduces[k].end = std::max(reduces[k].end, zone.end);
+            }
+        }
+        zones.insert(zones.end(), reduces.begin(), reduces.end());
+    }
+    return true;
+}
+
+std::vector<LabelledStepZone> label_step_zones(
+    const std::vector<RiscZones>& riscs, const SchedulePlan& plan, const PhysicalCoreFn& physical_core) {
+    std::map<std::string, StepPhase> phases;
+    for (StepPhase phase : all_phases) {
+        phases[step_zone_name(phase)] = phase;
+    }
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> cores;
+    for (uint32_t core = 0; core < plan.total_nodes; core++) {
+        cores[physical_core(core)] = core;
+    }
+
+    std::vector<LabelledStepZone> labelled;
+    for (const RiscZones& risc : riscs) {
+        auto core_it = cores.find({risc.x, risc.y});
+        if (core_it == cores.end()) {
+            continue;
+        }
+        uint32_t core = core_it->second;
+        bool compute = risc.risc.rfind("TRISC", 0) == 0;
+        // Steps in which this RISC sends, and those in which it monitors cb_recv
+        std::vector<uint32_t> send_steps, recv_steps;
+        for (uint32_t i = 0; i < plan.algo_steps; i++) {
+            bool direction_SE = (plan.step_directions[core] >> i) & 1;
+            (direction_SE == (risc.risc == "NCRISC") ? send_steps : recv_steps).push_back(i);
+        }
+
+        std::map<StepPhase, uint32_t> counts;
+        for (const ZoneSpan& zone : risc.zones) {
+            auto phase_it = phases.find(zone.name);
+            if (phase_it == phases.end() || compute != (phase_it->second == StepPhase::Reduce)) {
+                continue;
+            }
+            StepPhase phase = phase_it->second;
+            uint32_t k = counts[phase]++;
+            if (compute) {
+                labelled.push_back(LabelledStepZone{&risc, &zone, phase, core, k / plan.algo_steps, k % plan.algo_steps});
+                continue;
+            }
+            const std::vector<uint32_t>& steps = phase == StepPhase::Recv ? recv_steps : send_steps;
+            if (steps.empty()) {
+                continue;
+            }
+            // The allgather goes through the steps backwards
+            uint32_t n = k % steps.size();
+            uint32_t step = steps[gather_phase(phase) ? steps.size() - 1 - n : n];
+            labelled.push_back(LabelledStepZone{&risc, &zone, phase, core, (uint32_t)(k / steps.size()), step});
+        }
+    }
+    return labelled;
+}
+
+std::vector<CriticalPathLink> critical_path(const SchedulePlan& plan, const std::vector<StepZone>& zones) {
+    std::vector<CriticalPathLink> links;
+    if (zones.empty()) {
+        return links;
+    }
+    StepZoneIndex index(zones);
+
+    // Last zone of the same core and kernel (the dataflow RISCs sync at every step) that ended before zone started
+    auto previous = [&](const StepZone& zone) {
+        const StepZone* latest = nullptr;
+        for (const StepZone& other : zones) {
+            if (&other != &zone && other.core == zone.core && other.compute() == zone.compute() &&
+                other.end <= zone.start && (!latest || other.end > latest->end)) {
+                latest = &other;
+            }
+        }
+        return latest;
+    };
+
+    const StepZone* zone = &*std::max_element(
+        zones.begin(), zones.end(), [](const StepZone& a, const StepZone& b) { return a.end < b.end; });
+    uint64_t exit = zone->end;
+    // Every link ends no later than the one after it, the bound only guards against equal times
+    for (size_t hops = 0; zone && hops <= 2 * zones.size(); hops++) {
+        Release release = release_of(plan, index, *zone);
+        if (release.zone && release.time() > zone->start && release.time() <= exit) {
+            links.push_back(CriticalPathLink{*zone, release.time(), exit, (int)release.zone->core});
+            if (release.at_start) {
+                // The partner's handshake only started then, follow what it waited on
+                const StepZone* before = previous(*release.zone);
+                if (!before) {
+                    links.push_back(CriticalPathLink{*release.zone, release.zone->start, release.zone->start, -1});
+                }
+                zone = before;
+                exit = before ? before->end : 0;
+            } else {
+                zone = release.zone;
+                exit = release.zone->end;
+            }
+        } else {
+            links.push_back(CriticalPathLink{*zone, zone->start, exit, -1});
+            zone = previous(*zone);
+            exit = zone ? zone->end : 0;
+        }
+    }
+    std::reverse(links.begin(), links.end());
+    return links;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Critical path of one timed run of the BO kernels (both modes), from the zones they record at every step when
+// built with --step-zones. Each zone is attributed to a core, chunk, step and phase, and each wait to the event
+// of the other core (or RISC) that ends it, which gives the chain of zones the end of the run waited on.
+// Nothing in here depends on tt-metal.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "allred_profile.hpp"
+#include "allred_schedule.hpp"
+
+// Phases of a step, one zone each. The sending RISC waits for compute to release cb_local, then for its partner
+// (both inc each other's semaphore_0), then sends. The other RISC pushes the received tiles to compute as the
+// partner's semaphore_1 incs arrive. Allgather steps handshake, send, then wait for the partner's data
+enum class StepPhase {
+    ComputeWait,
+    PartnerWait,
+    Send,
+    Recv,
+    Reduce,
+    GatherPartnerWait,
+    GatherSend,
+    GatherDataWait,
+};
+
+// Name of the phase's zone in the kernels, e.g. AR_SEND
+const char* step_zone_name(StepPhase);
+
+struct StepZone {
+    StepPhase phase;
+    uint32_t core;   // Linear index
+    uint32_t chunk;  // 0 unless streaming
+    uint32_t step;   // Step of the plan, the allgather goes through them backwards
+    uint64_t start;
+    uint64_t end;
+
+    bool compute() const { return phase == StepPhase::Reduce; }
+};
+
+// The step zones of timed iteration `iteration` of every core of run run_id. Dataflow zones are those within
+// the core's ALL_RED_LOOP zone; the compute kernel has none, so its timed steps are its last ones, with the
+// three TRISCs merged. Returns false, with error set, if a core has no step zones or not those of whole steps
+// (the profiler buffer filled up)
+bool collect_step_zones(
+    const std::vector<RiscZones>& riscs,
+    uint64_t run_id,
+    const SchedulePlan&,
+    const PhysicalCoreFn&,
+    uint32_t iteration,
+    std::vector<StepZone>& zones,
+    std::string& error);
+
+// A step zone of one RISC, with the run of the allreduce and the step it belongs to
+struct LabelledStepZone {
+    const RiscZones* risc;
+    const ZoneSpan* zone;
+    StepPhase phase;
+    uint32_t core;
+    uint32_t run;  // Runs of the allreduce on the core before this one, warmup runs and chunks included
+    uint32_t step;
+};
+
+// Labels the step zones of every RISC of the plan's cores, over all runs. A dataflow RISC sends in the steps whose
+// NoC direction is its own (NCRISC is the SE one) and monitors in the others, so the k-th zone of a phase on it
+// belongs to a known step without looking at the times. Zones of cores outside the grid are left out
+std::vector<LabelledStepZone> label_step_zones(
+    const std::vector<RiscZones>& riscs, const SchedulePlan&, const PhysicalCoreFn&);
+
+struct CriticalPathLink {
+    StepZone zone;
+    uint64_t start;        // When the path enters the zone, after its start if the zone waited on released_by
+    uint64_t end;          // When the next link depends on it
+    int released_by = -1;  // Core whose zone ended the wait, -1 if the zone was gated by its own core's last zone
+};
+
+// Walks back from the zone that ends last: a wait that ended after the event it waits on started is gated by
+// that event's zone (a partner's send, the reduction of the previous step, ...), any other zone by the last one
+// its core finished before it started. Links are in time order
+std::vector<CriticalPathLink> critical_path(const SchedulePlan&, const std::vector<StepZone>&);
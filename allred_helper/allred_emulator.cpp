@@ -0,0 +1,495 @@
+#include "allred_emulator.hpp"
+#include "allred_bf16.hpp"
+#include <algorithm>
+#include <map>
+
+namespace {
+constexpr uint32_t tile_size_bytes = 2048;
+constexpr uint32_t tile_size_words = tile_size_bytes / sizeof(uint32_t);
+constexpr uint32_t num_sem_0 = 6;  // Semaphores waited on before sending, cycled through by step
+constexpr uint32_t max_sync_errors = 8;
+}  // namespace
+
+// Mirrors the sync setup of the allred_BO_2D dataflow kernel. The allred_LOO_2D one it is swapped for (see
+// kernel_variant) sends num_syncs chunks of the vector, block sizes don't matter to it
+KernelSyncs kernel_syncs(uint32_t num_syncs, uint32_t total_blocks) {
+    return {num_syncs, num_syncs ? total_blocks / num_syncs : 0};
+}
+
+AllredEmulator::AllredEmulator(const std::vector<std::pair<uint32_t, uint32_t>>& physical_cores) :
+    physical_cores(physical_cores),
+    core_args(physical_cores.size()),
+    inputs(physical_cores.size()),
+    local_data(physical_cores.size()),
+    recv_data(physical_cores.size()) {
+    for (uint32_t core_i = 0; core_i < physical_cores.size(); core_i++) {
+        core_index[physical_cores[core_i]] = core_i;
+    }
+}
+
+void AllredEmulator::SetCoreArgs(
+    uint32_t core_i, const std::vector<uint32_t>& dataflow_args, const std::vector<uint32_t>& compute_args) {
+    core_args[core_i].dataflow = dataflow_args;
+    core_args[core_i].compute = compute_args;
+}
+
+void AllredEmulator::SetCoreInput(uint32_t core_i, const std::vector<uint32_t>& src_vec) {
+    inputs[core_i] = src_vec;
+    local_data[core_i] = src_vec;
+}
+
+// Arg layout of a core, the mask width follows from the number of cores
+BOArgLayout AllredEmulator::Layout(uint32_t core_i) const {
+    return BOArgLayout(core_args[core_i].dataflow[6], physical_cores.size());
+}
+
+// A vector with its blocks moved from DRAM order to their L1 positions (to_l1) or back, like the dataflow
+// kernel's reads and writes of the vector
+std::vector<uint32_t> AllredEmulator::MoveBlocks(const std::vector<uint32_t>& data, bool to_l1) const {
+    const std::vector<uint32_t>& args_0 = core_args[0].dataflow;
+    uint32_t total_blocks = args_0[12] / args_0[13];
+    uint32_t block_size_words = args_0[13] * tile_size_words;
+    std::vector<uint32_t> moved(data.size());
+    for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+        uint32_t position = args_0[Layout(0).block_positions() + n_block];
+        std::copy_n(
+            data.begin() + (to_l1 ? n_block : position) * block_size_words,
+            block_size_words,
+            moved.begin() + (to_l1 ? position : n_block) * block_size_words);
+    }
+    return moved;
+}
+
+// Linear index of the core this core exchanges data with at a given step, -1 if unknown
+int AllredEmulator::PartnerAt(uint32_t core_i, uint32_t step) const {
+    BOArgLayout layout = Layout(core_i);
+    std::pair<uint32_t, uint32_t> partner = {
+        core_args[core_i].dataflow[layout.partner_coords() + 2 * step],
+        core_args[core_i].dataflow[layout.partner_coords() + 1 + 2 * step]};
+    auto it = core_index.find(partner);
+    return it == core_index.end() ? -1 : it->second;
+}
+
+BlockSet AllredEmulator::ReadBlocks(const std::vector<uint32_t>& args, uint32_t offset) const {
+    uint32_t total_blocks = core_args[0].dataflow[12] / core_args[0].dataflow[13];
+    BlockSet blocks(total_blocks);
+    for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+        if ((args[offset + n_block / 32] >> (n_block % 32)) & 1) {
+            blocks.set(n_block);
+        }
+    }
+    return blocks;
+}
+
+BlockSet AllredEmulator::SendBlocks(uint32_t core_i, uint32_t step) const {
+    BOArgLayout layout = Layout(core_i);
+    return ReadBlocks(core_args[core_i].dataflow, layout.send_blocks() + layout.mask_words * step);
+}
+
+BlockSet AllredEmulator::RecvBlocks(uint32_t core_i, uint32_t step) const {
+    BOArgLayout layout = Layout(core_i);
+    return ReadBlocks(core_args[core_i].dataflow, layout.recv_blocks() + layout.mask_words * step);
+}
+
+BlockSet AllredEmulator::ComputeRecvBlocks(uint32_t core_i, uint32_t step) const {
+    BOArgLayout layout = Layout(core_i);
+    return ReadBlocks(core_args[core_i].compute, layout.compute_recv_blocks() + layout.mask_words * step);
+}
+
+// Number of noc_async_write calls the dataflow kernel issues for a block mask. Contiguous
+// blocks are merged into one write, but writes are split at every synchronization point
+uint32_t count_writes(const BlockSet& blocks, uint32_t sync_stride) {
+    uint32_t writes = 0;
+    bool in_run = false;
+    for (uint32_t n_block = 0; n_block < blocks.size(); n_block++) {
+        bool send_block = blocks.test(n_block);
+        if (send_block && (!in_run || n_block % sync_stride == 0)) {
+            writes++;
+        }
+        in_run = send_block;
+    }
+    return writes;
+}
+
+// Checks the args of every core are complete and agree with each other
+bool AllredEmulator::CheckArgs(EmulatorResult& result) const {
+    auto fail = [&](const std::string& error) {
+        result.success = false;
+        result.error = error;
+        return false;
+    };
+
+    uint32_t num_cores = physical_cores.size();
+    if (num_cores == 0 || core_args[0].dataflow.size() < 14) {
+        return fail("no runtime args set for core 0");
+    }
+    const std::vector<uint32_t>& args_0 = core_args[0].dataflow;
+    uint32_t algo_steps = args_0[6];
+    uint32_t num_tiles = args_0[12];
+    uint32_t tiles_per_node = args_0[13];
+
+    if (algo_steps > 32 || tiles_per_node == 0 || num_tiles % tiles_per_node != 0) {
+        return fail("invalid step count or tiles per node");
+    }
+    BOArgLayout layout = Layout(0);
+
+    for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+        const CoreArgs& args = core_args[core_i];
+        std::string core_name = "core " + std::to_string(core_i);
+        if (args.dataflow.size() < layout.dataflow_size() || args.compute.size() < layout.compute_size()) {
+            return fail(core_name + ": runtime args too short");
+        }
+        if (args.dataflow[5] != args_0[5] || args.dataflow[6] != algo_steps || args.dataflow[12] != num_tiles ||
+            args.dataflow[13] != tiles_per_node || args.dataflow[layout.recv_tiles()] != args_0[layout.recv_tiles()] ||
+            args.dataflow[layout.num_syncs()] != args_0[layout.num_syncs()] ||
+            args.compute[layout.compute_recv_tiles()] != args_0[layout.recv_tiles()] ||
+            args.compute[layout.compute_batch_tiles()] != core_args[0].compute[layout.compute_batch_tiles()]) {
+            return fail(core_name + ": runtime args disagree with core 0");
+        }
+        if (local_data[core_i].size() != num_tiles * tile_size_words) {
+            return fail(core_name + ": input has the wrong size");
+        }
+    }
+
+    // The send loops advance by whole strides of blocks, see sync_blocks
+    uint32_t num_syncs = args_0[layout.num_syncs()];
+    if (num_syncs == 0 || (num_syncs & (num_syncs - 1)) != 0 || (num_tiles / tiles_per_node) % num_syncs != 0) {
+        return fail(
+            std::to_string(num_syncs) + " syncs per step do not divide the " + std::to_string(num_tiles / tiles_per_node) +
+            " blocks");
+    }
+
+    // A compute batch stays within a block and within the tiles of a sync, see reduce_batch_tiles
+    uint32_t batch_tiles = core_args[0].compute[layout.compute_batch_tiles()];
+    uint32_t sync_tiles = num_tiles / num_syncs;
+    if (batch_tiles == 0 || batch_tiles > MAX_BATCH_TILES || sync_tiles % batch_tiles != 0 ||
+        (args_0[5] && tiles_per_node % batch_tiles != 0)) {
+        return fail(std::to_string(batch_tiles) + " tiles per compute batch do not fit the blocks and syncs");
+    }
+
+    // Every core places the blocks the same way, each in its own L1 position
+    std::vector<bool> placed(num_tiles / tiles_per_node, false);
+    for (uint32_t n_block = 0; n_block < placed.size(); n_block++) {
+        uint32_t position = args_0[layout.block_positions() + n_block];
+        if (position >= placed.size() || placed[position]) {
+            return fail("block positions are not a permutation of the blocks");
+        }
+        placed[position] = true;
+        for (uint32_t core_i = 1; core_i < num_cores; core_i++) {
+            if (core_args[core_i].dataflow[layout.block_positions() + n_block] != position) {
+                return fail("core " + std::to_string(core_i) + ": block positions disagree with core 0");
+            }
+        }
+    }
+
+    // cb_recv holds the whole vector in latency optimal mode, the blocks received in a step otherwise
+    uint32_t recv_tiles = args_0[layout.recv_tiles()];
+    if (!args_0[5] && recv_tiles != num_tiles) {
+        return fail("cb_recv of " + std::to_string(recv_tiles) + " tiles does not hold the whole vector");
+    }
+
+    for (uint32_t i = 0; i < algo_steps; i++) {
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            std::string step_name = "core " + std::to_string(core_i) + " step " + std::to_string(i);
+            int partner = PartnerAt(core_i, i);
+            if (partner < 0) {
+                return fail(step_name + ": partner coordinates are not a core of the grid");
+            }
+            if (partner == static_cast<int>(core_i) || PartnerAt(partner, i) != static_cast<int>(core_i)) {
+                return fail(step_name + ": partner " + std::to_string(partner) + " does not pair back");
+            }
+            if (!args_0[5]) {
+                continue;
+            }
+            if (RecvBlocks(core_i, i) != ComputeRecvBlocks(core_i, i)) {
+                return fail(step_name + ": dataflow and compute recv masks differ");
+            }
+            if (SendBlocks(core_i, i) != RecvBlocks(partner, i)) {
+                return fail(step_name + ": send mask does not match the recv mask of partner " + std::to_string(partner));
+            }
+            if (SendBlocks(core_i, i).intersects(RecvBlocks(core_i, i))) {
+                return fail(step_name + ": send and recv masks overlap");
+            }
+            if (RecvBlocks(core_i, i).count() * tiles_per_node > recv_tiles) {
+                return fail(step_name + ": receives more tiles than the " + std::to_string(recv_tiles) + " of cb_recv");
+            }
+        }
+    }
+    return true;
+}
+
+// Number of semaphore_1 increments the sending NoC core makes at a step of the reduce-scatter (or allreduce).
+// Replays the block loop of the BO dataflow kernel, which increments at every sync point it crosses after sending
+uint32_t count_send_syncs(
+    const BlockSet& send_blocks, bool bandwidth_optimal, uint32_t num_tiles, uint32_t total_nodes, const KernelSyncs& syncs) {
+    if (runs_LOO_kernel(bandwidth_optimal, num_tiles)) {
+        return syncs.num_syncs;  // The LOO kernel sends one chunk per sync
+    }
+
+    auto should_send = [&](uint32_t n_block) {
+        return n_block < total_nodes && (bandwidth_optimal ? send_blocks.test(n_block) : n_block < num_tiles);
+    };
+    uint32_t incs = 0;
+    uint32_t n_block_sync = syncs.sync_stride;
+    bool sent_since_sync = false;
+    for (uint32_t n_block = 0; n_block < total_nodes;) {
+        bool send_block = should_send(n_block);
+        if (send_block) {
+            while (send_block && n_block < n_block_sync) {
+                n_block++;
+                send_block = should_send(n_block);
+            }
+            sent_since_sync = true;
+        } else {
+            n_block++;
+        }
+        if (n_block >= n_block_sync) {
+            incs += sent_since_sync;
+            sent_since_sync = false;
+            n_block_sync += syncs.sync_stride;
+            if (n_block > num_tiles) {
+                n_block += total_nodes;
+            }
+        }
+    }
+    return incs;
+}
+
+uint32_t count_recv_syncs(
+    const BlockSet& recv_blocks, bool bandwidth_optimal, uint32_t num_tiles, uint32_t total_nodes, const KernelSyncs& syncs) {
+    if (runs_LOO_kernel(bandwidth_optimal, num_tiles) || !bandwidth_optimal) {
+        return syncs.num_syncs;  // Every block is sent
+    }
+    uint32_t waits = 0;
+    for (uint32_t n_block = 0; n_block < total_nodes; n_block += syncs.sync_stride) {
+        for (uint32_t n = n_block; n < n_block + syncs.sync_stride; n++) {
+            if (recv_blocks.test(n)) {
+                waits++;
+                break;
+            }
+        }
+    }
+    return waits;
+}
+
+uint32_t AllredEmulator::CountSemaphoreIncs(uint32_t core_i, uint32_t step, const KernelSyncs& syncs) const {
+    const std::vector<uint32_t>& args = core_args[core_i].dataflow;
+    uint32_t num_tiles = args[12];
+    return count_send_syncs(SendBlocks(core_i, step), args[5], num_tiles, num_tiles / args[13], syncs);
+}
+
+// Replays the semaphore increments of the dataflow kernels over all iterations, with every core in lockstep,
+// and checks each wait threshold equals the count reached once the partner has signalled. A lower count
+// means the wait never returns, a higher one that it returns on a stale increment without waiting for the
+// partner, e.g. when more than num_sem_0 steps share the semaphore_0 slots
+void AllredEmulator::CheckSemaphores(EmulatorResult& result, uint32_t iterations) const {
+    const std::vector<uint32_t>& args_0 = core_args[0].dataflow;
+    bool bandwidth_optimal = args_0[5];
+    uint32_t algo_steps = args_0[6];
+    uint32_t num_tiles = args_0[12];
+    uint32_t num_cores = physical_cores.size();
+    KernelSyncs syncs = kernel_syncs(args_0[Layout(0).num_syncs()], num_tiles / args_0[13]);
+    // The LOO kernel, which has no allgather, only runs in latency optimal mode, see kernel_variant
+    bool allgather = bandwidth_optimal;
+
+    auto check = [&](uint32_t core_i, uint32_t count, uint32_t wait, const std::string& where) {
+        if (count == wait || result.sync_errors.size() >= max_sync_errors) {
+            return;
+        }
+        result.sync_errors.push_back(
+            "core " + std::to_string(core_i) + " " + where + ": waits for " + std::to_string(wait) + " but " +
+            std::to_string(count) + (count < wait ? " increments arrive, the wait never returns"
+                                                  : " increments have arrived, the wait returns early"));
+    };
+
+    std::vector<std::vector<uint32_t>> semaphore_0(num_cores, std::vector<uint32_t>(num_sem_0, 0));
+    std::vector<std::vector<uint32_t>> semaphore_1(num_cores, std::vector<uint32_t>(2, 0));
+    std::vector<uint32_t> syncs_received(num_cores);  // The wait threshold of semaphore_1[0], kept by the kernel
+    for (uint32_t j = 0; j < iterations; j++) {
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            semaphore_1[core_i][0] = 0;
+            syncs_received[core_i] = 0;
+        }
+        for (uint32_t i = 0; i < algo_steps; i++) {
+            for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+                int partner = PartnerAt(core_i, i);
+                semaphore_0[partner][i % num_sem_0]++;
+                semaphore_1[partner][0] += CountSemaphoreIncs(core_i, i, syncs);
+            }
+            std::string where = "iteration " + std::to_string(j) + " step " + std::to_string(i);
+            for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+                check(core_i, semaphore_0[core_i][i % num_sem_0], allgather ? 2 * j + 1 : j + 1,
+                    where + " semaphore_0[" + std::to_string(i % num_sem_0) + "]");
+                syncs_received[core_i] +=
+                    count_recv_syncs(RecvBlocks(core_i, i), bandwidth_optimal, num_tiles, num_tiles / args_0[13], syncs);
+                check(core_i, semaphore_1[core_i][0], syncs_received[core_i], where + " semaphore_1[0]");
+            }
+        }
+
+        if (!allgather) {
+            continue;
+        }
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            semaphore_1[core_i] = {0, 0};
+        }
+        for (uint32_t i = algo_steps; i-- > 0;) {
+            for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+                int partner = PartnerAt(core_i, i);
+                semaphore_0[partner][i % num_sem_0]++;
+                semaphore_1[partner][i % 2]++;
+            }
+            std::string where = "iteration " + std::to_string(j) + " allgather step " + std::to_string(i);
+            for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+                check(core_i, semaphore_0[core_i][i % num_sem_0], 2 * j + 2,
+                    where + " semaphore_0[" + std::to_string(i % num_sem_0) + "]");
+                check(core_i, semaphore_1[core_i][i % 2], ((algo_steps - i) + 1) / 2,
+                    where + " semaphore_1[" + std::to_string(i % 2) + "]");
+            }
+        }
+    }
+}
+
+EmulatorResult AllredEmulator::Run(uint32_t iterations) {
+    EmulatorResult result;
+    if (!CheckArgs(result)) {
+        return result;
+    }
+    CheckSemaphores(result, iterations);
+
+    uint32_t num_cores = physical_cores.size();
+    uint32_t recv_words = core_args[0].dataflow[Layout(0).recv_tiles()] * tile_size_words;
+    for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+        recv_data[core_i].assign(recv_words, 0);
+    }
+
+    // Like on the device, the recv buffers keep the data of the previous run, so later runs also check
+    // that no stale block is added
+    std::vector<std::vector<uint32_t>> first_result;
+    for (uint32_t j = 0; j < iterations && result.success; j++) {
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            local_data[core_i] = MoveBlocks(inputs[core_i], true);
+        }
+        RunOnce(result, j == 0);
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            local_data[core_i] = MoveBlocks(local_data[core_i], false);
+        }
+        if (j == 0) {
+            first_result = local_data;
+        } else if (result.success && local_data != first_result) {
+            result.success = false;
+            result.error = "iteration " + std::to_string(j) + " finished with a different result than iteration 0";
+        }
+    }
+    return result;
+}
+
+void AllredEmulator::RunOnce(EmulatorResult& result, bool record_costs) {
+    const std::vector<uint32_t>& args_0 = core_args[0].dataflow;
+    bool bandwidth_optimal = args_0[5];
+    uint32_t algo_steps = args_0[6];
+    uint32_t num_tiles = args_0[12];
+    uint32_t tiles_per_node = args_0[13];
+    uint32_t total_blocks = num_tiles / tiles_per_node;
+    uint32_t block_size_words = tiles_per_node * tile_size_words;
+    uint32_t block_size_bytes = tiles_per_node * tile_size_bytes;
+    uint32_t num_cores = physical_cores.size();
+
+    // Same chunking as the dataflow kernel, a sync is performed every sync_stride blocks
+    uint32_t sync_stride = kernel_syncs(args_0[Layout(0).num_syncs()], total_blocks).sync_stride;
+    BlockSet all_blocks(total_blocks);
+    for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+        all_blocks.set(n_block);
+    }
+    // Block at each L1 position, to count the writes the masks would take with the blocks in order
+    std::vector<uint32_t> position_blocks(total_blocks);
+    for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+        position_blocks[args_0[Layout(0).block_positions() + n_block]] = n_block;
+    }
+    auto block_order_writes = [&](const BlockSet& blocks, uint32_t stride) {
+        return count_writes(place_blocks(blocks, position_blocks), stride);
+    };
+
+    // Reduce-scatter (bandwidth optimal) or full allreduce (latency optimal)
+    for (uint32_t i = 0; i < algo_steps; i++) {
+        EmulatorStepCost cost;
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            int partner = PartnerAt(core_i, i);
+            BlockSet send_blocks = bandwidth_optimal ? SendBlocks(core_i, i) : all_blocks;
+            uint32_t bytes = 0;
+            // In bandwidth optimal mode the blocks land packed at the end of the partner's cb_recv
+            uint32_t recv_index = recv_data[partner].size() / block_size_words - send_blocks.count();
+            for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+                if (send_blocks.test(n_block)) {
+                    std::copy_n(
+                        local_data[core_i].begin() + n_block * block_size_words,
+                        block_size_words,
+                        recv_data[partner].begin() + (bandwidth_optimal ? recv_index : n_block) * block_size_words);
+                    bytes += block_size_bytes;
+                    recv_index++;
+                }
+            }
+            cost.max_bytes = std::max(cost.max_bytes, bytes);
+            cost.max_writes = std::max(cost.max_writes, count_writes(send_blocks, sync_stride));
+            cost.max_block_order_writes = std::max(cost.max_block_order_writes, block_order_writes(send_blocks, sync_stride));
+            cost.total_bytes += bytes;
+        }
+
+        // Compute core adds the received blocks onto the local ones
+        for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+            BlockSet recv_blocks = bandwidth_optimal ? ComputeRecvBlocks(core_i, i) : all_blocks;
+            uint32_t recv_index = recv_data[core_i].size() / block_size_words - recv_blocks.count();
+            for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+                if (recv_blocks.test(n_block)) {
+                    uint32_t recv_word = (bandwidth_optimal ? recv_index : n_block) * block_size_words;
+                    for (uint32_t w = n_block * block_size_words; w < (n_block + 1) * block_size_words; w++) {
+                        local_data[core_i][w] = bf16_add_packed(local_data[core_i][w], recv_data[core_i][recv_word++]);
+                    }
+                    recv_index++;
+                }
+            }
+        }
+        if (record_costs) {
+            result.scatter_steps.push_back(cost);
+        }
+    }
+
+    //This second allgather loop is only performed for the bandwidth optimal algorithm
+    if (bandwidth_optimal) {
+        for (uint32_t i = algo_steps; i-- > 0;) {
+            EmulatorStepCost cost;
+            // Blocks sent in a step are disjoint from the ones received, so copying in place is safe
+            for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+                int partner = PartnerAt(core_i, i);
+                BlockSet send_blocks = RecvBlocks(core_i, i);
+                uint32_t bytes = 0;
+                for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+                    if (send_blocks.test(n_block)) {
+                        std::copy_n(
+                            local_data[core_i].begin() + n_block * block_size_words,
+                            block_size_words,
+                            local_data[partner].begin() + n_block * block_size_words);
+                        bytes += block_size_bytes;
+                    }
+                }
+                cost.max_bytes = std::max(cost.max_bytes, bytes);
+                cost.max_writes = std::max(cost.max_writes, count_writes(send_blocks, total_blocks));
+                cost.max_block_order_writes =
+                    std::max(cost.max_block_order_writes, block_order_writes(send_blocks, total_blocks));
+                cost.total_bytes += bytes;
+            }
+            if (record_costs) {
+                result.gather_steps.push_back(cost);
+            }
+        }
+    }
+
+    // Every core must end up with the same vector. Only holds bit for bit in bandwidth optimal mode, in
+    // latency optimal mode Swing partners don't form fixed groups, so each core sums in its own order
+    for (uint32_t core_i = 1; core_i < num_cores && bandwidth_optimal; core_i++) {
+        if (local_data[core_i] != local_data[0]) {
+            result.success = false;
+            result.error = "core " + std::to_string(core_i) + " finished with a different result than core 0";
+            break;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Host-only emulator of the allred_BO_2D kernels. It consumes the same runtime args
+// the host program hands to the dataflow and compute kernels and replays the
+// reduce-scatter/allgather (or latency optimal allreduce) on bfloat16 data in host memory.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "allred_schedule.hpp"
+
+// Cost of one communication step, taken over all cores
+struct EmulatorStepCost {
+    uint32_t max_bytes = 0;   // Most bytes sent by a single core
+    uint32_t max_writes = 0;  // Most noc_async_write calls issued by a single core
+    uint32_t max_block_order_writes = 0;  // max_writes if the blocks were kept in order in L1
+    uint64_t total_bytes = 0;
+};
+
+struct EmulatorResult {
+    bool success = true;
+    std::string error;
+    std::vector<EmulatorStepCost> scatter_steps;  // Reduce-scatter (or allreduce) steps
+    std::vector<EmulatorStepCost> gather_steps;   // Allgather steps, in execution order
+    std::vector<std::string> sync_errors;         // Semaphore waits that deadlock or pass early, see CheckSemaphores
+};
+
+// Number of semaphore syncs per step (the num_syncs arg) and blocks between them, as used by the BO dataflow kernel
+struct KernelSyncs {
+    uint32_t num_syncs;
+    uint32_t sync_stride;
+};
+KernelSyncs kernel_syncs(uint32_t num_syncs, uint32_t total_blocks);
+
+// Number of noc_async_write calls the BO dataflow kernel issues to send blocks, split every sync_stride blocks
+uint32_t count_writes(const BlockSet&, uint32_t);
+
+// Number of semaphore_1 increments of the BO dataflow kernel sending send_blocks in a step, one per stride of
+// sync_stride blocks that it sends something in
+uint32_t count_send_syncs(const BlockSet&, bool, uint32_t, uint32_t, const KernelSyncs&);
+
+// Number of semaphore_1 waits of the BO dataflow kernel receiving recv_blocks in a step, one per stride that holds
+// a received block. The same as count_send_syncs of the partner when the masks agree
+uint32_t count_recv_syncs(const BlockSet&, bool, uint32_t, uint32_t, const KernelSyncs&);
+
+class AllredEmulator {
+public:
+    // physical_cores holds the physical x, y of every core, indexed by the core's linear index
+    explicit AllredEmulator(const std::vector<std::pair<uint32_t, uint32_t>>& physical_cores);
+
+    void SetCoreArgs(uint32_t core_i, const std::vector<uint32_t>& dataflow_args, const std::vector<uint32_t>& compute_args);
+    void SetCoreInput(uint32_t core_i, const std::vector<uint32_t>& src_vec);
+
+    // Runs the allreduce iterations times, every run starts from the inputs. Step costs are those of one run
+    EmulatorResult Run(uint32_t iterations = 1);
+
+    const std::vector<uint32_t>& CoreResult(uint32_t core_i) const { return local_data[core_i]; }
+
+private:
+    struct CoreArgs {
+        std::vector<uint32_t> dataflow;
+        std::vector<uint32_t> compute;
+    };
+
+    BOArgLayout Layout(uint32_t core_i) const;
+    int PartnerAt(uint32_t core_i, uint32_t step) const;
+    BlockSet ReadBlocks(const std::vector<uint32_t>& args, uint32_t offset) const;
+    BlockSet SendBlocks(uint32_t core_i, uint32_t step) const;
+    BlockSet RecvBlocks(uint32_t core_i, uint32_t step) const;
+    BlockSet ComputeRecvBlocks(uint32_t core_i, uint32_t step) const;
+    bool CheckArgs(EmulatorResult& result) const;
+    std::vector<uint32_t> MoveBlocks(const std::vector<uint32_t>& data, bool to_l1) const;
+    uint32_t CountSemaphoreIncs(uint32_t core_i, uint32_t step, const KernelSyncs& syncs) const;
+    void CheckSemaphores(EmulatorResult& result, uint32_t iterations) const;
+    void RunOnce(EmulatorResult& result, bool record_costs);
+
+    std::vector<std::pair<uint32_t, uint32_t>> physical_cores;
+    std::map<std::pair<uint32_t, uint32_t>, int> core_index;  // Physical coordinates -> linear index
+    std::vector<CoreArgs> core_args;
+    std::vector<std::vector<uint32_t>> inputs;
+    std::vector<std::vector<uint32_t>> local_data;
+    std::vector<std::vector<uint32_t>> recv_data;
+};
@@ -1,4 +1,10 @@
 #include "allred_helper.hpp"
+#include "allred_bf16.hpp"
+#include "allred_placement.hpp"
+#include "allred_reference.hpp"
+#include "allred_tuning.hpp"
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <cmath>
 #include <tt-metalium/host_api.hpp>
@@ -15,179 +21,78 @@ using namespace tt::tt_metal;
 #endif
 
 // Checks result vector to ensure it is correct
-void validate_result_vector(
+ValidationResult validate_result_vector(
     const std::vector<uint32_t>& result_vec,
     const std::vector<uint32_t>& src_vec_0,
     const std::vector<uint32_t>& src_vec_1,
     size_t num_els,
     float ERROR,
     uint32_t total_nodes) {
-    bool all_match = true;
-    int num_matches = 0;
-
-    std::vector<bfloat16> result_vec_b16 = unpack_uint32_vec_into_bfloat16_vec(result_vec);
-    std::vector<bfloat16> src_vec_0_b16 = unpack_uint32_vec_into_bfloat16_vec(src_vec_0);
-    std::vector<bfloat16> src_vec_1_b16 = unpack_uint32_vec_into_bfloat16_vec(src_vec_1);
-    std::vector<bfloat16> trgt_vec_b16 = unpack_uint32_vec_into_bfloat16_vec(src_vec_1);  // reused buffer
-
-    int last_matching_index = 0;
-    int last_incorrect_index = 0;
-    float error = static_cast<float>(ERROR);
-    float max_error = 0.0f;
-    int max_error_index = 0;
-    // string to be added to during for loop
-    std::string debug_info = "Mismatch blocks: ";
-
-    for (size_t i = 0; i < num_els * 2; i++) {
-        trgt_vec_b16[i] = static_cast<bfloat16>(
-            (src_vec_0_b16[i].to_float() + src_vec_1_b16[i].to_float()) * static_cast<float>(total_nodes / 2));
-
-        float actual = result_vec_b16[i].to_float();
-        float expected = trgt_vec_b16[i].to_float();
-        float diff = std::fabs(actual - expected);
-        
-        if (all_match && diff > error) {
-            printf("Mismatch at index %zu:\n", i);
-            printf("  Expected: %d\n", static_cast<int>(expected));
-            printf("  Actual  : %d\n", static_cast<int>(actual));
-            printf("  Original values: %f %f\n\n", src_vec_0_b16[i].to_float(), src_vec_1_b16[i].to_float());
-            all_match = false;
-            if (static_cast<int>(i)%1024==0){
-                debug_info += std::to_string(static_cast<int>(i)/1024) + " ";
-            }
-
-        } else if (diff <= error) {
-            last_matching_index = static_cast<int>(i);
-            num_matches++;
-        } else {
-            last_incorrect_index = static_cast<int>(i);
-            if (diff > max_error) {
-                max_error = diff;
-                max_error_index = static_cast<int>(i);
-            }
-            if (static_cast<int>(i)%1024==0){
-                debug_info += std::to_string(static_cast<int>(i)/1024) + " ";
-            }
-        }
-    }
-
-    if (all_match) {
+    ValidationResult validation = validate_allreduce(
+        result_vec.data(),
+        src_vec_0.data(),
+        src_vec_1.data(),
+        num_els,
+        ERROR,
+        static_cast<float>(total_nodes / 2));
+
+    if (validation.all_match()) {
         printf("All values match!\n");
-    } else {
-        printf("Total matches: %d\n", num_matches);
-        printf(
-            "Last match at index %d: %d\n\n",
-            last_matching_index,
-            static_cast<int>(result_vec_b16[last_matching_index].to_float()));
-        printf(
-            "Last wrong at index %d: %d Shpuld be: %d\n\n",
-            last_incorrect_index,
-            static_cast<int>(result_vec_b16[last_incorrect_index].to_float()),
-            static_cast<int>(trgt_vec_b16[last_incorrect_index].to_float()));
-
-        printf("Result (nocast) = %d, casted = %d\n", result_vec[0], static_cast<int>(result_vec_b16[0].to_float()));
-
-        uint32_t output = pack_two_bfloat16_into_uint32({trgt_vec_b16[0], trgt_vec_b16[1]});
-        printf("Expected (nocast) = %d, casted = %d\n", output, static_cast<int>(trgt_vec_b16[0].to_float()));
-
-        printf(
-            "Actual last result (nocast) = %d, casted = %d\n",
-            static_cast<int>(result_vec[num_els - 1]),
-            static_cast<int>(result_vec_b16[2 * num_els - 1].to_float()));
-
-        output = pack_two_bfloat16_into_uint32({trgt_vec_b16[2 * num_els - 2], trgt_vec_b16[2 * num_els - 1]});
-        printf(
-            "Expected last result (nocast) = %d, casted = %d\n",
-            output,
-            static_cast<int>(trgt_vec_b16[2 * num_els - 1].to_float()));
-
-        printf("Max error: %f\n", max_error);
-        printf(
-            "Max error index: %d, values %f vs %f\n",
-            max_error_index,
-            result_vec_b16[max_error_index].to_float(),
-            trgt_vec_b16[max_error_index].to_float());
-
-        if (max_error_index + 10 < static_cast<int>(trgt_vec_b16.size())) {
-            printf(
-                "Max error index +10: %d, values %f vs %f",
-                max_error_index + 10,
-                result_vec_b16[max_error_index + 10].to_float(),
-                trgt_vec_b16[max_error_index + 10].to_float());
-        }
-        printf("\n%s\n________________\n", debug_info.c_str());
+        return validation;
     }
-}
 
-int highest_power_of_two(int value) {
-    if (value >= 8) {
-        return 8;
-    }
-    if (value >= 4) {
-        return 4;
-    }
-    if (value >= 2) {
-        return 2;
-    }
-    return 1;
-}
+    // Element i is the low half of word i / 2 if i is even, the high half otherwise
+    auto element = [](const std::vector<uint32_t>& vec, size_t i) -> uint16_t {
+        return i % 2 ? vec[i / 2] >> 16 : vec[i / 2] & 0xffff;
+    };
+    auto expected = [&](size_t i) {
+        return expected_allreduce_value(element(src_vec_0, i), element(src_vec_1, i), total_nodes / 2);
+    };
 
-// Returns the pattern of which NoC will be used for each comm step for swing algo
-uint32_t get_step_directions(int node_x, int node_y) {
-    if (node_x % 2 == 0) {
-        return node_y % 2 == 0 ? 0b110011 : 0b011001;
-    } else {
-        return node_y % 2 == 0 ? 0b100110 : 0b001100;
-    }
-}
+    size_t first = validation.first_mismatch_index;
+    printf("Mismatch at index %zu:\n", first);
+    printf("  Expected: %d\n", static_cast<int>(expected(first)));
+    printf("  Actual  : %d\n", static_cast<int>(bf16_to_float(element(result_vec, first))));
+    printf(
+        "  Original values: %f %f\n\n",
+        bf16_to_float(element(src_vec_0, first)),
+        bf16_to_float(element(src_vec_1, first)));
+
+    printf("Total matches: %zu of %zu\n", validation.num_matches, validation.num_values);
+    printf("Max error: %f\n", validation.max_error);
+    printf(
+        "Max error index: %zu, values %f vs %f\n",
+        validation.max_error_index,
+        bf16_to_float(element(result_vec, validation.max_error_index)),
+        expected(validation.max_error_index));
 
-// Returns the 1D index of the communication partner for a given node at a given step
-int get_comm_partner_recdub_2D(
-    int node,
-    int recdub_step,
-    bool horizontal_step,
-    int message_pass_depth,
-    uint32_t& step_directions,
-    int SIDE_LENGTH) {
-    int row = node / SIDE_LENGTH;
-    int col = node % SIDE_LENGTH;
-    int node_position = horizontal_step ? col : row;
-    int node_other_position = !horizontal_step ? col : row;
-
-    bool sending_SE = node_position % (2 * message_pass_depth) < message_pass_depth;
-    step_directions = sending_SE ? (step_directions | (1 << recdub_step)) : (step_directions & ~(1 << recdub_step));
-
-    int recv_node = node_position + (sending_SE ? message_pass_depth : -message_pass_depth);
-    return horizontal_step ? recv_node + node_other_position * SIDE_LENGTH
-                           : recv_node * SIDE_LENGTH + node_other_position;
+    std::string debug_info = "Mismatch blocks: ";
+    for (uint32_t tile : validation.mismatch_tiles) {
+        debug_info += std::to_string(tile) + " ";
+    }
+    printf("%s\n________________\n", debug_info.c_str());
+    return validation;
 }
 
-// Returns the 1D index of the communication partner for a given node at a given step
-int get_comm_partner_swing_2D(int node, int step, bool horizontal_step, int SIDE_LENGTH, int TOTAL_NODES) {
-    int row = node / SIDE_LENGTH;
-    int col = node % SIDE_LENGTH;
-    step = step / 2;
-
-    // straight line distnce
-    int dist = (int)((1 - (int)pow(-2, step + 1)) / 3);
-
-    int comm_partner;
-    if (horizontal_step) {
-        comm_partner = (node % 2 == 0) ? (node + dist) : (node - dist);  // can return -ve number
-        if (comm_partner / SIDE_LENGTH < row || comm_partner < 0) {
-            comm_partner += SIDE_LENGTH;
-        } else if (comm_partner / SIDE_LENGTH > row) {
-            comm_partner -= SIDE_LENGTH;
-        }
+// Checks the result of an allreduce of distinct per-core inputs against the float sum of the inputs
+ValidationResult validate_against_reference(
+    const std::vector<uint32_t>& result_vec,
+    const std::vector<const uint32_t*>& inputs,
+    size_t num_els,
+    float ERROR,
+    const SchedulePlan& plan) {
+    AllredReference reference(plan, true);
+    std::vector<uint32_t> golden = reference.Run(inputs, num_els, ReferenceOrder::Float);
+    ValidationResult validation = validate_against_golden(result_vec.data(), golden.data(), num_els, ERROR);
+    if (validation.all_match()) {
+        printf("All values match!\n");
     } else {
-        comm_partner = (row % 2 == 0) ? (node + SIDE_LENGTH * dist) : (node - SIDE_LENGTH * dist);
-        if (comm_partner < 0) {
-            comm_partner += TOTAL_NODES;
-        } else if (comm_partner >= TOTAL_NODES) {
-            comm_partner -= TOTAL_NODES;
-        }
+        printf("Total matches: %zu of %zu\n", validation.num_matches, validation.num_values);
+        printf("First mismatch index: %zu\n", validation.first_mismatch_index);
+        printf("Max error: %f at index %zu\n", validation.max_error, validation.max_error_index);
+        printf("________________\n");
     }
-    return comm_partner;  // will  loop round  to  always be in  range
+    return validation;
 }
 
 // Handles all the setting up given a specific config
@@ -196,10 +101,9 @@ AllredConfig::AllredConfig(
     char** argv,
     IDevice* device,
     CommandQueue& cq,
-    Program& program,
-    CoreRange cores,
     int SIDE_LENGTH, 
-    bool large_buffer)
+    bool large_buffer,
+    const AllredOptions& options)
 {
     // Assign input args
     SWING_VERSION = false;
@@ -215,22 +119,40 @@ AllredConfig::AllredConfig(
     RND_SRC = (argc >= 5) ? std::stoi(argv[4]) : 0;
 
     NUM_TILES = (argc >= 6) ? std::stoi(argv[5]) : 1;
-    NUM_TILES = NUM_TILES < 1 ? 1 : NUM_TILES;
 
     ERROR = (argc >= 7) ? std::stoi(argv[6]) : 1;
 
+    PER_CORE_INPUTS = options.GetString("inputs", "pair") == "per-core";
+    ITERATIONS = std::max(1, options.GetInt("iterations", 1));
+    WARMUP = std::max(0, options.GetInt("warmup", 0));
+    STEP_ZONES = options.Has("step-zones");
+    STATS = options.Has("stats");
+    STATS_FREQ_MHZ = std::stod(options.GetString("freq-mhz", "1000"));
+    if (options.Has("tuning")) {
+        LOO_CROSSOVER_TILES = load_tuning_table(options.GetString("tuning", "")).loo_crossover_tiles;
+    }
+
+    this->SIDE_LENGTH = SIDE_LENGTH;
     TOTAL_NODES = SIDE_LENGTH * SIDE_LENGTH;
 
-    if (large_buffer) {
-        NUM_TILES = NUM_TILES * TOTAL_NODES;
-    } else if (NUM_TILES < 64){
-        uint32_t power = 1;
-        while (power < NUM_TILES) {
-            power <<= 1; // multiply by 2
-        }
-        NUM_TILES = power;
-    } else {
-        NUM_TILES = ((NUM_TILES + 64 - 1) / 64) * 64; // multiple of 64
+    NUM_TILES = normalize_num_tiles(NUM_TILES, large_buffer, TOTAL_NODES);
+    // The BO kernels in bandwidth optimal mode only need half a cb_recv, see recv_cb_tiles
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, SIDE_LENGTH);
+    ChunkPlan chunks = plan_chunks(plan, large_buffer, NUM_TILES, std::max(0, options.GetInt("chunk-tiles", 0)));
+    CHUNK_TILES = chunks.chunk_tiles;
+    NUM_CHUNKS = chunks.num_chunks;
+    if (chunks.streaming()) {
+        printf(
+            "Streaming %u tiles (%d requested) through L1 in %u chunks of %u tiles\n",
+            chunks.tiles(),
+            NUM_TILES,
+            NUM_CHUNKS,
+            CHUNK_TILES);
+        NUM_TILES = chunks.tiles();
+    }
+    NUM_SYNCS = std::max(0, options.GetInt("num-syncs", 0));
+    if (options.Has("sync-bytes")) {
+        NUM_SYNCS = std::max<uint32_t>(1, CHUNK_TILES * 2048 / std::max(1, options.GetInt("sync-bytes", 1)));
     }
 
     SWING_ALGO_STEPS = static_cast<uint32_t>(std::log2(TOTAL_NODES));
@@ -239,27 +161,21 @@ AllredConfig::AllredConfig(
     for (uint32_t i = 0; i < core_array.size(); i++) {
         core_array[i] = {i % SIDE_LENGTH, i / SIDE_LENGTH};
     }
-
-    constexpr uint32_t num_semaphore_tiles = 1;
-    constexpr uint32_t semaphore_tile_size = 1;
-    constexpr uint32_t cb_tile_size = 2048;
-    constexpr tt::DataFormat data_format = tt::DataFormat::Float16_b;
-
-    uint32_t num_data_tiles = NUM_TILES;
-    uint32_t num_recv_tiles = NUM_TILES;
-
-    // Helper lambda for CB creation
-    auto create_cb = [&](uint32_t index, uint32_t size, uint32_t page_size) {
-        return tt_metal::CreateCircularBuffer(
-            program, cores, CircularBufferConfig(size, {{index, data_format}}).set_page_size(index, page_size));
-    };
-
-    // Create circular buffers
-    CBHandle cb_compute = create_cb(CBIndex::c_0, semaphore_tile_size * num_semaphore_tiles, semaphore_tile_size);
-    CBHandle cb_NW = create_cb(CBIndex::c_1, semaphore_tile_size * num_semaphore_tiles, semaphore_tile_size);
-    CBHandle cb_SE = create_cb(CBIndex::c_2, semaphore_tile_size * num_semaphore_tiles, semaphore_tile_size);
-    CBHandle cb_recv = create_cb(CBIndex::c_3, num_recv_tiles * cb_tile_size, cb_tile_size);
-    CBHandle cb_local = create_cb(CBIndex::c_16, num_data_tiles * cb_tile_size, cb_tile_size);
+    if (options.Has("placement")) {
+        // Same rectangle of cores, so the CoreRange of the drivers still covers them all
+        std::string placement_path = options.GetString("placement", ""), error;
+        std::ifstream table(placement_path);
+        Placement placement;
+        if (!table) {
+            printf("Could not open %s, the cores are placed row major\n", placement_path.c_str());
+        } else if (!read_placement(table, SIDE_LENGTH, SIDE_LENGTH, placement, error)) {
+            printf("%s: %s, the cores are placed row major\n", placement_path.c_str(), error.c_str());
+        } else {
+            for (uint32_t i = 0; i < core_array.size(); i++) {
+                core_array[i] = {placement[i].first, placement[i].second};
+            }
+        }
+    }
 
     // DRAM setup
     single_tile_size = 2048;
@@ -269,12 +185,55 @@ AllredConfig::AllredConfig(
         .page_size = single_tile_size * NUM_TILES,
         .buffer_type = tt_metal::BufferType::DRAM};
 
-    src_0_dram_buffer = CreateBuffer(dram_config);
-    src_1_dram_buffer = CreateBuffer(dram_config);
     dst_dram_buffer = CreateBuffer(dram_config);
+    num_els = single_tile_size * NUM_TILES / sizeof(uint32_t);
+
+    if (STATS) {
+        // Zeroed, so a kernel that doesn't count shows up as a region without runs
+        tt_metal::InterleavedBufferConfig stats_config{
+            .device = device,
+            .size = StatsSlabBytes() * TOTAL_NODES,
+            .page_size = StatsSlabBytes() * TOTAL_NODES,
+            .buffer_type = tt_metal::BufferType::DRAM};
+        stats_dram_buffer = CreateBuffer(stats_config);
+        std::vector<uint32_t> zeros(StatsSlabBytes() * TOTAL_NODES / sizeof(uint32_t));
+        EnqueueWriteBuffer(cq, stats_dram_buffer, zeros, true);
+    }
+
+    if (PER_CORE_INPUTS) {
+        // One page per core, interleaved over the DRAM banks so the initial reads are spread out
+        using clock = std::chrono::steady_clock;
+        auto start = clock::now();
+        core_inputs = generate_core_inputs(TOTAL_NODES, num_els, RND_SRC);
+        auto generated = clock::now();
+
+        tt_metal::InterleavedBufferConfig inputs_config{
+            .device = device,
+            .size = single_tile_size * NUM_TILES * TOTAL_NODES,
+            .page_size = single_tile_size * NUM_TILES,
+            .buffer_type = tt_metal::BufferType::DRAM};
+        inputs_dram_buffer = CreateBuffer(inputs_config);
+        num_dram_banks = device->num_banks(tt_metal::BufferType::DRAM);
+        EnqueueWriteBuffer(cq, inputs_dram_buffer, core_inputs, true);
+        auto uploaded = clock::now();
+
+        double bytes = static_cast<double>(core_inputs.size() * sizeof(uint32_t));
+        double generate_ms = std::chrono::duration<double, std::milli>(generated - start).count();
+        double upload_ms = std::chrono::duration<double, std::milli>(uploaded - generated).count();
+        printf(
+            "Per-core inputs: %u x %u bytes, generated in %.1f ms (%.2f GB/s), uploaded in %.1f ms (%.2f GB/s)\n",
+            TOTAL_NODES,
+            single_tile_size * NUM_TILES,
+            generate_ms,
+            bytes / generate_ms / 1e6,
+            upload_ms,
+            bytes / upload_ms / 1e6);
+        return;
+    }
 
     // Create source data and write to DRAM
-    num_els = single_tile_size * NUM_TILES / sizeof(uint32_t);
+    src_0_dram_buffer = CreateBuffer(dram_config);
+    src_1_dram_buffer = CreateBuffer(dram_config);
     if (RND_SRC < 0) {
         src_vec_0 = create_constant_vector_of_bfloat16(single_tile_size * NUM_TILES, 1.0f);
         src_vec_1 = src_vec_0;
@@ -288,13 +247,62 @@ AllredConfig::AllredConfig(
     EnqueueWriteBuffer(cq, src_1_dram_buffer, src_vec_1, true);
 }
 
+void AllredConfig::CreateCircularBuffers(Program& program, const CoreRange& cores, uint32_t recv_tiles) const {
+    constexpr tt::DataFormat data_format = tt::DataFormat::Float16_b;
+    recv_tiles = recv_tiles ? recv_tiles : CHUNK_TILES;
+    for (const CircularBufferSpec& cb : allred_circular_buffers(CHUNK_TILES, recv_tiles, NUM_CHUNKS > 1, StatsSlabBytes())) {
+        tt_metal::CreateCircularBuffer(
+            program, cores, CircularBufferConfig(cb.size, {{cb.index, data_format}}).set_page_size(cb.index, cb.page_size));
+    }
+}
+
+void AllredConfig::SetSourceArgs(uint32_t core_i, std::vector<uint32_t>& dataflow_args) const {
+    if (PER_CORE_INPUTS) {
+        // Page core_i of an interleaved buffer sits in bank core_i % banks, at the same offset in every bank
+        uint32_t page_size = single_tile_size * NUM_TILES;
+        dataflow_args[0] = inputs_dram_buffer->address() + (core_i / num_dram_banks) * page_size;
+        dataflow_args[2] = core_i % num_dram_banks;
+    } else if (core_array[core_i].x % 2 == 0) {
+        dataflow_args[0] = src_1_dram_buffer->address();
+        dataflow_args[2] = src_1_bank_id;
+    } else {
+        dataflow_args[0] = src_0_dram_buffer->address();
+        dataflow_args[2] = src_0_bank_id;
+    }
+}
+
+void AllredConfig::PrintStats(CommandQueue& cq) {
+    std::vector<uint32_t> words;
+    EnqueueReadBuffer(cq, stats_dram_buffer, words, true);
+    std::vector<CoreStats> cores;
+    std::string error;
+    if (!parse_stats_buffer(words, TOTAL_NODES, stats_slots(SWING_ALGO_STEPS), cores, error)) {
+        printf("No stats: %s\n", error.c_str());
+        return;
+    }
+    printf("Per step stats, per core and timed run (%lu runs):\n", (unsigned long)cores[0].risc[0].runs);
+    print_stats_summary(
+        summarize_stats(cores), stats_slot_names(SWING_ALGO_STEPS, stats_mem), STATS_FREQ_MHZ / 1000);
+}
+
+// With per-core inputs the expected result is the float sum of all inputs, from the host reference
+ValidationResult AllredConfig::ValidateCoreInputsResult() const {
+    std::vector<const uint32_t*> inputs(TOTAL_NODES);
+    for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+        inputs[core_i] = &core_inputs[core_i * num_els];
+    }
+    return validate_against_reference(
+        result_vec, inputs, num_els, ERROR, SchedulePlanner::Get(SWING_VERSION, SIDE_LENGTH));
+}
+
 // Sets up the kernel
 KernelHandle CreateDataflowKernel(
     Program& program,
     const CoreCoord& core,
     std::vector<uint32_t>& args,
     bool is_SE,
-    const std::string& kernel_base_dir)
+    const std::string& kernel_base_dir,
+    const std::vector<uint32_t>& compile_args)
 {
     auto processor = is_SE ? DataMovementProcessor::RISCV_1 : DataMovementProcessor::RISCV_0;
     auto noc       = is_SE ? NOC::RISCV_1_default : NOC::RISCV_0_default;
@@ -307,7 +315,7 @@ KernelHandle CreateDataflowKernel(
         program,
         kernel_path,
         core,
-        DataMovementConfig{.processor = processor, .noc = noc});
+        DataMovementConfig{.processor = processor, .noc = noc, .compile_args = compile_args});
 
     SetRuntimeArgs(program, kernel, core, args);
     return kernel;
@@ -318,7 +326,8 @@ KernelHandle CreateComputeKernel(
     Program& program,
     const CoreCoord& core,
     const std::vector<uint32_t>& compute_args,
-    const std::string& kernel_base_dir)
+    const std::string& kernel_base_dir,
+    const std::vector<uint32_t>& compile_args)
 {
     std::string kernel_path = OVERRIDE_KERNEL_PREFIX "charlie_work/"
         + kernel_base_dir 
@@ -332,9 +341,196 @@ KernelHandle CreateComputeKernel(
             .math_fidelity = MathFidelity::HiFi4,
             .fp32_dest_acc_en = false,
             .math_approx_mode = false,
-            .compile_args = compute_args});
+            .compile_args = compile_args});
 
     SetRuntimeArgs(program, kernel, core, compute_args);
     return kernel;
 }
 
+
+// Kernels on all of cores, their runtime args are set per core
+KernelHandle CreateDataflowKernel(
+    Program& program,
+    const CoreRange& cores,
+    bool is_SE,
+    const std::string& kernel_base_dir,
+    const std::vector<uint32_t>& compile_args,
+    const std::map<std::string, std::string>& defines)
+{
+    auto processor = is_SE ? DataMovementProcessor::RISCV_1 : DataMovementProcessor::RISCV_0;
+    auto noc       = is_SE ? NOC::RISCV_1_default : NOC::RISCV_0_default;
+
+    std::string kernel_path = OVERRIDE_KERNEL_PREFIX "charlie_work/"
+        + kernel_base_dir
+        + "/kernels/dataflow_kernel.cpp";
+
+    return CreateKernel(
+        program,
+        kernel_path,
+        cores,
+        DataMovementConfig{.processor = processor, .noc = noc, .compile_args = compile_args, .defines = defines});
+}
+
+KernelHandle CreateComputeKernel(
+    Program& program,
+    const CoreRange& cores,
+    const std::string& kernel_base_dir,
+    const std::vector<uint32_t>& compile_args,
+    const std::map<std::string, std::string>& defines)
+{
+    std::string kernel_path = OVERRIDE_KERNEL_PREFIX "charlie_work/"
+        + kernel_base_dir
+        + "/kernels/compute_kernel.cpp";
+
+    return CreateKernel(
+        program,
+        kernel_path,
+        cores,
+        ComputeConfig{
+            .math_fidelity = MathFidelity::HiFi4,
+            .fp32_dest_acc_en = false,
+            .math_approx_mode = false,
+            .compile_args = compile_args,
+            .defines = defines});
+}
+
+AllredProgramKey AllredProgramCache::Key(const std::string& variant, const AllredConfig& arCfg) {
+    return {
+        arCfg.KernelVariant(variant),
+        arCfg.SWING_VERSION,
+        arCfg.SIDE_LENGTH,
+        arCfg.NUM_TILES,
+        arCfg.ITERATIONS,
+        arCfg.WARMUP,
+        arCfg.STEP_ZONES,
+        arCfg.STATS,
+        arCfg.NUM_SYNCS};
+}
+
+Program& AllredProgramCache::Get(
+    const std::string& variant, AllredConfig& arCfg, IDevice* device, const CoreRange& cores, int PRINT_CORE) {
+    std::unique_ptr<Entry>& entry = entries[Key(variant, arCfg)];
+    if (!entry) {
+        entry = Build(arCfg.KernelVariant(variant), arCfg, device, cores);
+    }
+
+    // Only the DRAM args depend on arCfg's buffers, the rest of the tables is kept
+    bool mem = variant == "allred_mem_2D";
+    uint32_t is_SE_arg = mem ? 13 : 10;
+    arCfg.common_dram_buffer = entry->common_dram_buffer;
+    arCfg.stats_mem = mem;
+    const SchedulePlan& plan = SchedulePlanner::Get(arCfg.SWING_VERSION, arCfg.SIDE_LENGTH);
+    uint32_t stats_arg = mem ? MemArgLayout(plan.algo_steps).stats() : BOArgLayout(plan.algo_steps, plan.total_nodes).stats();
+    for (uint32_t core_i = 0; core_i < arCfg.core_array.size(); core_i++) {
+        std::vector<uint32_t>& dataflow_args = entry->args.dataflow[core_i];
+        arCfg.SetSourceArgs(core_i, dataflow_args);
+        dataflow_args[1] = arCfg.dst_dram_buffer->address();
+        dataflow_args[4] = arCfg.dst_bank_id;
+        if (mem) {
+            dataflow_args[6] = entry->common_dram_buffer->address();
+            dataflow_args[7] = 0;  // common_dram_noc_coord.x
+        } else {
+            dataflow_args[3] = PRINT_CORE;
+        }
+        if (arCfg.STATS) {
+            // A single page, in the first bank
+            dataflow_args[stats_arg] = arCfg.stats_dram_buffer->address();
+            dataflow_args[stats_arg + 1] = 0;
+        }
+        dataflow_args[is_SE_arg] = (uint32_t)true;
+        SetRuntimeArgs(entry->program, entry->dataflow_SE, arCfg.core_array[core_i], dataflow_args);
+        dataflow_args[is_SE_arg] = (uint32_t)false;
+        SetRuntimeArgs(entry->program, entry->dataflow_NW, arCfg.core_array[core_i], dataflow_args);
+    }
+    return entry->program;
+}
+
+std::unique_ptr<AllredProgramCache::Entry> AllredProgramCache::Build(
+    const std::string& variant, const AllredConfig& arCfg, IDevice* device, const CoreRange& cores) {
+    auto entry = std::make_unique<Entry>();
+    entry->program = CreateProgram();
+    const SchedulePlan& plan = SchedulePlanner::Get(arCfg.SWING_VERSION, arCfg.SIDE_LENGTH);
+    // Same cb_recv size as build_BO_arg_tables hands the kernels
+    arCfg.CreateCircularBuffers(entry->program, cores, recv_cb_tiles(plan, variant, arCfg.CHUNK_TILES));
+
+    // Physical coordinates of the core with a given linear index
+    PhysicalCoreFn physical_core = [&](int core_i) {
+        CoreCoord core = device->worker_core_from_logical_core(arCfg.core_array[core_i]);
+        return std::make_pair((uint32_t)core.x, (uint32_t)core.y);
+    };
+
+    /*args for the BO NoC kernel:
+    0-5 : src + dst dram
+    6: num steps
+    7-8: core x, y
+    9: core i (x+ y*side length)
+    10: is_SE
+    11: step_directions
+    12: num_tiles
+    13: tiles_per_node
+    14-25: core x, y for each step
+    26-33: semaphores for each step
+    34-45: block indexes to send at each step
+    46-57: block indexes to recv at each step
+    58: number of chunks streamed per run, 1 if the vector fits in L1
+    59: pages of cb_recv, half the vector in bandwidth optimal mode
+    60: semaphore syncs per step of the send loop, see model_num_syncs
+    61-124: L1 position of each block, see contiguous_block_layout (in order in latency optimal mode)
+    125-126: address and bank of the --stats buffer
+
+    args for the mem NoC kernel:
+    0-5 : src + dst dram
+    6-8: common dram
+    9: num steps
+    10-11: core x, y
+    12: core i (x+ y*side length)
+    13: is_SE
+    14: step_directions
+    15: num_tiles
+    16: tiles_per_node
+    17-28: core x, y for each step
+    29-36: semaphores for each step
+    37-48: block indexes to send at each step
+    49-50: address and bank of the --stats buffer
+    */
+    uint32_t semaphores;
+    std::string dataflow_kernel_path, compute_kernel_path;
+    if (variant == "allred_mem_2D") {
+        entry->args = build_mem_arg_tables(plan, physical_core, arCfg.NUM_TILES);
+        semaphores = MemArgLayout(plan.algo_steps).semaphores();
+        dataflow_kernel_path = compute_kernel_path = "allred_mem_2D";
+
+        tt_metal::InterleavedBufferConfig common_dram_config{
+            .device = device,
+            .size = arCfg.single_tile_size * arCfg.NUM_TILES * arCfg.TOTAL_NODES,
+            .page_size = arCfg.single_tile_size * arCfg.NUM_TILES * arCfg.TOTAL_NODES,
+            .buffer_type = tt_metal::BufferType::DRAM};
+        entry->common_dram_buffer = CreateBuffer(common_dram_config);
+    } else {
+        entry->args = build_BO_arg_tables(
+            plan, physical_core, variant == "allred_BO_2D", arCfg.CHUNK_TILES, arCfg.NUM_CHUNKS, arCfg.NUM_SYNCS);
+        semaphores = BOArgLayout(plan.algo_steps).semaphores();
+        // The Latency Optimal algorithm uses a different dataflow kernel for small vectors, see KernelVariant
+        dataflow_kernel_path = variant == "allred_LOO_2D" ? "allred_LOO_2D" : "allred_BO_2D";
+        compute_kernel_path = "allred_BO_2D";
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint32_t semaphore = tt_metal::CreateSemaphore(entry->program, cores, INVALID);
+        for (std::vector<uint32_t>& dataflow_args : entry->args.dataflow) {
+            dataflow_args[semaphores + i] = semaphore;
+        }
+    }
+
+    // One kernel per RISC for all the cores, the compile args are the same everywhere
+    std::map<std::string, std::string> defines = arCfg.KernelDefines();
+    entry->dataflow_SE =
+        CreateDataflowKernel(entry->program, cores, true, dataflow_kernel_path, arCfg.KernelCompileArgs(), defines);
+    entry->dataflow_NW =
+        CreateDataflowKernel(entry->program, cores, false, dataflow_kernel_path, arCfg.KernelCompileArgs(), defines);
+    entry->compute = CreateComputeKernel(entry->program, cores, compute_kernel_path, arCfg.KernelCompileArgs(), defines);
+    for (uint32_t core_i = 0; core_i < arCfg.core_array.size(); core_i++) {
+        SetRuntimeArgs(entry->program, entry->compute, arCfg.core_array[core_i], entry->args.compute[core_i]);
+    }
+    return entry;
+}
@@ -7,12 +7,19 @@
 #include <vector>
 #include <cstdint>
 #include <cmath>
+#include <map>
 #include <memory>
+#include <tuple>
+#include "allred_inputs.hpp"
+#include "allred_options.hpp"
+#include "allred_schedule.hpp"
+#include "allred_stats.hpp"
+#include "allred_validate.hpp"
 
 using namespace tt;
 using namespace tt::tt_metal;
 
-void validate_result_vector(
+ValidationResult validate_result_vector(
     const std::vector<uint32_t>& result_vec,
     const std::vector<uint32_t>& src_vec_0,
     const std::vector<uint32_t>& src_vec_1,
@@ -20,27 +27,28 @@ void validate_result_vector(
     float ERROR,
     uint32_t total_nodes);
 
-    
-int highest_power_of_two(int);
-
-uint32_t get_step_directions(int, int);
-
-int get_comm_partner_swing_2D(int, int, bool, int, int);
+ValidationResult validate_against_reference(
+    const std::vector<uint32_t>& result_vec,
+    const std::vector<const uint32_t*>& inputs,
+    std::size_t num_els,
+    float ERROR,
+    const SchedulePlan& plan);
 
-int get_comm_partner_recdub_2D(int, int, bool, int, uint32_t&, int);
 
 KernelHandle CreateComputeKernel(
     Program&,
     const CoreCoord&,
     const std::vector<uint32_t>&,
-    const std::string&);
+    const std::string&,
+    const std::vector<uint32_t>&);
 
 KernelHandle CreateDataflowKernel(
     Program&,
     const CoreCoord&,
     std::vector<uint32_t>&,
     bool,
-    const std::string&);
+    const std::string&,
+    const std::vector<uint32_t>&);
 
 #ifndef ALLRED_HELPER_HPP
 #define ALLRED_HELPER_HPP
@@ -60,6 +68,33 @@ public:
     std::shared_ptr<tt::tt_metal::Buffer> src_0_dram_buffer;
     std::shared_ptr<tt::tt_metal::Buffer> src_1_dram_buffer;
     std::shared_ptr<tt::tt_metal::Buffer> dst_dram_buffer;
+    std::shared_ptr<tt::tt_metal::Buffer> common_dram_buffer;  // Shared vector of allred_mem_2D
+    // --inputs=per-core: every core reads its own vector from one interleaved buffer, a page per core
+    bool PER_CORE_INPUTS;
+    int SIDE_LENGTH;
+    std::shared_ptr<tt::tt_metal::Buffer> inputs_dram_buffer;
+    std::vector<uint32_t> core_inputs;  // All cores' inputs back to back, see generate_core_inputs
+    uint32_t num_dram_banks = 1;
+    // --iterations/--warmup: timed and untimed runs of the allreduce within one launch
+    uint32_t ITERATIONS;
+    uint32_t WARMUP;
+    // --tuning=PATH: allred_LO_2D runs the allred_LOO_2D dataflow kernel below the table's crossover, 64 without
+    uint32_t LOO_CROSSOVER_TILES = 64;
+    // Vectors larger than L1 are streamed through it by the BO kernels in NUM_CHUNKS chunks of CHUNK_TILES
+    // (--chunk-tiles=N, chosen by plan_chunks by default), NUM_TILES is then padded to whole chunks
+    uint32_t CHUNK_TILES;
+    uint32_t NUM_CHUNKS = 1;
+    // Semaphore syncs per step of the BO/LOO send loops, --num-syncs=N or --sync-bytes=N (N bytes of a chunk
+    // between syncs). 0 (the default) for the choice of model_num_syncs, others are rounded down to a valid count
+    uint32_t NUM_SYNCS = 0;
+    // --step-zones: the BO kernels record a profiler zone per phase of every step, see allred_critical_path
+    bool STEP_ZONES = false;
+    // --stats: the dataflow kernels count bytes, writes and wait cycles per step into stats_dram_buffer, a slab per
+    // core (see allred_stats.hpp), printed after every run with the bandwidth at --freq-mhz (1000 by default)
+    bool STATS = false;
+    double STATS_FREQ_MHZ = 1000;
+    bool stats_mem = false;  // Whether the last program set up by AllredProgramCache::Get is allred_mem_2D's
+    std::shared_ptr<tt::tt_metal::Buffer> stats_dram_buffer;
     std::vector<uint32_t> src_vec_0;
     std::vector<uint32_t> src_vec_1;
     std::vector<uint32_t> result_vec;
@@ -76,23 +111,115 @@ public:
     char** argv, 
     IDevice* device, 
     CommandQueue& cq, 
-    Program& program, 
-    CoreRange cores, 
     int SIDE_LENGTH,
-    bool large_buffer);
+    bool large_buffer,
+    const AllredOptions& options = AllredOptions());
 
-    void RunProgram(CommandQueue& cq, Program& program, IDevice* device) {
+    // Creates the CBs used by all the kernels, sized for a chunk of CHUNK_TILES. cb_recv has recv_tiles pages, a
+    // whole chunk if 0, see recv_cb_tiles
+    void CreateCircularBuffers(Program& program, const CoreRange& cores, uint32_t recv_tiles = 0) const;
+
+    // Compile time args shared by all the kernels
+    std::vector<uint32_t> KernelCompileArgs() const { return {ITERATIONS, WARMUP}; }
+    // Preprocessor defines shared by all the kernels
+    std::map<std::string, std::string> KernelDefines() const {
+        std::map<std::string, std::string> defines;
+        if (STEP_ZONES) {
+            defines["ALLRED_STEP_ZONES"] = "1";
+        }
+        if (STATS) {
+            defines["ALLRED_STATS"] = "1";
+        }
+        return defines;
+    }
+
+    // Variant whose kernels run for variant, allred_LOO_2D for allred_LO_2D below LOO_CROSSOVER_TILES, see
+    // kernel_variant
+    std::string KernelVariant(const std::string& variant) const {
+        return kernel_variant(variant, NUM_TILES, NUM_CHUNKS, LOO_CROSSOVER_TILES);
+    }
+
+    // Sets the source address and bank args (0 and 2) of the dataflow kernels of core_i
+    void SetSourceArgs(uint32_t core_i, std::vector<uint32_t>& dataflow_args) const;
+
+    // Bytes of a core's --stats slab, 0 without --stats
+    uint32_t StatsSlabBytes() const { return STATS ? stats_slab_bytes(stats_slots(SWING_ALGO_STEPS)) : 0; }
+    // Reads back the --stats buffer and prints its per step summary
+    void PrintStats(CommandQueue& cq);
+
+    // Runs the program (if RUN_KERNEL), then reads back and validates the result. The device is left open
+    ValidationResult Execute(CommandQueue& cq, Program& program, IDevice* device) {
         if (RUN_KERNEL) {
             EnqueueProgram(cq, program, false);
             Finish(cq);
             tt_metal::detail::DumpDeviceProfileResults(device);
+            if (STATS) {
+                PrintStats(cq);
+            }
         }
 
         /* Read in result into a host vector */
         EnqueueReadBuffer(cq, dst_dram_buffer, result_vec, true);
-        validate_result_vector(result_vec, src_vec_0, src_vec_1, num_els, ERROR, TOTAL_NODES);
+        if (PER_CORE_INPUTS) {
+            return ValidateCoreInputsResult();
+        }
+        return validate_result_vector(result_vec, src_vec_0, src_vec_1, num_els, ERROR, TOTAL_NODES);
+    }
 
+    void RunProgram(CommandQueue& cq, Program& program, IDevice* device) {
+        Execute(cq, program, device);
         CloseDevice(device);
     }
+
+private:
+    ValidationResult ValidateCoreInputsResult() const;
+};
+
+KernelHandle CreateDataflowKernel(
+    Program&,
+    const CoreRange&,
+    bool,
+    const std::string&,
+    const std::vector<uint32_t>&,
+    const std::map<std::string, std::string>& defines = {});
+
+KernelHandle CreateComputeKernel(
+    Program&,
+    const CoreRange&,
+    const std::string&,
+    const std::vector<uint32_t>&,
+    const std::map<std::string, std::string>& defines = {});
+
+// Variant (allred_BO_2D, allred_LO_2D for the BO kernels in latency optimal mode, allred_LOO_2D for the same with
+// the dataflow kernel for small vectors, or allred_mem_2D), swing version, SIDE_LENGTH, NUM_TILES, iterations,
+// warmup, step zones, stats and NUM_SYNCS. allred_LO_2D is keyed by AllredConfig::KernelVariant, so by the kernels
+// that actually run
+using AllredProgramKey = std::tuple<std::string, bool, int, int, uint32_t, uint32_t, bool, bool, uint32_t>;
+
+// Programs of the allreduce variants, built once per configuration. The first Get of a configuration
+// creates the CBs, semaphores and one kernel per RISC on all cores, with the runtime arg tables from
+// build_BO_arg_tables/build_mem_arg_tables. Later Gets only point the DRAM args at the new buffers.
+class AllredProgramCache {
+public:
+    Program& Get(const std::string& variant, AllredConfig& arCfg, IDevice* device, const CoreRange& cores, int PRINT_CORE = 0);
+
+    bool Contains(const std::string& variant, const AllredConfig& arCfg) const {
+        return entries.count(Key(variant, arCfg)) > 0;
+    }
+    size_t Size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        Program program;
+        KernelHandle dataflow_SE, dataflow_NW, compute;
+        AllredArgTables args;
+        std::shared_ptr<tt::tt_metal::Buffer> common_dram_buffer;  // Shared vector of allred_mem_2D
+    };
+
+    static AllredProgramKey Key(const std::string& variant, const AllredConfig& arCfg);
+    static std::unique_ptr<Entry> Build(
+        const std::string& variant, const AllredConfig& arCfg, IDevice* device, const CoreRange& cores);
+
+    std::map<AllredProgramKey, std::unique_ptr<Entry>> entries;
 };
 #endif // ALLRED_HELPER_HPP
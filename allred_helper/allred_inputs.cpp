@@ -0,0 +1,57 @@
+#include "allred_inputs.hpp"
+#include "allred_bf16.hpp"
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+namespace {
+
+// Mixes the base seed and the core index into independent generator seeds
+uint64_t core_seed(int seed, uint32_t core_i) {
+    uint64_t z = (static_cast<uint64_t>(seed) << 32) + core_i + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void generate_core_input(uint32_t* words, size_t num_words, int seed, uint32_t core_i) {
+    if (seed < 0) {
+        uint32_t one = float_to_bf16(1.0f);
+        std::fill(words, words + num_words, one | one << 16);
+        return;
+    }
+    // Two 16 bit fractions per draw rather than uniform_real_distribution, which is several times slower.
+    // 16 bits is plenty for the 8 bit mantissa of bfloat16
+    std::mt19937_64 rng(core_seed(seed, core_i));
+    for (size_t i = 0; i < num_words; i++) {
+        uint64_t bits = rng();
+        float lo = static_cast<float>(bits & 0xffff) * (100.0f / 65536.0f);
+        float hi = static_cast<float>((bits >> 16) & 0xffff) * (100.0f / 65536.0f);
+        words[i] = float_to_bf16(lo) | static_cast<uint32_t>(float_to_bf16(hi)) << 16;
+    }
+}
+
+}  // namespace
+
+std::vector<uint32_t> generate_core_inputs(uint32_t total_nodes, size_t num_words, int seed, unsigned num_threads) {
+    std::vector<uint32_t> inputs(total_nodes * num_words);
+    num_threads = num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, total_nodes);
+
+    std::atomic<uint32_t> next_core{0};
+    auto worker = [&] {
+        for (uint32_t core_i = next_core++; core_i < total_nodes; core_i = next_core++) {
+            generate_core_input(&inputs[core_i * num_words], num_words, seed, core_i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < num_threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    return inputs;
+}
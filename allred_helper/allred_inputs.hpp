@@ -0,0 +1,13 @@
+#pragma once
+
+// Host generation of distinct per-core input vectors. Nothing in here depends on tt-metal.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Returns the inputs of all cores back to back (core i's num_words packed words at i * num_words), the
+// layout of the per-core DRAM buffer. Core i's values are uniform bfloat16 in [0, 100) drawn from a
+// generator seeded by (seed, i), so they don't depend on the number of threads. A negative seed gives
+// 1.0 everywhere, like the constant source of AllredConfig
+std::vector<uint32_t> generate_core_inputs(uint32_t total_nodes, size_t num_words, int seed, unsigned num_threads = 0);
@@ -0,0 +1,608 @@
+#include "allred_interleave.hpp"
+#include "allred_emulator.hpp"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <unordered_set>
+
+namespace {
+constexpr uint32_t num_sem_0 = 6;  // semaphore_0 ids, semaphore_1[i] is id num_sem_0 + i
+
+// CB slots of the models, c_1/c_2 are the flags of the NW/SE RISCs, c_3 receives and c_16 holds the local vector
+constexpr uint32_t slot_NW = 0;
+constexpr uint32_t slot_SE = 1;
+constexpr uint32_t slot_recv = 2;
+constexpr uint32_t slot_local = 3;
+
+std::string semaphore_name(uint32_t index) {
+    return index < num_sem_0 ? "semaphore_0[" + std::to_string(index) + "]"
+                             : "semaphore_1[" + std::to_string(index - num_sem_0) + "]";
+}
+
+// Appends the ops of one thread after another, tagging them with the kernel code they come from
+class ProtocolBuilder {
+public:
+    explicit ProtocolBuilder(ProtocolModel& model) : model(model) {}
+
+    void Begin(uint32_t core, const char* risc) { model.threads.push_back({core, risc, {}}); }
+
+    void At(const std::string& label) {
+        auto it = label_index.find(label);
+        if (it == label_index.end()) {
+            it = label_index.emplace(label, model.labels.size()).first;
+            model.labels.push_back(label);
+        }
+        where = it->second;
+    }
+
+    void Op(ProtocolOpKind kind, uint32_t core, uint32_t index, uint32_t value) {
+        model.threads.back().ops.push_back({kind, core, index, value, where});
+    }
+
+    // sync_NOC of the dataflow kernels, the two RISCs hand each other a page of their flag CBs
+    void SyncNOC(uint32_t core, uint32_t slot_this, uint32_t slot_that) {
+        Op(ProtocolOpKind::CbReserve, core, slot_that, 1);
+        Op(ProtocolOpKind::CbPush, core, slot_that, 1);
+        Op(ProtocolOpKind::CbWait, core, slot_this, 1);
+        Op(ProtocolOpKind::CbPop, core, slot_this, 1);
+    }
+
+private:
+    ProtocolModel& model;
+    std::map<std::string, uint32_t> label_index;
+    uint32_t where = 0;
+};
+
+}  // namespace
+
+size_t ProtocolModel::NumOps() const {
+    size_t num_ops = 0;
+    for (const ProtocolThread& thread : threads) {
+        num_ops += thread.ops.size();
+    }
+    return num_ops;
+}
+
+std::string ProtocolModel::Describe(uint32_t thread, const ProtocolOp& op) const {
+    std::string cb_name = op.index < cb_ids.size() ? "c_" + std::to_string(cb_ids[op.index]) : "";
+    std::string value = std::to_string(op.value);
+    std::string call;
+    switch (op.kind) {
+        case ProtocolOpKind::SemInc:
+            call = "noc_semaphore_inc(core " + std::to_string(op.core) + " " + semaphore_name(op.index) + ", " + value + ")";
+            break;
+        case ProtocolOpKind::SemSet: call = "noc_semaphore_set(" + semaphore_name(op.index) + ", " + value + ")"; break;
+        case ProtocolOpKind::SemWait: call = "noc_semaphore_wait(" + semaphore_name(op.index) + " == " + value + ")"; break;
+        case ProtocolOpKind::SemWaitMin:
+            call = "noc_semaphore_wait_min(" + semaphore_name(op.index) + " >= " + value + ")";
+            break;
+        case ProtocolOpKind::CbReserve: call = "cb_reserve_back(" + cb_name + ", " + value + ")"; break;
+        case ProtocolOpKind::CbPush: call = "cb_push_back(" + cb_name + ", " + value + ")"; break;
+        case ProtocolOpKind::CbWait: call = "cb_wait_front(" + cb_name + ", " + value + ")"; break;
+        case ProtocolOpKind::CbPop: call = "cb_pop_front(" + cb_name + ", " + value + ")"; break;
+        case ProtocolOpKind::RemoteWrite:
+            call = "noc_async_write to core " + std::to_string(op.core) + ", which must have consumed its " + cb_name;
+            if (op.value) {
+                call += " but for " + value + " empty pages";
+            }
+            break;
+    }
+    return "core " + std::to_string(threads[thread].core) + " " + threads[thread].risc + " " + call + " (" +
+           labels[op.where] + ")";
+}
+
+// One thread per RISC, in the order the kernels make the calls. The compute kernel waits for and pops a batch of
+// reduce_batch_tiles tiles at a time, which never spans two blocks or two pushes of the dataflow kernels, and in
+// bandwidth optimal mode skips the blocks it doesn't receive in one wait and pop of cb_local
+ProtocolModel build_BO_protocol(
+    const SchedulePlan& plan, bool bandwidth_optimal, uint32_t num_tiles, const ProtocolOptions& options) {
+    ProtocolModel model;
+    model.num_cores = plan.total_nodes;
+    model.cb_ids = {1, 2, 3, 16};
+
+    // Same args as fill_BO_common_args hands the kernels
+    uint32_t tiles_per_node = num_tiles / plan.total_nodes == 0 ? 1 : num_tiles / plan.total_nodes;
+    uint32_t total_nodes = num_tiles / tiles_per_node;
+    KernelSyncs syncs = kernel_syncs(
+        options.num_syncs ? valid_num_syncs(plan, num_tiles, options.num_syncs)
+                          : model_num_syncs(plan, bandwidth_optimal, num_tiles),
+        total_nodes);
+    uint32_t chunk = num_tiles / syncs.num_syncs;
+    uint32_t batch_tiles = reduce_batch_tiles(plan, bandwidth_optimal, num_tiles, syncs.num_syncs);
+    // The kernels the host programs run, see kernel_variant
+    std::string variant = kernel_variant(bandwidth_optimal ? "allred_BO_2D" : "allred_LO_2D", num_tiles);
+    bool loo = variant == "allred_LOO_2D";
+    bool allgather = bandwidth_optimal;
+    // With the allgather, cb_recv only holds the blocks received in a step, after empty pages that pad it to
+    // recv_tiles
+    uint32_t recv_tiles = recv_cb_tiles(plan, variant, num_tiles);
+    model.cb_pages = {1, 1, recv_tiles, num_tiles};
+    // The kernels get the masks in L1 order, see contiguous_block_layout
+    std::vector<BlockSet> send_blocks(plan.send_blocks.size()), recv_blocks(plan.recv_blocks.size());
+    for (uint32_t i = 0; i < plan.send_blocks.size(); i++) {
+        send_blocks[i] = place_blocks(plan.send_blocks[i], plan.block_positions);
+        recv_blocks[i] = place_blocks(plan.recv_blocks[i], plan.block_positions);
+    }
+    // Received tiles among tiles [first, first + count) of cb_local in step i
+    auto received = [&](uint32_t core, uint32_t i, uint32_t first, uint32_t count) {
+        if (!allgather) {
+            return count;
+        }
+        uint32_t tiles = 0;
+        for (uint32_t tile = first; tile < first + count; tile++) {
+            uint32_t n_block = tile / tiles_per_node;
+            tiles += n_block < plan.total_nodes && recv_blocks[i * plan.total_nodes + core].test(n_block);
+        }
+        return tiles;
+    };
+    std::string kernel = loo ? "LOO dataflow" : "BO dataflow";
+    std::string scatter = kernel + (allgather ? " reduce-scatter" : " allreduce");
+
+    ProtocolBuilder builder(model);
+    for (uint32_t core = 0; core < plan.total_nodes; core++) {
+        for (bool this_core_SE : {false, true}) {
+            builder.Begin(core, this_core_SE ? "NCRISC" : "BRISC");
+            uint32_t slot_this = this_core_SE ? slot_SE : slot_NW;
+            uint32_t slot_that = this_core_SE ? slot_NW : slot_SE;
+            for (uint32_t j = 0; j < options.runs; j++) {
+                builder.At(kernel + " run start");
+                builder.SyncNOC(core, slot_this, slot_that);
+                builder.At(scatter + " start");
+                builder.SyncNOC(core, slot_this, slot_that);
+                builder.Op(ProtocolOpKind::SemSet, core, num_sem_0, 0);
+                uint32_t syncs_received = 0;
+
+                for (uint32_t i = 0; i < plan.algo_steps; i++) {
+                    std::string step = scatter + " step " + std::to_string(i);
+                    bool direction_SE = (plan.step_directions[core] >> i) & 1;
+                    if (options.step_sync) {
+                        builder.At(step + " sync_NOC");
+                        builder.SyncNOC(core, slot_this, slot_that);
+                    }
+                    if (this_core_SE == direction_SE) {
+                        uint32_t partner = plan.partner(core, i);
+                        const BlockSet& step_send_blocks = send_blocks[i * plan.total_nodes + core];
+                        builder.At(step + " send");
+                        builder.Op(ProtocolOpKind::CbReserve, core, slot_local, num_tiles);
+                        if (allgather) {
+                            builder.Op(ProtocolOpKind::CbPush, core, slot_local, num_tiles);
+                        }
+                        builder.Op(ProtocolOpKind::SemInc, partner, i % num_sem_0, 1);
+                        builder.Op(ProtocolOpKind::SemWaitMin, core, i % num_sem_0, allgather ? 2 * j + 1 : j + 1);
+                        if (!allgather || step_send_blocks.count() > 0) {
+                            // The blocks land after the empty pages the partner may already have pushed
+                            uint32_t padding = recv_tiles - received(partner, i, 0, num_tiles);
+                            builder.Op(ProtocolOpKind::RemoteWrite, partner, slot_recv, padding);
+                        }
+                        uint32_t incs =
+                            count_send_syncs(step_send_blocks, bandwidth_optimal, num_tiles, total_nodes, syncs);
+                        for (uint32_t n_sync = 0; n_sync < incs; n_sync++) {
+                            builder.Op(ProtocolOpKind::SemInc, partner, num_sem_0, 1);
+                            if (!allgather) {
+                                builder.Op(ProtocolOpKind::CbPush, core, slot_local, chunk);
+                            }
+                        }
+                    } else {
+                        builder.At(step + " receive");
+                        builder.Op(ProtocolOpKind::CbReserve, core, slot_recv, recv_tiles);
+                        builder.Op(ProtocolOpKind::CbPush, core, slot_recv, recv_tiles - received(core, i, 0, num_tiles));
+                        // Strides without a received block are not synced
+                        uint32_t sync_count = 0;
+                        for (uint32_t n_sync = 0; n_sync < syncs.num_syncs; n_sync++) {
+                            uint32_t sync_tiles = received(core, i, n_sync * chunk, chunk);
+                            if (sync_tiles == 0) {
+                                continue;
+                            }
+                            builder.Op(ProtocolOpKind::SemWaitMin, core, num_sem_0, syncs_received + ++sync_count);
+                            builder.Op(ProtocolOpKind::CbPush, core, slot_recv, sync_tiles);
+                        }
+                    }
+                    // Both RISCs count the syncs of every step, they share the semaphore
+                    for (uint32_t n_sync = 0; n_sync < syncs.num_syncs; n_sync++) {
+                        syncs_received += received(core, i, n_sync * chunk, chunk) > 0;
+                    }
+                }
+                builder.At(scatter + " end");
+                builder.Op(ProtocolOpKind::CbReserve, core, slot_recv, recv_tiles);
+
+                if (!allgather) {
+                    continue;
+                }
+                builder.At(kernel + " allgather start");
+                builder.SyncNOC(core, slot_this, slot_that);
+                builder.Op(ProtocolOpKind::SemSet, core, num_sem_0, 0);
+                builder.Op(ProtocolOpKind::SemSet, core, num_sem_0 + 1, 0);
+                for (uint32_t i = plan.algo_steps; i-- > 0;) {
+                    std::string step = kernel + " allgather step " + std::to_string(i);
+                    bool direction_SE = (plan.step_directions[core] >> i) & 1;
+                    if (options.step_sync) {
+                        builder.At(step + " sync_NOC");
+                        builder.SyncNOC(core, slot_this, slot_that);
+                    }
+                    if (this_core_SE == direction_SE) {
+                        uint32_t partner = plan.partner(core, i);
+                        builder.At(step + " send");
+                        builder.Op(ProtocolOpKind::SemInc, partner, i % num_sem_0, 1);
+                        builder.Op(ProtocolOpKind::SemWaitMin, core, i % num_sem_0, 2 * j + 2);
+                        // Writes into cb_local, compute packs every tile before popping cb_recv
+                        builder.Op(ProtocolOpKind::RemoteWrite, partner, slot_recv, 0);
+                        builder.Op(ProtocolOpKind::SemInc, partner, num_sem_0 + i % 2, 1);
+                        builder.Op(ProtocolOpKind::SemWaitMin, core, num_sem_0 + i % 2, ((plan.algo_steps - i) + 1) / 2);
+                    }
+                }
+            }
+            builder.At(kernel + " end");
+            builder.SyncNOC(core, slot_this, slot_that);
+        }
+
+        builder.Begin(core, "TRISC");
+        for (uint32_t j = 0; j < options.runs; j++) {
+            for (uint32_t i = 0; i < plan.algo_steps; i++) {
+                builder.At("BO compute step " + std::to_string(i));
+                uint32_t padding = recv_tiles - received(core, i, 0, num_tiles);
+                builder.Op(ProtocolOpKind::CbWait, core, slot_recv, padding);
+                builder.Op(ProtocolOpKind::CbPop, core, slot_recv, padding);
+                for (uint32_t tile = 0; tile < num_tiles;) {
+                    // The tiles up to the next received block are skipped with one wait and pop
+                    uint32_t skip = 0;
+                    while (tile + skip < num_tiles && received(core, i, tile + skip, 1) == 0) {
+                        skip += tiles_per_node;
+                    }
+                    if (skip > 0) {
+                        builder.Op(ProtocolOpKind::CbWait, core, slot_local, skip);
+                        builder.Op(ProtocolOpKind::CbPop, core, slot_local, skip);
+                        tile += skip;
+                        continue;
+                    }
+                    builder.Op(ProtocolOpKind::CbWait, core, slot_recv, batch_tiles);
+                    builder.Op(ProtocolOpKind::CbWait, core, slot_local, batch_tiles);
+                    builder.Op(ProtocolOpKind::CbPop, core, slot_recv, batch_tiles);
+                    builder.Op(ProtocolOpKind::CbPop, core, slot_local, batch_tiles);
+                    tile += batch_tiles;
+                }
+            }
+        }
+    }
+    return model;
+}
+
+ProtocolModel build_mem_protocol(const SchedulePlan& plan, uint32_t num_tiles, const ProtocolOptions& options) {
+    ProtocolModel model;
+    model.num_cores = plan.total_nodes;
+    model.cb_ids = {1, 2, 3, 16};
+    model.cb_pages = {1, 1, num_tiles, num_tiles};
+    uint32_t tiles_per_node = num_tiles / plan.total_nodes;
+    uint32_t total_nodes = num_tiles / tiles_per_node;
+
+    ProtocolBuilder builder(model);
+    for (uint32_t core = 0; core < plan.total_nodes; core++) {
+        for (bool this_core_SE : {false, true}) {
+            builder.Begin(core, this_core_SE ? "NCRISC" : "BRISC");
+            uint32_t slot_this = this_core_SE ? slot_SE : slot_NW;
+            uint32_t num_syncs = 1;  // Counted by both RISCs over all the sync_nodes calls
+
+            // The NW RISCs sync with their partners at every step, then hand over to the SE RISC of the core
+            auto sync_nodes = [&](const std::string& label) {
+                builder.At("mem dataflow sync_nodes " + label);
+                if (!this_core_SE) {
+                    for (uint32_t i = 0; i < plan.algo_steps; i++) {
+                        builder.Op(ProtocolOpKind::SemInc, plan.partner(core, i), i % num_sem_0, 1);
+                        builder.Op(ProtocolOpKind::SemWaitMin, core, i % num_sem_0, num_syncs);
+                    }
+                }
+                builder.Op(ProtocolOpKind::SemInc, core, num_sem_0 + this_core_SE, 1);
+                builder.Op(ProtocolOpKind::SemWaitMin, core, num_sem_0 + !this_core_SE, num_syncs);
+                num_syncs++;
+            };
+
+            for (uint32_t j = 0; j < options.runs; j++) {
+                if (j == 0 && !this_core_SE) {
+                    builder.At("mem dataflow run start");
+                    builder.Op(ProtocolOpKind::CbReserve, core, slot_local, num_tiles);
+                }
+                sync_nodes("at run start");
+                sync_nodes("after the DRAM write");
+                if (this_core_SE) {
+                    builder.At("mem dataflow SE reads the blocks");
+                    builder.Op(ProtocolOpKind::CbPush, core, slot_local, num_tiles);
+                    for (uint32_t n_node = 0; n_node < total_nodes; n_node++) {
+                        builder.Op(ProtocolOpKind::CbPush, core, slot_recv, tiles_per_node);
+                    }
+                }
+                builder.At("mem dataflow wait for compute");
+                builder.Op(ProtocolOpKind::CbWait, core, slot_this, 1);
+                builder.Op(ProtocolOpKind::CbPop, core, slot_this, 1);
+                sync_nodes("after the result write");
+            }
+        }
+
+        builder.Begin(core, "TRISC");
+        for (uint32_t j = 0; j < options.runs; j++) {
+            builder.At("mem compute run start");
+            builder.Op(ProtocolOpKind::CbWait, core, slot_local, num_tiles);
+            builder.Op(ProtocolOpKind::CbPop, core, slot_local, num_tiles);
+            builder.Op(ProtocolOpKind::CbReserve, core, slot_local, num_tiles);
+            builder.At("mem compute reduce");
+            for (uint32_t n_node = 0; n_node < total_nodes; n_node++) {
+                builder.Op(ProtocolOpKind::CbWait, core, slot_recv, tiles_per_node);
+                builder.Op(ProtocolOpKind::CbPop, core, slot_recv, tiles_per_node);
+            }
+            builder.At("mem compute done");
+            builder.Op(ProtocolOpKind::CbPush, core, slot_SE, 1);
+            builder.Op(ProtocolOpKind::CbPush, core, slot_NW, 1);
+        }
+    }
+    return model;
+}
+
+// Semaphores and CB page counts of every core, indexed [core * num_semaphores + id] and [core * num_slots + slot].
+// consumed is the highest value a completed wait needed since the semaphore was last set: a set while the value
+// is above it discards increments (or a set signal) that no wait has seen, a lost wakeup
+struct InterleavingExplorer::State {
+    std::vector<uint32_t> pc;
+    std::vector<uint32_t> semaphores;
+    std::vector<uint32_t> consumed;
+    std::vector<uint32_t> cb_used;  // Pages pushed and not popped yet
+    uint64_t step = 0;
+};
+
+InterleavingExplorer::State InterleavingExplorer::InitialState() const {
+    State state;
+    state.pc.assign(model.threads.size(), 0);
+    state.semaphores.assign(model.num_cores * model.num_semaphores, 0);
+    state.consumed.assign(model.num_cores * model.num_semaphores, 0);
+    state.cb_used.assign(model.num_cores * model.cb_ids.size(), 0);
+    return state;
+}
+
+bool InterleavingExplorer::Enabled(const State& state, uint32_t thread) const {
+    const std::vector<ProtocolOp>& ops = model.threads[thread].ops;
+    if (state.pc[thread] >= ops.size()) {
+        return false;
+    }
+    const ProtocolOp& op = ops[state.pc[thread]];
+    uint32_t semaphore = state.semaphores[op.core * model.num_semaphores + op.index];
+    uint32_t cb_slot = op.core * model.cb_ids.size() + op.index;
+    switch (op.kind) {
+        case ProtocolOpKind::SemWait: return semaphore == op.value;
+        case ProtocolOpKind::SemWaitMin: return semaphore >= op.value;
+        case ProtocolOpKind::CbReserve:
+            return state.cb_used[cb_slot] + op.value <= model.cb_pages[op.index];
+        case ProtocolOpKind::CbWait: return state.cb_used[cb_slot] >= op.value;
+        default: return true;
+    }
+}
+
+bool InterleavingExplorer::Execute(State& state, uint32_t thread, ExploreResult& result, uint64_t seed) const {
+    const ProtocolOp& op = model.threads[thread].ops[state.pc[thread]];
+    uint32_t sem_i = op.core * model.num_semaphores + op.index;
+    uint32_t cb_slot = op.core * model.cb_ids.size() + op.index;
+    ProtocolIssue issue;
+    switch (op.kind) {
+        case ProtocolOpKind::SemInc: state.semaphores[sem_i] += op.value; break;
+        case ProtocolOpKind::SemSet:
+            if (state.semaphores[sem_i] > state.consumed[sem_i]) {
+                issue.kind = "lost wakeup";
+                issue.description = model.Describe(thread, op) + " overwrites value " +
+                                    std::to_string(state.semaphores[sem_i]) + ", no wait has seen more than " +
+                                    std::to_string(state.consumed[sem_i]);
+            }
+            state.semaphores[sem_i] = op.value;
+            state.consumed[sem_i] = 0;
+            break;
+        case ProtocolOpKind::SemWait:
+        case ProtocolOpKind::SemWaitMin: state.consumed[sem_i] = std::max(state.consumed[sem_i], op.value); break;
+        case ProtocolOpKind::CbPush:
+            if (state.cb_used[cb_slot] + op.value > model.cb_pages[op.index]) {
+                issue.kind = "CB overrun";
+                issue.description = model.Describe(thread, op) + " with " + std::to_string(state.cb_used[cb_slot]) +
+                                    " of " + std::to_string(model.cb_pages[op.index]) + " pages in use";
+            }
+            state.cb_used[cb_slot] += op.value;
+            break;
+        case ProtocolOpKind::CbPop:
+            if (state.cb_used[cb_slot] < op.value) {
+                issue.kind = "CB underrun";
+                issue.description =
+                    model.Describe(thread, op) + " with " + std::to_string(state.cb_used[cb_slot]) + " pages pushed";
+            }
+            state.cb_used[cb_slot] -= std::min(state.cb_used[cb_slot], op.value);
+            break;
+        case ProtocolOpKind::RemoteWrite:
+            if (state.cb_used[cb_slot] > op.value) {
+                issue.kind = "data hazard";
+                issue.description = model.Describe(thread, op) + ", " + std::to_string(state.cb_used[cb_slot]) +
+                                    " pages are left";
+            }
+            break;
+        default: break;
+    }
+    state.pc[thread]++;
+    state.step++;
+
+    if (issue.kind.empty()) {
+        return true;
+    }
+    issue.seed = seed;
+    issue.step = state.step;
+    issue.where = op.where;
+    Report(result, issue);
+    return false;
+}
+
+bool InterleavingExplorer::Finished(const State& state) const {
+    for (uint32_t thread = 0; thread < model.threads.size(); thread++) {
+        if (state.pc[thread] < model.threads[thread].ops.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Lists the op every unfinished thread is blocked in, with the value it is waiting on
+void InterleavingExplorer::ReportDeadlock(const State& state, ExploreResult& result, uint64_t seed) const {
+    ProtocolIssue issue;
+    issue.kind = "deadlock";
+    issue.seed = seed;
+    issue.step = state.step;
+    for (uint32_t thread = 0; thread < model.threads.size(); thread++) {
+        const std::vector<ProtocolOp>& ops = model.threads[thread].ops;
+        if (state.pc[thread] >= ops.size()) {
+            continue;
+        }
+        const ProtocolOp& op = ops[state.pc[thread]];
+        bool semaphore_op = op.kind == ProtocolOpKind::SemWait || op.kind == ProtocolOpKind::SemWaitMin;
+        uint32_t value = semaphore_op ? state.semaphores[op.core * model.num_semaphores + op.index]
+                                      : state.cb_used[op.core * model.cb_ids.size() + op.index];
+        if (issue.blocked.empty()) {
+            issue.where = op.where;
+        }
+        issue.blocked.push_back(
+            model.Describe(thread, op) + (semaphore_op ? ", value " : ", pages in use ") + std::to_string(value));
+    }
+    issue.description = std::to_string(issue.blocked.size()) + " of " + std::to_string(model.threads.size()) +
+                        " threads blocked, first " + issue.blocked[0];
+    Report(result, issue);
+}
+
+void InterleavingExplorer::Report(ExploreResult& result, ProtocolIssue issue) const {
+    for (const ProtocolIssue& reported : result.issues) {
+        if (reported.kind == issue.kind && reported.where == issue.where) {
+            return;
+        }
+    }
+    result.issues.push_back(std::move(issue));
+}
+
+// The step count is left out, so states reached by different interleavings merge
+std::string InterleavingExplorer::Key(const State& state) const {
+    std::string key;
+    for (const std::vector<uint32_t>* values : {&state.pc, &state.semaphores, &state.consumed, &state.cb_used}) {
+        key.append(reinterpret_cast<const char*>(values->data()), values->size() * sizeof(uint32_t));
+    }
+    return key;
+}
+
+// Picks the next thread with a generator seeded by seed alone, so a schedule is replayed by its seed. PCT gives
+// every thread a distinct priority from depth up and always runs the highest enabled one, and at depth - 1
+// random steps lowers the running thread below all others, which finds any bug needing depth ordering
+// constraints with a probability of at least 1 / (threads * ops^(depth - 1))
+bool InterleavingExplorer::RunSchedule(
+    uint64_t seed, ScheduleStrategy strategy, uint32_t depth, ExploreResult& result) const {
+    std::mt19937_64 rng(seed);
+    uint32_t num_threads = model.threads.size();
+    std::vector<uint64_t> priority(num_threads);
+    std::map<uint64_t, uint64_t> change_points;  // Step -> priority the running thread drops to
+    if (strategy == ScheduleStrategy::PCT) {
+        for (uint32_t thread = 0; thread < num_threads; thread++) {
+            priority[thread] = depth + thread;
+        }
+        std::shuffle(priority.begin(), priority.end(), rng);
+        uint64_t num_ops = std::max<uint64_t>(1, model.NumOps());
+        for (uint32_t k = 1; k < depth; k++) {
+            change_points[rng() % num_ops] = depth - k;
+        }
+    }
+
+    // PCT walks the threads from the highest priority down, the running one usually stays enabled
+    std::vector<uint32_t> order(num_threads);
+    for (uint32_t thread = 0; thread < num_threads; thread++) {
+        order[thread] = thread;
+    }
+    auto sort_order = [&]() {
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return priority[a] > priority[b]; });
+    };
+    auto highest_enabled = [&](const State& state) {
+        for (uint32_t thread : order) {
+            if (Enabled(state, thread)) {
+                return (int64_t)thread;
+            }
+        }
+        return (int64_t)-1;
+    };
+    sort_order();
+
+    State state = InitialState();
+    std::vector<uint32_t> enabled;
+    bool no_issue = true;
+    while (true) {
+        int64_t next = -1;
+        if (strategy == ScheduleStrategy::Random) {
+            enabled.clear();
+            for (uint32_t thread = 0; thread < num_threads; thread++) {
+                if (Enabled(state, thread)) {
+                    enabled.push_back(thread);
+                }
+            }
+            next = enabled.empty() ? -1 : (int64_t)enabled[rng() % enabled.size()];
+        } else {
+            next = highest_enabled(state);
+            auto change = change_points.find(state.step);
+            if (next >= 0 && change != change_points.end()) {
+                priority[next] = change->second;
+                sort_order();
+                next = highest_enabled(state);
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        no_issue &= Execute(state, next, result, seed);
+    }
+
+    if (!Finished(state)) {
+        ReportDeadlock(state, result, seed);
+        no_issue = false;
+    }
+    result.schedules++;
+    return no_issue;
+}
+
+ExploreResult InterleavingExplorer::ExploreRandom(
+    uint64_t seed, uint32_t schedules, ScheduleStrategy strategy, uint32_t depth, bool stop_at_issue) const {
+    ExploreResult result;
+    for (uint32_t n = 0; n < schedules; n++) {
+        if (!RunSchedule(seed + n, strategy, depth, result) && stop_at_issue) {
+            break;
+        }
+    }
+    return result;
+}
+
+// Every interleaving of the threads, as a depth first search over the states. Branches reaching a state seen
+// before are cut, so the search is over distinct states rather than schedules and a schedule counts paths
+// that finished or deadlocked
+ExploreResult InterleavingExplorer::ExploreExhaustive(uint64_t max_states) const {
+    ExploreResult result;
+    std::unordered_set<std::string> visited;
+    std::vector<State> stack = {InitialState()};
+    while (!stack.empty()) {
+        State state = std::move(stack.back());
+        stack.pop_back();
+        if (!visited.insert(Key(state)).second) {
+            continue;
+        }
+        if (visited.size() > max_states) {
+            result.complete = false;
+            break;
+        }
+
+        bool any_enabled = false;
+        for (uint32_t thread = model.threads.size(); thread-- > 0;) {
+            if (Enabled(state, thread)) {
+                State next = state;
+                Execute(next, thread, result, 0);
+                stack.push_back(std::move(next));
+                any_enabled = true;
+            }
+        }
+        if (!any_enabled) {
+            if (!Finished(state)) {
+                ReportDeadlock(state, result, 0);
+            }
+            result.schedules++;
+        }
+    }
+    result.states = visited.size();
+    return result;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+// Deterministic interleaving explorer for the synchronization of the allreduce kernels. A ProtocolModel holds
+// the semaphore and circular buffer operations of every RISC of every core, in kernel order and built from the
+// schedule plan, without the data movement. The explorer runs the RISCs against each other under a scheduler
+// that is fully determined by a seed (or walks all interleavings of a small model) and reports the schedules
+// that deadlock, lose a semaphore wakeup, overrun a CB or write into tiles the partner has not consumed yet.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "allred_schedule.hpp"
+
+enum class ProtocolOpKind {
+    SemInc,       // noc_semaphore_inc of a (possibly remote) semaphore
+    SemSet,       // noc_semaphore_set of a local semaphore
+    SemWait,      // noc_semaphore_wait, value == value
+    SemWaitMin,   // noc_semaphore_wait_min, value >= value
+    CbReserve,    // cb_reserve_back
+    CbPush,       // cb_push_back
+    CbWait,       // cb_wait_front
+    CbPop,        // cb_pop_front
+    RemoteWrite,  // First noc_async_write of a step to the partner, whose CB (c_3) must be consumed but for value
+                  // empty pages
+};
+
+struct ProtocolOp {
+    ProtocolOpKind kind;
+    uint32_t core;   // Core of the semaphore or CB, the partner for SemInc and RemoteWrite
+    uint32_t index;  // Semaphore id, or CB slot (see ProtocolModel::cb_ids)
+    uint32_t value;  // Increment, value set, wait threshold or number of pages
+    uint32_t where;  // Index of the kernel code the op comes from in ProtocolModel::labels
+};
+
+struct ProtocolThread {
+    uint32_t core;
+    const char* risc;  // "BRISC" (NW), "NCRISC" (SE) or "TRISC" (compute)
+    std::vector<ProtocolOp> ops;
+};
+
+struct ProtocolModel {
+    uint32_t num_cores = 0;
+    uint32_t num_semaphores = 8;     // semaphore_0[0-5] then semaphore_1[0-1], as the kernels number them
+    std::vector<uint32_t> cb_ids;    // CB index of each slot
+    std::vector<uint32_t> cb_pages;  // Capacity in pages of each slot, the same on every core
+    std::vector<ProtocolThread> threads;
+    std::vector<std::string> labels;
+
+    size_t NumOps() const;
+    std::string Describe(uint32_t thread, const ProtocolOp& op) const;
+};
+
+// What the protocol models can leave out, to check whether a synchronization is needed
+struct ProtocolOptions {
+    uint32_t runs = 2;       // warmup + iterations of the kernels
+    bool step_sync = true;   // sync_NOC of the two dataflow RISCs at the start of every step
+    uint32_t num_syncs = 0;  // Syncs per step of the BO send loop, 0 for model_num_syncs' choice
+};
+
+// Models of the BO kernels (LOO dataflow kernel where the host programs run it, see kernel_variant) and of the SM kernels
+ProtocolModel build_BO_protocol(const SchedulePlan&, bool, uint32_t, const ProtocolOptions&);
+ProtocolModel build_mem_protocol(const SchedulePlan&, uint32_t, const ProtocolOptions&);
+
+struct ProtocolIssue {
+    std::string kind;  // deadlock, lost wakeup, CB overrun, CB underrun or data hazard
+    std::string description;
+    std::vector<std::string> blocked;  // Ops the threads were blocked in, for deadlocks
+    uint64_t seed = 0;                 // Random schedule that found it, a RunSchedule with it replays it
+    uint64_t step = 0;                 // Number of ops executed by then
+    uint32_t where = 0;                // Kernel code of the op, issues are reported once per kind and where
+};
+
+struct ExploreResult {
+    uint64_t schedules = 0;
+    uint64_t states = 0;     // Distinct states visited by an exhaustive exploration
+    bool complete = true;    // False if an exhaustive exploration ran out of states
+    std::vector<ProtocolIssue> issues;  // The first of each kind and kernel location
+};
+
+enum class ScheduleStrategy {
+    Random,  // Uniformly random enabled thread at every op
+    PCT,     // Probabilistic concurrency testing: random thread priorities, lowered at depth - 1 random points
+};
+
+class InterleavingExplorer {
+public:
+    explicit InterleavingExplorer(const ProtocolModel& model) : model(model) {}
+
+    // Runs one schedule to completion or deadlock, returns false if it found an issue
+    bool RunSchedule(uint64_t seed, ScheduleStrategy strategy, uint32_t depth, ExploreResult& result) const;
+    // Schedules seed, seed + 1, ..., stopping at the first one with an issue if stop_at_issue
+    ExploreResult ExploreRandom(
+        uint64_t seed, uint32_t schedules, ScheduleStrategy strategy, uint32_t depth, bool stop_at_issue) const;
+    // Depth first search over all interleavings, merging identical states, up to max_states states
+    ExploreResult ExploreExhaustive(uint64_t max_states) const;
+
+private:
+    struct State;
+
+    State InitialState() const;
+    bool Enabled(const State& state, uint32_t thread) const;
+    // Runs the next op of thread, returns false if it raised an issue
+    bool Execute(State& state, uint32_t thread, ExploreResult& result, uint64_t seed) const;
+    bool Finished(const State& state) const;
+    void ReportDeadlock(const State& state, ExploreResult& result, uint64_t seed) const;
+    void Report(ExploreResult& result, ProtocolIssue issue) const;
+    std::string Key(const State& state) const;
+
+    const ProtocolModel& model;
+};
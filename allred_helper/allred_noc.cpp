@@ -0,0 +1,135 @@
+#include "allred_noc.hpp"
+#include "allred_emulator.hpp"
+#include <algorithm>
+
+namespace {
+constexpr uint32_t tile_size_bytes = 2048;
+}  // namespace
+
+const char* noc_directions_name(NocDirections directions) {
+    switch (directions) {
+        case NocDirections::Plan: return "plan";
+        case NocDirections::Swapped: return "swapped";
+        case NocDirections::Noc0: return "noc0";
+        case NocDirections::Noc1: return "noc1";
+        case NocDirections::Shortest: return "shortest";
+    }
+    return "";
+}
+
+const std::vector<NocDirections>& all_noc_directions() {
+    static const std::vector<NocDirections> directions = {
+        NocDirections::Plan, NocDirections::Swapped, NocDirections::Noc0, NocDirections::Noc1, NocDirections::Shortest};
+    return directions;
+}
+
+std::string NocTopology::LinkName(uint32_t link) const {
+    bool y_link = link % 2;
+    uint32_t x = (link / 2) % width;
+    uint32_t y = (link / 2 / width) % height;
+    uint32_t noc = link / 2 / width / height;
+    const char* direction = noc == 0 ? (y_link ? "+y" : "+x") : (y_link ? "-y" : "-x");
+    return "NOC" + std::to_string(noc) + " (" + std::to_string(x) + "," + std::to_string(y) + ") " + direction;
+}
+
+void NocTopology::Route(
+    uint32_t noc, std::pair<uint32_t, uint32_t> src, std::pair<uint32_t, uint32_t> dst, std::vector<uint32_t>& links) const {
+    auto [x, y] = src;
+    if (noc == 0) {
+        for (; x != dst.first; x = (x + 1) % width) {
+            links.push_back(LinkId(0, x, y, false));
+        }
+        for (; y != dst.second; y = (y + 1) % height) {
+            links.push_back(LinkId(0, x, y, true));
+        }
+    } else {
+        for (; y != dst.second; y = (y + height - 1) % height) {
+            links.push_back(LinkId(1, x, y, true));
+        }
+        for (; x != dst.first; x = (x + width - 1) % width) {
+            links.push_back(LinkId(1, x, y, false));
+        }
+    }
+}
+
+// Bytes and writes as the BO dataflow kernel sends them (the LOO one sends num_syncs chunks of the vector).
+// Semaphore increments are a few bytes and left out
+NocSimResult simulate_noc(
+    const SchedulePlan& plan,
+    const PhysicalCoreFn& physical_core,
+    const NocTopology& topology,
+    bool bandwidth_optimal,
+    uint32_t num_tiles,
+    NocDirections directions,
+    const NocCostParams& params,
+    uint32_t num_syncs) {
+    uint32_t tiles_per_node = num_tiles / plan.total_nodes == 0 ? 1 : num_tiles / plan.total_nodes;
+    uint32_t total_blocks = num_tiles / tiles_per_node;
+    uint32_t block_bytes = tiles_per_node * tile_size_bytes;
+    num_syncs = num_syncs ? valid_num_syncs(plan, num_tiles, num_syncs)
+                          : model_num_syncs(plan, bandwidth_optimal, num_tiles);
+    uint32_t sync_stride = kernel_syncs(num_syncs, total_blocks).sync_stride;
+    uint32_t loo_writes = num_syncs;
+    bool loo = runs_LOO_kernel(bandwidth_optimal, num_tiles);
+    bool masks = bandwidth_optimal;  // The LOO kernel (latency optimal only) always sends the whole vector
+    BlockSet all_blocks(total_blocks);
+    for (uint32_t n_block = 0; n_block < total_blocks; n_block++) {
+        all_blocks.set(n_block);
+    }
+
+    auto simulate_step = [&](const std::string& name, uint32_t step, bool allgather) {
+        NocStepLoad load;
+        load.name = name;
+        load.link_bytes.assign(topology.NumLinks(), 0);
+        load.link_flows.assign(topology.NumLinks(), 0);
+        double max_latency_ns = 0.0;
+        std::vector<uint32_t> route[2];
+        for (uint32_t core = 0; core < plan.total_nodes; core++) {
+            std::pair<uint32_t, uint32_t> src = physical_core(core);
+            std::pair<uint32_t, uint32_t> dst = physical_core(plan.partner(core, step));
+            const BlockSet& blocks = !masks ? all_blocks : allgather ? plan.recv(core, step) : plan.send(core, step);
+            uint64_t bytes = (uint64_t)blocks.count() * block_bytes;
+            // The masks are in L1 order on the device, see contiguous_block_layout
+            BlockSet placed = masks ? place_blocks(blocks, plan.block_positions) : blocks;
+            uint32_t writes = loo ? loo_writes : count_writes(placed, allgather ? total_blocks : sync_stride);
+
+            for (uint32_t noc = 0; noc < 2; noc++) {
+                route[noc].clear();
+                topology.Route(noc, src, dst, route[noc]);
+            }
+            bool plan_noc = (plan.step_directions[core] >> step) & 1;  // SE RISC, on NOC1
+            uint32_t noc = directions == NocDirections::Plan      ? plan_noc
+                           : directions == NocDirections::Swapped ? !plan_noc
+                           : directions == NocDirections::Noc0    ? 0
+                           : directions == NocDirections::Noc1    ? 1
+                                                                  : route[1].size() < route[0].size();
+            for (uint32_t link : route[noc]) {
+                load.link_bytes[link] += bytes;
+                load.link_flows[link]++;
+            }
+            uint32_t hops = route[noc].size();
+            load.total_bytes += bytes;
+            load.link_bytes_total += bytes * hops;
+            load.max_hops = std::max(load.max_hops, hops);
+            load.max_writes = std::max(load.max_writes, writes);
+            max_latency_ns = std::max(max_latency_ns, params.alpha_ns * writes + params.hop_ns * hops);
+        }
+        load.max_link = std::max_element(load.link_bytes.begin(), load.link_bytes.end()) - load.link_bytes.begin();
+        load.max_link_bytes = load.link_bytes[load.max_link];
+        load.time_ns = max_latency_ns + load.max_link_bytes / params.bytes_per_ns;
+        return load;
+    };
+
+    NocSimResult result;
+    for (uint32_t i = 0; i < plan.algo_steps; i++) {
+        result.steps.push_back(
+            simulate_step((masks ? "reduce-scatter " : "allreduce ") + std::to_string(i), i, false));
+    }
+    for (uint32_t i = plan.algo_steps; i-- > 0 && masks;) {
+        result.steps.push_back(simulate_step("allgather " + std::to_string(i), i, true));
+    }
+    for (const NocStepLoad& load : result.steps) {
+        result.total_ns += load.time_ns;
+    }
+    return result;
+}
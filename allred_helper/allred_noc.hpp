@@ -0,0 +1,84 @@
+#pragma once
+
+// Host model of the two NoCs of a Wormhole chip, to see how the transfers of each allreduce step share the
+// NoC links. Both NoCs are 2D tori over the whole chip (workers, DRAM and ethernet cores) with dimension order
+// routing: NOC0 goes +x to the destination column then +y, NOC1 goes -y to the destination row then -x.
+// The NW dataflow kernel runs on RISCV_0 and uses NOC0, the SE one on RISCV_1 uses NOC1.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "allred_schedule.hpp"
+
+class NocTopology {
+public:
+    // The Wormhole NoC grid is 10 x 12, virtual grids that don't fit on the chip get their own size
+    explicit NocTopology(uint32_t width = 10, uint32_t height = 12) : width(width), height(height) {}
+
+    // Every router has one outgoing x link and one outgoing y link on each NoC
+    uint32_t NumLinks() const { return 2 * 2 * width * height; }
+    std::string LinkName(uint32_t link) const;
+
+    // Appends the links a packet crosses from src to dst on noc (0 or 1)
+    void Route(uint32_t noc, std::pair<uint32_t, uint32_t> src, std::pair<uint32_t, uint32_t> dst,
+        std::vector<uint32_t>& links) const;
+
+private:
+    uint32_t LinkId(uint32_t noc, uint32_t x, uint32_t y, bool y_link) const {
+        return ((noc * height + y) * width + x) * 2 + y_link;
+    }
+
+    uint32_t width;
+    uint32_t height;
+};
+
+// Which NoC the sender of every step uses
+enum class NocDirections {
+    Plan,      // The RISC set by the plan's step directions, as the kernels run
+    Swapped,   // The other RISC of every step
+    Noc0,      // Always NOC0
+    Noc1,      // Always NOC1
+    Shortest,  // The NoC with the fewer hops to the partner
+};
+
+// "plan", "swapped", "noc0", "noc1" or "shortest", as given to --directions
+const char* noc_directions_name(NocDirections);
+const std::vector<NocDirections>& all_noc_directions();
+
+// Alpha-beta parameters: a step takes the longest write overhead plus hop latency of its transfers, plus the
+// time the busiest link needs for all the bytes crossing it. Rough Wormhole figures by default
+struct NocCostParams {
+    double alpha_ns = 500.0;      // Issuing a write, waiting for its barrier and signalling the partner
+    double hop_ns = 10.0;         // Latency of a router hop
+    double bytes_per_ns = 32.0;   // Link bandwidth, 32 bytes per cycle at 1 GHz
+};
+
+struct NocStepLoad {
+    std::string name;                 // "reduce-scatter 0", "allgather 5"...
+    std::vector<uint64_t> link_bytes;  // Indexed by link, see NocTopology
+    std::vector<uint32_t> link_flows;  // Transfers crossing each link
+    uint32_t max_link = 0;             // Most loaded link
+    uint64_t max_link_bytes = 0;
+    uint64_t total_bytes = 0;          // Bytes sent by all cores
+    uint64_t link_bytes_total = 0;     // Bytes times the hops they cross
+    uint32_t max_hops = 0;
+    uint32_t max_writes = 0;
+    double time_ns = 0.0;
+};
+
+struct NocSimResult {
+    std::vector<NocStepLoad> steps;
+    double total_ns = 0.0;
+};
+
+// Routes the transfers of every step of the BO (or LO) allreduce, with the writes the dataflow kernels issue
+NocSimResult simulate_noc(
+    const SchedulePlan&,
+    const PhysicalCoreFn&,
+    const NocTopology&,
+    bool,
+    uint32_t,
+    NocDirections,
+    const NocCostParams&,
+    uint32_t num_syncs = 0);  // Of the send loops, 0 for model_num_syncs' choice
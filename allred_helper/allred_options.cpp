@@ -0,0 +1,41 @@
+#include "allred_options.hpp"
+#include <cstdio>
+
+AllredOptions AllredOptions::Parse(int& argc, char** argv) {
+    AllredOptions options;
+    int positional = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            argv[positional++] = argv[i];
+            continue;
+        }
+        size_t equals = arg.find('=');
+        if (equals == std::string::npos) {
+            options.values.insert_or_assign(arg.substr(2), std::string(1, '1'));
+        } else {
+            options.values[arg.substr(2, equals - 2)] = arg.substr(equals + 1);
+        }
+    }
+    argc = positional;
+    argv[argc] = nullptr;
+    return options;
+}
+
+std::string AllredOptions::GetString(const std::string& name, const std::string& default_value) const {
+    auto it = values.find(name);
+    return it == values.end() ? default_value : it->second;
+}
+
+int AllredOptions::GetInt(const std::string& name, int default_value) const {
+    auto it = values.find(name);
+    if (it == values.end()) {
+        return default_value;
+    }
+    try {
+        return std::stoi(it->second);
+    } catch (const std::exception&) {
+        printf("Ignoring --%s=%s, expected an integer\n", name.c_str(), it->second.c_str());
+        return default_value;
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Named "--name=value" options, given after (or between) the positional args of the allred programs.
+// Nothing in here depends on tt-metal.
+
+#include <map>
+#include <string>
+
+class AllredOptions {
+public:
+    // Removes every "--name=value" (or bare "--name", read as "1") arg from argv and decrements argc
+    // accordingly, so the positional args keep their indexes
+    static AllredOptions Parse(int& argc, char** argv);
+
+    bool Has(const std::string& name) const { return values.count(name) > 0; }
+    std::string GetString(const std::string& name, const std::string& default_value) const;
+    int GetInt(const std::string& name, int default_value) const;
+
+    void Set(const std::string& name, const std::string& value) { values[name] = value; }
+
+private:
+    std::map<std::string, std::string> values;
+};
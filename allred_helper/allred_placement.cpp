@@ -0,0 +1,144 @@
+#include "allred_placement.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+
+Placement row_major_placement(uint32_t width, uint32_t height) {
+    Placement placement(width * height);
+    for (uint32_t i = 0; i < placement.size(); i++) {
+        placement[i] = {i % width, i / width};
+    }
+    return placement;
+}
+
+bool read_placement(std::istream& table, uint32_t width, uint32_t height, Placement& placement, std::string& error) {
+    Placement read(width * height);
+    std::vector<bool> placed(width * height, false);
+    std::set<std::pair<uint32_t, uint32_t>> cores;
+    std::string line;
+    for (uint32_t line_number = 1; std::getline(table, line); line_number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        int64_t rank, x, y;
+        if (!(fields >> rank)) {
+            continue;  // Blank or comment line
+        }
+        if (!(fields >> x >> y)) {
+            error = "line " + std::to_string(line_number) + " is not \"rank x y\"";
+            return false;
+        }
+        if (rank < 0 || rank >= (int64_t)read.size() || x < 0 || x >= width || y < 0 || y >= height) {
+            error = "line " + std::to_string(line_number) + " is outside of the " + std::to_string(width) + "x" +
+                    std::to_string(height) + " grid";
+            return false;
+        }
+        if (placed[rank] || !cores.insert({x, y}).second) {
+            error = "line " + std::to_string(line_number) + " places a rank or a core twice";
+            return false;
+        }
+        placed[rank] = true;
+        read[rank] = {x, y};
+    }
+    if (cores.size() != read.size()) {
+        error = "places " + std::to_string(cores.size()) + " of " + std::to_string(read.size()) + " ranks";
+        return false;
+    }
+    placement = read;
+    return true;
+}
+
+void write_placement(std::ostream& table, const Placement& placement, const std::string& comment) {
+    table << "# " << comment << "\n# rank x y (logical core)\n";
+    for (uint32_t rank = 0; rank < placement.size(); rank++) {
+        table << rank << " " << placement[rank].first << " " << placement[rank].second << "\n";
+    }
+}
+
+double placement_cost(
+    const SchedulePlan& plan,
+    const Placement& placement,
+    bool bandwidth_optimal,
+    uint32_t num_tiles,
+    const PlacementSearchParams& params) {
+    // Virtual grids that don't fit on the chip are routed on a torus of their own size
+    bool on_chip_grid = plan.width <= 8 && plan.height <= 8;
+    NocTopology topology = on_chip_grid ? NocTopology() : NocTopology(plan.width, plan.height);
+    PhysicalCoreFn physical_core = [&](int rank) {
+        return on_chip_grid ? wormhole_worker_core(placement[rank].first, placement[rank].second) : placement[rank];
+    };
+
+    NocSimResult result =
+        simulate_noc(plan, physical_core, topology, bandwidth_optimal, num_tiles, params.directions, params.cost);
+    double cost = 0.0;
+    for (const NocStepLoad& load : result.steps) {
+        cost += params.objective == PlacementObjective::Hops      ? (double)load.link_bytes_total
+                : params.objective == PlacementObjective::MaxLink ? (double)load.max_link_bytes
+                                                                  : load.time_ns;
+    }
+    return cost;
+}
+
+PlacementSearchResult search_placement(
+    const SchedulePlan& plan, bool bandwidth_optimal, uint32_t num_tiles, const PlacementSearchParams& params) {
+    PlacementSearchResult best;
+    best.placement = row_major_placement(plan.width, plan.height);
+    best.initial_cost = best.cost = placement_cost(plan, best.placement, bandwidth_optimal, num_tiles, params);
+    if (plan.total_nodes < 3 || best.cost == 0.0) {
+        return best;
+    }
+
+    uint32_t num_threads = params.threads ? params.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<PlacementSearchResult> results(num_threads);
+    auto anneal = [&](uint32_t thread_i) {
+        PlacementSearchResult& result = results[thread_i];
+        std::mt19937_64 rng(params.seed + thread_i);
+        std::uniform_int_distribution<uint32_t> pick_rank(0, plan.total_nodes - 1);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        Placement placement = best.placement;
+        double cost = best.initial_cost;
+        result.placement = placement;
+        result.cost = cost;
+        double temperature = 0.05 * best.initial_cost;
+        double cooling = std::pow(1e-4 / 0.05, 1.0 / std::max(1u, params.iterations));
+        for (uint32_t i = 0; i < params.iterations; i++, temperature *= cooling) {
+            uint32_t a = pick_rank(rng);
+            uint32_t b = pick_rank(rng);
+            if (a == b) {
+                continue;
+            }
+            std::swap(placement[a], placement[b]);
+            double swapped_cost = placement_cost(plan, placement, bandwidth_optimal, num_tiles, params);
+            result.evaluations++;
+            if (swapped_cost <= cost || uniform(rng) < std::exp((cost - swapped_cost) / temperature)) {
+                cost = swapped_cost;
+                if (cost < result.cost) {
+                    result.cost = cost;
+                    result.placement = placement;
+                }
+            } else {
+                std::swap(placement[a], placement[b]);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t t = 1; t < num_threads; t++) {
+        pool.emplace_back(anneal, t);
+    }
+    anneal(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    for (const PlacementSearchResult& result : results) {
+        best.evaluations += result.evaluations;
+        if (result.cost < best.cost) {
+            best.cost = result.cost;
+            best.placement = result.placement;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Placement of the allreduce ranks on the worker cores. Rank i runs on logical core {i % width, i / width}
+// by default; a placement permutes the ranks over the same width x height rectangle of logical cores, so the
+// CoreRange of the drivers is unchanged. Placements are searched with simulated annealing against the link
+// loads of allred_noc and stored as a table of "rank x y" lines. Nothing in here depends on tt-metal.
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "allred_noc.hpp"
+#include "allred_schedule.hpp"
+
+// Logical core of every rank, indexed by rank
+using Placement = std::vector<std::pair<uint32_t, uint32_t>>;
+
+// Rank i on {i % width, i / width}, as AllredConfig lays out the cores
+Placement row_major_placement(uint32_t width, uint32_t height);
+
+// Reads a table written by write_placement ('#' starts a comment). Returns false, with error set, unless it
+// places every rank of a width x height grid on a distinct core of the rectangle
+bool read_placement(std::istream&, uint32_t width, uint32_t height, Placement&, std::string& error);
+
+void write_placement(std::ostream&, const Placement&, const std::string& comment);
+
+// What the annealing minimizes, all from simulate_noc summed over the steps
+enum class PlacementObjective {
+    Hops,     // Bytes times the hops they cross
+    MaxLink,  // Bytes on the busiest link
+    Time,     // Predicted time of the alpha-beta model
+};
+
+struct PlacementSearchParams {
+    PlacementObjective objective = PlacementObjective::Time;
+    NocDirections directions = NocDirections::Plan;
+    NocCostParams cost;
+    uint32_t iterations = 20000;  // Swaps tried by every thread
+    uint32_t threads = 0;         // 0 for the hardware concurrency
+    uint64_t seed = 1;            // Thread t anneals with seed + t
+};
+
+struct PlacementSearchResult {
+    Placement placement;
+    double cost = 0.0;
+    double initial_cost = 0.0;   // Of the row major placement
+    uint64_t evaluations = 0;    // Over all threads
+};
+
+// Cost of a placement of the plan's ranks on the worker cores of the chip (or of a virtual grid that doesn't fit)
+double placement_cost(
+    const SchedulePlan&,
+    const Placement&,
+    bool bandwidth_optimal,
+    uint32_t num_tiles,
+    const PlacementSearchParams&);
+
+// Independent annealing runs on every thread, starting from the row major placement, and the best result.
+// The temperature falls geometrically from 5% of the initial cost to 0.01% of it
+PlacementSearchResult search_placement(const SchedulePlan&, bool, uint32_t, const PlacementSearchParams&);
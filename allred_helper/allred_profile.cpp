@@ -0,0 +1,344 @@
+#include "allred_profile.hpp"
+#include "allred_schedule.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string_view>
+
+namespace {
+
+std::string_view trim(std::string_view field) {
+    size_t first = field.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    size_t last = field.find_last_not_of(" \t\r");
+    return field.substr(first, last - first + 1);
+}
+
+// Splits a line of the log at the commas, the log has no quoted fields
+void split_fields(std::string_view line, std::vector<std::string_view>& fields) {
+    fields.clear();
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(trim(line.substr(start, comma - start)));
+        if (comma == std::string_view::npos) {
+            return;
+        }
+        start = comma + 1;
+    }
+}
+
+bool parse_uint(std::string_view field, uint64_t& value) {
+    if (field.empty()) {
+        return false;
+    }
+    value = 0;
+    for (char c : field) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+constexpr size_t missing_column = std::numeric_limits<size_t>::max();
+
+// Columns of the log used by the readers
+struct LogColumns {
+    size_t zone = missing_column, x, y, risc, time, type, run;
+    size_t count;  // Lines with fewer fields are skipped
+};
+
+// Skips to the header, which follows an "ARCH: ..." line, and finds the columns in it
+bool read_log_header(std::istream& log, size_t& lines_read, LogColumns& columns, std::string& error) {
+    std::string line;
+    std::vector<std::string_view> fields;
+    auto column = [&](std::string_view name) {
+        auto it = std::find(fields.begin(), fields.end(), name);
+        return it == fields.end() ? missing_column : static_cast<size_t>(it - fields.begin());
+    };
+    while (columns.zone == missing_column && std::getline(log, line)) {
+        lines_read++;
+        split_fields(line, fields);
+        columns.zone = column("zone name");
+    }
+    if (columns.zone == missing_column) {
+        error = "no header with a \"zone name\" column";
+        return false;
+    }
+    columns.x = column("core_x");
+    columns.y = column("core_y");
+    columns.risc = column("RISC processor type");
+    columns.time = column("time[cycles since reset]");
+    columns.type = column("type");
+    columns.run = column("run host ID");
+    columns.count = fields.size();
+    if (columns.x == missing_column || columns.y == missing_column || columns.risc == missing_column ||
+        columns.time == missing_column || columns.type == missing_column) {
+        error = "header lacks one of core_x, core_y, RISC processor type, time[cycles since reset] or type";
+        return false;
+    }
+    return true;
+}
+
+// Linear interpolation between the closest ranks, numpy's default
+double percentile(const std::vector<double>& sorted, double p) {
+    double rank = p / 100.0 * (sorted.size() - 1);
+    size_t below = static_cast<size_t>(rank);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (rank - below) * (sorted[above] - sorted[below]);
+}
+
+}  // namespace
+
+TimeStats time_stats(std::vector<double> values) {
+    TimeStats stats;
+    stats.count = values.size();
+    if (values.empty()) {
+        return stats;
+    }
+    std::sort(values.begin(), values.end());
+    stats.min = values.front();
+    stats.lower_quartile = percentile(values, 25);
+    stats.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    stats.median = percentile(values, 50);
+    stats.upper_quartile = percentile(values, 75);
+    stats.max = values.back();
+    return stats;
+}
+
+TimeStats ProfileRun::Durations(int iteration) const {
+    std::vector<double> durations;
+    for (const ProfileCore& core : cores) {
+        for (uint32_t k = 0; k < core.iterations.size(); k++) {
+            if (iteration < 0 || static_cast<int>(k) == iteration) {
+                durations.push_back(static_cast<double>(core.iterations[k].duration()));
+            }
+        }
+    }
+    return time_stats(std::move(durations));
+}
+
+uint64_t ProfileRun::EarliestStart(uint32_t iteration) const {
+    uint64_t earliest = std::numeric_limits<uint64_t>::max();
+    for (const ProfileCore& core : cores) {
+        if (iteration < core.iterations.size()) {
+            earliest = std::min(earliest, core.iterations[iteration].start);
+        }
+    }
+    return earliest;
+}
+
+const ProfileCore* ProfileRun::Core(uint32_t x, uint32_t y) const {
+    for (const ProfileCore& core : cores) {
+        if (core.x == x && core.y == y) {
+            return &core;
+        }
+    }
+    return nullptr;
+}
+
+ProfileLogReader::ProfileLogReader(const std::string& zone_name) : zone_name(zone_name) {}
+
+bool ProfileLogReader::Read(std::istream& log, std::string& error) {
+    LogColumns columns;
+    if (!read_log_header(log, lines_read, columns, error)) {
+        return false;
+    }
+
+    std::string line;
+    std::vector<std::string_view> fields;
+    while (std::getline(log, line)) {
+        lines_read++;
+        split_fields(line, fields);
+        if (fields.size() < columns.count || fields[columns.zone] != zone_name) {
+            continue;
+        }
+        uint64_t x, y, time, run_id = 0;
+        if (!parse_uint(fields[columns.x], x) || !parse_uint(fields[columns.y], y) ||
+            !parse_uint(fields[columns.time], time)) {
+            continue;
+        }
+        if (columns.run != missing_column) {
+            parse_uint(fields[columns.run], run_id);
+        }
+        RiscTimes& times = zone_times[{run_id, static_cast<uint32_t>(x), static_cast<uint32_t>(y)}]
+                                     [std::string(fields[columns.risc])];
+        if (fields[columns.type] == "ZONE_START") {
+            times.starts.push_back(time);
+        } else if (fields[columns.type] == "ZONE_END") {
+            times.ends.push_back(time);
+        }
+    }
+    return true;
+}
+
+bool read_profile_zones(std::istream& log, std::vector<RiscZones>& riscs, std::string& error) {
+    size_t lines_read = 0;
+    LogColumns columns;
+    if (!read_log_header(log, lines_read, columns, error)) {
+        return false;
+    }
+
+    // (run id, core x, core y, RISC) -> zone name -> starts and ends
+    using RiscKey = std::tuple<uint64_t, uint32_t, uint32_t, std::string>;
+    std::map<RiscKey, std::map<std::string, std::pair<std::vector<uint64_t>, std::vector<uint64_t>>>> zone_times;
+    std::string line;
+    std::vector<std::string_view> fields;
+    while (std::getline(log, line)) {
+        split_fields(line, fields);
+        uint64_t x, y, time, run_id = 0;
+        if (fields.size() < columns.count || !parse_uint(fields[columns.x], x) || !parse_uint(fields[columns.y], y) ||
+            !parse_uint(fields[columns.time], time)) {
+            continue;
+        }
+        if (columns.run != missing_column) {
+            parse_uint(fields[columns.run], run_id);
+        }
+        RiscKey risc_key{run_id, static_cast<uint32_t>(x), static_cast<uint32_t>(y), std::string(fields[columns.risc])};
+        auto& times = zone_times[risc_key][std::string(fields[columns.zone])];
+        if (fields[columns.type] == "ZONE_START") {
+            times.first.push_back(time);
+        } else if (fields[columns.type] == "ZONE_END") {
+            times.second.push_back(time);
+        }
+    }
+
+    for (auto& [key, zones] : zone_times) {
+        auto& [run_id, x, y, risc] = key;
+        RiscZones risc_zones{run_id, x, y, risc, {}};
+        for (auto& [name, times] : zones) {
+            auto& [starts, ends] = times;
+            std::sort(starts.begin(), starts.end());
+            std::sort(ends.begin(), ends.end());
+            for (size_t k = 0; k < std::min(starts.size(), ends.size()); k++) {
+                risc_zones.zones.push_back(ZoneSpan{name, starts[k], ends[k]});
+            }
+        }
+        std::sort(risc_zones.zones.begin(), risc_zones.zones.end(), [](const ZoneSpan& a, const ZoneSpan& b) {
+            return a.start < b.start;
+        });
+        riscs.push_back(std::move(risc_zones));
+    }
+    return true;
+}
+
+std::vector<ProfileRun> ProfileLogReader::Runs() const {
+    std::vector<ProfileRun> runs;
+    std::map<std::string, std::vector<double>> start_offsets, end_offsets;
+    auto finish_run = [&]() {
+        for (auto& [risc, offsets] : start_offsets) {
+            runs.back().risc_skew.push_back(
+                RiscSkew{risc, time_stats(std::move(offsets)), time_stats(std::move(end_offsets[risc]))});
+        }
+        start_offsets.clear();
+        end_offsets.clear();
+    };
+
+    for (const auto& [key, riscs] : zone_times) {
+        auto [run_id, x, y] = key;
+        if (runs.empty() || runs.back().run_id != run_id) {
+            if (!runs.empty()) {
+                finish_run();
+            }
+            runs.push_back(ProfileRun{});
+            runs.back().run_id = run_id;
+        }
+
+        // The k-th start of every RISC belongs with its k-th end, the log is not sorted by time
+        std::map<std::string, RiscTimes> sorted = riscs;
+        size_t num_iterations = 0;
+        for (auto& [risc, times] : sorted) {
+            std::sort(times.starts.begin(), times.starts.end());
+            std::sort(times.ends.begin(), times.ends.end());
+            num_iterations = std::max(num_iterations, std::min(times.starts.size(), times.ends.size()));
+        }
+
+        ProfileCore core{x, y, {}};
+        for (size_t k = 0; k < num_iterations; k++) {
+            ZoneTimes zone{0, 0};
+            uint64_t first_start = std::numeric_limits<uint64_t>::max();
+            uint64_t first_end = std::numeric_limits<uint64_t>::max();
+            for (const auto& [risc, times] : sorted) {
+                if (k < std::min(times.starts.size(), times.ends.size())) {
+                    zone.start = std::max(zone.start, times.starts[k]);
+                    zone.end = std::max(zone.end, times.ends[k]);
+                    first_start = std::min(first_start, times.starts[k]);
+                    first_end = std::min(first_end, times.ends[k]);
+                }
+            }
+            for (const auto& [risc, times] : sorted) {
+                if (k < std::min(times.starts.size(), times.ends.size())) {
+                    start_offsets[risc].push_back(static_cast<double>(times.starts[k] - first_start));
+                    end_offsets[risc].push_back(static_cast<double>(times.ends[k] - first_end));
+                }
+            }
+            core.iterations.push_back(zone);
+        }
+        runs.back().num_iterations = std::max<uint32_t>(runs.back().num_iterations, num_iterations);
+        runs.back().cores.push_back(std::move(core));
+    }
+    if (!runs.empty()) {
+        finish_run();
+    }
+    return runs;
+}
+
+std::string default_profile_log_path() {
+    const char* tt_metal_home = std::getenv("TT_METAL_HOME");
+    return std::string(tt_metal_home ? tt_metal_home : ".") + "/generated/profiler/.logs/profile_log_device.csv";
+}
+
+bool append_timing_csv(
+    const std::string& path,
+    const ProfileRun& run,
+    const std::string& mode,
+    const std::string& swing_algo,
+    const std::string& data_size,
+    int run_num) {
+    // Columns are named by the physical x and y digits of the worker cores, row by row
+    std::vector<std::pair<uint32_t, uint32_t>> cores;
+    for (uint32_t y = 0; y < 8; y++) {
+        for (uint32_t x = 0; x < 8; x++) {
+            cores.push_back(wormhole_worker_core(x, y));
+        }
+    }
+
+    bool new_file = !std::ifstream(path).good();
+    std::ofstream csv(path, std::ios::app);
+    if (!csv) {
+        return false;
+    }
+    if (new_file) {
+        csv << "mode,swing_algo,data_size,run_num";
+        for (const char* suffix : {"_start", "_end"}) {
+            for (auto [x, y] : cores) {
+                csv << "," << x << y << suffix;
+            }
+        }
+        csv << "\n";
+    }
+
+    for (uint32_t k = 0; k < run.num_iterations; k++) {
+        uint64_t earliest = run.EarliestStart(k);
+        csv << mode << "," << swing_algo << "," << data_size << "," << run_num + k;
+        for (bool end : {false, true}) {
+            for (auto [x, y] : cores) {
+                const ProfileCore* core = run.Core(x, y);
+                if (core && k < core->iterations.size()) {
+                    const ZoneTimes& zone = core->iterations[k];
+                    csv << "," << (end ? zone.end : zone.start) - earliest;
+                } else {
+                    csv << ",N/A";
+                }
+            }
+        }
+        csv << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// Streaming analysis of the device profiler log (generated/profiler/.logs/profile_log_device.csv).
+// The log is read line by line and ProfileLogReader only keeps the start/end times of one zone (ALL_RED_LOOP by
+// default), so long sweeps don't need to fit in memory. Nothing in here depends on tt-metal.
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Summary of a set of cycle counts, quartiles are interpolated like numpy.percentile
+struct TimeStats {
+    size_t count = 0;
+    double min = 0, lower_quartile = 0, mean = 0, median = 0, upper_quartile = 0, max = 0;
+};
+TimeStats time_stats(std::vector<double> values);
+
+// One run of the zone on a core: latest start and latest end over the core's RISCs, like the python analyzers
+struct ZoneTimes {
+    uint64_t start;
+    uint64_t end;
+    uint64_t duration() const { return end - start; }
+};
+
+struct ProfileCore {
+    uint32_t x, y;                      // Physical coordinates
+    std::vector<ZoneTimes> iterations;  // In execution order, one per run of the zone
+};
+
+// Cycles by which a RISC starts/ends the zone after the first RISC of the same core
+struct RiscSkew {
+    std::string risc;
+    TimeStats start_offset;
+    TimeStats end_offset;
+};
+
+// All the zones of one program run, identified by the "run host ID" column when the log has one
+struct ProfileRun {
+    uint64_t run_id = 0;
+    uint32_t num_iterations = 0;  // Most runs of the zone seen on one core
+    std::vector<ProfileCore> cores;
+    std::vector<RiscSkew> risc_skew;
+
+    // Durations over all cores, of one iteration or (iteration < 0) of all of them
+    TimeStats Durations(int iteration = -1) const;
+    // Earliest start over all cores of an iteration, the python analyzers normalize to it
+    uint64_t EarliestStart(uint32_t iteration) const;
+    // Core with the given physical coordinates, nullptr if it has no zones
+    const ProfileCore* Core(uint32_t x, uint32_t y) const;
+};
+
+class ProfileLogReader {
+public:
+    explicit ProfileLogReader(const std::string& zone_name = "ALL_RED_LOOP");
+
+    // Reads (the rest of) a log, may be called for several logs. Returns false, with error set, on a bad header
+    bool Read(std::istream& log, std::string& error);
+
+    std::vector<ProfileRun> Runs() const;
+    size_t LinesRead() const { return lines_read; }
+
+private:
+    struct RiscTimes {
+        std::vector<uint64_t> starts;
+        std::vector<uint64_t> ends;
+    };
+    // (run id, core x, core y) -> RISC name -> zone times
+    using CoreKey = std::tuple<uint64_t, uint32_t, uint32_t>;
+
+    std::string zone_name;
+    size_t lines_read = 0;
+    std::map<CoreKey, std::map<std::string, RiscTimes>> zone_times;
+};
+
+// One run of a zone on a RISC
+struct ZoneSpan {
+    std::string name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Every zone of one RISC of a core in one program run
+struct RiscZones {
+    uint64_t run_id;
+    uint32_t x, y;  // Physical coordinates
+    std::string risc;
+    std::vector<ZoneSpan> zones;  // By start time
+};
+
+// Reads every zone of a log into memory, for analyses of more than one zone such as allred_critical_path. The k-th
+// start of a zone name on a RISC is paired with its k-th end. Returns false, with error set, on a bad header
+bool read_profile_zones(std::istream& log, std::vector<RiscZones>& riscs, std::string& error);
+
+// $TT_METAL_HOME/generated/profiler/.logs/profile_log_device.csv, relative to the working directory without TT_METAL_HOME
+std::string default_profile_log_path();
+
+// Appends one row per iteration of run, in the schema of timing_taker.py's results (mode, swing_algo, data_size,
+// run_num, then the normalized start and end of the 64 worker cores). Writes the header to a new file
+bool append_timing_csv(
+    const std::string& path,
+    const ProfileRun& run,
+    const std::string& mode,
+    const std::string& swing_algo,
+    const std::string& data_size,
+    int run_num);
@@ -0,0 +1,127 @@
+#include "allred_reference.hpp"
+#include "allred_bf16.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// Words handled by one work item, one tile
+constexpr size_t REFERENCE_CHUNK_WORDS = 512;
+
+struct WorkItem {
+    size_t begin;
+    size_t end;
+    uint32_t root;
+};
+
+}  // namespace
+
+AllredReference::AllredReference(const SchedulePlan& plan, bool bandwidth_optimal, unsigned num_threads) :
+    total_nodes(plan.total_nodes),
+    bandwidth_optimal(bandwidth_optimal),
+    num_threads(num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency())) {
+    // The value a core holds after step s is its value before step s plus its partner's. Walking back
+    // from the core holding the result gives the additions, every core's input is used exactly once
+    root_additions.resize(total_nodes);
+    for (uint32_t root = 0; root < total_nodes; root++) {
+        std::vector<uint32_t> needed = {root};
+        std::vector<std::vector<Addition>> step_additions(plan.algo_steps);
+        for (uint32_t step = plan.algo_steps; step-- > 0;) {
+            size_t num_needed = needed.size();
+            for (size_t i = 0; i < num_needed; i++) {
+                uint32_t partner = plan.partner(needed[i], step);
+                step_additions[step].push_back({needed[i], partner});
+                needed.push_back(partner);
+            }
+        }
+        for (const std::vector<Addition>& additions : step_additions) {
+            root_additions[root].insert(root_additions[root].end(), additions.begin(), additions.end());
+        }
+    }
+}
+
+void AllredReference::RunFloat(
+    const std::vector<const uint32_t*>& inputs, uint32_t* result, size_t begin, size_t end) const {
+    float sums[2 * REFERENCE_CHUNK_WORDS];
+    for (size_t chunk = begin; chunk < end; chunk += REFERENCE_CHUNK_WORDS) {
+        size_t words = std::min(REFERENCE_CHUNK_WORDS, end - chunk);
+        std::fill(sums, sums + 2 * words, 0.0f);
+        for (const uint32_t* input : inputs) {
+            for (size_t i = 0; i < words; i++) {
+                sums[2 * i] += bf16_to_float(input[chunk + i] & 0xffff);
+                sums[2 * i + 1] += bf16_to_float(input[chunk + i] >> 16);
+            }
+        }
+        for (size_t i = 0; i < words; i++) {
+            uint32_t hi = float_to_bf16(sums[2 * i + 1]);
+            result[chunk + i] = float_to_bf16(sums[2 * i]) | hi << 16;
+        }
+    }
+}
+
+void AllredReference::RunDevice(
+    const std::vector<const uint32_t*>& inputs,
+    uint32_t* result,
+    size_t begin,
+    size_t end,
+    uint32_t root,
+    std::vector<uint32_t>& scratch) const {
+    size_t words = end - begin;
+    scratch.resize(total_nodes * REFERENCE_CHUNK_WORDS);
+    for (uint32_t core = 0; core < total_nodes; core++) {
+        std::copy(inputs[core] + begin, inputs[core] + end, scratch.begin() + core * REFERENCE_CHUNK_WORDS);
+    }
+    for (const Addition& addition : root_additions[root]) {
+        uint32_t* dst = &scratch[addition.first * REFERENCE_CHUNK_WORDS];
+        const uint32_t* src = &scratch[addition.second * REFERENCE_CHUNK_WORDS];
+        for (size_t i = 0; i < words; i++) {
+            dst[i] = bf16_add_packed(dst[i], src[i]);
+        }
+    }
+    const uint32_t* reduced = &scratch[root * REFERENCE_CHUNK_WORDS];
+    std::copy(reduced, reduced + words, result + begin);
+}
+
+std::vector<uint32_t> AllredReference::Run(
+    const std::vector<const uint32_t*>& inputs, size_t num_words, ReferenceOrder order, uint32_t core_i) const {
+    std::vector<uint32_t> result(num_words);
+    if (inputs.size() != total_nodes) {
+        return result;
+    }
+
+    // In bandwidth optimal mode block b is reduced on core b, otherwise every block is reduced on core_i
+    bool owned_blocks = bandwidth_optimal && num_words % total_nodes == 0;
+    size_t block_words = owned_blocks ? num_words / total_nodes : num_words;
+    std::vector<WorkItem> items;
+    for (size_t block_begin = 0; block_begin < num_words; block_begin += block_words) {
+        uint32_t root = owned_blocks ? static_cast<uint32_t>(block_begin / block_words) : core_i;
+        for (size_t begin = block_begin; begin < block_begin + block_words; begin += REFERENCE_CHUNK_WORDS) {
+            items.push_back({begin, std::min(begin + REFERENCE_CHUNK_WORDS, block_begin + block_words), root});
+        }
+    }
+
+    std::atomic<size_t> next_item{0};
+    auto worker = [&] {
+        std::vector<uint32_t> scratch;
+        for (size_t item = next_item++; item < items.size(); item = next_item++) {
+            const WorkItem& work = items[item];
+            if (order == ReferenceOrder::Float) {
+                RunFloat(inputs, result.data(), work.begin, work.end);
+            } else {
+                RunDevice(inputs, result.data(), work.begin, work.end, work.root, scratch);
+            }
+        }
+    };
+
+    unsigned threads = std::min<size_t>(num_threads, items.size());
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Host reference allreduce, producing golden results for arbitrary per-core inputs.
+// Nothing in here depends on tt-metal.
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "allred_schedule.hpp"
+
+enum class ReferenceOrder {
+    Float,   // Sum all cores in float, round to bfloat16 once
+    Device,  // Bit exact: the pairwise bfloat16 additions in the order the kernels do them
+};
+
+class AllredReference {
+public:
+    // num_threads = 0 uses every hardware thread
+    AllredReference(const SchedulePlan& plan, bool bandwidth_optimal, unsigned num_threads = 0);
+
+    // inputs holds one packed vector of num_words words per core, indexed by the core's linear index.
+    // Returns the result as core_i ends up with it (in bandwidth optimal mode block b is reduced on
+    // core b and then copied, so the result is the same on every core)
+    std::vector<uint32_t> Run(
+        const std::vector<const uint32_t*>& inputs, size_t num_words, ReferenceOrder order, uint32_t core_i = 0) const;
+
+private:
+    // One addition of the device schedule: value[dst] = value[dst] + value[src]
+    using Addition = std::pair<uint32_t, uint32_t>;
+
+    void RunFloat(const std::vector<const uint32_t*>& inputs, uint32_t* result, size_t begin, size_t end) const;
+    void RunDevice(
+        const std::vector<const uint32_t*>& inputs,
+        uint32_t* result,
+        size_t begin,
+        size_t end,
+        uint32_t root,
+        std::vector<uint32_t>& scratch) const;
+
+    uint32_t total_nodes;
+    bool bandwidth_optimal;
+    unsigned num_threads;
+    std::vector<std::vector<Addition>> root_additions;  // Indexed by the core that holds the result
+};
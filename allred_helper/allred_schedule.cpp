@@ -0,0 +1,632 @@
+#include "allred_schedule.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+// cb_recv pages, see recv_cb_tiles
+uint32_t recv_tiles_of(const SchedulePlan& plan, bool compact_recv, uint32_t num_tiles) {
+    // With fewer tiles than cores the blocks are single tiles and some lie past the vector, keep it whole
+    if (!compact_recv || num_tiles < plan.total_nodes) {
+        return num_tiles;
+    }
+    uint32_t max_blocks = 0;
+    for (const BlockSet& blocks : plan.recv_blocks) {
+        max_blocks = std::max(max_blocks, blocks.count());
+    }
+    return std::max(1u, max_blocks) * (num_tiles / plan.total_nodes);
+}
+
+}  // namespace
+
+// Largest power of two not above value, clamped to max_value (8 for the 8x8 grid of one n150)
+int highest_power_of_two(int value, int max_value) {
+    int power = 1;
+    while (2 * power <= value && 2 * power <= max_value) {
+        power *= 2;
+    }
+    return power;
+}
+
+// Rounds the requested number of tiles to a size the kernels can handle
+int normalize_num_tiles(int num_tiles, bool large_buffer, uint32_t total_nodes) {
+    num_tiles = num_tiles < 1 ? 1 : num_tiles;
+    if (large_buffer) {
+        return num_tiles * total_nodes;
+    }
+    if (num_tiles < 64) {
+        int power = 1;
+        while (power < num_tiles) {
+            power <<= 1;  // multiply by 2
+        }
+        return power;
+    }
+    return ((num_tiles + 64 - 1) / 64) * 64;  // multiple of 64
+}
+
+// Returns the pattern of which NoC will be used for each comm step for swing algo
+uint32_t get_step_directions(int node_x, int node_y) {
+    if (node_x % 2 == 0) {
+        return node_y % 2 == 0 ? 0b110011 : 0b011001;
+    } else {
+        return node_y % 2 == 0 ? 0b100110 : 0b001100;
+    }
+}
+
+// Straight line distance to the swing partner at a given step of one dimension, (1 - (-2)^(step+1)) / 3
+int swing_distance(int step) {
+    int power = 1 << (step + 1);
+    return (step % 2 == 0) ? (1 + power) / 3 : (1 - power) / 3;
+}
+
+// Returns the 1D index of the communication partner for a given node at a given step
+int get_comm_partner_recdub_2D(
+    int node,
+    int recdub_step,
+    bool horizontal_step,
+    int message_pass_depth,
+    uint32_t& step_directions,
+    int SIDE_LENGTH) {
+    int row = node / SIDE_LENGTH;
+    int col = node % SIDE_LENGTH;
+    int node_position = horizontal_step ? col : row;
+    int node_other_position = !horizontal_step ? col : row;
+
+    bool sending_SE = node_position % (2 * message_pass_depth) < message_pass_depth;
+    step_directions = sending_SE ? (step_directions | (1 << recdub_step)) : (step_directions & ~(1 << recdub_step));
+
+    int recv_node = node_position + (sending_SE ? message_pass_depth : -message_pass_depth);
+    return horizontal_step ? recv_node + node_other_position * SIDE_LENGTH
+                           : recv_node * SIDE_LENGTH + node_other_position;
+}
+
+// Returns the 1D index of the communication partner for a given node at a given step
+int get_comm_partner_swing_2D(int node, int step, bool horizontal_step, int SIDE_LENGTH, int TOTAL_NODES) {
+    int row = node / SIDE_LENGTH;
+    step = step / 2;
+
+    // straight line distnce
+    int dist = swing_distance(step);
+
+    int comm_partner;
+    if (horizontal_step) {
+        comm_partner = (node % 2 == 0) ? (node + dist) : (node - dist);  // can return -ve number
+        if (comm_partner / SIDE_LENGTH < row || comm_partner < 0) {
+            comm_partner += SIDE_LENGTH;
+        } else if (comm_partner / SIDE_LENGTH > row) {
+            comm_partner -= SIDE_LENGTH;
+        }
+    } else {
+        comm_partner = (row % 2 == 0) ? (node + SIDE_LENGTH * dist) : (node - SIDE_LENGTH * dist);
+        if (comm_partner < 0) {
+            comm_partner += TOTAL_NODES;
+        } else if (comm_partner >= TOTAL_NODES) {
+            comm_partner -= TOTAL_NODES;
+        }
+    }
+    return comm_partner;  // will  loop round  to  always be in  range
+}
+
+// Function to get the indexes of the blocks that need to be communicated.
+// Recursively checks which blocks will be sent by all the nodes that a given node will communicate 
+// with in future steps, and sets all of those chunks of data to be sent. Swing version.
+void get_swing_block_comm_indexes(
+    int node, int step, uint32_t* blocks, bool horizontal_step, int SIDE_LENGTH, int TOTAL_NODES) {
+    int num_steps = (int)log2((double)TOTAL_NODES);
+    if (step >= num_steps) {
+        return;
+    }
+    for (int s = step; s < num_steps; s++) {
+        int peer = get_comm_partner_swing_2D(node, s, horizontal_step, SIDE_LENGTH, TOTAL_NODES);
+        if (peer < 32) {
+            *blocks = *blocks | (1 << peer);
+        } else {
+            *(blocks + 1) = *(blocks + 1) | (1 << (peer - 32));
+        }
+        horizontal_step = !horizontal_step;
+        get_swing_block_comm_indexes(peer, s + 1, blocks, horizontal_step, SIDE_LENGTH, TOTAL_NODES);
+    }
+    return;
+}
+
+// Function to get the indexes of the blocks that need to be communicated.
+// Recursively checks which blocks will be sent by all the nodes that a given node will communicate 
+// with in future steps, and sets all of those chunks of data to be sent. Recursive doubling version.
+void get_recdub_block_comm_indexes(
+    int node,
+    int step,
+    uint32_t* blocks,
+    bool horizontal_step,
+    int SIDE_LENGTH,
+    int TOTAL_NODES,
+    int message_pass_depth,
+    uint32_t& step_directions) {
+    int num_steps = (int)log2((double)TOTAL_NODES);
+    if (step >= num_steps) {
+        return;
+    }
+    for (int s = step; s < num_steps; s++) {
+        int peer =
+            get_comm_partner_recdub_2D(node, s, horizontal_step, message_pass_depth, step_directions, SIDE_LENGTH);
+        if (peer < 32) {
+            *blocks = *blocks | (1 << peer);
+        } else {
+            *(blocks + 1) = *(blocks + 1) | (1 << (peer - 32));
+        }
+
+        message_pass_depth = horizontal_step ? message_pass_depth : 2 * message_pass_depth;
+        horizontal_step = !horizontal_step;
+        get_recdub_block_comm_indexes(
+            peer, s + 1, blocks, horizontal_step, SIDE_LENGTH, TOTAL_NODES, message_pass_depth, step_directions);
+    }
+    return;
+}
+
+// Physical coordinates of a logical worker core on an unharvested n150 (Wormhole),
+// the DRAM/ethernet column at x = 5 and row at y = 6 are skipped
+std::pair<uint32_t, uint32_t> wormhole_worker_core(uint32_t logical_x, uint32_t logical_y) {
+    uint32_t physical_x = logical_x + 1 + (logical_x >= 4 ? 1 : 0);
+    uint32_t physical_y = logical_y + 1 + (logical_y >= 5 ? 1 : 0);
+    return {physical_x, physical_y};
+}
+
+uint32_t BlockSet::count() const {
+    uint32_t total = 0;
+    for (uint64_t word : bits) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+bool BlockSet::intersects(const BlockSet& other) const {
+    for (size_t i = 0; i < bits.size() && i < other.bits.size(); i++) {
+        if (bits[i] & other.bits[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+BlockSet& BlockSet::operator|=(const BlockSet& other) {
+    for (size_t i = 0; i < bits.size() && i < other.bits.size(); i++) {
+        bits[i] |= other.bits[i];
+    }
+    return *this;
+}
+
+// Returns the 1D index of the communication partner of a node on a width x height grid.
+// Steps alternate between rows and columns starting horizontally, once the shorter side is
+// done the remaining steps are all along the longer one. On square grids this gives the same
+// partners as get_comm_partner_swing_2D/get_comm_partner_recdub_2D. sending_SE is set if the
+// partner is in the +x/+y direction (same as get_step_directions/the recdub step_directions)
+int get_comm_partner_2D(int node, uint32_t step, bool swing_version, int width, int height, bool& sending_SE) {
+    int steps_x = 0, steps_y = 0;
+    while ((1 << steps_x) < width) {
+        steps_x++;
+    }
+    while ((1 << steps_y) < height) {
+        steps_y++;
+    }
+    int common_steps = steps_x < steps_y ? steps_x : steps_y;
+
+    bool horizontal_step;
+    int dim_step;
+    if ((int)step < 2 * common_steps) {
+        horizontal_step = step % 2 == 0;
+        dim_step = step / 2;
+    } else {
+        horizontal_step = steps_x > steps_y;
+        dim_step = common_steps + (step - 2 * common_steps);
+    }
+
+    int col = node % width;
+    int row = node / width;
+    int node_position = horizontal_step ? col : row;
+    int side = horizontal_step ? width : height;
+
+    int recv_node;
+    if (swing_version) {
+        int dist = swing_distance(dim_step);
+        int offset = (node_position % 2 == 0) ? dist : -dist;
+        sending_SE = offset > 0;
+        recv_node = ((node_position + offset) % side + side) % side;
+    } else {
+        int message_pass_depth = 1 << dim_step;
+        sending_SE = node_position % (2 * message_pass_depth) < message_pass_depth;
+        recv_node = node_position + (sending_SE ? message_pass_depth : -message_pass_depth);
+    }
+    return horizontal_step ? recv_node + row * width : recv_node * width + col;
+}
+
+// Builds the plan for all cores at once. A core that receives at step i reduces the blocks it will
+// own from step i+1 on, plus the blocks its partner would have owned, so with
+// owned[s][core] = blocks the core is responsible for from step s on:
+//   owned[algo_steps][core] = {core}
+//   owned[s][core] = owned[s+1][core] | owned[s+1][partner(core, s)]
+//   recv[s][core] = owned[s+1][core], send[s][core] = owned[s+1][partner(core, s)]
+// which gives the same masks as get_swing/recdub_block_comm_indexes without the recursion.
+SchedulePlan SchedulePlanner::Build(bool swing_version, int width, int height) {
+    SchedulePlan plan;
+    plan.swing_version = swing_version;
+    plan.width = width;
+    plan.height = height;
+    plan.total_nodes = width * height;
+    plan.algo_steps = 0;
+    while ((1u << plan.algo_steps) < plan.total_nodes) {
+        plan.algo_steps++;
+    }
+
+    uint32_t total_nodes = plan.total_nodes;
+    uint32_t algo_steps = plan.algo_steps;
+    plan.partners.resize(algo_steps * total_nodes);
+    plan.send_blocks.resize(algo_steps * total_nodes);
+    plan.recv_blocks.resize(algo_steps * total_nodes);
+    plan.step_directions.assign(total_nodes, 0);
+
+    // Communication partner and NoC direction of every core at every step
+    for (uint32_t step = 0; step < algo_steps; step++) {
+        for (uint32_t core = 0; core < total_nodes; core++) {
+            bool sending_SE;
+            plan.partners[step * total_nodes + core] =
+                get_comm_partner_2D(core, step, swing_version, width, height, sending_SE);
+            plan.step_directions[core] |= (uint32_t)sending_SE << step;
+        }
+    }
+
+    // Walk the steps backwards, merging the blocks owned by each pair of partners
+    std::vector<BlockSet> owned(total_nodes, BlockSet(total_nodes));
+    for (uint32_t core = 0; core < total_nodes; core++) {
+        owned[core].set(core);
+    }
+    std::vector<BlockSet> owned_before(total_nodes);
+    for (uint32_t step = algo_steps; step-- > 0;) {
+        for (uint32_t core = 0; core < total_nodes; core++) {
+            int partner = plan.partner(core, step);
+            plan.recv_blocks[step * total_nodes + core] = owned[core];
+            plan.send_blocks[step * total_nodes + core] = owned[partner];
+            owned_before[core] = owned[core];
+            owned_before[core] |= owned[partner];
+        }
+        owned.swap(owned_before);
+    }
+    plan.block_positions = contiguous_block_layout(plan);
+    return plan;
+}
+
+std::vector<uint32_t> contiguous_block_layout(const SchedulePlan& plan) {
+    // Block b is kept at step i by the cores whose recv mask holds it, keyed by the first block of that mask
+    std::vector<std::vector<uint32_t>> keys(plan.total_nodes, std::vector<uint32_t>(plan.algo_steps, 0));
+    for (uint32_t step = 0; step < plan.algo_steps; step++) {
+        for (uint32_t core = 0; core < plan.total_nodes; core++) {
+            const BlockSet& kept = plan.recv(core, step);
+            uint32_t first_block = plan.total_nodes;
+            for (uint32_t n_block = 0; n_block < plan.total_nodes; n_block++) {
+                if (kept.test(n_block)) {
+                    first_block = std::min(first_block, n_block);
+                    keys[n_block][step] = first_block;
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> order(plan.total_nodes), positions(plan.total_nodes), identity(plan.total_nodes);
+    for (uint32_t n_block = 0; n_block < plan.total_nodes; n_block++) {
+        order[n_block] = identity[n_block] = n_block;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    for (uint32_t position = 0; position < plan.total_nodes; position++) {
+        positions[order[position]] = position;
+    }
+
+    // Only nested masks end up contiguous, check them all
+    auto contiguous = [&](const BlockSet& blocks) {
+        BlockSet placed = place_blocks(blocks, positions);
+        uint32_t runs = 0;
+        for (uint32_t position = 0; position < plan.total_nodes; position++) {
+            runs += placed.test(position) && (position == 0 || !placed.test(position - 1));
+        }
+        return runs <= 1;
+    };
+    for (uint32_t i = 0; i < plan.send_blocks.size(); i++) {
+        if (!contiguous(plan.send_blocks[i]) || !contiguous(plan.recv_blocks[i])) {
+            return identity;
+        }
+    }
+    return positions;
+}
+
+BlockSet place_blocks(const BlockSet& blocks, const std::vector<uint32_t>& positions) {
+    BlockSet placed(blocks.size());
+    for (uint32_t n_block = 0; n_block < blocks.size(); n_block++) {
+        if (blocks.test(n_block)) {
+            placed.set(positions[n_block]);
+        }
+    }
+    return placed;
+}
+
+const SchedulePlan& SchedulePlanner::Get(bool swing_version, int SIDE_LENGTH) {
+    return Get(swing_version, SIDE_LENGTH, SIDE_LENGTH);
+}
+
+const SchedulePlan& SchedulePlanner::Get(bool swing_version, int width, int height) {
+    static std::mutex cache_mutex;
+    static std::map<std::tuple<bool, int, int>, SchedulePlan> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto key = std::make_tuple(swing_version, width, height);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        it = cache.emplace(key, Build(swing_version, width, height)).first;
+    }
+    return it->second;
+}
+
+// Fills in the partner coordinates, block masks and step directions of one core
+// for the allred_BO_2D kernels (see BOArgLayout)
+// Args that are the same on every core, apart from the DRAM and semaphore ones which need a device
+void fill_BO_common_args(
+    const SchedulePlan& plan,
+    bool bandwidth_optimal,
+    uint32_t num_tiles,
+    std::vector<uint32_t>& dataflow_args,
+    std::vector<uint32_t>& compute_args,
+    uint32_t num_chunks,
+    uint32_t num_syncs) {
+    BOArgLayout layout(plan.algo_steps, plan.total_nodes);
+    uint32_t tiles_per_node = num_tiles / plan.total_nodes == 0 ? 1 : num_tiles / plan.total_nodes;
+    std::string kernel = kernel_variant(bandwidth_optimal ? "allred_BO_2D" : "allred_LO_2D", num_tiles, num_chunks);
+    uint32_t recv_tiles = recv_cb_tiles(plan, kernel, num_tiles);
+    dataflow_args[5] = bandwidth_optimal;
+    dataflow_args[6] = plan.algo_steps;
+    dataflow_args[12] = num_tiles;
+    dataflow_args[13] = tiles_per_node;
+    compute_args[0] = plan.algo_steps;
+    compute_args[1] = bandwidth_optimal;
+    dataflow_args[layout.num_chunks()] = num_chunks;
+    dataflow_args[layout.recv_tiles()] = recv_tiles;
+    num_syncs =
+        num_syncs ? valid_num_syncs(plan, num_tiles, num_syncs) : model_num_syncs(plan, bandwidth_optimal, num_tiles);
+    dataflow_args[layout.num_syncs()] = num_syncs;
+    compute_args[4] = num_tiles;
+    compute_args[5] = tiles_per_node;
+    compute_args[layout.compute_num_chunks()] = num_chunks;
+    compute_args[layout.compute_recv_tiles()] = recv_tiles;
+    compute_args[layout.compute_batch_tiles()] = reduce_batch_tiles(plan, bandwidth_optimal, num_tiles, num_syncs);
+    for (uint32_t n_block = 0; n_block < plan.total_nodes; n_block++) {
+        dataflow_args[layout.block_positions() + n_block] = bandwidth_optimal ? plan.block_positions[n_block] : n_block;
+    }
+}
+
+void fill_BO_schedule_args(
+    int core_i,
+    const SchedulePlan& plan,
+    const PhysicalCoreFn& physical_core,
+    std::vector<uint32_t>& dataflow_args,
+    std::vector<uint32_t>& compute_args) {
+    BOArgLayout layout(plan.algo_steps, plan.total_nodes);
+
+    for (uint32_t algo_step = 0; algo_step < plan.algo_steps; algo_step++) {
+        std::pair<uint32_t, uint32_t> partner_core = physical_core(plan.partner(core_i, algo_step));
+        dataflow_args[layout.partner_coords() + 2 * algo_step] = partner_core.first;
+        dataflow_args[layout.partner_coords() + 1 + 2 * algo_step] = partner_core.second;
+
+        // Block masks are passed as mask_words 32 bit args, low bits first
+        BlockSet send_blocks = place_blocks(plan.send(core_i, algo_step), plan.block_positions);
+        BlockSet recv_blocks = place_blocks(plan.recv(core_i, algo_step), plan.block_positions);
+        for (uint32_t w = 0; w < layout.mask_words; w++) {
+            dataflow_args[layout.send_blocks() + layout.mask_words * algo_step + w] = send_blocks.word32(w);
+            dataflow_args[layout.recv_blocks() + layout.mask_words * algo_step + w] = recv_blocks.word32(w);
+            compute_args[layout.compute_recv_blocks() + layout.mask_words * algo_step + w] = recv_blocks.word32(w);
+        }
+    }
+
+    std::pair<uint32_t, uint32_t> this_core = physical_core(core_i);
+    dataflow_args[7] = this_core.first;
+    dataflow_args[8] = this_core.second;
+    dataflow_args[11] = plan.step_directions[core_i];
+    compute_args[3] = plan.step_directions[core_i];
+}
+
+void fill_mem_common_args(
+    const SchedulePlan& plan, uint32_t num_tiles, std::vector<uint32_t>& dataflow_args, std::vector<uint32_t>& compute_args) {
+    dataflow_args[9] = plan.algo_steps;
+    dataflow_args[15] = num_tiles;
+    dataflow_args[16] = num_tiles / plan.total_nodes;  // tiles per node
+    compute_args[0] = plan.algo_steps;
+    compute_args[5] = num_tiles;
+    compute_args[6] = num_tiles / plan.total_nodes;
+}
+
+void fill_mem_schedule_args(
+    int core_i,
+    const SchedulePlan& plan,
+    const PhysicalCoreFn& physical_core,
+    std::vector<uint32_t>& dataflow_args,
+    std::vector<uint32_t>& compute_args) {
+    MemArgLayout layout(plan.algo_steps);
+
+    std::pair<uint32_t, uint32_t> this_core = physical_core(core_i);
+    dataflow_args[10] = this_core.first;
+    dataflow_args[11] = this_core.second;
+    dataflow_args[12] = core_i;
+    compute_args[1] = this_core.first;
+    compute_args[2] = this_core.second;
+    compute_args[3] = core_i;
+
+    // Partners are only used for node to node syncs, so only the partner's own block is marked
+    for (uint32_t algo_step = 0; algo_step < plan.algo_steps; algo_step++) {
+        int comm_partner_idx = plan.partner(core_i, algo_step);
+        std::pair<uint32_t, uint32_t> partner_core = physical_core(comm_partner_idx);
+        dataflow_args[layout.partner_coords() + 2 * algo_step] = partner_core.first;
+        dataflow_args[layout.partner_coords() + 1 + 2 * algo_step] = partner_core.second;
+
+        uint64_t blocks_to_send = 1ull << comm_partner_idx;
+        uint64_t blocks_to_recv = 1ull << core_i;
+        dataflow_args[layout.send_blocks() + 2 * algo_step] = (uint32_t)blocks_to_send;
+        dataflow_args[layout.send_blocks() + 1 + 2 * algo_step] = (uint32_t)(blocks_to_send >> 32);
+        compute_args[layout.compute_recv_blocks() + 2 * algo_step] = (uint32_t)blocks_to_recv;
+        compute_args[layout.compute_recv_blocks() + 1 + 2 * algo_step] = (uint32_t)(blocks_to_recv >> 32);
+    }
+
+    dataflow_args[14] = plan.step_directions[core_i];
+    compute_args[4] = plan.step_directions[core_i];
+}
+
+AllredArgTables build_BO_arg_tables(
+    const SchedulePlan& plan,
+    const PhysicalCoreFn& physical_core,
+    bool bandwidth_optimal,
+    uint32_t num_tiles,
+    uint32_t num_chunks,
+    uint32_t num_syncs) {
+    BOArgLayout layout(plan.algo_steps, plan.total_nodes);
+    std::vector<uint32_t> dataflow_args(layout.dataflow_size());
+    std::vector<uint32_t> compute_args(layout.compute_size());
+    fill_BO_common_args(plan, bandwidth_optimal, num_tiles, dataflow_args, compute_args, num_chunks, num_syncs);
+
+    AllredArgTables tables;
+    for (uint32_t core_i = 0; core_i < plan.total_nodes; core_i++) {
+        dataflow_args[9] = core_i;
+        fill_BO_schedule_args(core_i, plan, physical_core, dataflow_args, compute_args);
+        tables.dataflow.push_back(dataflow_args);
+        tables.compute.push_back(compute_args);
+    }
+    return tables;
+}
+
+AllredArgTables build_mem_arg_tables(const SchedulePlan& plan, const PhysicalCoreFn& physical_core, uint32_t num_tiles) {
+    MemArgLayout layout(plan.algo_steps);
+    std::vector<uint32_t> dataflow_args(layout.dataflow_size());
+    std::vector<uint32_t> compute_args(layout.compute_size());
+    fill_mem_common_args(plan, num_tiles, dataflow_args, compute_args);
+
+    AllredArgTables tables;
+    for (uint32_t core_i = 0; core_i < plan.total_nodes; core_i++) {
+        fill_mem_schedule_args(core_i, plan, physical_core, dataflow_args, compute_args);
+        tables.dataflow.push_back(dataflow_args);
+        tables.compute.push_back(compute_args);
+    }
+    return tables;
+}
+
+std::vector<CircularBufferSpec> allred_circular_buffers(
+    uint32_t num_tiles, uint32_t recv_tiles, bool streaming, uint32_t stats_bytes) {
+    constexpr uint32_t flag_page_size = 1;
+    constexpr uint32_t tile_size = 2048;
+    std::vector<CircularBufferSpec> cbs = {
+        {0, flag_page_size, flag_page_size},     // compute
+        {1, flag_page_size, flag_page_size},     // NW
+        {2, flag_page_size, flag_page_size},     // SE
+        {3, recv_tiles * tile_size, tile_size},  // recv
+        {16, num_tiles * tile_size, tile_size},  // local
+    };
+    if (streaming) {
+        cbs.push_back({4, num_tiles * tile_size, tile_size});  // prefetch
+    }
+    if (stats_bytes) {
+        cbs.push_back({5, stats_bytes, stats_bytes});  // stats
+    }
+    return cbs;
+}
+
+std::string kernel_variant(
+    const std::string& variant, uint32_t num_tiles, uint32_t num_chunks, uint32_t loo_crossover_tiles) {
+    return variant == "allred_LO_2D" && num_chunks == 1 && num_tiles < loo_crossover_tiles ? "allred_LOO_2D" : variant;
+}
+
+bool runs_LOO_kernel(bool bandwidth_optimal, uint32_t num_tiles, uint32_t num_chunks, uint32_t loo_crossover_tiles) {
+    std::string variant = bandwidth_optimal ? "allred_BO_2D" : "allred_LO_2D";
+    return kernel_variant(variant, num_tiles, num_chunks, loo_crossover_tiles) == "allred_LOO_2D";
+}
+
+uint32_t recv_cb_tiles(const SchedulePlan& plan, const std::string& kernel, uint32_t num_tiles) {
+    return recv_tiles_of(plan, kernel == "allred_BO_2D", num_tiles);
+}
+
+uint32_t l1_footprint_tiles(const SchedulePlan& plan, bool compact_recv, uint32_t num_tiles, bool streaming) {
+    return recv_tiles_of(plan, compact_recv, num_tiles) + num_tiles * (streaming ? 2 : 1);
+}
+
+ChunkPlan plan_chunks(
+    const SchedulePlan& plan, bool compact_recv, uint32_t num_tiles, uint32_t chunk_tiles, uint32_t l1_budget) {
+    constexpr uint32_t tile_size = 2048;
+    if (chunk_tiles == 0) {
+        if (l1_footprint_tiles(plan, compact_recv, num_tiles, false) * tile_size <= l1_budget) {
+            return {num_tiles, 1};
+        }
+        chunk_tiles = 64;
+        while (l1_footprint_tiles(plan, compact_recv, chunk_tiles + 64, true) * tile_size <= l1_budget) {
+            chunk_tiles += 64;
+        }
+    } else {
+        chunk_tiles = (chunk_tiles + 63) / 64 * 64;
+    }
+    if (chunk_tiles >= num_tiles) {
+        return {num_tiles, 1};
+    }
+    return {chunk_tiles, (num_tiles + chunk_tiles - 1) / chunk_tiles};
+}
+
+uint32_t sync_blocks(const SchedulePlan& plan, uint32_t num_tiles) {
+    uint32_t tiles_per_node = num_tiles / plan.total_nodes == 0 ? 1 : num_tiles / plan.total_nodes;
+    return num_tiles / tiles_per_node;
+}
+
+uint32_t valid_num_syncs(const SchedulePlan& plan, uint32_t num_tiles, uint32_t num_syncs) {
+    uint32_t blocks = sync_blocks(plan, num_tiles);
+    uint32_t valid = 1;
+    while (2 * valid <= num_syncs && blocks % (2 * valid) == 0) {
+        valid *= 2;
+    }
+    return valid;
+}
+
+double model_sync_time_ns(
+    const SchedulePlan& plan,
+    bool bandwidth_optimal,
+    uint32_t num_tiles,
+    uint32_t num_syncs,
+    const SyncCostParams& params) {
+    constexpr double tile_size = 2048;
+    uint32_t blocks = sync_blocks(plan, num_tiles);
+    double block_tiles = (double)num_tiles / blocks;
+    uint32_t sync_stride = blocks / num_syncs;
+    double time_ns = 0;
+    for (uint32_t step = 0; step < plan.algo_steps; step++) {
+        uint32_t step_blocks = bandwidth_optimal ? plan.send(0, step).count() : blocks;
+        uint32_t chunks = std::max(1u, step_blocks / sync_stride);
+        double chunk_tiles = step_blocks * block_tiles / chunks;
+        double transfer_ns = chunk_tiles * tile_size / params.bytes_per_ns + params.sync_ns;
+        double reduce_ns = chunk_tiles * params.reduce_ns_per_tile;
+        time_ns += transfer_ns + reduce_ns + (chunks - 1) * std::max(transfer_ns, reduce_ns);
+    }
+    return time_ns;
+}
+
+uint32_t model_num_syncs(
+    const SchedulePlan& plan, bool bandwidth_optimal, uint32_t num_tiles, const SyncCostParams& params) {
+    uint32_t best = 1;
+    double best_ns = model_sync_time_ns(plan, bandwidth_optimal, num_tiles, 1, params);
+    for (uint32_t num_syncs = 2; valid_num_syncs(plan, num_tiles, num_syncs) == num_syncs; num_syncs *= 2) {
+        double time_ns = model_sync_time_ns(plan, bandwidth_optimal, num_tiles, num_syncs, params);
+        if (time_ns < best_ns) {
+            best = num_syncs;
+            best_ns = time_ns;
+        }
+    }
+    return best;
+}
+
+uint32_t reduce_batch_tiles(const SchedulePlan& plan, bool bandwidth_optimal, uint32_t num_tiles, uint32_t num_syncs) {
+    uint32_t blocks = sync_blocks(plan, num_tiles);
+    uint32_t block_tiles = num_tiles / blocks;
+    uint32_t unit = bandwidth_optimal ? block_tiles : block_tiles * (blocks / num_syncs);
+    uint32_t batch = std::min(unit, MAX_BATCH_TILES);
+    while (unit % batch != 0) {
+        batch--;
+    }
+    return batch;
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+// Host-only schedule helpers (communication partners, block masks and kernel arg layouts).
+// Nothing in here depends on tt-metal, so it can be used without a device.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+int highest_power_of_two(int, int max_value = 8);
+
+int normalize_num_tiles(int, bool, uint32_t);
+
+uint32_t get_step_directions(int, int);
+
+int swing_distance(int);
+
+int get_comm_partner_2D(int, uint32_t, bool, int, int, bool&);
+
+int get_comm_partner_swing_2D(int, int, bool, int, int);
+
+int get_comm_partner_recdub_2D(int, int, bool, int, uint32_t&, int);
+
+void get_swing_block_comm_indexes(int, int, uint32_t*, bool, int, int);
+
+void get_recdub_block_comm_indexes(int, int, uint32_t*, bool, int, int, int, uint32_t&);
+
+// Maps the linear index of a core to its physical (NoC) x, y coordinates
+using PhysicalCoreFn = std::function<std::pair<uint32_t, uint32_t>(int)>;
+
+// Physical coordinates of a logical worker core on an unharvested n150 (Wormhole)
+std::pair<uint32_t, uint32_t> wormhole_worker_core(uint32_t, uint32_t);
+
+// Set of block indexes of any size, used for the send/recv block masks
+class BlockSet {
+public:
+    BlockSet() = default;
+    explicit BlockSet(uint32_t num_blocks) : num_blocks(num_blocks), bits((num_blocks + 63) / 64, 0) {}
+
+    uint32_t size() const { return num_blocks; }
+    void set(uint32_t block) { bits[block / 64] |= 1ull << (block % 64); }
+    bool test(uint32_t block) const { return (bits[block / 64] >> (block % 64)) & 1; }
+    uint32_t count() const;
+    bool intersects(const BlockSet& other) const;
+
+    // Word i of the mask when split into 32 bit runtime args, low bits first
+    uint32_t word32(uint32_t i) const {
+        return i / 2 < bits.size() ? (uint32_t)(bits[i / 2] >> (32 * (i % 2))) : 0;
+    }
+    uint64_t word64(uint32_t i) const { return i < bits.size() ? bits[i] : 0; }
+
+    BlockSet& operator|=(const BlockSet& other);
+    bool operator==(const BlockSet& other) const { return num_blocks == other.num_blocks && bits == other.bits; }
+    bool operator!=(const BlockSet& other) const { return !(*this == other); }
+
+private:
+    uint32_t num_blocks = 0;
+    std::vector<uint64_t> bits;
+};
+
+// Partners, NoC directions and block masks of every core at every step of one algorithm on a
+// width x height grid of cores (both powers of two). Indexed as [step * total_nodes + core]
+struct SchedulePlan {
+    bool swing_version;
+    int width;
+    int height;
+    uint32_t total_nodes;
+    uint32_t algo_steps;
+    std::vector<int> partners;
+    std::vector<BlockSet> send_blocks;  // Blocks a core sends to its partner during reduce-scatter
+    std::vector<BlockSet> recv_blocks;  // Blocks a core receives and reduces during reduce-scatter
+    std::vector<uint32_t> step_directions;  // Indexed by core, bit i set if the SE NoC is used in step i
+    std::vector<uint32_t> block_positions;  // Indexed by block, its place in L1, see contiguous_block_layout
+
+    int partner(int core, uint32_t step) const { return partners[step * total_nodes + core]; }
+    const BlockSet& send(int core, uint32_t step) const { return send_blocks[step * total_nodes + core]; }
+    const BlockSet& recv(int core, uint32_t step) const { return recv_blocks[step * total_nodes + core]; }
+};
+
+// Order of the blocks in L1 in which every send and recv mask of the plan is one contiguous range, so the BO
+// kernels send each step (within a sync stride) with a single write. Blocks are sorted by the masks that keep
+// them at each step, which nest for both algorithms. The identity if the masks of a plan don't nest
+std::vector<uint32_t> contiguous_block_layout(const SchedulePlan&);
+
+// The places of the blocks of a mask, with block b at positions[b]
+BlockSet place_blocks(const BlockSet&, const std::vector<uint32_t>& positions);
+
+// Builds schedule plans. Plans are built once per (algorithm, grid) and cached
+class SchedulePlanner {
+public:
+    static const SchedulePlan& Get(bool swing_version, int SIDE_LENGTH);
+    static const SchedulePlan& Get(bool swing_version, int width, int height);
+    static SchedulePlan Build(bool swing_version, int width, int height);
+};
+
+// Runtime arg layout of the allred_BO_2D dataflow and compute kernels. Block masks take
+// mask_words 32 bit args per step, 2 for grids of up to 64 cores. Block masks are in L1 order, the
+// dataflow kernel puts block b at the position in arg block_positions() + b when moving the vector to and
+// from DRAM. Latency optimal mode, which doesn't read the masks, keeps the blocks in order
+struct BOArgLayout {
+    uint32_t algo_steps;
+    uint32_t total_nodes;
+    uint32_t mask_words = 2;
+
+    BOArgLayout(uint32_t algo_steps, uint32_t total_nodes = 64) :
+        algo_steps(algo_steps), total_nodes(total_nodes), mask_words(total_nodes > 64 ? (total_nodes + 31) / 32 : 2) {}
+
+    uint32_t partner_coords() const { return 14; }                // x, y of the partner for each step
+    uint32_t semaphores() const { return 14 + 2 * algo_steps; }    // 8 semaphore ids
+    uint32_t send_blocks() const { return 22 + 2 * algo_steps; }   // Block mask per step
+    uint32_t recv_blocks() const { return send_blocks() + mask_words * algo_steps; }  // Block mask per step
+    uint32_t num_chunks() const { return recv_blocks() + mask_words * algo_steps; }    // See ChunkPlan
+    uint32_t recv_tiles() const { return num_chunks() + 1; }                           // Pages of cb_recv
+    uint32_t num_syncs() const { return recv_tiles() + 1; }                            // See model_num_syncs
+    uint32_t block_positions() const { return num_syncs() + 1; }                       // One per block
+    uint32_t stats() const { return block_positions() + total_nodes; }  // Address and bank of the --stats buffer
+    uint32_t dataflow_size() const { return stats() + 2; }
+
+    uint32_t compute_recv_blocks() const { return 6; }
+    uint32_t compute_num_chunks() const { return 6 + mask_words * algo_steps; }
+    uint32_t compute_recv_tiles() const { return compute_num_chunks() + 1; }
+    uint32_t compute_batch_tiles() const { return compute_recv_tiles() + 1; }  // See reduce_batch_tiles
+    uint32_t compute_size() const { return compute_batch_tiles() + 1; }
+};
+
+// Runtime arg layout of the allred_mem_2D kernels, where partners are only used for node to node syncs
+struct MemArgLayout {
+    uint32_t algo_steps;
+
+    explicit MemArgLayout(uint32_t algo_steps) : algo_steps(algo_steps) {}
+
+    uint32_t partner_coords() const { return 17; }                // x, y of the partner for each step
+    uint32_t semaphores() const { return 17 + 2 * algo_steps; }    // 8 semaphore ids
+    uint32_t send_blocks() const { return 25 + 2 * algo_steps; }   // Block mask per step
+    uint32_t stats() const { return send_blocks() + 2 * algo_steps; }  // Address and bank of the --stats buffer
+    uint32_t dataflow_size() const { return stats() + 2; }
+
+    uint32_t compute_recv_blocks() const { return 7; }
+    uint32_t compute_size() const { return 7 + 2 * algo_steps; }
+};
+
+// num_syncs 0 takes the choice of model_num_syncs, others are rounded down to a valid count
+void fill_BO_common_args(
+    const SchedulePlan&,
+    bool,
+    uint32_t,
+    std::vector<uint32_t>&,
+    std::vector<uint32_t>&,
+    uint32_t num_chunks = 1,
+    uint32_t num_syncs = 0);
+
+void fill_BO_schedule_args(
+    int,
+    const SchedulePlan&,
+    const PhysicalCoreFn&,
+    std::vector<uint32_t>&,
+    std::vector<uint32_t>&);
+
+void fill_mem_common_args(const SchedulePlan&, uint32_t, std::vector<uint32_t>&, std::vector<uint32_t>&);
+
+void fill_mem_schedule_args(
+    int,
+    const SchedulePlan&,
+    const PhysicalCoreFn&,
+    std::vector<uint32_t>&,
+    std::vector<uint32_t>&);
+
+// Runtime args of every core for one configuration, indexed by core. The DRAM args, the semaphore ids and
+// is_SE need a device and are left 0, see AllredProgramCache
+struct AllredArgTables {
+    std::vector<std::vector<uint32_t>> dataflow;
+    std::vector<std::vector<uint32_t>> compute;
+};
+
+// num_tiles is the size of a chunk when streaming, see ChunkPlan
+AllredArgTables build_BO_arg_tables(
+    const SchedulePlan&, const PhysicalCoreFn&, bool, uint32_t, uint32_t num_chunks = 1, uint32_t num_syncs = 0);
+
+AllredArgTables build_mem_arg_tables(const SchedulePlan&, const PhysicalCoreFn&, uint32_t);
+
+// Circular buffers of the allreduce kernels, the same on every core. c_0-c_2 are one byte pages used as
+// flags between the RISCs, c_3 receives the partner's blocks (recv_tiles, see recv_cb_tiles) and c_16 holds the
+// local vector. When streaming, c_4 holds the next chunk, prefetched from DRAM while the current one is reduced.
+// With --stats, c_5 holds the counters of the dataflow RISCs (stats_bytes, see stats_slab_bytes)
+struct CircularBufferSpec {
+    uint32_t index;
+    uint32_t size;
+    uint32_t page_size;
+};
+
+std::vector<CircularBufferSpec> allred_circular_buffers(
+    uint32_t num_tiles, uint32_t recv_tiles, bool streaming = false, uint32_t stats_bytes = 0);
+
+// L1 the allreduce CBs may take on every core, c_3 and c_16 of the largest vector that fits with a full size
+// cb_recv
+constexpr uint32_t ALLRED_MAX_L1_TILES = 320;
+constexpr uint32_t ALLRED_L1_BUDGET = 2 * ALLRED_MAX_L1_TILES * 2048;
+
+// Variant whose kernels run for variant: allred_LO_2D swaps in the allred_LOO_2D dataflow kernel for a vector of
+// one chunk below loo_crossover_tiles (64, or the crossover of a --tuning table). The LOO kernel sends the whole
+// vector at every step and has no allgather, so allred_BO_2D keeps the BO dataflow kernel at every size. The host
+// programs, the shim and the host models all pick the kernel here
+std::string kernel_variant(
+    const std::string& variant, uint32_t num_tiles, uint32_t num_chunks = 1, uint32_t loo_crossover_tiles = 64);
+
+// Whether the BO kernels in bandwidth_optimal mode run with the LOO dataflow kernel, see kernel_variant
+bool runs_LOO_kernel(bool bandwidth_optimal, uint32_t num_tiles, uint32_t num_chunks = 1, uint32_t loo_crossover_tiles = 64);
+
+// L1 footprint planner. The BO dataflow kernel in bandwidth optimal mode (kernel allred_BO_2D, see kernel_variant)
+// packs the blocks received in a reduce-scatter step at the end of cb_recv, so it only needs the most any core
+// receives in one step, half the vector for both algorithms. The other kernels (allred_LO_2D, allred_LOO_2D,
+// allred_mem_2D) reserve the whole vector in it
+uint32_t recv_cb_tiles(const SchedulePlan&, const std::string& kernel, uint32_t num_tiles);
+
+// Pages of the recv, local and (when streaming) prefetch CBs, with a compact cb_recv (compact_recv) for the BO
+// kernels in bandwidth optimal mode
+uint32_t l1_footprint_tiles(const SchedulePlan&, bool compact_recv, uint32_t num_tiles, bool streaming);
+
+// Streaming of vectors larger than L1 with the BO kernels: the vector stays in DRAM and the allreduce runs on
+// one chunk of chunk_tiles at a time, the NW RISC prefetching the next chunk while the current one is reduced
+struct ChunkPlan {
+    uint32_t chunk_tiles;
+    uint32_t num_chunks;
+
+    uint32_t tiles() const { return chunk_tiles * num_chunks; }
+    bool streaming() const { return num_chunks > 1; }
+};
+
+// A single chunk if num_tiles fits in l1_budget, otherwise the largest multiple of 64 tiles for which the
+// three CBs of a chunk fit (or chunk_tiles rounded up to one, if given). The vector is padded to whole chunks
+ChunkPlan plan_chunks(
+    const SchedulePlan&,
+    bool compact_recv,
+    uint32_t num_tiles,
+    uint32_t chunk_tiles = 0,
+    uint32_t l1_budget = ALLRED_L1_BUDGET);
+
+// Semaphore syncs per step of the send loops of the BO and LOO dataflow kernels. The sender signals its partner
+// after every 1/num_syncs of the blocks, and the partner's idle RISC then pushes the tiles that arrived on to
+// compute, so add_tiles starts before the whole step has arrived. Each sync waits for a write barrier, so more of
+// them overlap more of the transfer with the reduction but add a round trip each. num_syncs is a power of two
+// that divides the blocks of a chunk, sync_blocks
+uint32_t sync_blocks(const SchedulePlan&, uint32_t num_tiles);
+
+// Largest valid num_syncs of at most num_syncs, 1 at least
+uint32_t valid_num_syncs(const SchedulePlan&, uint32_t num_tiles, uint32_t num_syncs);
+
+// Pipeline model of the reduce-scatter (or allreduce) steps. Rough Wormhole figures by default
+struct SyncCostParams {
+    double sync_ns = 500.0;             // Write barrier and semaphore inc of a sync, as NocCostParams::alpha_ns
+    double bytes_per_ns = 32.0;         // NoC bandwidth of a write
+    double reduce_ns_per_tile = 150.0;  // add_tiles and pack_tile of one tile
+};
+
+// Predicted time of the steps of core 0: in a step sending k chunks, the first chunk is sent then reduced, and
+// the k - 1 others each take the slower of their transfer and their reduction. Blocks of a step are one range
+// in L1 (see contiguous_block_layout), so only the syncs within it carry data, the kernels skip the others
+double model_sync_time_ns(
+    const SchedulePlan&, bool bandwidth_optimal, uint32_t num_tiles, uint32_t num_syncs, const SyncCostParams& = {});
+
+// The valid num_syncs with the lowest model_sync_time_ns, the default of the host programs
+uint32_t model_num_syncs(const SchedulePlan&, bool bandwidth_optimal, uint32_t num_tiles, const SyncCostParams& = {});
+
+// Tiles the BO compute kernel adds per DST acquire, and packs together once their adds are done. At most 8, the
+// half of DST a bf16 acquire gets, and a divisor of both a block (bandwidth optimal mode only reduces the received
+// ones) and the tiles a sync pushes, so a batch never waits on tiles it doesn't reduce or on the next sync
+constexpr uint32_t MAX_BATCH_TILES = 8;
+uint32_t reduce_batch_tiles(const SchedulePlan&, bool bandwidth_optimal, uint32_t num_tiles, uint32_t num_syncs);
@@ -0,0 +1,140 @@
+#include "allred_stats.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+constexpr uint32_t counters_per_slot = 5;
+
+uint64_t read_u64(const std::vector<uint32_t>& words, size_t index) {
+    return (uint64_t)words[index] | ((uint64_t)words[index + 1] << 32);
+}
+
+}  // namespace
+
+uint32_t stats_region_bytes(uint32_t slots) {
+    return (2 * sizeof(uint64_t) + slots * counters_per_slot * sizeof(uint64_t) + 31) & ~31u;
+}
+
+std::vector<std::string> stats_slot_names(uint32_t algo_steps, bool mem) {
+    std::vector<std::string> names;
+    for (uint32_t step = 0; step < algo_steps; step++) {
+        names.push_back((mem ? "sync step " : "step ") + std::to_string(step));
+    }
+    for (uint32_t step = 0; step < algo_steps; step++) {
+        names.push_back(
+            !mem        ? "gather step " + std::to_string(step)
+            : step == 0 ? "exchange"
+            : step == 1 ? "result"
+                        : "unused");
+    }
+    return names;
+}
+
+bool parse_stats_buffer(
+    const std::vector<uint32_t>& words, uint32_t num_cores, uint32_t slots, std::vector<CoreStats>& cores, std::string& error) {
+    size_t region_words = stats_region_bytes(slots) / sizeof(uint32_t);
+    if (words.size() < 2 * region_words * num_cores) {
+        error = std::to_string(words.size()) + " words, " + std::to_string(num_cores) + " slabs of " +
+                std::to_string(2 * region_words) + " expected";
+        return false;
+    }
+    cores.assign(num_cores, CoreStats());
+    for (uint32_t core_i = 0; core_i < num_cores; core_i++) {
+        for (uint32_t risc = 0; risc < 2; risc++) {
+            size_t region = (2 * core_i + risc) * region_words;
+            RiscStats& stats = cores[core_i].risc[risc];
+            std::string name = "core " + std::to_string(core_i) + (risc ? " SE" : " NW");
+            stats.runs = read_u64(words, region);
+            if (read_u64(words, region + 2) != slots) {
+                error = name + ": " + std::to_string(read_u64(words, region + 2)) + " slots, " + std::to_string(slots) +
+                        " expected";
+                return false;
+            }
+            if (stats.runs == 0) {
+                error = name + ": no timed runs counted, are the kernels built with ALLRED_STATS?";
+                return false;
+            }
+            stats.slots.resize(slots);
+            for (uint32_t slot = 0; slot < slots; slot++) {
+                size_t counters = region + 4 + 2 * counters_per_slot * slot;
+                StatsCounters& slot_stats = stats.slots[slot];
+                slot_stats.bytes = read_u64(words, counters);
+                slot_stats.writes = read_u64(words, counters + 2);
+                slot_stats.sem_wait_cycles = read_u64(words, counters + 4);
+                slot_stats.cb_wait_cycles = read_u64(words, counters + 6);
+                slot_stats.step_cycles = read_u64(words, counters + 8);
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<StatsSlotSummary> summarize_stats(const std::vector<CoreStats>& cores) {
+    std::vector<StatsSlotSummary> summaries;
+    size_t slots = cores.empty() ? 0 : cores[0].risc[0].slots.size();
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        StatsSlotSummary summary;
+        summary.slot = slot;
+        double cycles = 0, risc_cycles = 0, sem_wait_cycles = 0, cb_wait_cycles = 0;
+        for (const CoreStats& core : cores) {
+            // Both RISCs count the same runs, the NW one is the reference
+            double runs = std::max<uint64_t>(1, core.risc[0].runs);
+            double core_cycles = 0;
+            for (const RiscStats& risc : core.risc) {
+                const StatsCounters& counters = risc.slots[slot];
+                summary.bytes += counters.bytes / runs;
+                summary.writes += counters.writes / runs;
+                core_cycles = std::max(core_cycles, counters.step_cycles / runs);
+                risc_cycles += counters.step_cycles / runs;
+                sem_wait_cycles += counters.sem_wait_cycles / runs;
+                cb_wait_cycles += counters.cb_wait_cycles / runs;
+            }
+            if (core_cycles > 0) {
+                summary.cores++;
+                cycles += core_cycles;
+                summary.max_cycles = std::max(summary.max_cycles, core_cycles);
+            }
+        }
+        if (summary.cores == 0) {
+            continue;
+        }
+        summary.bytes_per_cycle = summary.bytes / cycles;
+        summary.bytes /= summary.cores;
+        summary.writes /= summary.cores;
+        summary.mean_cycles = cycles / summary.cores;
+        summary.sem_wait_fraction = risc_cycles > 0 ? sem_wait_cycles / risc_cycles : 0;
+        summary.cb_wait_fraction = risc_cycles > 0 ? cb_wait_cycles / risc_cycles : 0;
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+void print_stats_summary(
+    const std::vector<StatsSlotSummary>& summaries, const std::vector<std::string>& slot_names, double cycles_per_ns) {
+    printf(
+        "%-14s %6s %10s %8s %12s %12s %9s %9s %9s\n",
+        "step",
+        "cores",
+        "bytes",
+        "writes",
+        "mean cyc",
+        "max cyc",
+        "GB/s",
+        "sem wait",
+        "cb wait");
+    for (const StatsSlotSummary& summary : summaries) {
+        std::string name = summary.slot < slot_names.size() ? slot_names[summary.slot] : std::to_string(summary.slot);
+        printf(
+            "%-14s %6u %10.0f %8.1f %12.0f %12.0f %9.2f %8.1f%% %8.1f%%\n",
+            name.c_str(),
+            summary.cores,
+            summary.bytes,
+            summary.writes,
+            summary.mean_cycles,
+            summary.max_cycles,
+            summary.bytes_per_cycle * cycles_per_ns,
+            100 * summary.sem_wait_fraction,
+            100 * summary.cb_wait_fraction);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// The per step counters the dataflow kernels keep with --stats (see kernels/kernel_stats.h in allred_BO_2D), read
+// back from the stats DRAM buffer. The buffer holds a slab per core, in rank order, made of one region per dataflow
+// RISC (NW, i.e. BRISC, first), each
+//   uint64 runs      timed runs of the allreduce counted, chunks of a streamed run count as runs
+//   uint64 slots
+//   slots x StatsCounters
+// padded to 32 bytes. Nothing in here depends on tt-metal.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counters of a step (a slot) on one RISC, summed over the timed runs
+struct StatsCounters {
+    uint64_t bytes = 0;            // Written by noc_async_write
+    uint64_t writes = 0;           // noc_async_write calls
+    uint64_t sem_wait_cycles = 0;  // In noc_semaphore_wait_min
+    uint64_t cb_wait_cycles = 0;   // In cb_reserve_back, or waiting for compute
+    uint64_t step_cycles = 0;      // Whole step
+};
+
+struct RiscStats {
+    uint64_t runs = 0;
+    std::vector<StatsCounters> slots;
+};
+
+struct CoreStats {
+    RiscStats risc[2];  // NW, SE
+};
+
+// Slots of the kernels: the reduce scatter (or allreduce) steps, then the allgather steps. The allred_mem_2D
+// kernels count their node sync steps in the first ones, then the common buffer exchange and the result
+inline uint32_t stats_slots(uint32_t algo_steps) { return 2 * algo_steps; }
+uint32_t stats_region_bytes(uint32_t slots);
+inline uint32_t stats_slab_bytes(uint32_t slots) { return 2 * stats_region_bytes(slots); }
+
+// Names of the slots, as printed
+std::vector<std::string> stats_slot_names(uint32_t algo_steps, bool mem);
+
+// Splits the buffer into the slabs of num_cores cores. Returns false, with error set, if it is too short, or a
+// region has another slot count or no timed run (its kernel was not built with ALLRED_STATS)
+bool parse_stats_buffer(
+    const std::vector<uint32_t>& words, uint32_t num_cores, uint32_t slots, std::vector<CoreStats>& cores, std::string& error);
+
+// A slot over all cores, per core and timed run. A core's step lasts as long as its slower RISC, the wait
+// fractions are over the step cycles of both RISCs
+struct StatsSlotSummary {
+    uint32_t slot = 0;
+    uint32_t cores = 0;  // That spent cycles in the slot
+    double bytes = 0;
+    double writes = 0;
+    double mean_cycles = 0;
+    double max_cycles = 0;   // Slowest core
+    double bytes_per_cycle = 0;
+    double sem_wait_fraction = 0;
+    double cb_wait_fraction = 0;
+};
+
+// Summaries of the slots some core spent cycles in, in slot order
+std::vector<StatsSlotSummary> summarize_stats(const std::vector<CoreStats>& cores);
+
+// Prints the summaries as a table, with the bandwidth in GB/s at the given clock
+void print_stats_summary(
+    const std::vector<StatsSlotSummary>& summaries, const std::vector<std::string>& slot_names, double cycles_per_ns = 1.0);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Host model of a tt-metal circular buffer (CircularBufferConfig with size and page_size). Like on the device,
+// the only shared state is the pair of page counters: the producer adds to pages_received in push, the consumer
+// to pages_acked in pop, and each side keeps its own read/write pointer, advanced in whole pages and wrapped at
+// the end of the buffer. So the ring is lock free with a single producer and a single consumer. The counters are
+// added to atomically, which also covers the dataflow kernels taking turns at pushing cb_recv.
+class TileRing {
+public:
+    TileRing() = default;
+    TileRing(uint32_t size, uint32_t page_size) { Configure(size, page_size); }
+    TileRing(const TileRing&) = delete;
+    TileRing& operator=(const TileRing&) = delete;
+
+    // size is in bytes, the ring holds size / page_size pages
+    void Configure(uint32_t size, uint32_t page_size) {
+        ring_size = size;
+        ring_page_size = page_size;
+        num_pages = page_size ? size / page_size : 0;
+        Reset();
+    }
+
+    // Empties the ring, only while neither side uses it (a new launch on the device)
+    void Reset() {
+        pages_received.store(0, std::memory_order_relaxed);
+        pages_acked.store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t Size() const { return ring_size; }
+    uint32_t PageSize() const { return ring_page_size; }
+    uint32_t NumPages() const { return num_pages; }
+
+    // Pushed and not yet popped pages. The counters wrap around, only their difference is meaningful
+    uint32_t PagesInUse() const {
+        return pages_received.load(std::memory_order_acquire) - pages_acked.load(std::memory_order_acquire);
+    }
+
+    // cb_reserve_back/cb_wait_front without the wait
+    bool CanReserve(uint32_t pages) const { return num_pages - PagesInUse() >= pages; }
+    bool CanWait(uint32_t pages) const { return PagesInUse() >= pages; }
+
+    // cb_push_back/cb_pop_front, the caller advances its own pointer with Advance
+    void Push(uint32_t pages) { pages_received.fetch_add(pages, std::memory_order_release); }
+    void Pop(uint32_t pages) { pages_acked.fetch_add(pages, std::memory_order_release); }
+
+    // Byte offset of a read/write pointer after pages more pages
+    uint32_t Advance(uint32_t offset, uint32_t pages) const {
+        offset += pages * ring_page_size;
+        return offset >= ring_size ? offset - ring_size : offset;
+    }
+
+    // Blocking reserve/wait for host threads, spinning and then yielding, so a ring also works on one CPU
+    void ReserveBack(uint32_t pages) const {
+        for (uint32_t tries = 0; !CanReserve(pages); tries++) {
+            pause(tries);
+        }
+    }
+    void WaitFront(uint32_t pages) const {
+        for (uint32_t tries = 0; !CanWait(pages); tries++) {
+            pause(tries);
+        }
+    }
+
+private:
+    static void pause(uint32_t tries) {
+        if (tries >= 64) {
+            std::this_thread::yield();
+        }
+    }
+
+    uint32_t ring_size = 0;
+    uint32_t ring_page_size = 0;
+    uint32_t num_pages = 0;
+    // On separate cache lines, so the producer and the consumer only share a line when one reads the other's
+    alignas(64) std::atomic<uint32_t> pages_received{0};
+    alignas(64) std::atomic<uint32_t> pages_acked{0};
+};
@@ -0,0 +1,160 @@
+#include "allred_trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <tuple>
+#include "allred_critical_path.hpp"
+
+namespace {
+
+// Thread of a RISC within its core's process, in the order the cores run them
+uint32_t risc_thread(const std::string& risc) {
+    static const std::map<std::string, uint32_t> threads = {
+        {"BRISC", 0}, {"NCRISC", 1}, {"TRISC", 2}, {"TRISC_0", 2}, {"TRISC_1", 3}, {"TRISC_2", 4}, {"ERISC", 5}};
+    auto it = threads.find(risc);
+    return it == threads.end() ? 6 : it->second;
+}
+
+// Zone names are identifiers, but the log is not ours
+std::string json_string(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += (c >= 0 && c < 0x20) ? ' ' : c;
+    }
+    return quoted + "\"";
+}
+
+std::string coords_name(uint32_t x, uint32_t y) { return "(" + std::to_string(x) + "," + std::to_string(y) + ")"; }
+
+}  // namespace
+
+TraceSummary write_chrome_trace(
+    std::ostream& trace,
+    const std::vector<RiscZones>& riscs,
+    const SchedulePlan& plan,
+    const PhysicalCoreFn& physical_core,
+    const TraceOptions& options) {
+    TraceSummary summary;
+    std::vector<const RiscZones*> exported;
+    uint64_t origin = std::numeric_limits<uint64_t>::max();
+    for (const RiscZones& risc : riscs) {
+        if (options.all_runs || risc.run_id == options.run_id) {
+            exported.push_back(&risc);
+            for (const ZoneSpan& zone : risc.zones) {
+                origin = std::min(origin, zone.start);
+            }
+        }
+    }
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> ranks;
+    for (uint32_t core = 0; core < plan.total_nodes; core++) {
+        ranks[physical_core(core)] = core;
+    }
+    // Cores of the plan are processes 0 to total_nodes - 1, others follow by coordinates
+    auto process = [&](const RiscZones& risc) {
+        auto it = ranks.find({risc.x, risc.y});
+        return it != ranks.end() ? it->second : plan.total_nodes + risc.y * 64 + risc.x;
+    };
+
+    char number[32];
+    auto us = [&](uint64_t cycles) {
+        snprintf(number, sizeof(number), "%.3f", (double)cycles / options.cycles_per_us);
+        return std::string(number);
+    };
+    const char* separator = "\n";
+    auto event = [&](const std::string& fields) {
+        trace << separator << "{" << fields << "}";
+        separator = ",\n";
+    };
+    trace << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+    // Names of the core processes and RISC threads
+    std::map<uint32_t, std::string> processes;
+    std::map<std::pair<uint32_t, uint32_t>, std::string> threads;
+    for (const RiscZones* risc : exported) {
+        uint32_t pid = process(*risc);
+        processes[pid] = (pid < plan.total_nodes ? "core " + std::to_string(pid) + " " : "core ") +
+                         coords_name(risc->x, risc->y);
+        threads[{pid, risc_thread(risc->risc)}] = risc->risc;
+    }
+    for (const auto& [pid, name] : processes) {
+        event("\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " + std::to_string(pid) +
+              ", \"args\": {\"name\": " + json_string(name) + "}");
+        event("\"ph\": \"M\", \"name\": \"process_sort_index\", \"pid\": " + std::to_string(pid) +
+              ", \"args\": {\"sort_index\": " + std::to_string(pid) + "}");
+    }
+    for (const auto& [thread, name] : threads) {
+        event("\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " + std::to_string(thread.first) +
+              ", \"tid\": " + std::to_string(thread.second) + ", \"args\": {\"name\": " + json_string(name) + "}");
+    }
+
+    // Step zones get their step and partner, and are looked up by (run id, core, run, step, phase) for the flows
+    std::vector<LabelledStepZone> labelled = label_step_zones(riscs, plan, physical_core);
+    std::map<const ZoneSpan*, const LabelledStepZone*> labels;
+    std::map<std::tuple<uint64_t, uint32_t, uint32_t, uint32_t, int>, const LabelledStepZone*> step_zones;
+    for (const LabelledStepZone& zone : labelled) {
+        labels[zone.zone] = &zone;
+        step_zones[{zone.risc->run_id, zone.core, zone.run, zone.step, (int)zone.phase}] = &zone;
+    }
+
+    for (const RiscZones* risc : exported) {
+        std::string ids = "\"pid\": " + std::to_string(process(*risc)) + ", \"tid\": " +
+                          std::to_string(risc_thread(risc->risc));
+        for (const ZoneSpan& zone : risc->zones) {
+            std::string name = zone.name;
+            std::string args = "\"run host ID\": " + std::to_string(risc->run_id);
+            auto label = labels.find(&zone);
+            if (label != labels.end()) {
+                const LabelledStepZone& step_zone = *label->second;
+                uint32_t partner = plan.partner(step_zone.core, step_zone.step);
+                auto [x, y] = physical_core(partner);
+                name += " step " + std::to_string(step_zone.step) + ", core " + std::to_string(partner);
+                args += ", \"run\": " + std::to_string(step_zone.run) + ", \"step\": " +
+                        std::to_string(step_zone.step) + ", \"partner\": " + std::to_string(partner) +
+                        ", \"partner core\": " + json_string(coords_name(x, y));
+                summary.step_zones++;
+            }
+            event("\"ph\": \"X\", \"cat\": \"zone\", \"name\": " + json_string(name) + ", " + ids + ", \"ts\": " +
+                  us(zone.start - origin) + ", \"dur\": " + us(zone.end - zone.start) + ", \"args\": {" + args + "}");
+            summary.zones++;
+        }
+    }
+
+    // An arrow from the partner's semaphore inc to the end of the wait it releases: the handshake incs come first
+    // in the partner's wait zone, the data incs last in its send zone
+    for (const LabelledStepZone& wait : labelled) {
+        bool at_start = wait.phase == StepPhase::PartnerWait || wait.phase == StepPhase::GatherPartnerWait;
+        StepPhase source_phase = wait.phase == StepPhase::Recv             ? StepPhase::Send
+                                 : wait.phase == StepPhase::GatherDataWait ? StepPhase::GatherSend
+                                                                           : wait.phase;
+        if (!at_start && source_phase == wait.phase) {
+            continue;  // Not a wait on the partner
+        }
+        if (!options.all_runs && wait.risc->run_id != options.run_id) {
+            continue;
+        }
+        uint32_t partner = plan.partner(wait.core, wait.step);
+        auto source_it = step_zones.find({wait.risc->run_id, partner, wait.run, wait.step, (int)source_phase});
+        if (source_it == step_zones.end()) {
+            continue;
+        }
+        const LabelledStepZone& source = *source_it->second;
+        // Flow ends bind to the slice enclosing their time, so stay a cycle inside the zones
+        uint64_t source_time = at_start ? source.zone->start : std::max(source.zone->start, source.zone->end - 1);
+        uint64_t wait_time = std::max(wait.zone->start, wait.zone->end - 1);
+        std::string id = std::to_string(summary.flows);
+        std::string name = json_string(at_start ? "semaphore_0" : "semaphore_1");
+        event("\"ph\": \"s\", \"cat\": \"semaphore\", \"name\": " + name + ", \"id\": " + id + ", \"pid\": " +
+              std::to_string(process(*source.risc)) + ", \"tid\": " + std::to_string(risc_thread(source.risc->risc)) +
+              ", \"ts\": " + us(source_time - origin));
+        event("\"ph\": \"f\", \"bp\": \"e\", \"cat\": \"semaphore\", \"name\": " + name + ", \"id\": " + id +
+              ", \"pid\": " + std::to_string(process(*wait.risc)) + ", \"tid\": " +
+              std::to_string(risc_thread(wait.risc->risc)) + ", \"ts\": " + us(wait_time - origin));
+        summary.flows++;
+    }
+    trace << "\n]}\n";
+    return summary;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Chrome trace event JSON of the zones of a device profiler log, for chrome://tracing or ui.perfetto.dev: a process
+// per core and a thread per RISC. The step zones of --step-zones are named after their step and partner, and the
+// semaphore signals between partners are drawn as flow arrows. Nothing in here depends on tt-metal.
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "allred_profile.hpp"
+#include "allred_schedule.hpp"
+
+struct TraceOptions {
+    double cycles_per_us = 1000;  // CHIP_FREQ[MHz] of the log
+    bool all_runs = true;         // Otherwise only run_id
+    uint64_t run_id = 0;
+};
+
+struct TraceSummary {
+    size_t zones = 0;
+    size_t step_zones = 0;  // Named after their step
+    size_t flows = 0;
+};
+
+// Writes the zones of riscs as one trace. Cores are numbered by their rank in the plan (physical_core maps ranks to
+// physical coordinates), cores outside it by their coordinates. Times start at the earliest zone written
+TraceSummary write_chrome_trace(
+    std::ostream&, const std::vector<RiscZones>& riscs, const SchedulePlan&, const PhysicalCoreFn&, const TraceOptions&);
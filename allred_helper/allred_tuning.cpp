@@ -0,0 +1,406 @@
+#include "allred_tuning.hpp"
+#include "allred_noc.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+namespace {
+
+constexpr uint32_t tile_size_bytes = 2048;
+
+std::vector<std::string> split_csv_line(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ',')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+bool latency_optimal_mode(const std::string& mode) { return mode == "allred_LO_2D" || mode == "allred_LOO_2D"; }
+
+// Solves the n x n system a x = b in place, with partial pivoting. Returns false if it is singular
+bool solve_linear(std::vector<std::vector<double>>& a, std::vector<double>& b) {
+    size_t n = b.size();
+    for (size_t col = 0; col < n; col++) {
+        size_t pivot = col;
+        for (size_t row = col + 1; row < n; row++) {
+            if (std::fabs(a[row][col]) > std::fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (std::fabs(a[pivot][col]) < 1e-12) {
+            return false;
+        }
+        std::swap(a[col], a[pivot]);
+        std::swap(b[col], b[pivot]);
+        for (size_t row = col + 1; row < n; row++) {
+            double factor = a[row][col] / a[col][col];
+            for (size_t k = col; k < n; k++) {
+                a[row][k] -= factor * a[col][k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+    for (size_t col = n; col-- > 0;) {
+        for (size_t k = col + 1; k < n; k++) {
+            b[col] -= a[col][k] * b[k];
+        }
+        b[col] /= a[col][col];
+    }
+    return true;
+}
+
+}  // namespace
+
+const std::vector<std::string>& tuned_kernels() {
+    static const std::vector<std::string> kernels = {"allred_BO_2D", "allred_LO_2D", "allred_LOO_2D", "allred_mem_2D"};
+    return kernels;
+}
+
+CostFeatures cost_features(const std::string& kernel, const SchedulePlan& plan, uint32_t num_tiles) {
+    // Virtual grids that don't fit on the chip are routed on a torus of their own size
+    bool on_chip_grid = plan.width <= 8 && plan.height <= 8;
+    NocTopology topology = on_chip_grid ? NocTopology() : NocTopology(plan.width, plan.height);
+    PhysicalCoreFn physical_core = [&](int core_i) {
+        return on_chip_grid ? wormhole_worker_core(core_i % plan.width, core_i / plan.width)
+                            : std::make_pair<uint32_t, uint32_t>(core_i % plan.width, core_i / plan.width);
+    };
+    bool mem = kernel == "allred_mem_2D";
+    NocSimResult result = simulate_noc(
+        plan, physical_core, topology, kernel == "allred_BO_2D", num_tiles, NocDirections::Plan, NocCostParams());
+
+    CostFeatures features;
+    for (const NocStepLoad& load : result.steps) {
+        features.syncs += load.max_writes;
+        features.hops += load.max_hops;
+        features.bytes += load.max_link_bytes;
+    }
+    if (mem) {
+        // Two node syncs per step, and every core writes the vector to DRAM, reads the blocks of all cores,
+        // writes its block back and reads the whole result
+        double vector_bytes = (double)num_tiles * tile_size_bytes;
+        features.syncs = 2.0 * plan.algo_steps;
+        features.hops *= 2.0;
+        features.bytes = 3.0 * vector_bytes + vector_bytes / plan.total_nodes;
+    }
+    return features;
+}
+
+bool read_timing_points(std::istream& csv, std::vector<TimingPoint>& points, std::string& error) {
+    std::string line;
+    if (!std::getline(csv, line) || line.rfind("mode,swing_algo,data_size,run_num", 0) != 0) {
+        error = "not a timing results file, the header should start with mode,swing_algo,data_size,run_num";
+        return false;
+    }
+    size_t num_cores = (split_csv_line(line).size() - 4) / 2;
+
+    // (mode, swing_algo, data_size) -> cycles of every row
+    std::map<std::tuple<std::string, int, int>, std::vector<double>> samples;
+    while (std::getline(csv, line)) {
+        std::vector<std::string> fields = split_csv_line(line);
+        if (fields.size() < 4 + 2 * num_cores ||
+            std::find(tuned_kernels().begin(), tuned_kernels().end(), fields[0]) == tuned_kernels().end()) {
+            continue;
+        }
+        // Starts are normalized to the earliest core, so the run ends with the last end
+        double cycles = -1;
+        for (size_t i = 4 + num_cores; i < 4 + 2 * num_cores; i++) {
+            if (fields[i] != "N/A" && !fields[i].empty()) {
+                cycles = std::max(cycles, std::stod(fields[i]));
+            }
+        }
+        if (cycles >= 0) {
+            samples[{fields[0], std::stoi(fields[1]), std::stoi(fields[2])}].push_back(cycles);
+        }
+    }
+
+    for (auto& [key, cycles] : samples) {
+        auto& [mode, swing_algo, data_size] = key;
+        std::nth_element(cycles.begin(), cycles.begin() + cycles.size() / 2, cycles.end());
+        TimingPoint point;
+        point.num_tiles = normalize_num_tiles(data_size, !latency_optimal_mode(mode), 64);
+        point.kernel = kernel_variant(mode, point.num_tiles);
+        point.swing_version = swing_algo == 1;
+        point.cycles = cycles[cycles.size() / 2];
+        point.samples = cycles.size();
+        points.push_back(point);
+    }
+    return true;
+}
+
+CostModelParams fit_cost_model(const std::vector<TimingPoint>& points, const std::string& kernel) {
+    CostModelParams params;
+    std::vector<std::vector<double>> rows;  // 1, syncs, hops, bytes
+    std::vector<double> cycles;
+    uint32_t algorithms = 0;
+    for (const TimingPoint& point : points) {
+        if (point.kernel == kernel) {
+            algorithms |= point.swing_version ? 2 : 1;
+            CostFeatures f = cost_features(kernel, SchedulePlanner::Get(point.swing_version, 8), point.num_tiles);
+            rows.push_back({1.0, f.syncs, f.hops, f.bytes});
+            cycles.push_back(point.cycles);
+        }
+    }
+    if (rows.empty()) {
+        return params;
+    }
+
+    // Columns are scaled to a maximum of 1 so the tiny ridge term weighs them alike
+    constexpr size_t num_params = 4;
+    std::vector<double> scale(num_params, 0.0);
+    for (const std::vector<double>& row : rows) {
+        for (size_t k = 0; k < num_params; k++) {
+            scale[k] = std::max(scale[k], std::fabs(row[k]));
+        }
+    }
+    std::vector<bool> active(num_params);
+    for (size_t k = 0; k < num_params; k++) {
+        active[k] = scale[k] > 0;
+    }
+
+    std::vector<double> coefficients(num_params, 0.0);
+    for (bool refit = true; refit;) {
+        std::vector<size_t> columns;
+        for (size_t k = 0; k < num_params; k++) {
+            if (active[k]) {
+                columns.push_back(k);
+            }
+        }
+        std::vector<std::vector<double>> normal(columns.size(), std::vector<double>(columns.size(), 0.0));
+        std::vector<double> rhs(columns.size(), 0.0);
+        for (size_t r = 0; r < rows.size(); r++) {
+            for (size_t i = 0; i < columns.size(); i++) {
+                double xi = rows[r][columns[i]] / scale[columns[i]];
+                rhs[i] += xi * cycles[r];
+                for (size_t j = 0; j < columns.size(); j++) {
+                    normal[i][j] += xi * rows[r][columns[j]] / scale[columns[j]];
+                }
+            }
+        }
+        for (size_t i = 0; i < columns.size(); i++) {
+            normal[i][i] += 1e-9 * rows.size();
+        }
+        std::fill(coefficients.begin(), coefficients.end(), 0.0);
+        if (!solve_linear(normal, rhs)) {
+            return params;
+        }
+        for (size_t i = 0; i < columns.size(); i++) {
+            coefficients[columns[i]] = rhs[i] / scale[columns[i]];
+        }
+
+        // Drop the most negative of the syncs, hops and bytes terms, the base may be negative
+        size_t worst = 0;
+        for (size_t k = 1; k < num_params; k++) {
+            if (active[k] && coefficients[k] < 0 && (worst == 0 || coefficients[k] < coefficients[worst])) {
+                worst = k;
+            }
+        }
+        refit = worst != 0;
+        if (refit) {
+            active[worst] = false;
+        }
+    }
+
+    params.base_cycles = coefficients[0];
+    params.sync_cycles = coefficients[1];
+    params.hop_cycles = coefficients[2];
+    params.cycles_per_byte = coefficients[3];
+    params.points = rows.size();
+    params.algorithms = algorithms;
+    double squared_error = 0;
+    for (size_t r = 0; r < rows.size(); r++) {
+        double predicted = params.Predict({rows[r][1], rows[r][2], rows[r][3]});
+        squared_error += (predicted - cycles[r]) * (predicted - cycles[r]);
+    }
+    params.rms_error = std::sqrt(squared_error / rows.size());
+    return params;
+}
+
+TuningTable::TuningTable() {
+    NocCostParams noc;
+    CostModelParams untuned;
+    untuned.sync_cycles = noc.alpha_ns;
+    untuned.hop_cycles = noc.hop_ns;
+    untuned.cycles_per_byte = 1.0 / noc.bytes_per_ns;
+    for (const char* kernel : {"allred_BO_2D", "allred_LO_2D", "allred_LOO_2D"}) {
+        kernels[kernel] = untuned;
+    }
+}
+
+double TuningTable::Predict(const std::string& kernel, const SchedulePlan& plan, uint32_t num_tiles) const {
+    auto it = kernels.find(kernel);
+    if (it == kernels.end()) {
+        return -1;
+    }
+    return std::max(0.0, it->second.Predict(cost_features(kernel, plan, num_tiles)));
+}
+
+uint32_t fit_loo_crossover(const TuningTable& table, uint32_t max_tiles) {
+    for (const char* kernel : {"allred_LO_2D", "allred_LOO_2D"}) {
+        if (!table.kernels.count(kernel) || table.kernels.at(kernel).points == 0) {
+            return 64;
+        }
+    }
+    uint32_t crossover = max_tiles + 64;
+    for (uint32_t num_tiles = max_tiles / 64 * 64; num_tiles >= 64; num_tiles -= 64) {
+        double lo = 0, loo = 0;
+        for (bool swing_version : {false, true}) {
+            const SchedulePlan& plan = SchedulePlanner::Get(swing_version, 8);
+            lo += table.Predict("allred_LO_2D", plan, num_tiles);
+            loo += table.Predict("allred_LOO_2D", plan, num_tiles);
+        }
+        if (lo > loo) {
+            break;
+        }
+        crossover = num_tiles;
+    }
+    return crossover;
+}
+
+bool read_tuning_table(std::istream& file, TuningTable& table, std::string& error) {
+    TuningTable read;
+    std::string line;
+    for (uint32_t line_number = 1; std::getline(file, line); line_number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key)) {
+            continue;  // Blank or comment line
+        }
+        if (key == "kernel") {
+            std::string kernel;
+            CostModelParams params;
+            if (!(fields >> kernel >> params.base_cycles >> params.sync_cycles >> params.hop_cycles >>
+                  params.cycles_per_byte >> params.points >> params.algorithms >> params.rms_error) ||
+                std::find(tuned_kernels().begin(), tuned_kernels().end(), kernel) == tuned_kernels().end()) {
+                error = "line " + std::to_string(line_number) + " is not \"kernel <name> <7 numbers>\"";
+                return false;
+            }
+            read.kernels[kernel] = params;
+        } else if (key == "loo_crossover_tiles") {
+            if (!(fields >> read.loo_crossover_tiles)) {
+                error = "line " + std::to_string(line_number) + " has no number of tiles";
+                return false;
+            }
+            read.loo_crossover_tiles = std::max<uint32_t>(64, read.loo_crossover_tiles);
+        } else {
+            error = "line " + std::to_string(line_number) + " has an unknown key " + key;
+            return false;
+        }
+    }
+    table = read;
+    return true;
+}
+
+void write_tuning_table(std::ostream& file, const TuningTable& table) {
+    file << "# cycles = base + syncs * sync_cycles + hops * hop_cycles + bytes * cycles_per_byte, see allred_tuning.hpp\n";
+    file << "# kernel name base_cycles sync_cycles hop_cycles cycles_per_byte points algorithms rms_error\n";
+    for (const auto& [kernel, params] : table.kernels) {
+        file << "kernel " << kernel << " " << params.base_cycles << " " << params.sync_cycles << " "
+             << params.hop_cycles << " " << params.cycles_per_byte << " " << params.points << " "
+             << params.algorithms << " " << params.rms_error << "\n";
+    }
+    file << "loo_crossover_tiles " << table.loo_crossover_tiles << "\n";
+}
+
+TuningTable load_tuning_table(const std::string& path) {
+    TuningTable table;
+    std::ifstream file(path);
+    std::string error;
+    if (!file) {
+        printf("No tuning table at %s, using the untuned model\n", path.c_str());
+    } else if (!read_tuning_table(file, table, error)) {
+        printf("%s: %s, using the untuned model\n", path.c_str(), error.c_str());
+    }
+    return table;
+}
+
+AlgorithmChoice select_algorithm(
+    const TuningTable& table,
+    uint64_t bytes,
+    int width,
+    int height,
+    const std::vector<std::string>& variants,
+    int swing_version) {
+    uint32_t total_nodes = width * height;
+    uint32_t vector_tiles = std::max<uint64_t>(1, (bytes + tile_size_bytes - 1) / tile_size_bytes);
+    AlgorithmChoice best;
+    for (const std::string& variant : variants) {
+        for (bool swing : {false, true}) {
+            if (swing_version >= 0 && swing != (swing_version == 1)) {
+                continue;
+            }
+            AlgorithmChoice choice;
+            choice.variant = variant;
+            choice.swing_version = swing;
+            if (variant == "allred_LO_2D") {
+                choice.data_size = vector_tiles;
+                choice.num_tiles = normalize_num_tiles(vector_tiles, false, total_nodes);
+            } else {
+                // A block of whole tiles per core
+                choice.data_size = (vector_tiles + total_nodes - 1) / total_nodes;
+                choice.num_tiles = normalize_num_tiles(choice.data_size, true, total_nodes);
+            }
+            choice.kernel = kernel_variant(variant, choice.num_tiles, 1, table.loo_crossover_tiles);
+            auto params = table.kernels.find(choice.kernel);
+            const SchedulePlan& plan = SchedulePlanner::Get(swing, width, height);
+            bool compact_recv = variant == "allred_BO_2D";
+            bool fits =
+                l1_footprint_tiles(plan, compact_recv, choice.num_tiles, false) * tile_size_bytes <= ALLRED_L1_BUDGET;
+            if (!fits || params == table.kernels.end() ||
+                !((params->second.algorithms >> swing) & 1)) {
+                continue;
+            }
+            choice.predicted_cycles = table.Predict(choice.kernel, plan, choice.num_tiles);
+            if (choice.predicted_cycles >= 0 &&
+                (best.predicted_cycles < 0 || choice.predicted_cycles < best.predicted_cycles)) {
+                best = choice;
+            }
+        }
+    }
+    return best;
+}
+
+bool resolve_auto_args(
+    int argc,
+    char** argv,
+    int width,
+    int height,
+    const std::string& tuning_path,
+    std::vector<std::string>& args,
+    AlgorithmChoice& choice) {
+    bool swing_auto = argc >= 2 && std::string(argv[1]) == "auto";
+    bool mode_auto = argc >= 9 && std::string(argv[8]) == "auto";
+    if (!swing_auto && !mode_auto) {
+        return false;
+    }
+    uint32_t total_nodes = width * height;
+    int data_size = (argc >= 6) ? std::max(1, std::stoi(argv[5])) : 1;
+    bool bandwidth_optimal = !mode_auto && argc >= 9 && std::stoi(argv[8]) == 1;
+    uint64_t bytes = (uint64_t)data_size * tile_size_bytes * (bandwidth_optimal ? total_nodes : 1);
+    std::vector<std::string> variants = mode_auto           ? std::vector<std::string>{"allred_BO_2D", "allred_LO_2D", "allred_mem_2D"}
+                                        : bandwidth_optimal ? std::vector<std::string>{"allred_BO_2D"}
+                                                            : std::vector<std::string>{"allred_LO_2D"};
+    choice = select_algorithm(load_tuning_table(tuning_path), bytes, width, height, variants, swing_auto ? -1 : std::stoi(argv[1]));
+    if (choice.predicted_cycles < 0) {
+        return true;
+    }
+
+    args = {
+        choice.swing_version ? "1" : "0",
+        std::to_string(choice.data_size),
+        choice.variant == "allred_LO_2D" ? "0" : "1"};
+    argv[1] = args[0].data();
+    if (argc >= 6) {
+        argv[5] = args[1].data();
+    }
+    if (argc >= 9) {
+        argv[8] = args[2].data();
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Alpha-beta model of the ALL_RED_LOOP cycles of each kernel, fitted to the timing results of allred_sweep or
+// allred_profiler --csv (the schema of timing_taker.py), and the choice of algorithm and variant it implies.
+// The fitted parameters are kept in a tuning table, a text file the drivers read with --tuning=PATH.
+// Nothing in here depends on tt-metal.
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "allred_schedule.hpp"
+
+// Kernels the model tells apart, by the name of their folder: allred_BO_2D (bandwidth optimal), allred_LO_2D
+// (the BO kernels in latency optimal mode), allred_LOO_2D (its dataflow kernel for small vectors) and allred_mem_2D
+const std::vector<std::string>& tuned_kernels();
+
+// What a run of the allreduce does on its critical path, summed over the steps
+struct CostFeatures {
+    double syncs = 0;  // Semaphore syncs (one per write of the dataflow kernels) of the busiest core
+    double hops = 0;   // Router hops to the farthest partner
+    double bytes = 0;  // Bytes on the busiest NoC link (DRAM bytes of a core for allred_mem_2D)
+};
+
+// Features of one run of kernel on the plan's grid, with row major cores and the plan's NoC directions
+CostFeatures cost_features(const std::string& kernel, const SchedulePlan&, uint32_t num_tiles);
+
+// cycles = base + syncs * sync_cycles + hops * hop_cycles + bytes * cycles_per_byte
+struct CostModelParams {
+    double base_cycles = 0;
+    double sync_cycles = 0;
+    double hop_cycles = 0;
+    double cycles_per_byte = 0;
+    uint32_t points = 0;    // Configurations fitted, 0 for the untuned defaults
+    uint32_t algorithms = 3;  // Bit 0 recdub, bit 1 swing: the algorithms fitted, only those are selected
+    double rms_error = 0;   // Over the fitted configurations, in cycles
+
+    double Predict(const CostFeatures& f) const {
+        return base_cycles + f.syncs * sync_cycles + f.hops * hop_cycles + f.bytes * cycles_per_byte;
+    }
+};
+
+// Median ALL_RED_LOOP cycles (end of the last core) of one configuration
+struct TimingPoint {
+    std::string kernel;
+    bool swing_version;
+    uint32_t num_tiles;
+    double cycles;
+    uint32_t samples;
+};
+
+// Reads a timing results CSV of an 8x8 grid and adds one point per (mode, swing_algo, data_size) to points.
+// allred_sweep writes the variant whose kernels ran; other allred_LO_2D rows are attributed to allred_LOO_2D below
+// 64 tiles, as run without --tuning. Returns false, with error set, on a bad header
+bool read_timing_points(std::istream&, std::vector<TimingPoint>&, std::string& error);
+
+// Least squares fit of the points of one kernel. Parameters that come out negative are dropped and the rest
+// refitted, so a grid where hops or syncs don't vary gets 0 for them rather than a meaningless value
+CostModelParams fit_cost_model(const std::vector<TimingPoint>&, const std::string& kernel);
+
+struct TuningTable {
+    // Untuned BO/LO/LOO kernels use the defaults of NocCostParams at 1 GHz; allred_mem_2D has none, so it is
+    // only selected once it has been fitted
+    TuningTable();
+
+    std::map<std::string, CostModelParams> kernels;
+    // allred_LO_2D runs the allred_LOO_2D dataflow kernel below this many tiles. At least 64, the BO dataflow
+    // kernel can't sync fewer tiles than that
+    uint32_t loo_crossover_tiles = 64;
+
+    // Predicted cycles, negative if the kernel has no parameters
+    double Predict(const std::string& kernel, const SchedulePlan&, uint32_t num_tiles) const;
+};
+
+// Smallest multiple of 64 tiles (up to max_tiles) from which the BO kernels in latency optimal mode are
+// predicted to be at least as fast as allred_LOO_2D with both algorithms. max_tiles + 64 if they never are,
+// 64 unless both kernels were fitted
+uint32_t fit_loo_crossover(const TuningTable&, uint32_t max_tiles = 320);
+
+bool read_tuning_table(std::istream&, TuningTable&, std::string& error);
+
+void write_tuning_table(std::ostream&, const TuningTable&);
+
+// The table at path, or the untuned defaults (saying so) if it is missing or bad
+TuningTable load_tuning_table(const std::string& path);
+
+struct AlgorithmChoice {
+    std::string variant;   // allred_BO_2D, allred_LO_2D or allred_mem_2D, as passed to AllredProgramCache
+    std::string kernel;    // Kernel that runs, allred_LOO_2D for allred_LO_2D below the crossover
+    bool swing_version = false;
+    int data_size = 0;     // Arg 5 of the variant
+    uint32_t num_tiles = 0;
+    double predicted_cycles = -1;
+};
+
+// Variant and algorithm with the lowest predicted time for an allreduce of at least bytes, among variants and
+// swing (swing_version < 0), recdub or both, among those whose CBs fit in L1 (see l1_footprint_tiles, streamed
+// vectors aren't modelled). The choice has a negative predicted_cycles if no candidate fits
+AlgorithmChoice select_algorithm(
+    const TuningTable&,
+    uint64_t bytes,
+    int width,
+    int height,
+    const std::vector<std::string>& variants = {"allred_BO_2D", "allred_LO_2D", "allred_mem_2D"},
+    int swing_version = -1);
+
+// Drivers: replaces "auto" in arg 1 (swing version) and/or arg 8 (bandwidth optimal) of argv with the choice
+// of select_algorithm with the table at tuning_path, and arg 5 with the choice's data size. With arg 8 "auto",
+// arg 5 is the number of tiles of the whole vector, otherwise it keeps the meaning of the given mode. args
+// holds the replaced strings and must outlive argv. Returns false (argv untouched) if neither arg is "auto"
+bool resolve_auto_args(
+    int argc,
+    char** argv,
+    int width,
+    int height,
+    const std::string& tuning_path,
+    std::vector<std::string>& args,
+    AlgorithmChoice&);
@@ -0,0 +1,218 @@
+#include "allred_validate.hpp"
+#include "allred_bf16.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ALLRED_VALIDATE_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ALLRED_VALIDATE_NEON 1
+#endif
+
+namespace {
+
+// Largest difference and number of mismatching elements in a run of packed words
+struct TileStats {
+    float max_diff;
+    uint32_t mismatches;
+};
+
+using TileStatsFn = TileStats (*)(const uint32_t*, const uint32_t*, const uint32_t*, size_t, float, float);
+
+inline float element_diff(uint16_t result, uint16_t a, uint16_t b, float scale) {
+    return std::fabs(bf16_to_float(result) - expected_allreduce_value(a, b, scale));
+}
+
+// NaN differences count as mismatches, and are ignored for the max error
+inline void accumulate(TileStats& stats, float diff, float error) {
+    stats.mismatches += !(diff <= error);
+    stats.max_diff = diff > stats.max_diff ? diff : stats.max_diff;
+}
+
+TileStats tile_stats_scalar(
+    const uint32_t* result, const uint32_t* src_0, const uint32_t* src_1, size_t num_words, float error, float scale) {
+    TileStats stats{0.0f, 0};
+    for (size_t i = 0; i < num_words; i++) {
+        accumulate(stats, element_diff(result[i] & 0xffff, src_0[i] & 0xffff, src_1[i] & 0xffff, scale), error);
+        accumulate(stats, element_diff(result[i] >> 16, src_0[i] >> 16, src_1[i] >> 16, scale), error);
+    }
+    return stats;
+}
+
+#ifdef ALLRED_VALIDATE_AVX2
+// |result - trunc_bf16((a + b) * scale)| for 8 elements already expanded to float
+__attribute__((target("avx2"))) inline __m256 diff_avx2(__m256 result, __m256 a, __m256 b, __m256 scale) {
+    const __m256 hi_mask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0xffff0000)));
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 expected = _mm256_and_ps(_mm256_mul_ps(_mm256_add_ps(a, b), scale), hi_mask);
+    return _mm256_and_ps(_mm256_sub_ps(result, expected), abs_mask);
+}
+
+__attribute__((target("avx2"))) inline __m256 low_half_avx2(__m256i words) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(words, 16));
+}
+
+__attribute__((target("avx2"))) inline __m256 high_half_avx2(__m256i words) {
+    return _mm256_castsi256_ps(_mm256_and_si256(words, _mm256_set1_epi32(static_cast<int>(0xffff0000))));
+}
+
+__attribute__((target("avx2"))) TileStats tile_stats_avx2(
+    const uint32_t* result, const uint32_t* src_0, const uint32_t* src_1, size_t num_words, float error, float scale) {
+    const __m256 v_scale = _mm256_set1_ps(scale);
+    const __m256 v_error = _mm256_set1_ps(error);
+    __m256 v_max = _mm256_setzero_ps();
+    uint32_t mismatches = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= num_words; i += 8) {
+        __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(result + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src_0 + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src_1 + i));
+        __m256 diff_lo = diff_avx2(low_half_avx2(r), low_half_avx2(a), low_half_avx2(b), v_scale);
+        __m256 diff_hi = diff_avx2(high_half_avx2(r), high_half_avx2(a), high_half_avx2(b), v_scale);
+
+        // Not-less-or-equal (unordered) so that NaN differences are mismatches
+        mismatches += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(diff_lo, v_error, _CMP_NLE_UQ)));
+        mismatches += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(diff_hi, v_error, _CMP_NLE_UQ)));
+        // maxps returns the second operand if either is NaN, which keeps NaN out of the max
+        v_max = _mm256_max_ps(diff_lo, v_max);
+        v_max = _mm256_max_ps(diff_hi, v_max);
+    }
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, v_max);
+    TileStats stats{*std::max_element(lanes, lanes + 8), mismatches};
+    TileStats tail = tile_stats_scalar(result + i, src_0 + i, src_1 + i, num_words - i, error, scale);
+    stats.mismatches += tail.mismatches;
+    stats.max_diff = std::max(stats.max_diff, tail.max_diff);
+    return stats;
+}
+#endif
+
+#ifdef ALLRED_VALIDATE_NEON
+inline float32x4_t diff_neon(float32x4_t result, float32x4_t a, float32x4_t b, float32x4_t scale) {
+    uint32x4_t expected = vandq_u32(vreinterpretq_u32_f32(vmulq_f32(vaddq_f32(a, b), scale)), vdupq_n_u32(0xffff0000));
+    return vabsq_f32(vsubq_f32(result, vreinterpretq_f32_u32(expected)));
+}
+
+inline float32x4_t low_half_neon(uint32x4_t words) { return vreinterpretq_f32_u32(vshlq_n_u32(words, 16)); }
+
+inline float32x4_t high_half_neon(uint32x4_t words) {
+    return vreinterpretq_f32_u32(vandq_u32(words, vdupq_n_u32(0xffff0000)));
+}
+
+TileStats tile_stats_neon(
+    const uint32_t* result, const uint32_t* src_0, const uint32_t* src_1, size_t num_words, float error, float scale) {
+    const float32x4_t v_scale = vdupq_n_f32(scale);
+    const float32x4_t v_error = vdupq_n_f32(error);
+    float32x4_t v_max = vdupq_n_f32(0.0f);
+    uint32x4_t v_mismatches = vdupq_n_u32(0);
+
+    size_t i = 0;
+    for (; i + 4 <= num_words; i += 4) {
+        uint32x4_t r = vld1q_u32(result + i);
+        uint32x4_t a = vld1q_u32(src_0 + i);
+        uint32x4_t b = vld1q_u32(src_1 + i);
+        float32x4_t diff_lo = diff_neon(low_half_neon(r), low_half_neon(a), low_half_neon(b), v_scale);
+        float32x4_t diff_hi = diff_neon(high_half_neon(r), high_half_neon(a), high_half_neon(b), v_scale);
+
+        // Lanes that are not <= error (including NaN) are all ones, shifted down to 1
+        v_mismatches = vaddq_u32(v_mismatches, vshrq_n_u32(vmvnq_u32(vcleq_f32(diff_lo, v_error)), 31));
+        v_mismatches = vaddq_u32(v_mismatches, vshrq_n_u32(vmvnq_u32(vcleq_f32(diff_hi, v_error)), 31));
+        // maxnm ignores NaN operands
+        v_max = vmaxnmq_f32(v_max, diff_lo);
+        v_max = vmaxnmq_f32(v_max, diff_hi);
+    }
+
+    TileStats stats{vmaxnmvq_f32(v_max), vaddvq_u32(v_mismatches)};
+    TileStats tail = tile_stats_scalar(result + i, src_0 + i, src_1 + i, num_words - i, error, scale);
+    stats.mismatches += tail.mismatches;
+    stats.max_diff = std::max(stats.max_diff, tail.max_diff);
+    return stats;
+}
+#endif
+
+struct TileStatsImpl {
+    TileStatsFn fn;
+    const char* name;
+};
+
+const TileStatsImpl& tile_stats_impl() {
+    static const TileStatsImpl impl = [] {
+#ifdef ALLRED_VALIDATE_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return TileStatsImpl{tile_stats_avx2, "avx2"};
+        }
+#endif
+#ifdef ALLRED_VALIDATE_NEON
+        return TileStatsImpl{tile_stats_neon, "neon"};
+#endif
+        return TileStatsImpl{tile_stats_scalar, "scalar"};
+    }();
+    return impl;
+}
+
+// Element index of the first element in the run of words at start for which pred(diff) holds
+template <typename Pred>
+size_t find_element(
+    const uint32_t* result, const uint32_t* src_0, const uint32_t* src_1, size_t start, size_t num_words, float scale,
+    Pred pred) {
+    for (size_t i = start; i < start + num_words; i++) {
+        if (pred(element_diff(result[i] & 0xffff, src_0[i] & 0xffff, src_1[i] & 0xffff, scale))) {
+            return 2 * i;
+        }
+        if (pred(element_diff(result[i] >> 16, src_0[i] >> 16, src_1[i] >> 16, scale))) {
+            return 2 * i + 1;
+        }
+    }
+    return 2 * start;
+}
+
+}  // namespace
+
+float expected_allreduce_value(uint16_t a, uint16_t b, float scale) {
+    float sum = (bf16_to_float(a) + bf16_to_float(b)) * scale;
+    uint32_t bits;
+    std::memcpy(&bits, &sum, sizeof(bits));
+    return bf16_to_float(static_cast<uint16_t>(bits >> 16));
+}
+
+ValidationResult validate_allreduce(
+    const uint32_t* result, const uint32_t* src_0, const uint32_t* src_1, size_t num_words, float error, float scale) {
+    constexpr size_t tile_words = VALIDATE_TILE_ELEMENTS / 2;
+    TileStatsFn tile_stats = tile_stats_impl().fn;
+
+    ValidationResult validation;
+    validation.num_values = 2 * num_words;
+    for (size_t start = 0; start < num_words; start += tile_words) {
+        size_t words = std::min(tile_words, num_words - start);
+        TileStats stats = tile_stats(result + start, src_0 + start, src_1 + start, words, error, scale);
+        validation.num_matches += 2 * words - stats.mismatches;
+
+        // Exact indices are only looked up for the (rare) tiles that need them
+        if (stats.mismatches > 0) {
+            if (validation.mismatch_tiles.empty()) {
+                validation.first_mismatch_index = find_element(
+                    result, src_0, src_1, start, words, scale, [error](float diff) { return !(diff <= error); });
+            }
+            validation.mismatch_tiles.push_back(static_cast<uint32_t>(start / tile_words));
+        }
+        if (stats.max_diff > validation.max_error) {
+            float max_diff = stats.max_diff;
+            validation.max_error = max_diff;
+            validation.max_error_index = find_element(
+                result, src_0, src_1, start, words, scale, [max_diff](float diff) { return diff == max_diff; });
+        }
+    }
+    return validation;
+}
+
+// Golden values are already bfloat16, so (golden + 0) * 1 reproduces them exactly
+ValidationResult validate_against_golden(const uint32_t* result, const uint32_t* golden, size_t num_words, float error) {
+    std::vector<uint32_t> zeros(num_words, 0);
+    return validate_allreduce(result, golden, zeros.data(), num_words, error, 1.0f);
+}
+
+const char* validate_implementation() { return tile_stats_impl().name; }
@@ -0,0 +1,37 @@
+#pragma once
+
+// Host-side validation of allreduce results, working directly on the packed uint32 buffers.
+// Nothing in here depends on tt-metal.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Number of bfloat16 values in one 32x32 tile
+constexpr size_t VALIDATE_TILE_ELEMENTS = 1024;
+
+struct ValidationResult {
+    size_t num_values = 0;
+    size_t num_matches = 0;
+    float max_error = 0.0f;
+    size_t max_error_index = 0;        // Element (not word) index of the largest error
+    size_t first_mismatch_index = 0;   // Only meaningful if there is a mismatch
+    std::vector<uint32_t> mismatch_tiles;  // Tiles containing at least one mismatch, in order
+
+    bool all_match() const { return num_matches == num_values; }
+};
+
+// Expected result of the allreduce for one element: (a + b) * scale, truncated to bfloat16 the same
+// way as the host bfloat16 conversion. a and b are the raw bfloat16 bits
+float expected_allreduce_value(uint16_t a, uint16_t b, float scale);
+
+// Compares num_words packed words of result against (src_0 + src_1) * scale. An element matches if the
+// absolute difference is at most error. Uses AVX2 or NEON when available
+ValidationResult validate_allreduce(
+    const uint32_t* result, const uint32_t* src_0, const uint32_t* src_1, size_t num_words, float error, float scale);
+
+// Compares num_words packed words of result against a golden result, e.g. from AllredReference
+ValidationResult validate_against_golden(const uint32_t* result, const uint32_t* golden, size_t num_words, float error);
+
+// Name of the implementation picked by validate_allreduce ("avx2", "neon" or "scalar")
+const char* validate_implementation();
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "allred_interleave.hpp"
+#include "allred_options.hpp"
+#include "allred_schedule.hpp"
+
+// Explores interleavings of the semaphore and CB synchronization of the allreduce kernels, with a scheduler
+// that is fully determined by its seed, and reports deadlocks, lost wakeups, CB overruns and data hazards.
+// Takes the same args as allred_BO_2D (args 2, 4, 6 and 7 are ignored). Needs neither a device nor tt-metal.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: is swing version? 0 1 (0 = recdub)
+    Arg 3: Size of node array 1,2,4,8
+    arg 5: Number of tiles, see allred_BO_2D
+    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)
+    Arg 9, 10: Width and height of the grid (powers of 2, override arg 3)
+    --variant=allred_mem_2D: model the shared memory kernels instead of the BO/LO ones
+    --runs=N: warmup + iterations runs of the allreduce in the model, 2 by default
+    --no-step-sync: leave out the sync_NOC at the start of every step, to check whether it is needed
+    --num-syncs=N: syncs per step of the BO send loop, the host programs' default (model_num_syncs) otherwise
+    --schedules=N: random schedules to run, 1000 by default
+    --seed=S: seed of the first schedule, schedule n uses S + n
+    --strategy=random|pct: uniformly random thread at every op, or PCT (the default) with --depth=D, 3 by default
+    --replay=S: run the single schedule S and print its issues
+    --exhaustive: explore every interleaving instead, up to --max-states=N distinct states (1000000)*/
+    bool SWING_VERSION = (argc >= 2) && std::stoi(argv[1]) == 1;
+    int SIDE_LENGTH = (argc >= 4) ? highest_power_of_two(std::stoi(argv[3])) : 1;
+    bool BANDWIDTH_OPTIMAL = (argc >= 9) ? (bool) std::stoi(argv[8]) : false;
+    int GRID_WIDTH = (argc >= 10) ? highest_power_of_two(std::stoi(argv[9]), 1 << 16) : SIDE_LENGTH;
+    int GRID_HEIGHT = (argc >= 11) ? highest_power_of_two(std::stoi(argv[10]), 1 << 16) : GRID_WIDTH;
+    bool MEM = options.GetString("variant", "") == "allred_mem_2D";
+
+    uint32_t TOTAL_NODES = GRID_WIDTH * GRID_HEIGHT;
+    int NUM_TILES = normalize_num_tiles((argc >= 6) ? std::stoi(argv[5]) : 1, MEM || BANDWIDTH_OPTIMAL, TOTAL_NODES);
+    if (TOTAL_NODES < 2) {
+        printf("Nothing to explore on a single core\n");
+        return 0;
+    }
+
+    ProtocolOptions protocol_options;
+    protocol_options.runs = std::max(1, options.GetInt("runs", 2));
+    protocol_options.step_sync = !options.Has("no-step-sync");
+    protocol_options.num_syncs = std::max(0, options.GetInt("num-syncs", 0));
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, GRID_WIDTH, GRID_HEIGHT);
+    ProtocolModel model = MEM ? build_mem_protocol(plan, NUM_TILES, protocol_options)
+                              : build_BO_protocol(plan, BANDWIDTH_OPTIMAL, NUM_TILES, protocol_options);
+    InterleavingExplorer explorer(model);
+
+    std::string strategy_name = options.GetString("strategy", "pct");
+    ScheduleStrategy strategy = strategy_name == "random" ? ScheduleStrategy::Random : ScheduleStrategy::PCT;
+    uint32_t DEPTH = std::max(1, options.GetInt("depth", 3));
+    printf(
+        "Exploring %s on %dx%d cores, %d tiles, %s, %u runs%s: %zu threads, %zu ops\n",
+        MEM ? "allred_mem_2D" : BANDWIDTH_OPTIMAL ? "allred_BO_2D" : "allred_LO_2D",
+        GRID_WIDTH,
+        GRID_HEIGHT,
+        NUM_TILES,
+        SWING_VERSION ? "swing" : "recdub",
+        protocol_options.runs,
+        protocol_options.step_sync ? "" : " without step syncs",
+        model.threads.size(),
+        model.NumOps());
+
+    auto start = std::chrono::steady_clock::now();
+    ExploreResult result;
+    if (options.Has("exhaustive")) {
+        result = explorer.ExploreExhaustive(std::max(1, options.GetInt("max-states", 1000000)));
+    } else if (options.Has("replay")) {
+        explorer.RunSchedule(options.GetInt("replay", 0), strategy, DEPTH, result);
+    } else {
+        result = explorer.ExploreRandom(
+            options.GetInt("seed", 1), std::max(1, options.GetInt("schedules", 1000)), strategy, DEPTH, false);
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (options.Has("exhaustive")) {
+        printf(
+            "%s %lu states, %lu paths ended, in %.1f ms\n",
+            result.complete ? "Explored all" : "Stopped at the state limit after",
+            (unsigned long)result.states,
+            (unsigned long)result.schedules,
+            elapsed_ms);
+    } else {
+        printf(
+            "Ran %lu %s schedules in %.1f ms\n",
+            (unsigned long)result.schedules,
+            strategy == ScheduleStrategy::Random ? "random" : "PCT",
+            elapsed_ms);
+    }
+
+    for (const ProtocolIssue& issue : result.issues) {
+        printf("%s: %s\n", issue.kind.c_str(), issue.description.c_str());
+        for (size_t i = 1; i < issue.blocked.size() && i < 8; i++) {
+            printf("  %s\n", issue.blocked[i].c_str());
+        }
+        if (issue.blocked.size() > 8) {
+            printf("  ... and %zu more\n", issue.blocked.size() - 8);
+        }
+        if (!options.Has("exhaustive")) {
+            printf("  after %lu ops, replay with --replay=%lu\n", (unsigned long)issue.step, (unsigned long)issue.seed);
+        }
+    }
+    if (result.issues.empty()) {
+        printf("No issues found\n");
+    }
+    return result.issues.empty() ? 0 : 1;
+}
@@ -31,21 +31,25 @@ void MAIN {
         block_indexes[i] = (high_bits << 32) | low_bits;
     }
 
-    cb_wait_front(cb_id_local, num_tiles);
+    // Warmup and timed runs of the allreduce, see the dataflow kernel
+    constexpr uint32_t iterations = get_compile_time_arg_val(0);
+    constexpr uint32_t warmup = get_compile_time_arg_val(1);
 
     binary_op_init_common(cb_id_local, cb_id_recv, cb_id_local);
     add_tiles_init(cb_id_local, cb_id_recv, cb_id_local);
 
-    cb_pop_front(cb_id_local, num_tiles);
-    cb_reserve_back(cb_id_local, num_tiles);
     bool SE, recv_block;
     uint32_t offset = this_core_i * num_tiles_per_node;
-    for (uint32_t j = 0; j < 1; j++) {
+    for (uint32_t j = 0; j < warmup + iterations; j++) {
+        // Wait for SE to hand over the local vector of this run
+        cb_wait_front(cb_id_local, num_tiles);
+        cb_pop_front(cb_id_local, num_tiles);
+        cb_reserve_back(cb_id_local, num_tiles);
         tile_regs_acquire();
         tile_regs_wait();
         copy_tile_to_dst_init_short(cb_id_local);
         for (uint32_t n_tile = 0; n_tile < num_tiles_per_node; n_tile++) {
-            copy_tile(cb_id_local, n_tile, n_tile);
+            copy_tile(cb_id_local, offset + n_tile, n_tile);  // This core's block of the local vector
         }
 
         binary_dest_reuse_tiles_init<EltwiseBinaryType::ELWADD, EltwiseBinaryReuseDestType::DEST_TO_SRCB>(cb_id_recv);
@@ -63,10 +67,11 @@ void MAIN {
         tile_regs_commit();
 
         for (uint32_t n_tile = 0; n_tile < num_tiles_per_node; n_tile++) {
-            pack_tile(n_tile, cb_id_local, n_tile);
+            pack_tile<true>(n_tile, cb_id_local, n_tile);  // Explicit index, local is never pushed between runs
         }
         tile_regs_release();
-        cb_push_back(cb_id_local, num_tiles);
+        // The packed tiles are not pushed: nothing consumes them, and a full cb_id_local would let the
+        // next run's cb_wait_front through before SE has handed over its local vector
         cb_push_back(cb_id_SE, 1);
         cb_push_back(cb_id_NW, 1);
     }
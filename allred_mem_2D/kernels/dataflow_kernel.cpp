@@ -6,17 +6,22 @@
 #include "dataflow_api.h"
 #include "debug/dprint.h"
 #include "third_party/tracy/public/tracy/Tracy.hpp"
+#include "../../allred_BO_2D/kernels/kernel_stats.h"
 
 void sync_nodes(
+    uint32_t,
+    uint32_t,
     uint32_t,
     bool,
     uint32_t,
     uint32_t*,
     volatile tt_l1_ptr uint32_t**,
+    uint32_t*,
     volatile tt_l1_ptr uint32_t**,
     uint32_t*,
     uint32_t*,
-    uint32_t*);
+    uint32_t*,
+    KernelStats&);
 void kernel_main() {
     uint32_t src0_addr = get_arg_val<uint32_t>(0);
     uint32_t dst0_addr = get_arg_val<uint32_t>(1);
@@ -112,81 +117,126 @@ void kernel_main() {
         semaphore_1_ptr[i] = reinterpret_cast<volatile tt_l1_ptr uint32_t*>(semaphore_1[i]);
     }
 
-    // read ublocks from src to local
-    if (!this_core_SE) {
-        cb_reserve_back(cb_id_local, num_tiles);
-        noc_async_read(src0_noc_addr, l1_write_addr_local, total_vector_size);
-        noc_async_read_barrier();
-    }
+    // --stats: the stats DRAM buffer. Slot i counts step i of the node syncs, slot algo_steps the exchange through
+    // the common buffer and slot algo_steps + 1 the write and read back of the result
+    uint32_t stats_addr = get_arg_val<uint32_t>(25 + 4 * algo_steps);
+    uint32_t stats_bank_id = get_arg_val<uint32_t>(26 + 4 * algo_steps);
+    KernelStats stats;
+    stats.Init(2 * algo_steps, this_core_SE);
 
-    sync_nodes(
-        algo_steps,
-        this_core_SE,
-        num_sem_0,
-        semaphore_0,
-        semaphore_0_ptr,
-        semaphore_1_ptr,
-        dst_core_x,
-        dst_core_y,
-        &num_syncs);
-
-    for (uint32_t j = 0; j < 1; j++) {
-        DeviceZoneScopedN("ALL_RED_LOOP");
-        {
-            uint32_t write_offset = total_vector_size * this_core_i;
-            uint64_t common_noc_addr = get_noc_addr_from_bank_id<true>(common_bank_id, common_addr + write_offset);
-            if (!this_core_SE) {
-                noc_async_write(l1_write_addr_local, common_noc_addr, total_vector_size);
-                noc_async_write_barrier();
-            }
+    // Number of timed runs of the allreduce, preceded by untimed warmup runs
+    constexpr uint32_t iterations = get_compile_time_arg_val(0);
+    constexpr uint32_t warmup = get_compile_time_arg_val(1);
 
-            sync_nodes(
-                algo_steps,
-                this_core_SE,
-                num_sem_0,
-                semaphore_0,
-                semaphore_0_ptr,
-                semaphore_1_ptr,
-                dst_core_x,
-                dst_core_y,
-                &num_syncs);
-            if (this_core_SE) {
-                cb_push_back(cb_id_local, num_tiles);
-                for (uint32_t i = 0; i < total_nodes; i++) {
-                    uint32_t read_offset =
-                        i * total_vector_size + this_core_i * tile_block_size;  // i * tile_block_size;
-                    common_noc_addr = get_noc_addr_from_bank_id<true>(common_bank_id, common_addr + read_offset);
-                    noc_async_read(common_noc_addr, l1_write_addr_recv + i * tile_block_size, tile_block_size);
-                    noc_async_read_barrier();
-                    cb_push_back(cb_id_recv, num_tiles_per_node);
-                }
-            }
-            // DPRINT << "NOC after  [first]: " << recv_array[this_core_i * num_els_per_node + el_start]
-            //        << " and sum [last]" << recv_array[this_core_i * num_els_per_node + el_end - 1] << ENDL();
-            cb_wait_front(cb_id_this, 1);
-            cb_pop_front(cb_id_this, 1);
-            
-            uint32_t offset = tile_block_size * this_core_i;
-            uint64_t dst0_noc_addr = get_noc_addr_from_bank_id<true>(dst0_bank_id, dst0_addr + offset);
-            if (!this_core_SE) {
-                noc_async_write(l1_write_addr_local, dst0_noc_addr, tile_block_size);
-                noc_async_write_barrier();
-            }
-            sync_nodes(
-                algo_steps,
-                this_core_SE,
-                num_sem_0,
-                semaphore_0,
-                semaphore_0_ptr,
-                semaphore_1_ptr,
-                dst_core_x,
-                dst_core_y,
-                &num_syncs);
-            if (this_core_SE) {
-                noc_async_read(dst0_noc_addr, l1_write_addr_local, total_vector_size);
+    auto allreduce = [&]() {
+        uint32_t write_offset = total_vector_size * this_core_i;
+        uint64_t common_noc_addr = get_noc_addr_from_bank_id<true>(common_bank_id, common_addr + write_offset);
+        stats.Begin(algo_steps);
+        if (!this_core_SE) {
+            noc_async_write(l1_write_addr_local, common_noc_addr, total_vector_size);
+            stats.Write(total_vector_size);
+            noc_async_write_barrier();
+        }
+        stats.End();
+
+        sync_nodes(
+            algo_steps,
+            this_core_x,
+            this_core_y,
+            this_core_SE,
+            num_sem_0,
+            semaphore_0,
+            semaphore_0_ptr,
+            semaphore_1,
+            semaphore_1_ptr,
+            dst_core_x,
+            dst_core_y,
+            &num_syncs,
+            stats);
+        stats.Begin(algo_steps);
+        if (this_core_SE) {
+            cb_push_back(cb_id_local, num_tiles);
+            for (uint32_t i = 0; i < total_nodes; i++) {
+                uint32_t read_offset =
+                    i * total_vector_size + this_core_i * tile_block_size;  // i * tile_block_size;
+                common_noc_addr = get_noc_addr_from_bank_id<true>(common_bank_id, common_addr + read_offset);
+                noc_async_read(common_noc_addr, l1_write_addr_recv + i * tile_block_size, tile_block_size);
                 noc_async_read_barrier();
+                cb_push_back(cb_id_recv, num_tiles_per_node);
             }
         }
+        // DPRINT << "NOC after  [first]: " << recv_array[this_core_i * num_els_per_node + el_start]
+        //        << " and sum [last]" << recv_array[this_core_i * num_els_per_node + el_end - 1] << ENDL();
+        // Compute is done with the block
+        stats.CBWait([&] { cb_wait_front(cb_id_this, 1); });
+        cb_pop_front(cb_id_this, 1);
+        stats.End();
+
+        uint32_t offset = tile_block_size * this_core_i;
+        uint64_t dst0_noc_addr = get_noc_addr_from_bank_id<true>(dst0_bank_id, dst0_addr + offset);
+        stats.Begin(algo_steps + 1);
+        if (!this_core_SE) {
+            noc_async_write(l1_write_addr_local, dst0_noc_addr, tile_block_size);
+            stats.Write(tile_block_size);
+            noc_async_write_barrier();
+        }
+        stats.End();
+        sync_nodes(
+            algo_steps,
+            this_core_x,
+            this_core_y,
+            this_core_SE,
+            num_sem_0,
+            semaphore_0,
+            semaphore_0_ptr,
+            semaphore_1,
+            semaphore_1_ptr,
+            dst_core_x,
+            dst_core_y,
+            &num_syncs,
+            stats);
+        stats.Begin(algo_steps + 1);
+        if (this_core_SE) {
+            noc_async_read(dst0_noc_addr, l1_write_addr_local, total_vector_size);
+            noc_async_read_barrier();
+        }
+        stats.End();
+    };
+
+    for (uint32_t j = 0; j < warmup + iterations; j++) {
+        stats.Run(j + 1 > warmup);
+        // read ublocks from src to local. After the first run SE reads them, as it is the core that
+        // read the previous result into local
+        if (j == 0 && !this_core_SE) {
+            cb_reserve_back(cb_id_local, num_tiles);
+            noc_async_read(src0_noc_addr, l1_write_addr_local, total_vector_size);
+            noc_async_read_barrier();
+        } else if (j > 0 && this_core_SE) {
+            noc_async_read(src0_noc_addr, l1_write_addr_local, total_vector_size);
+            noc_async_read_barrier();
+        }
+
+        sync_nodes(
+            algo_steps,
+            this_core_x,
+            this_core_y,
+            this_core_SE,
+            num_sem_0,
+            semaphore_0,
+            semaphore_0_ptr,
+            semaphore_1,
+            semaphore_1_ptr,
+            dst_core_x,
+            dst_core_y,
+            &num_syncs,
+            stats);
+
+        if (j >= warmup) {
+            DeviceZoneScopedN("ALL_RED_LOOP");
+            allreduce();
+        } else {
+            allreduce();
+        }
     }
     uint32_t num_els = ublock_size_bytes_data * num_tiles / sizeof(uint32_t);
 
@@ -196,35 +246,38 @@ void kernel_main() {
         noc_async_write(l1_write_addr_local, dst0_noc_addr, tile_block_size);
         noc_async_write_barrier();
     }
+    stats.Flush(stats_addr, stats_bank_id, this_core_i, this_core_SE);
 }
 
 void sync_nodes(
     uint32_t algo_steps,
+    uint32_t this_core_x,
+    uint32_t this_core_y,
     bool this_core_SE,
     uint32_t num_sem_0,
     uint32_t* semaphore_0,
     volatile tt_l1_ptr uint32_t** semaphore_0_ptr,
+    uint32_t* semaphore_1,
     volatile tt_l1_ptr uint32_t** semaphore_1_ptr,
     uint32_t* dst_core_x,
     uint32_t* dst_core_y,
-    uint32_t* num_syncs) {
+    uint32_t* num_syncs,
+    KernelStats& stats) {
     if (!this_core_SE) {
         // NW core to sync with all other NW cores via swing algo
         for (uint32_t i = 0; i < algo_steps; i++) {
             // DPRINT << " step " << i << ENDL();
+            stats.Begin(i);
             uint64_t dst_noc_semaphore_0 = get_noc_addr(dst_core_x[i], dst_core_y[i], semaphore_0[i % num_sem_0]);
             noc_semaphore_inc(dst_noc_semaphore_0, 1);
-            noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], *num_syncs);
+            stats.SemaphoreWait([&] { noc_semaphore_wait_min(semaphore_0_ptr[i % num_sem_0], *num_syncs); });
+            stats.End();
         }
-        // NW core syncs with SE core
-        noc_semaphore_set(semaphore_1_ptr[0], 1);
-        noc_semaphore_wait(semaphore_1_ptr[1], 1);
-        noc_semaphore_set(semaphore_1_ptr[1], 0);
-        (*num_syncs)++;
-    } else {
-        // SE core syncs with NW core
-        noc_semaphore_set(semaphore_1_ptr[1], 1);
-        noc_semaphore_wait(semaphore_1_ptr[0], 1);
-        noc_semaphore_set(semaphore_1_ptr[0], 0);
     }
+    // NW and SE cores sync with each other. Each counts up its own semaphore_1 (0 for NW, 1 for SE) at every
+    // call, and both RISCs count the calls in num_syncs, so a signal of the next sync can't be lost to a reset
+    uint64_t this_noc_semaphore_1 = get_noc_addr(this_core_x, this_core_y, semaphore_1[this_core_SE]);
+    noc_semaphore_inc(this_noc_semaphore_1, 1);
+    noc_semaphore_wait_min(semaphore_1_ptr[!this_core_SE], *num_syncs);
+    (*num_syncs)++;
 }
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include "allred_noc.hpp"
+#include "allred_placement.hpp"
+#include "allred_options.hpp"
+#include "allred_schedule.hpp"
+
+// Routes the transfers of every allreduce step over the NoCs of the chip and reports the link loads and the
+// step times predicted by an alpha-beta model. Takes the same args as allred_emulator (args 2, 4, 6 and 7 are
+// ignored), so the algorithms and NoC direction patterns can be compared without a device.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: is swing version? 0 1 (0 = recdub)
+    Arg 3: Size of node array 1,2,4,8
+    arg 5: Number of tiles, see allred_BO_2D
+    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)
+    Arg 9, 10: Width and height of the grid (powers of 2, override arg 3)
+    --directions=plan|swapped|noc0|noc1|shortest: NoC of the sender of every step, plan (as the kernels run) by default
+    --compare: print the total time of both algorithms with every direction pattern instead
+    --links=N: print the N most loaded links of every step, 1 by default
+    --csv=PATH: write the bytes and transfers of every loaded link of every step
+    --placement=PATH: place the ranks as in a table of allred_placement instead of row major
+    --alpha-ns, --hop-ns, --link-gbps: parameters of the cost model, see NocCostParams
+    --num-syncs=N: syncs per step of the send loops, the host programs' default (model_num_syncs) otherwise*/
+    bool SWING_VERSION = (argc >= 2) && std::stoi(argv[1]) == 1;
+    int SIDE_LENGTH = (argc >= 4) ? highest_power_of_two(std::stoi(argv[3])) : 1;
+    bool BANDWIDTH_OPTIMAL = (argc >= 9) ? (bool) std::stoi(argv[8]) : false;
+    int GRID_WIDTH = (argc >= 10) ? highest_power_of_two(std::stoi(argv[9]), 1 << 16) : SIDE_LENGTH;
+    int GRID_HEIGHT = (argc >= 11) ? highest_power_of_two(std::stoi(argv[10]), 1 << 16) : GRID_WIDTH;
+    bool on_chip_grid = GRID_WIDTH <= 8 && GRID_HEIGHT <= 8;
+
+    uint32_t TOTAL_NODES = GRID_WIDTH * GRID_HEIGHT;
+    int NUM_TILES = normalize_num_tiles((argc >= 6) ? std::stoi(argv[5]) : 1, BANDWIDTH_OPTIMAL, TOTAL_NODES);
+    if (TOTAL_NODES < 2) {
+        printf("Nothing to route on a single core\n");
+        return 0;
+    }
+
+    NocCostParams params;
+    params.alpha_ns = std::stod(options.GetString("alpha-ns", std::to_string(params.alpha_ns)));
+    params.hop_ns = std::stod(options.GetString("hop-ns", std::to_string(params.hop_ns)));
+    params.bytes_per_ns = std::stod(options.GetString("link-gbps", std::to_string(params.bytes_per_ns)));
+    uint32_t NUM_SYNCS = std::max(0, options.GetInt("num-syncs", 0));
+
+    // Virtual grids that don't fit on the chip are routed on a torus of their own size
+    NocTopology topology = on_chip_grid ? NocTopology() : NocTopology(GRID_WIDTH, GRID_HEIGHT);
+    Placement placement = row_major_placement(GRID_WIDTH, GRID_HEIGHT);
+    if (options.Has("placement")) {
+        std::string placement_path = options.GetString("placement", ""), error;
+        std::ifstream table(placement_path);
+        if (!table) {
+            printf("Could not open %s\n", placement_path.c_str());
+            return 1;
+        }
+        if (!read_placement(table, GRID_WIDTH, GRID_HEIGHT, placement, error)) {
+            printf("%s: %s\n", placement_path.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    PhysicalCoreFn physical_core = [&](int core_i) {
+        return on_chip_grid ? wormhole_worker_core(placement[core_i].first, placement[core_i].second)
+                            : placement[core_i];
+    };
+
+    const std::vector<NocDirections>& all_directions = all_noc_directions();
+    if (options.Has("compare")) {
+        printf(
+            "%dx%d cores, %d tiles, %s, total predicted time [us]\n",
+            GRID_WIDTH,
+            GRID_HEIGHT,
+            NUM_TILES,
+            BANDWIDTH_OPTIMAL ? "bandwidth optimal" : "latency optimal");
+        printf("%-8s", "algo");
+        for (NocDirections directions : all_directions) {
+            printf(" %10s", noc_directions_name(directions));
+        }
+        printf("\n");
+        for (int swing_version = 0; swing_version < 2; swing_version++) {
+            const SchedulePlan& plan = SchedulePlanner::Get(swing_version, GRID_WIDTH, GRID_HEIGHT);
+            printf("%-8s", swing_version ? "swing" : "recdub");
+            for (NocDirections directions : all_directions) {
+                NocSimResult result = simulate_noc(
+                    plan, physical_core, topology, BANDWIDTH_OPTIMAL, NUM_TILES, directions, params, NUM_SYNCS);
+                printf(" %10.2f", result.total_ns / 1000.0);
+            }
+            printf("\n");
+        }
+        return 0;
+    }
+
+    std::string directions_option = options.GetString("directions", "plan");
+    auto directions_it = std::find_if(all_directions.begin(), all_directions.end(), [&](NocDirections directions) {
+        return directions_option == noc_directions_name(directions);
+    });
+    if (directions_it == all_directions.end()) {
+        printf("Unknown --directions=%s\n", directions_option.c_str());
+        return 1;
+    }
+    uint32_t LINKS = std::max(1, options.GetInt("links", 1));
+
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, GRID_WIDTH, GRID_HEIGHT);
+    NocSimResult result =
+        simulate_noc(plan, physical_core, topology, BANDWIDTH_OPTIMAL, NUM_TILES, *directions_it, params, NUM_SYNCS);
+    printf(
+        "Routing %s on %dx%d cores, %d tiles, %s, %s NoC directions\n",
+        BANDWIDTH_OPTIMAL ? "allred_BO_2D" : "allred_LO_2D",
+        GRID_WIDTH,
+        GRID_HEIGHT,
+        NUM_TILES,
+        SWING_VERSION ? "swing" : "recdub",
+        noc_directions_name(*directions_it));
+
+    std::ofstream csv;
+    if (options.Has("csv")) {
+        csv.open(options.GetString("csv", ""));
+        csv << "step,link,bytes,transfers\n";
+    }
+    for (const NocStepLoad& load : result.steps) {
+        printf(
+            "%-16s %8.2f us: max link %s %lu bytes by %u transfers, %.2f link bytes per byte sent, max %u hops, "
+            "max %u writes\n",
+            load.name.c_str(),
+            load.time_ns / 1000.0,
+            topology.LinkName(load.max_link).c_str(),
+            (unsigned long)load.max_link_bytes,
+            load.link_flows[load.max_link],
+            load.total_bytes ? (double)load.link_bytes_total / load.total_bytes : 0.0,
+            load.max_hops,
+            load.max_writes);
+
+        std::vector<uint32_t> links(load.link_bytes.size());
+        std::iota(links.begin(), links.end(), 0);
+        std::stable_sort(links.begin(), links.end(), [&](uint32_t a, uint32_t b) {
+            return load.link_bytes[a] > load.link_bytes[b];
+        });
+        for (uint32_t n = 1; n < LINKS && n < links.size() && load.link_bytes[links[n]] > 0; n++) {
+            printf(
+                "%-16s             %s %lu bytes by %u transfers\n",
+                "",
+                topology.LinkName(links[n]).c_str(),
+                (unsigned long)load.link_bytes[links[n]],
+                load.link_flows[links[n]]);
+        }
+        for (uint32_t link = 0; link < load.link_bytes.size() && csv.is_open(); link++) {
+            if (load.link_bytes[link] > 0) {
+                csv << load.name << "," << topology.LinkName(link) << "," << load.link_bytes[link] << ","
+                    << load.link_flows[link] << "\n";
+            }
+        }
+    }
+    printf("Predicted allreduce time %.2f us\n", result.total_ns / 1000.0);
+    return 0;
+}
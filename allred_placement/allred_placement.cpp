@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include "allred_options.hpp"
+#include "allred_placement.hpp"
+#include "allred_schedule.hpp"
+
+namespace {
+
+// Rank on every logical core of the grid, one row per line
+void print_grid(const Placement& placement, int width, int height) {
+    std::vector<uint32_t> ranks(placement.size());
+    for (uint32_t rank = 0; rank < placement.size(); rank++) {
+        ranks[placement[rank].second * width + placement[rank].first] = rank;
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            printf(" %4u", ranks[y * width + x]);
+        }
+        printf("\n");
+    }
+}
+
+}  // namespace
+
+// Searches a placement of the allreduce ranks on the worker cores that lowers the NoC link load predicted by
+// allred_noc, and writes it as a table the drivers read with --placement=PATH. Takes the same args as
+// allred_noc. Needs neither a device nor tt-metal.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: is swing version? 0 1 (0 = recdub)
+    Arg 3: Size of node array 1,2,4,8
+    arg 5: Number of tiles, see allred_BO_2D
+    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)
+    Arg 9, 10: Width and height of the grid (powers of 2, override arg 3)
+    --objective=time|links|hops: minimize the predicted time (default), the bytes on the busiest link or the
+                                 bytes times hops, summed over the steps
+    --directions=plan|swapped|noc0|noc1|shortest: NoC of the sender of every step, see allred_noc
+    --iterations=N: swaps tried by every thread, 20000 by default
+    --threads=N: annealing threads, all hardware threads by default
+    --seed=S: seed of the first thread, thread t uses S + t
+    --out=PATH: write the placement table to PATH
+    --alpha-ns, --hop-ns, --link-gbps: parameters of the cost model, see NocCostParams*/
+    bool SWING_VERSION = (argc >= 2) && std::stoi(argv[1]) == 1;
+    int SIDE_LENGTH = (argc >= 4) ? highest_power_of_two(std::stoi(argv[3])) : 1;
+    bool BANDWIDTH_OPTIMAL = (argc >= 9) ? (bool) std::stoi(argv[8]) : false;
+    int GRID_WIDTH = (argc >= 10) ? highest_power_of_two(std::stoi(argv[9]), 1 << 16) : SIDE_LENGTH;
+    int GRID_HEIGHT = (argc >= 11) ? highest_power_of_two(std::stoi(argv[10]), 1 << 16) : GRID_WIDTH;
+
+    uint32_t TOTAL_NODES = GRID_WIDTH * GRID_HEIGHT;
+    int NUM_TILES = normalize_num_tiles((argc >= 6) ? std::stoi(argv[5]) : 1, BANDWIDTH_OPTIMAL, TOTAL_NODES);
+    if (TOTAL_NODES < 2) {
+        printf("Nothing to place on a single core\n");
+        return 0;
+    }
+
+    PlacementSearchParams params;
+    std::string objective = options.GetString("objective", "time");
+    if (objective != "time" && objective != "links" && objective != "hops") {
+        printf("Unknown --objective=%s\n", objective.c_str());
+        return 1;
+    }
+    params.objective = objective == "hops"    ? PlacementObjective::Hops
+                       : objective == "links" ? PlacementObjective::MaxLink
+                                              : PlacementObjective::Time;
+    std::string directions_option = options.GetString("directions", "plan");
+    const std::vector<NocDirections>& all_directions = all_noc_directions();
+    auto directions_it = std::find_if(all_directions.begin(), all_directions.end(), [&](NocDirections directions) {
+        return directions_option == noc_directions_name(directions);
+    });
+    if (directions_it == all_directions.end()) {
+        printf("Unknown --directions=%s\n", directions_option.c_str());
+        return 1;
+    }
+    params.directions = *directions_it;
+    params.cost.alpha_ns = std::stod(options.GetString("alpha-ns", std::to_string(params.cost.alpha_ns)));
+    params.cost.hop_ns = std::stod(options.GetString("hop-ns", std::to_string(params.cost.hop_ns)));
+    params.cost.bytes_per_ns = std::stod(options.GetString("link-gbps", std::to_string(params.cost.bytes_per_ns)));
+    params.iterations = std::max(1, options.GetInt("iterations", 20000));
+    params.threads = std::max(0, options.GetInt("threads", 0));
+    params.seed = std::max(0, options.GetInt("seed", 1));
+
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, GRID_WIDTH, GRID_HEIGHT);
+    printf(
+        "Placing %s on %dx%d cores, %d tiles, %s, %s NoC directions, minimizing %s\n",
+        BANDWIDTH_OPTIMAL ? "allred_BO_2D" : "allred_LO_2D",
+        GRID_WIDTH,
+        GRID_HEIGHT,
+        NUM_TILES,
+        SWING_VERSION ? "swing" : "recdub",
+        noc_directions_name(params.directions),
+        objective.c_str());
+
+    auto start = std::chrono::steady_clock::now();
+    PlacementSearchResult result = search_placement(plan, BANDWIDTH_OPTIMAL, NUM_TILES, params);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Evaluated %lu placements in %.1f ms\n", (unsigned long)result.evaluations, elapsed_ms);
+
+    // All three metrics of both placements, whatever the objective
+    Placement row_major = row_major_placement(GRID_WIDTH, GRID_HEIGHT);
+    printf("%-10s %14s %16s %14s\n", "placement", "time [us]", "max link bytes", "byte hops");
+    for (const Placement* placement : {&row_major, &result.placement}) {
+        PlacementSearchParams metric = params;
+        double costs[3];
+        for (PlacementObjective objective : {PlacementObjective::Time, PlacementObjective::MaxLink, PlacementObjective::Hops}) {
+            metric.objective = objective;
+            costs[(int)objective] = placement_cost(plan, *placement, BANDWIDTH_OPTIMAL, NUM_TILES, metric);
+        }
+        printf(
+            "%-10s %14.2f %16.0f %14.0f\n",
+            placement == &row_major ? "row major" : "searched",
+            costs[(int)PlacementObjective::Time] / 1000.0,
+            costs[(int)PlacementObjective::MaxLink],
+            costs[(int)PlacementObjective::Hops]);
+    }
+    printf("Rank on every logical core:\n");
+    print_grid(result.placement, GRID_WIDTH, GRID_HEIGHT);
+
+    if (options.Has("out")) {
+        std::string out_path = options.GetString("out", "");
+        std::ofstream table(out_path);
+        if (!table) {
+            printf("Could not open %s\n", out_path.c_str());
+            return 1;
+        }
+        write_placement(
+            table,
+            result.placement,
+            std::string("allred_placement ") + (SWING_VERSION ? "swing " : "recdub ") + std::to_string(GRID_WIDTH) + "x" +
+                std::to_string(GRID_HEIGHT) + ", " + std::to_string(NUM_TILES) + " tiles, " +
+                (BANDWIDTH_OPTIMAL ? "bandwidth optimal" : "latency optimal") + ", " + noc_directions_name(params.directions) +
+                " directions, minimizing " + objective);
+        printf("Wrote %s\n", out_path.c_str());
+    }
+    return 0;
+}
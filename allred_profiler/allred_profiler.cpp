@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "allred_options.hpp"
+#include "allred_profile.hpp"
+
+// Reads the device profiler log in one pass and prints the ALL_RED_LOOP timings, replacing the pandas
+// scripts in the python folder. The "Core (x,y): normalized_start=..." lines are printed in the same format
+// as profiler_results_analyzer_timing_distributions.py, so timing_taker.py can parse either.
+namespace {
+
+void print_stats(const char* name, const TimeStats& stats) {
+    printf(
+        "%s: min %.0f, lower quartile %.0f, mean %.1f, median %.0f, upper quartile %.0f, max %.0f\n",
+        name,
+        stats.min,
+        stats.lower_quartile,
+        stats.mean,
+        stats.median,
+        stats.upper_quartile,
+        stats.max);
+}
+
+void write_json_stats(std::ofstream& json, const TimeStats& stats) {
+    json << "{\"count\": " << stats.count << ", \"min\": " << stats.min << ", \"lower_quartile\": "
+         << stats.lower_quartile << ", \"mean\": " << stats.mean << ", \"median\": " << stats.median
+         << ", \"upper_quartile\": " << stats.upper_quartile << ", \"max\": " << stats.max << "}";
+}
+
+bool write_json(const std::string& path, const std::vector<ProfileRun>& runs) {
+    std::ofstream json(path);
+    if (!json) {
+        return false;
+    }
+    json << "[\n";
+    for (size_t r = 0; r < runs.size(); r++) {
+        const ProfileRun& run = runs[r];
+        json << "  {\"run_id\": " << run.run_id << ", \"iterations\": " << run.num_iterations << ",\n";
+        json << "   \"durations\": ";
+        write_json_stats(json, run.Durations());
+        json << ",\n   \"risc_skew\": {";
+        for (size_t i = 0; i < run.risc_skew.size(); i++) {
+            json << (i ? ", " : "") << "\"" << run.risc_skew[i].risc << "\": {\"start\": ";
+            write_json_stats(json, run.risc_skew[i].start_offset);
+            json << ", \"end\": ";
+            write_json_stats(json, run.risc_skew[i].end_offset);
+            json << "}";
+        }
+        json << "},\n   \"cores\": [";
+        for (size_t c = 0; c < run.cores.size(); c++) {
+            const ProfileCore& core = run.cores[c];
+            json << (c ? ",\n     " : "\n     ") << "{\"x\": " << core.x << ", \"y\": " << core.y << ", \"zones\": [";
+            for (size_t k = 0; k < core.iterations.size(); k++) {
+                json << (k ? ", " : "") << "[" << core.iterations[k].start << ", " << core.iterations[k].end << "]";
+            }
+            json << "]}";
+        }
+        json << "]}" << (r + 1 < runs.size() ? "," : "") << "\n";
+    }
+    json << "]\n";
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: Path of profile_log_device.csv, defaults to the one under $TT_METAL_HOME
+    --zone=NAME: zone to analyze, ALL_RED_LOOP by default
+    --csv=PATH: append the normalized start/end of every core to PATH, in the format of timing_taker.py,
+                with the --mode, --swing, --size and --run values in the first columns
+    --json=PATH: write the statistics and raw zone times to PATH*/
+    std::string log_path = (argc >= 2) ? argv[1] : default_profile_log_path();
+
+    std::ifstream log(log_path);
+    if (!log) {
+        printf("Could not open %s\n", log_path.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ProfileLogReader reader(options.GetString("zone", "ALL_RED_LOOP"));
+    std::string error;
+    if (!reader.Read(log, error)) {
+        printf("%s: %s\n", log_path.c_str(), error.c_str());
+        return 1;
+    }
+    std::vector<ProfileRun> runs = reader.Runs();
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Read %zu lines in %.1f ms\n", reader.LinesRead(), elapsed_ms);
+
+    if (runs.empty()) {
+        printf("No execution data found.\n");
+        return 1;
+    }
+
+    for (const ProfileRun& run : runs) {
+        printf("Run %lu: %zu cores, %u iterations\n", (unsigned long)run.run_id, run.cores.size(), run.num_iterations);
+        for (uint32_t k = 0; k < run.num_iterations && run.num_iterations > 1; k++) {
+            print_stats(("Iteration " + std::to_string(k)).c_str(), run.Durations(k));
+        }
+        print_stats("All iterations", run.Durations());
+        printf("RISC skew, cycles after the first RISC of the core (median/max):\n");
+        for (const RiscSkew& skew : run.risc_skew) {
+            printf(
+                "  %-8s start %.0f/%.0f, end %.0f/%.0f\n",
+                skew.risc.c_str(),
+                skew.start_offset.median,
+                skew.start_offset.max,
+                skew.end_offset.median,
+                skew.end_offset.max);
+        }
+    }
+
+    // Like the python analyzers, the core lines are those of the latest zone of the last run
+    const ProfileRun& last = runs.back();
+    uint64_t earliest = last.EarliestStart(last.num_iterations - 1);
+    for (uint32_t y = 1; y < 10; y++) {
+        for (uint32_t x = 1; x < 10; x++) {
+            const ProfileCore* core = last.Core(x, y);
+            if (core && core->iterations.size() == last.num_iterations) {
+                const ZoneTimes& zone = core->iterations.back();
+                printf(
+                    "Core (%u,%u): normalized_start=%lu, normalized_end=%lu\n",
+                    x,
+                    y,
+                    (unsigned long)(zone.start - earliest),
+                    (unsigned long)(zone.end - earliest));
+            }
+        }
+    }
+
+    bool csv_written = !options.Has("csv") || append_timing_csv(
+        options.GetString("csv", ""),
+        last,
+        options.GetString("mode", ""),
+        options.GetString("swing", ""),
+        options.GetString("size", ""),
+        options.GetInt("run", 0));
+    if (!csv_written) {
+        printf("Could not write %s\n", options.GetString("csv", "").c_str());
+        return 1;
+    }
+    if (options.Has("json") && !write_json(options.GetString("json", ""), runs)) {
+        printf("Could not write %s\n", options.GetString("json", "").c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "allred_bf16.hpp"
+#include "allred_inputs.hpp"
+#include "allred_options.hpp"
+#include "allred_profile.hpp"
+#include "allred_reference.hpp"
+#include "allred_schedule.hpp"
+#include "allred_shim_device.hpp"
+#include "allred_shim_kernels.hpp"
+#include "allred_stats.hpp"
+#include "allred_tuning.hpp"
+#include "allred_validate.hpp"
+
+namespace {
+
+// allred_mem_2D reduces block b on core b, starting from its own block and adding the other cores' in order
+std::vector<uint32_t> mem_device_order_result(const std::vector<const uint32_t*>& inputs, size_t num_words) {
+    size_t block_words = num_words / inputs.size();
+    std::vector<uint32_t> result(num_words);
+    for (size_t block = 0; block < inputs.size(); block++) {
+        for (size_t word = block * block_words; word < (block + 1) * block_words; word++) {
+            uint32_t sum = inputs[block][word];
+            for (size_t core_i = 0; core_i < inputs.size(); core_i++) {
+                sum = core_i == block ? sum : bf16_add_packed(sum, inputs[core_i][word]);
+            }
+            result[word] = sum;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+// Runs the unmodified allreduce kernels on the host, one thread per RISC of every core, and checks the result
+// of every core. Takes the same args as allred_BO_2D (arg 2 is ignored), with per-core inputs. Needs neither
+// a device nor tt-metal, so kernel changes can be functionally tested, and timed against each other, anywhere.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: is swing version? 0 1 (0 = recdub)
+    Arg 2: unused
+    Arg 3: Size of node array 1,2,4,8
+    Arg 4: Random seed of the per-core inputs
+    arg 5: Number of tiles, see allred_BO_2D
+    arg 6: Acceptible calculation error, for the allred_mem_2D result
+    Arg 7: Which core writes its result to DRAM
+    Arg 8: is bandwidth optimal? 0 1 (0 = latency optimal)
+    --variant=allred_mem_2D: run the shared memory kernels instead of the BO/LO ones
+    --chunk-tiles=N: stream the vector in chunks of N tiles, as allred_BO_2D does for vectors larger than L1
+    --num-syncs=N: syncs per step of the BO/LOO send loops, as allred_BO_2D --num-syncs
+    --tuning=PATH: take the allred_LOO_2D crossover from a tuning table, as allred_BO_2D --tuning
+    --launches=N: launch the program N times, 1 by default
+    --timeout=MS: abort a launch in which no wait completes for MS ms (a hang), 5000 by default
+    --profile-log=PATH: write the zones of all launches to PATH, in the format of the device profiler log
+    --dprint: print the kernels' DPRINT output
+    Built with -DALLRED_STATS it also prints the per step stats of every launch, like allred_BO_2D --stats*/
+    bool SWING_VERSION = (argc >= 2) && std::stoi(argv[1]) == 1;
+    int SIDE_LENGTH = (argc >= 4) ? highest_power_of_two(std::stoi(argv[3])) : 1;
+    int RND_SRC = (argc >= 5) ? std::stoi(argv[4]) : 0;
+    int ERROR = (argc >= 7) ? std::stoi(argv[6]) : 1;
+    int PRINT_CORE = (argc >= 8) ? std::stoi(argv[7]) : 0;
+    bool BANDWIDTH_OPTIMAL = (argc >= 9) ? (bool) std::stoi(argv[8]) : false;
+    bool MEM = options.GetString("variant", "") == "allred_mem_2D";
+    int LAUNCHES = std::max(1, options.GetInt("launches", 1));
+
+    uint32_t TOTAL_NODES = SIDE_LENGTH * SIDE_LENGTH;
+    int NUM_TILES = normalize_num_tiles((argc >= 6) ? std::stoi(argv[5]) : 1, MEM || BANDWIDTH_OPTIMAL, TOTAL_NODES);
+    const SchedulePlan& plan = SchedulePlanner::Get(SWING_VERSION, SIDE_LENGTH);
+    ChunkPlan chunks =
+        plan_chunks(plan, !MEM && BANDWIDTH_OPTIMAL, NUM_TILES, std::max(0, options.GetInt("chunk-tiles", 0)));
+    NUM_TILES = chunks.tiles();
+    // The kernels that run, picked as AllredConfig::KernelVariant does
+    uint32_t LOO_CROSSOVER_TILES =
+        options.Has("tuning") ? load_tuning_table(options.GetString("tuning", "")).loo_crossover_tiles : 64;
+    std::string KERNEL = kernel_variant(
+        MEM ? "allred_mem_2D" : BANDWIDTH_OPTIMAL ? "allred_BO_2D" : "allred_LO_2D",
+        chunks.chunk_tiles,
+        chunks.num_chunks,
+        LOO_CROSSOVER_TILES);
+    uint32_t single_tile_size = 2048;
+    size_t num_words = single_tile_size * NUM_TILES / sizeof(uint32_t);
+    size_t chunk_words = num_words / chunks.num_chunks;
+    PRINT_CORE = PRINT_CORE < (int)TOTAL_NODES ? PRINT_CORE : 0;
+    if (TOTAL_NODES < 2) {
+        printf("Nothing to run on a single core\n");
+        return 0;
+    }
+    if (MEM && chunks.streaming()) {
+        printf("allred_mem_2D holds the whole vector in L1, only the BO kernels stream larger vectors\n");
+        return 1;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> physical_cores(TOTAL_NODES);
+    for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+        physical_cores[core_i] = wormhole_worker_core(core_i % SIDE_LENGTH, core_i / SIDE_LENGTH);
+    }
+    PhysicalCoreFn physical_core = [&](int core_i) { return physical_cores[core_i]; };
+
+    allred_shim::Device device(physical_cores);
+    device.dprint_enabled = options.Has("dprint");
+    uint32_t recv_tiles = recv_cb_tiles(plan, KERNEL, chunks.chunk_tiles);
+    uint32_t stats_slots_count = stats_slots(plan.algo_steps);
+    uint32_t slab_bytes = allred_shim::kernel_stats() ? stats_slab_bytes(stats_slots_count) : 0;
+    for (const CircularBufferSpec& cb :
+         allred_circular_buffers(chunks.chunk_tiles, recv_tiles, chunks.streaming(), slab_bytes)) {
+        device.CreateCircularBuffer(cb.index, cb.size, cb.page_size);
+    }
+
+    // One input page per core, interleaved over the banks like --inputs=per-core
+    std::vector<uint32_t> core_inputs = generate_core_inputs(TOTAL_NODES, num_words, RND_SRC);
+    uint32_t page_size = single_tile_size * NUM_TILES;
+    allred_shim::DramBuffer inputs_buffer = device.CreateDramBuffer(page_size * TOTAL_NODES, page_size);
+    allred_shim::DramBuffer dst_buffer = device.CreateDramBuffer(page_size, page_size);
+    allred_shim::DramBuffer common_buffer;
+    allred_shim::DramBuffer stats_buffer;
+    if (slab_bytes) {
+        stats_buffer = device.CreateDramBuffer(slab_bytes * TOTAL_NODES, slab_bytes * TOTAL_NODES);
+    }
+    device.WriteBuffer(inputs_buffer, core_inputs);
+
+    // Runtime args as AllredProgramCache sets them, with the shim's semaphore ids and DRAM buffers
+    AllredArgTables args;
+    uint32_t semaphores, is_SE_arg, stats_arg;
+    if (MEM) {
+        args = build_mem_arg_tables(plan, physical_core, NUM_TILES);
+        semaphores = MemArgLayout(plan.algo_steps).semaphores();
+        stats_arg = MemArgLayout(plan.algo_steps).stats();
+        is_SE_arg = 13;
+        common_buffer = device.CreateDramBuffer(page_size * TOTAL_NODES, page_size * TOTAL_NODES);
+    } else {
+        args = build_BO_arg_tables(
+            plan,
+            physical_core,
+            BANDWIDTH_OPTIMAL,
+            chunks.chunk_tiles,
+            chunks.num_chunks,
+            std::max(0, options.GetInt("num-syncs", 0)));
+        semaphores = BOArgLayout(plan.algo_steps).semaphores();
+        stats_arg = BOArgLayout(plan.algo_steps, plan.total_nodes).stats();
+        is_SE_arg = 10;
+    }
+    allred_shim::KernelFn dataflow_kernel = MEM                        ? allred_shim::mem_dataflow_kernel
+                                            : KERNEL == "allred_LOO_2D" ? allred_shim::LOO_dataflow_kernel
+                                                                        : allred_shim::BO_dataflow_kernel;
+    allred_shim::KernelFn compute_kernel = MEM ? allred_shim::mem_compute_kernel : allred_shim::BO_compute_kernel;
+    for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+        std::vector<uint32_t>& dataflow_args = args.dataflow[core_i];
+        dataflow_args[0] = inputs_buffer.address + (core_i / allred_shim::NUM_DRAM_BANKS) * page_size;
+        dataflow_args[1] = dst_buffer.address;
+        dataflow_args[2] = core_i % allred_shim::NUM_DRAM_BANKS;
+        dataflow_args[4] = 0;
+        if (MEM) {
+            dataflow_args[6] = common_buffer.address;
+            dataflow_args[7] = 0;
+        } else {
+            dataflow_args[3] = PRINT_CORE;
+        }
+        for (uint32_t i = 0; i < allred_shim::NUM_SEMAPHORES; i++) {
+            dataflow_args[semaphores + i] = i;
+        }
+        dataflow_args[stats_arg] = stats_buffer.address;
+        dataflow_args[stats_arg + 1] = 0;
+        dataflow_args[is_SE_arg] = 0;
+        device.SetKernel(core_i, allred_shim::Risc::BRISC, dataflow_kernel, dataflow_args);
+        dataflow_args[is_SE_arg] = 1;
+        device.SetKernel(core_i, allred_shim::Risc::NCRISC, dataflow_kernel, dataflow_args);
+        device.SetKernel(core_i, allred_shim::Risc::TRISC, compute_kernel, args.compute[core_i]);
+    }
+
+    // Golden results: BO/LO must match the device order reference bit for bit on every core, the
+    // allred_mem_2D result in DRAM must be within the error of the float sum. A streamed vector is reduced
+    // chunk by chunk, so its blocks (and the order of the additions) are those of a chunk
+    AllredReference reference(plan, MEM || BANDWIDTH_OPTIMAL);
+    std::vector<std::vector<uint32_t>> golden(MEM ? 1 : TOTAL_NODES, std::vector<uint32_t>(num_words));
+    std::vector<const uint32_t*> inputs(TOTAL_NODES);
+    for (uint32_t chunk = 0; chunk < chunks.num_chunks; chunk++) {
+        for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+            inputs[core_i] = &core_inputs[core_i * num_words + chunk * chunk_words];
+        }
+        for (uint32_t core_i = 0; core_i < golden.size(); core_i++) {
+            std::vector<uint32_t> chunk_golden =
+                reference.Run(inputs, chunk_words, MEM ? ReferenceOrder::Float : ReferenceOrder::Device, core_i);
+            std::copy(chunk_golden.begin(), chunk_golden.end(), golden[core_i].begin() + chunk * chunk_words);
+        }
+    }
+    // What the kernels write to dst: the print core's vector, or block b of every chunk from core b when streaming
+    std::vector<uint32_t> dst_golden = MEM ? std::vector<uint32_t>() : golden[PRINT_CORE];
+    if (!MEM && chunks.streaming()) {
+        size_t block_words = chunk_words / TOTAL_NODES;
+        for (size_t word = 0; word < num_words; word++) {
+            dst_golden[word] = golden[(word % chunk_words) / block_words][word];
+        }
+    }
+    for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+        inputs[core_i] = &core_inputs[core_i * num_words];
+    }
+    std::vector<uint32_t> mem_golden = MEM ? mem_device_order_result(inputs, num_words) : std::vector<uint32_t>();
+
+    printf(
+        "Running %s on %dx%d cores, %d tiles in %u chunks, %s, kernels built for %u iterations after %u warmup runs\n",
+        KERNEL.c_str(),
+        SIDE_LENGTH,
+        SIDE_LENGTH,
+        NUM_TILES,
+        chunks.num_chunks,
+        SWING_VERSION ? "swing" : "recdub",
+        allred_shim::kernel_iterations(),
+        allred_shim::kernel_warmup());
+
+    bool success = true;
+    for (int launch = 0; launch < LAUNCHES && success; launch++) {
+        allred_shim::LaunchResult result = device.Launch(options.GetInt("timeout", 5000));
+        for (const std::string& error : result.errors) {
+            printf("Error: %s\n", error.c_str());
+        }
+        if (!result.completed) {
+            printf("Launch %d aborted after %.1f ms, blocked waits:\n", launch, result.elapsed_ms);
+            for (size_t i = 0; i < result.blocked.size() && i < 16; i++) {
+                printf("  %s\n", result.blocked[i].c_str());
+            }
+            if (result.blocked.size() > 16) {
+                printf("  ... and %zu more\n", result.blocked.size() - 16);
+            }
+            success = false;
+            break;
+        }
+
+        uint32_t mismatched_cores = 0;
+        if (MEM) {
+            std::vector<uint32_t> result_vec = device.ReadBuffer(dst_buffer);
+            // The mem kernels add the blocks in a fixed order, so the result is exact against mem_device_order_result
+            ValidationResult exact = validate_against_golden(result_vec.data(), mem_golden.data(), num_words, 0.0f);
+            if (!exact.all_match()) {
+                ValidationResult validation = validate_against_golden(result_vec.data(), golden[0].data(), num_words, ERROR);
+                printf(
+                    "%zu of %zu values differ from the device order reference, first at index %zu, %zu outside the error\n",
+                    exact.num_values - exact.num_matches,
+                    exact.num_values,
+                    exact.first_mismatch_index,
+                    validation.num_values - validation.num_matches);
+                mismatched_cores = 1;
+            }
+        } else {
+            // The local CB holds the last chunk, in bandwidth optimal mode with the blocks in the plan's L1 order
+            size_t last_chunk = num_words - chunk_words;
+            size_t block_words = chunk_words / TOTAL_NODES;
+            for (uint32_t core_i = 0; core_i < TOTAL_NODES; core_i++) {
+                std::vector<uint32_t> local_vec = device.ReadCircularBuffer(core_i, 16, chunk_words);
+                std::vector<uint32_t> result_vec = local_vec;
+                for (uint32_t n_block = 0; n_block < TOTAL_NODES && BANDWIDTH_OPTIMAL; n_block++) {
+                    std::copy_n(
+                        local_vec.begin() + plan.block_positions[n_block] * block_words,
+                        block_words,
+                        result_vec.begin() + n_block * block_words);
+                }
+                if (!std::equal(result_vec.begin(), result_vec.end(), golden[core_i].begin() + last_chunk)) {
+                    if (mismatched_cores == 0) {
+                        ValidationResult exact = validate_against_golden(
+                            result_vec.data(), golden[core_i].data() + last_chunk, chunk_words, 0.0f);
+                        printf(
+                            "Core %u: %zu of %zu values differ from the device order reference, first at index %zu\n",
+                            core_i,
+                            exact.num_values - exact.num_matches,
+                            exact.num_values,
+                            exact.first_mismatch_index);
+                    }
+                    mismatched_cores++;
+                }
+            }
+            // Over the full vector when streaming
+            mismatched_cores += device.ReadBuffer(dst_buffer) != dst_golden;
+        }
+        printf(
+            "Launch %d: %.1f ms, %s\n",
+            launch,
+            result.elapsed_ms,
+            mismatched_cores == 0 ? (MEM ? "result bit exact" : "every core bit exact") : "RESULT MISMATCH");
+        if (slab_bytes) {
+            std::vector<CoreStats> cores;
+            std::string stats_error;
+            if (parse_stats_buffer(device.ReadBuffer(stats_buffer), TOTAL_NODES, stats_slots_count, cores, stats_error)) {
+                print_stats_summary(summarize_stats(cores), stats_slot_names(plan.algo_steps, MEM));
+            } else {
+                printf("No stats: %s\n", stats_error.c_str());
+            }
+        }
+        success = result.errors.empty() && mismatched_cores == 0;
+    }
+
+    std::stringstream log;
+    device.WriteProfileLog(log);
+    if (options.Has("profile-log")) {
+        std::ofstream(options.GetString("profile-log", "")) << log.str();
+    }
+    ProfileLogReader reader;
+    std::string log_error;
+    if (reader.Read(log, log_error)) {
+        for (const ProfileRun& run : reader.Runs()) {
+            TimeStats stats = run.Durations();
+            printf(
+                "Launch %lu ALL_RED_LOOP over %zu cores: min %.0f, median %.0f, max %.0f ns\n",
+                (unsigned long)run.run_id,
+                run.cores.size(),
+                stats.min,
+                stats.median,
+                stats.max);
+        }
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+#include "allred_shim_device.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace allred_shim {
+
+thread_local RiscContext* current_risc = nullptr;
+
+namespace {
+
+uint8_t* map_low_memory(size_t size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_32BIT
+    flags |= MAP_32BIT;
+    void* hint = nullptr;
+#else
+    void* hint = reinterpret_cast<void*>(0x10000000);
+#endif
+    void* memory = mmap(hint, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw ShimError("Could not map " + std::to_string(size) + " bytes of L1");
+    }
+    if (reinterpret_cast<uintptr_t>(memory) + size > (1ull << 32)) {
+        munmap(memory, size);
+        throw ShimError("L1 could not be mapped below 4GB, the kernels keep L1 addresses in 32 bits");
+    }
+    return static_cast<uint8_t*>(memory);
+}
+
+uint8_t* map_memory(size_t size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw ShimError("Could not map " + std::to_string(size) + " bytes of DRAM");
+    }
+    return static_cast<uint8_t*>(memory);
+}
+
+// Semaphores take the start of L1, then come the CBs
+constexpr uint32_t SEMAPHORES_SIZE = NUM_SEMAPHORES * L1_ALIGNMENT;
+
+}  // namespace
+
+const char* risc_name(Risc risc) {
+    switch (risc) {
+        case Risc::BRISC: return "BRISC";
+        case Risc::NCRISC: return "NCRISC";
+        default: return "TRISC";
+    }
+}
+
+void backoff(uint32_t tries) {
+    if (tries < 64) {
+        return;
+    } else if (tries < 1024) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+}
+
+Device::Device(const std::vector<std::pair<uint32_t, uint32_t>>& physical_cores) :
+    cores(physical_cores.size()), next_l1_address(SEMAPHORES_SIZE) {
+    l1_arenas = map_low_memory(static_cast<size_t>(L1_SIZE) * cores.size());
+    dram_banks = map_memory(static_cast<size_t>(DRAM_BANK_SIZE) * NUM_DRAM_BANKS);
+
+    uint32_t max_x = 0, max_y = 0;
+    for (const auto& [x, y] : physical_cores) {
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+    }
+    core_at_width = max_x + 1;
+    core_at.assign(core_at_width * (max_y + 1), -1);
+    for (uint32_t core_i = 0; core_i < cores.size(); core_i++) {
+        cores[core_i].x = physical_cores[core_i].first;
+        cores[core_i].y = physical_cores[core_i].second;
+        cores[core_i].l1 = l1_arenas + static_cast<size_t>(L1_SIZE) * core_i;
+        core_at[cores[core_i].y * core_at_width + cores[core_i].x] = core_i;
+    }
+    start_ns = NowNs();
+}
+
+Device::~Device() {
+    munmap(l1_arenas, static_cast<size_t>(L1_SIZE) * cores.size());
+    munmap(dram_banks, static_cast<size_t>(DRAM_BANK_SIZE) * NUM_DRAM_BANKS);
+}
+
+uint64_t Device::NowNs() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Device::CreateCircularBuffer(uint32_t cb_index, uint32_t size, uint32_t page_size) {
+    if (cb_index >= NUM_CIRCULAR_BUFFERS || next_l1_address + size > L1_SIZE) {
+        throw ShimError("CB " + std::to_string(cb_index) + " of " + std::to_string(size) + " bytes does not fit in L1");
+    }
+    for (Core& core : cores) {
+        CircularBuffer& cb = core.cbs[cb_index];
+        cb.address = next_l1_address;
+        cb.ring.Configure(size, page_size);
+    }
+    next_l1_address += (size + L1_ALIGNMENT - 1) / L1_ALIGNMENT * L1_ALIGNMENT;
+}
+
+uint32_t Device::SemaphoreAddress(uint32_t core_i, uint32_t semaphore_id) const {
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(cores[core_i].l1)) + semaphore_id * L1_ALIGNMENT;
+}
+
+DramBuffer Device::CreateDramBuffer(uint32_t size, uint32_t page_size) {
+    // Like tt-metal, an interleaved buffer has the same address in every bank
+    uint32_t num_pages = (size + page_size - 1) / page_size;
+    uint32_t bank_size = (num_pages + NUM_DRAM_BANKS - 1) / NUM_DRAM_BANKS * page_size;
+    if (static_cast<uint64_t>(next_dram_address) + bank_size > DRAM_BANK_SIZE) {
+        throw ShimError("DRAM buffer of " + std::to_string(size) + " bytes does not fit in the banks");
+    }
+    DramBuffer buffer{next_dram_address, size, page_size};
+    next_dram_address += (bank_size + 31) / 32 * 32;
+    return buffer;
+}
+
+void Device::WriteBuffer(const DramBuffer& buffer, const std::vector<uint32_t>& data) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    uint32_t size = std::min<size_t>(buffer.size, data.size() * sizeof(uint32_t));
+    for (uint32_t page = 0; page * buffer.page_size < size; page++) {
+        uint32_t bytes_in_page = std::min(buffer.page_size, size - page * buffer.page_size);
+        uint8_t* bank = dram_banks + static_cast<size_t>(DRAM_BANK_SIZE) * (page % NUM_DRAM_BANKS);
+        std::memcpy(
+            bank + buffer.address + (page / NUM_DRAM_BANKS) * buffer.page_size,
+            bytes + page * buffer.page_size,
+            bytes_in_page);
+    }
+}
+
+std::vector<uint32_t> Device::ReadBuffer(const DramBuffer& buffer) const {
+    std::vector<uint32_t> data(buffer.size / sizeof(uint32_t));
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(data.data());
+    for (uint32_t page = 0; page * buffer.page_size < buffer.size; page++) {
+        uint32_t bytes_in_page = std::min(buffer.page_size, buffer.size - page * buffer.page_size);
+        const uint8_t* bank = dram_banks + static_cast<size_t>(DRAM_BANK_SIZE) * (page % NUM_DRAM_BANKS);
+        std::memcpy(
+            bytes + page * buffer.page_size,
+            bank + buffer.address + (page / NUM_DRAM_BANKS) * buffer.page_size,
+            bytes_in_page);
+    }
+    return data;
+}
+
+std::vector<uint32_t> Device::ReadCircularBuffer(uint32_t core_i, uint32_t cb_index, size_t num_words) const {
+    const Core& core = cores[core_i];
+    const uint32_t* start = reinterpret_cast<const uint32_t*>(core.l1 + core.cbs[cb_index].address);
+    return std::vector<uint32_t>(start, start + num_words);
+}
+
+void Device::SetKernel(uint32_t core_i, Risc risc, KernelFn kernel, const std::vector<uint32_t>& args) {
+    cores[core_i].kernels[static_cast<int>(risc)] = kernel;
+    cores[core_i].args[static_cast<int>(risc)] = args;
+}
+
+uint64_t Device::CoreNocAddress(uint32_t x, uint32_t y, uint32_t l1_addr, const Core& from) const {
+    int core_i = (x < core_at_width && y * core_at_width + x < core_at.size()) ? core_at[y * core_at_width + x] : -1;
+    if (core_i < 0) {
+        throw ShimError("get_noc_addr of core (" + std::to_string(x) + "," + std::to_string(y) + "), not in the grid");
+    }
+    // Every core has the same L1 layout, so the offset in the sender's L1 is the offset in the receiver's
+    uint32_t offset = l1_addr - static_cast<uint32_t>(reinterpret_cast<uintptr_t>(from.l1));
+    return (static_cast<uint64_t>(core_i) << 32) | offset;
+}
+
+uint8_t* Device::ResolveNocAddress(uint64_t noc_addr, uint32_t size) const {
+    uint32_t offset = static_cast<uint32_t>(noc_addr);
+    if (noc_addr & DRAM_NOC_FLAG) {
+        uint32_t bank = static_cast<uint32_t>(noc_addr >> 32) & 0x7fffffff;
+        if (bank >= NUM_DRAM_BANKS || static_cast<uint64_t>(offset) + size > DRAM_BANK_SIZE) {
+            throw ShimError("NoC access of " + std::to_string(size) + " bytes outside of DRAM bank " + std::to_string(bank));
+        }
+        return dram_banks + static_cast<size_t>(DRAM_BANK_SIZE) * bank + offset;
+    }
+    uint32_t core_i = static_cast<uint32_t>(noc_addr >> 32);
+    if (core_i >= cores.size() || static_cast<uint64_t>(offset) + size > L1_SIZE) {
+        throw ShimError("NoC access of " + std::to_string(size) + " bytes at L1 offset " + std::to_string(offset) +
+                        " of core " + std::to_string(core_i) + ", outside of L1");
+    }
+    return cores[core_i].l1 + offset;
+}
+
+void Device::RunRisc(RiscContext& context, KernelFn kernel) {
+    current_risc = &context;
+    try {
+        kernel();
+    } catch (const ShimAbort&) {
+        // Blocked when the launch was aborted, blocked_on says where
+    } catch (const std::exception& e) {
+        context.error = e.what();
+        aborted = true;
+    }
+    current_risc = nullptr;
+}
+
+LaunchResult Device::Launch(uint32_t timeout_ms) {
+    LaunchResult result;
+    aborted = false;
+    for (Core& core : cores) {
+        std::memset(core.l1, 0, SEMAPHORES_SIZE);
+        for (CircularBuffer& cb : core.cbs) {
+            cb.ring.Reset();
+        }
+    }
+
+    std::vector<std::unique_ptr<RiscContext>> contexts;
+    for (uint32_t core_i = 0; core_i < cores.size(); core_i++) {
+        Core& core = cores[core_i];
+        for (uint32_t risc = 0; risc < NUM_RISCS; risc++) {
+            if (!core.kernels[risc]) {
+                continue;
+            }
+            auto context = std::make_unique<RiscContext>();
+            context->device = this;
+            context->core = &core;
+            context->risc = static_cast<Risc>(risc);
+            context->args = &core.args[risc];
+            for (uint32_t cb = 0; cb < NUM_CIRCULAR_BUFFERS; cb++) {
+                uint32_t address = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(core.l1)) + core.cbs[cb].address;
+                context->fifo_rd_ptr[cb] = context->fifo_wr_ptr[cb] = address;
+            }
+            if (context->risc == Risc::TRISC) {
+                context->dst.assign(NUM_DST_TILES * TILE_ELEMENTS, 0.0f);
+            }
+            contexts.push_back(std::move(context));
+        }
+    }
+
+    uint64_t launch_start = NowNs();
+    std::vector<std::thread> threads;
+    for (const std::unique_ptr<RiscContext>& context : contexts) {
+        KernelFn kernel = context->core->kernels[static_cast<int>(context->risc)];
+        threads.emplace_back([this, &context, kernel] { RunRisc(*context, kernel); });
+    }
+
+    // Watchdog: abort the launch once no wait completes for timeout_ms
+    std::atomic<bool> done{false};
+    std::thread watchdog([&] {
+        uint64_t last_progress = 0;
+        auto last_change = std::chrono::steady_clock::now();
+        while (!done && !aborted) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            uint64_t progress = 0;
+            for (const std::unique_ptr<RiscContext>& context : contexts) {
+                progress += context->progress.load(std::memory_order_relaxed);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (progress != last_progress) {
+                last_progress = progress;
+                last_change = now;
+            } else if (std::chrono::duration<double, std::milli>(now - last_change).count() > timeout_ms) {
+                aborted = true;
+            }
+        }
+    });
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    watchdog.join();
+    result.elapsed_ms = (NowNs() - launch_start) / 1e6;
+
+    for (const std::unique_ptr<RiscContext>& context : contexts) {
+        std::string where = "Core (" + std::to_string(context->core->x) + "," + std::to_string(context->core->y) +
+                            ") " + risc_name(context->risc) + ": ";
+        if (!context->error.empty()) {
+            result.errors.push_back(where + context->error);
+        }
+        if (!context->blocked_on.empty()) {
+            result.blocked.push_back(where + context->blocked_on);
+        }
+        uint32_t core_i = context->core - cores.data();
+        for (const ZoneRecord& zone : context->zones) {
+            launch_zones.push_back(LaunchZone{num_launches, core_i, context->risc, zone});
+        }
+    }
+    result.completed = !aborted;
+    num_launches++;
+    return result;
+}
+
+void Device::WriteProfileLog(std::ostream& log) const {
+    log << "ARCH: wormhole_b0, CHIP_FREQ[MHz]: 1000\n";
+    log << "PCIe slot, core_x, core_y, RISC processor type, timer_id, time[cycles since reset], stat value, run ID, "
+           "run host ID,  zone name, type, source line, source file\n";
+    for (const LaunchZone& entry : launch_zones) {
+        const Core& core = cores[entry.core_i];
+        for (bool start : {true, false}) {
+            log << "0, " << core.x << ", " << core.y << ", " << risc_name(entry.risc) << ", 0, "
+                << (start ? entry.zone.start_ns : entry.zone.end_ns) - start_ns << ", 0, " << entry.launch << ", "
+                << entry.launch << ", " << entry.zone.name << ", " << (start ? "ZONE_START" : "ZONE_END")
+                << ", 0, shim\n";
+        }
+    }
+}
+
+}  // namespace allred_shim
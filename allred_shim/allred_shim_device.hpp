@@ -0,0 +1,188 @@
+#pragma once
+
+// Host runtime of the kernel shim: per-core L1 arenas, DRAM banks and circular buffers, and one thread per
+// RISC running the unmodified kernels. The kernels see it through the fake tt-metal headers in include/,
+// which are implemented in allred_shim_api.hpp. Nothing in here depends on tt-metal.
+//
+// The kernels keep L1 addresses in uint32_t and cast them back to pointers, so the L1 arenas are mapped in
+// the low 4GB of the address space (MAP_32BIT on x86-64) and an L1 address is the host address itself.
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "allred_tile_ring.hpp"
+
+namespace allred_shim {
+
+constexpr uint32_t L1_SIZE = 1464 * 1024;  // Wormhole worker L1
+constexpr uint32_t NUM_SEMAPHORES = 8;
+constexpr uint32_t L1_ALIGNMENT = 16;
+constexpr uint32_t NUM_CIRCULAR_BUFFERS = 32;
+constexpr uint32_t NUM_DRAM_BANKS = 12;  // Wormhole n150
+constexpr uint32_t DRAM_BANK_SIZE = 256 * 1024 * 1024;  // Reserved lazily, only the pages written use memory
+constexpr uint32_t NUM_DST_TILES = 16;
+constexpr uint32_t TILE_ELEMENTS = 1024;
+
+// NoC addresses: the core's linear index (or the DRAM bank, flagged) in the upper word, the offset in the lower
+constexpr uint64_t DRAM_NOC_FLAG = 1ull << 63;
+inline uint64_t dram_noc_address(uint32_t bank_id, uint32_t address) {
+    return DRAM_NOC_FLAG | (static_cast<uint64_t>(bank_id) << 32) | address;
+}
+
+// RISCs emulated on every core. The NW dataflow kernel runs on BRISC (RISCV_0) and the SE one on NCRISC
+// (RISCV_1), as set up by CreateDataflowKernel. One thread stands for the three TRISCs of the compute kernel
+enum class Risc { BRISC, NCRISC, TRISC };
+constexpr uint32_t NUM_RISCS = 3;
+const char* risc_name(Risc risc);
+
+using KernelFn = void (*)();
+
+// Errors of the kernels' use of the API (out of range args or NoC addresses), they stop the launch
+struct ShimError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Thrown out of a blocked wait once the launch is aborted
+struct ShimAbort {};
+
+struct CircularBuffer {
+    uint32_t address = 0;  // Same L1 offset on every core
+    TileRing ring;  // Page counters shared by the RISCs of the core, the pointers are in each RiscContext
+};
+
+struct ZoneRecord {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+class Device;
+struct Core;
+
+// What a thread emulates, the kernel API finds it through current_risc
+struct RiscContext {
+    Device* device = nullptr;
+    Core* core = nullptr;
+    Risc risc = Risc::BRISC;
+    const std::vector<uint32_t>* args = nullptr;
+    // Local copies of the CB pointers, each RISC advances its own like on the device
+    uint32_t fifo_rd_ptr[NUM_CIRCULAR_BUFFERS] = {};
+    uint32_t fifo_wr_ptr[NUM_CIRCULAR_BUFFERS] = {};
+    uint32_t fifo_wr_tile_ptr[NUM_CIRCULAR_BUFFERS] = {};  // Next tile of an in order pack_tile
+    std::vector<float> dst;  // DST register tiles of the compute kernel, bfloat16 values held as float
+    std::vector<ZoneRecord> zones;
+    std::ostringstream dprint;
+    std::string blocked_on;  // Set when a wait is abandoned because the launch was aborted
+    std::string error;
+    std::atomic<uint64_t> progress{0};  // Completed waits, watched for hangs
+};
+
+extern thread_local RiscContext* current_risc;
+
+struct Core {
+    uint32_t x, y;  // Physical coordinates, as the kernels use them for get_noc_addr
+    uint8_t* l1 = nullptr;
+    CircularBuffer cbs[NUM_CIRCULAR_BUFFERS];
+    KernelFn kernels[NUM_RISCS] = {};
+    std::vector<uint32_t> args[NUM_RISCS];
+};
+
+// An interleaved DRAM buffer: page p is at address + (p / NUM_DRAM_BANKS) * page_size in bank p % NUM_DRAM_BANKS
+struct DramBuffer {
+    uint32_t address = 0;
+    uint32_t size = 0;
+    uint32_t page_size = 0;
+};
+
+struct LaunchResult {
+    bool completed = false;
+    double elapsed_ms = 0.0;
+    std::vector<std::string> errors;   // ShimErrors and exceptions of the kernels
+    std::vector<std::string> blocked;  // Waits of the RISCs still blocked when a hung launch was aborted
+};
+
+class Device {
+public:
+    // physical_cores holds the coordinates of the core with each linear index
+    explicit Device(const std::vector<std::pair<uint32_t, uint32_t>>& physical_cores);
+    ~Device();
+    Device(const Device&) = delete;
+    Device& operator=(const Device&) = delete;
+
+    uint32_t NumCores() const { return cores.size(); }
+    Core& GetCore(uint32_t core_i) { return cores[core_i]; }
+
+    // Allocates the CB at the same L1 address on every core
+    void CreateCircularBuffer(uint32_t cb_index, uint32_t size, uint32_t page_size);
+    // Semaphores are L1 words at fixed addresses, initialized to 0 at every launch
+    uint32_t SemaphoreAddress(uint32_t core_i, uint32_t semaphore_id) const;
+
+    DramBuffer CreateDramBuffer(uint32_t size, uint32_t page_size);
+    void WriteBuffer(const DramBuffer& buffer, const std::vector<uint32_t>& data);
+    std::vector<uint32_t> ReadBuffer(const DramBuffer& buffer) const;
+    // Copy of num_words words of a core's L1, from the start of a CB
+    std::vector<uint32_t> ReadCircularBuffer(uint32_t core_i, uint32_t cb_index, size_t num_words) const;
+
+    void SetKernel(uint32_t core_i, Risc risc, KernelFn kernel, const std::vector<uint32_t>& args);
+
+    // Runs every kernel to completion on its own thread. A launch in which no wait completes for
+    // timeout_ms is considered hung, and is aborted with the waits left blocked in the result
+    LaunchResult Launch(uint32_t timeout_ms = 5000);
+
+    // Zones of all launches, in the format of the device profiler log (at a 1GHz clock, so cycles are ns),
+    // with the launch number as run host ID. ProfileLogReader and allred_profiler read it
+    void WriteProfileLog(std::ostream& log) const;
+
+    bool dprint_enabled = false;
+
+    // Used by the kernel API
+    uint8_t* ResolveNocAddress(uint64_t noc_addr, uint32_t size) const;
+    uint64_t CoreNocAddress(uint32_t x, uint32_t y, uint32_t l1_addr, const Core& from) const;
+    bool Aborted() const { return aborted.load(std::memory_order_relaxed); }
+    uint64_t NowNs() const;
+
+private:
+    struct LaunchZone {
+        uint32_t launch;
+        uint32_t core_i;
+        Risc risc;
+        ZoneRecord zone;
+    };
+
+    void RunRisc(RiscContext& context, KernelFn kernel);
+
+    std::vector<Core> cores;
+    std::vector<int> core_at;  // Linear index of the core at physical (x, y), -1 if none
+    uint32_t core_at_width = 0;
+    uint8_t* l1_arenas = nullptr;
+    uint8_t* dram_banks = nullptr;
+    uint32_t next_l1_address = 0;  // Offset of the next CB
+    uint32_t next_dram_address = 0;
+    std::atomic<bool> aborted{false};
+    uint64_t start_ns = 0;
+    uint32_t num_launches = 0;
+    std::vector<LaunchZone> launch_zones;
+};
+
+void backoff(uint32_t tries);
+
+// Waits until ready() holds, backing off from spinning to sleeping so 192 threads can share a few CPUs.
+// Throws ShimAbort, with the wait described in the RISC's blocked_on, if the launch is aborted meanwhile
+template <typename Ready, typename Describe>
+void wait_until(Ready ready, Describe describe) {
+    for (uint32_t tries = 0; !ready(); tries++) {
+        if (current_risc->device->Aborted()) {
+            current_risc->blocked_on = describe();
+            throw ShimAbort{};
+        }
+        backoff(tries);
+    }
+    current_risc->progress.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace allred_shim
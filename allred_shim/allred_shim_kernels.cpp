@@ -0,0 +1,54 @@
+#include "allred_shim_kernels.hpp"
+
+// The kernel sources are included unmodified, each in its own namespace so their kernel_main and helper
+// functions don't clash. The shim headers they include are included here first, at global scope.
+#include "dataflow_api.h"
+#include "debug/dprint.h"
+#include "third_party/tracy/public/tracy/Tracy.hpp"
+#include "compute_kernel_api/eltwise_binary.h"
+#include "compute_kernel_api/tile_move_copy.h"
+
+// The compute kernels define NAMESPACE::MAIN, compiled once per TRISC on the device
+#define NAMESPACE compute
+#define MAIN kernel_main()
+
+// The device build has its own warning flags, the kernels' unused locals aren't the shim's to fix
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+
+namespace allred_shim_BO_dataflow {
+#include "../allred_BO_2D/kernels/dataflow_kernel.cpp"
+}
+
+namespace allred_shim_LOO_dataflow {
+#include "../allred_LOO_2D/kernels/dataflow_kernel.cpp"
+}
+
+namespace allred_shim_BO_compute {
+#include "../allred_BO_2D/kernels/compute_kernel.cpp"
+}
+
+namespace allred_shim_mem_dataflow {
+#include "../allred_mem_2D/kernels/dataflow_kernel.cpp"
+}
+
+namespace allred_shim_mem_compute {
+#include "../allred_mem_2D/kernels/compute_kernel.cpp"
+}
+
+#pragma GCC diagnostic pop
+
+namespace allred_shim {
+
+uint32_t kernel_iterations() { return get_compile_time_arg_val(0); }
+uint32_t kernel_warmup() { return get_compile_time_arg_val(1); }
+bool kernel_stats() { return allred_shim_BO_dataflow::stats_enabled; }
+
+void BO_dataflow_kernel() { allred_shim_BO_dataflow::kernel_main(); }
+void LOO_dataflow_kernel() { allred_shim_LOO_dataflow::kernel_main(); }
+void BO_compute_kernel() { allred_shim_BO_compute::compute::kernel_main(); }
+void mem_dataflow_kernel() { allred_shim_mem_dataflow::kernel_main(); }
+void mem_compute_kernel() { allred_shim_mem_compute::compute::kernel_main(); }
+
+}  // namespace allred_shim
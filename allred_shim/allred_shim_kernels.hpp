@@ -0,0 +1,21 @@
+#pragma once
+
+// Entry points of the allreduce kernels, compiled for the host against the shim headers
+
+#include <cstdint>
+
+namespace allred_shim {
+
+// The kernels' compile time args, set at build time with -DKERNEL_COMPILE_TIME_ARGS="iterations, warmup"
+uint32_t kernel_iterations();
+uint32_t kernel_warmup();
+// Whether the dataflow kernels count --stats, built with -DALLRED_STATS
+bool kernel_stats();
+
+void BO_dataflow_kernel();   // allred_BO_2D/kernels/dataflow_kernel.cpp
+void LOO_dataflow_kernel();  // allred_LOO_2D/kernels/dataflow_kernel.cpp
+void BO_compute_kernel();    // allred_BO_2D/kernels/compute_kernel.cpp
+void mem_dataflow_kernel();  // allred_mem_2D/kernels/dataflow_kernel.cpp
+void mem_compute_kernel();   // allred_mem_2D/kernels/compute_kernel.cpp
+
+}  // namespace allred_shim
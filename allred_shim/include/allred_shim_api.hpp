@@ -0,0 +1,298 @@
+#pragma once
+
+// The part of the tt-metal kernel API used by the allreduce kernels, implemented on top of the shim's
+// Device. Included by the fake dataflow_api.h, compute_kernel_api/*.h, debug/dprint.h and Tracy.hpp, so
+// the kernels compile unmodified for the host.
+//
+// NoC writes and reads are done at once (the barriers have nothing left to wait for), semaphores are
+// atomics in the L1 arenas, and the compute kernel adds tiles in float and rounds to bfloat16 on every
+// write of DST, as the Float16_b DST and packer do.
+
+#include <stdint.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include "allred_bf16.hpp"
+#include "allred_shim_device.hpp"
+
+#define tt_l1_ptr
+#define FORCE_INLINE inline __attribute__((always_inline))
+
+// Compile time args are fixed when the kernels are built, like a JIT build of one program
+#ifndef KERNEL_COMPILE_TIME_ARGS
+#define KERNEL_COMPILE_TIME_ARGS 1, 0
+#endif
+constexpr uint32_t kernel_compile_time_args[] = {KERNEL_COMPILE_TIME_ARGS};
+#define get_compile_time_arg_val(arg_idx) kernel_compile_time_args[arg_idx]
+
+namespace tt {
+enum CBIndex : uint8_t {
+    c_0 = 0, c_1, c_2, c_3, c_4, c_5, c_6, c_7, c_8, c_9, c_10, c_11, c_12, c_13, c_14, c_15,
+    c_16, c_17, c_18, c_19, c_20, c_21, c_22, c_23, c_24, c_25, c_26, c_27, c_28, c_29, c_30, c_31
+};
+}  // namespace tt
+
+namespace allred_shim {
+
+inline std::string core_name() {
+    return "core (" + std::to_string(current_risc->core->x) + "," + std::to_string(current_risc->core->y) + ")";
+}
+
+inline uint32_t l1_base() { return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(current_risc->core->l1)); }
+
+inline std::atomic_ref<uint32_t> semaphore_ref(volatile uint32_t* semaphore) {
+    return std::atomic_ref<uint32_t>(*const_cast<uint32_t*>(semaphore));
+}
+
+inline CircularBuffer& circular_buffer(int32_t cb_id) { return current_risc->core->cbs[cb_id]; }
+
+// Advances a local CB pointer by num_pages, wrapping around at the end of the CB
+inline void advance_fifo_ptr(uint32_t& ptr, int32_t cb_id, int32_t num_pages) {
+    const CircularBuffer& cb = circular_buffer(cb_id);
+    uint32_t start = l1_base() + cb.address;
+    ptr = start + cb.ring.Advance(ptr - start, num_pages);
+}
+
+// Address of a tile in a CB, relative to a local CB pointer
+inline uint16_t* cb_tile(uint32_t fifo_ptr, int32_t cb_id, uint32_t tile_index) {
+    uint32_t address = fifo_ptr + tile_index * circular_buffer(cb_id).ring.PageSize();
+    return reinterpret_cast<uint16_t*>(static_cast<uintptr_t>(address));
+}
+
+inline float* dst_tile(uint32_t dst_index) {
+    if (dst_index >= NUM_DST_TILES) {
+        throw ShimError("DST tile " + std::to_string(dst_index) + " out of range");
+    }
+    return &current_risc->dst[dst_index * TILE_ELEMENTS];
+}
+
+// DST holds Float16_b values, so every result written to it is rounded
+inline float round_to_dst(float value) { return bf16_to_float(float_to_bf16(value)); }
+
+// Ends a DPRINT line
+struct DebugEndl {};
+
+struct DebugPrinter {
+    template <typename T>
+    DebugPrinter& operator<<(const T& value) {
+        if (current_risc->device->dprint_enabled) {
+            current_risc->dprint << value;
+        }
+        return *this;
+    }
+    DebugPrinter& operator<<(DebugEndl) {
+        if (current_risc->device->dprint_enabled) {
+            printf("%s %s: %s\n", core_name().c_str(), risc_name(current_risc->risc), current_risc->dprint.str().c_str());
+            current_risc->dprint.str("");
+        }
+        return *this;
+    }
+};
+
+// DeviceZoneScopedN: records the zone's start and end on the RISC, see Device::WriteProfileLog
+struct ScopedZone {
+    const char* name;
+    uint64_t start_ns;
+    explicit ScopedZone(const char* name) : name(name), start_ns(current_risc->device->NowNs()) {}
+    ~ScopedZone() { current_risc->zones.push_back(ZoneRecord{name, start_ns, current_risc->device->NowNs()}); }
+};
+
+}  // namespace allred_shim
+
+// Runtime args
+
+template <typename T>
+T get_arg_val(int arg_idx) {
+    static_assert(sizeof(T) == sizeof(uint32_t), "runtime args are 32 bit words");
+    const std::vector<uint32_t>& args = *allred_shim::current_risc->args;
+    if (arg_idx < 0 || static_cast<size_t>(arg_idx) >= args.size()) {
+        throw allred_shim::ShimError(
+            "get_arg_val(" + std::to_string(arg_idx) + ") with " + std::to_string(args.size()) + " runtime args");
+    }
+    T value;
+    std::memcpy(&value, &args[arg_idx], sizeof(T));
+    return value;
+}
+
+// Circular buffers
+
+inline uint32_t get_write_ptr(uint32_t cb_id) { return allred_shim::current_risc->fifo_wr_ptr[cb_id]; }
+inline uint32_t get_read_ptr(uint32_t cb_id) { return allred_shim::current_risc->fifo_rd_ptr[cb_id]; }
+inline uint32_t get_tile_size(uint32_t cb_id) { return allred_shim::circular_buffer(cb_id).ring.PageSize(); }
+
+inline void cb_reserve_back(int32_t cb_id, int32_t num_pages) {
+    const TileRing& ring = allred_shim::circular_buffer(cb_id).ring;
+    allred_shim::wait_until(
+        [&] { return ring.CanReserve(num_pages); },
+        [&] {
+            return "cb_reserve_back(" + std::to_string(cb_id) + ", " + std::to_string(num_pages) + "), " +
+                   std::to_string(ring.PagesInUse()) + " of " + std::to_string(ring.NumPages()) + " pages in use";
+        });
+}
+
+inline void cb_push_back(int32_t cb_id, int32_t num_pages) {
+    allred_shim::RiscContext& risc = *allred_shim::current_risc;
+    allred_shim::circular_buffer(cb_id).ring.Push(num_pages);
+    allred_shim::advance_fifo_ptr(risc.fifo_wr_ptr[cb_id], cb_id, num_pages);
+    risc.fifo_wr_tile_ptr[cb_id] = 0;
+}
+
+inline void cb_wait_front(int32_t cb_id, int32_t num_pages) {
+    const TileRing& ring = allred_shim::circular_buffer(cb_id).ring;
+    allred_shim::wait_until(
+        [&] { return ring.CanWait(num_pages); },
+        [&] {
+            return "cb_wait_front(" + std::to_string(cb_id) + ", " + std::to_string(num_pages) + "), " +
+                   std::to_string(ring.PagesInUse()) + " pages available";
+        });
+}
+
+inline void cb_pop_front(int32_t cb_id, int32_t num_pages) {
+    allred_shim::circular_buffer(cb_id).ring.Pop(num_pages);
+    allred_shim::advance_fifo_ptr(allred_shim::current_risc->fifo_rd_ptr[cb_id], cb_id, num_pages);
+}
+
+// NoC
+
+inline uint32_t get_semaphore(uint32_t semaphore_id) {
+    if (semaphore_id >= allred_shim::NUM_SEMAPHORES) {
+        throw allred_shim::ShimError("get_semaphore(" + std::to_string(semaphore_id) + ")");
+    }
+    return allred_shim::l1_base() + semaphore_id * allred_shim::L1_ALIGNMENT;
+}
+
+inline uint64_t get_noc_addr(uint32_t noc_x, uint32_t noc_y, uint32_t addr, uint8_t /* noc */ = 0) {
+    return allred_shim::current_risc->device->CoreNocAddress(noc_x, noc_y, addr, *allred_shim::current_risc->core);
+}
+
+template <bool DRAM>
+uint64_t get_noc_addr_from_bank_id(uint32_t bank_id, uint32_t bank_address_offset, uint8_t /* noc */ = 0) {
+    static_assert(DRAM, "only DRAM banks are emulated");
+    return allred_shim::dram_noc_address(bank_id, bank_address_offset);
+}
+
+inline void noc_async_write(uint32_t src_local_l1_addr, uint64_t dst_noc_addr, uint32_t size, uint8_t /* noc */ = 0) {
+    uint8_t* dst = allred_shim::current_risc->device->ResolveNocAddress(dst_noc_addr, size);
+    std::memcpy(dst, reinterpret_cast<const void*>(static_cast<uintptr_t>(src_local_l1_addr)), size);
+}
+
+inline void noc_async_read(uint64_t src_noc_addr, uint32_t dst_local_l1_addr, uint32_t size, uint8_t /* noc */ = 0) {
+    const uint8_t* src = allred_shim::current_risc->device->ResolveNocAddress(src_noc_addr, size);
+    std::memcpy(reinterpret_cast<void*>(static_cast<uintptr_t>(dst_local_l1_addr)), src, size);
+}
+
+inline void noc_async_write_barrier(uint8_t /* noc */ = 0) { std::atomic_thread_fence(std::memory_order_release); }
+inline void noc_async_read_barrier(uint8_t /* noc */ = 0) { std::atomic_thread_fence(std::memory_order_acquire); }
+
+inline void noc_semaphore_inc(uint64_t addr, uint32_t incr, uint8_t /* noc */ = 0) {
+    uint32_t* semaphore = reinterpret_cast<uint32_t*>(
+        allred_shim::current_risc->device->ResolveNocAddress(addr, sizeof(uint32_t)));
+    std::atomic_ref<uint32_t>(*semaphore).fetch_add(incr, std::memory_order_release);
+}
+
+inline void noc_semaphore_set(volatile uint32_t* sem_addr, uint32_t val) {
+    allred_shim::semaphore_ref(sem_addr).store(val, std::memory_order_release);
+}
+
+inline void noc_semaphore_wait(volatile uint32_t* sem_addr, uint32_t val) {
+    allred_shim::wait_until(
+        [&] { return allred_shim::semaphore_ref(sem_addr).load(std::memory_order_acquire) == val; },
+        [&] {
+            return "noc_semaphore_wait(semaphore " +
+                   std::to_string((reinterpret_cast<uintptr_t>(sem_addr) - allred_shim::l1_base()) / allred_shim::L1_ALIGNMENT) +
+                   ", " + std::to_string(val) + "), value " + std::to_string(*sem_addr);
+        });
+}
+
+inline void noc_semaphore_wait_min(volatile uint32_t* sem_addr, uint32_t val) {
+    allred_shim::wait_until(
+        [&] { return allred_shim::semaphore_ref(sem_addr).load(std::memory_order_acquire) >= val; },
+        [&] {
+            return "noc_semaphore_wait_min(semaphore " +
+                   std::to_string((reinterpret_cast<uintptr_t>(sem_addr) - allred_shim::l1_base()) / allred_shim::L1_ALIGNMENT) +
+                   ", " + std::to_string(val) + "), value " + std::to_string(*sem_addr);
+        });
+}
+
+// Compute
+
+enum class EltwiseBinaryType { ELWMUL, ELWDIV, ELWADD, ELWSUB, ELWMAX };
+enum class EltwiseBinaryReuseDestType { NONE, DEST_TO_SRCA, DEST_TO_SRCB };
+
+inline void binary_op_init_common(uint32_t /* icb0 */, uint32_t /* icb1 */, uint32_t /* ocb */ = 16) {}
+inline void add_tiles_init(uint32_t /* icb0 */, uint32_t /* icb1 */, bool /* acc_to_dest */ = false) {}
+inline void copy_tile_to_dst_init_short(uint32_t /* cbid */, uint32_t /* transpose */ = 0) {}
+template <EltwiseBinaryType eltwise_binary_type, EltwiseBinaryReuseDestType binary_reuse_dest>
+void binary_dest_reuse_tiles_init(uint32_t /* icb0 */) {}
+
+inline void tile_regs_acquire() {}
+inline void tile_regs_commit() {}
+inline void tile_regs_wait() {}
+inline void tile_regs_release() {}
+
+inline void add_tiles(uint32_t icb0, uint32_t icb1, uint32_t itile0, uint32_t itile1, uint32_t idst) {
+    allred_shim::RiscContext& risc = *allred_shim::current_risc;
+    const uint16_t* a = allred_shim::cb_tile(risc.fifo_rd_ptr[icb0], icb0, itile0);
+    const uint16_t* b = allred_shim::cb_tile(risc.fifo_rd_ptr[icb1], icb1, itile1);
+    float* dst = allred_shim::dst_tile(idst);
+    for (uint32_t i = 0; i < allred_shim::TILE_ELEMENTS; i++) {
+        dst[i] = allred_shim::round_to_dst(bf16_to_float(a[i]) + bf16_to_float(b[i]));
+    }
+}
+
+inline void copy_tile(uint32_t in_cb_id, uint32_t in_tile_index, uint32_t dst_tile_index) {
+    allred_shim::RiscContext& risc = *allred_shim::current_risc;
+    const uint16_t* in = allred_shim::cb_tile(risc.fifo_rd_ptr[in_cb_id], in_cb_id, in_tile_index);
+    float* dst = allred_shim::dst_tile(dst_tile_index);
+    for (uint32_t i = 0; i < allred_shim::TILE_ELEMENTS; i++) {
+        dst[i] = bf16_to_float(in[i]);
+    }
+}
+
+// Only ELWADD is used by the kernels
+template <EltwiseBinaryType eltwise_binary_type, EltwiseBinaryReuseDestType binary_reuse_dest>
+void binary_dest_reuse_tiles(uint32_t in_cb_id, uint32_t in_tile_index, uint32_t dst_tile_index) {
+    static_assert(eltwise_binary_type == EltwiseBinaryType::ELWADD, "only ELWADD is emulated");
+    allred_shim::RiscContext& risc = *allred_shim::current_risc;
+    const uint16_t* in = allred_shim::cb_tile(risc.fifo_rd_ptr[in_cb_id], in_cb_id, in_tile_index);
+    float* dst = allred_shim::dst_tile(dst_tile_index);
+    for (uint32_t i = 0; i < allred_shim::TILE_ELEMENTS; i++) {
+        dst[i] = allred_shim::round_to_dst(dst[i] + bf16_to_float(in[i]));
+    }
+}
+
+// In order packs fill the tiles after the CB's write pointer one by one, out of order packs go to output_tile_index
+template <bool out_of_order_output = false>
+void pack_tile(uint32_t ifrom_dst, uint32_t icb, uint32_t output_tile_index = 0) {
+    allred_shim::RiscContext& risc = *allred_shim::current_risc;
+    uint32_t tile_index = out_of_order_output ? output_tile_index : risc.fifo_wr_tile_ptr[icb]++;
+    uint16_t* out = allred_shim::cb_tile(risc.fifo_wr_ptr[icb], icb, tile_index);
+    const float* dst = allred_shim::dst_tile(ifrom_dst);
+    for (uint32_t i = 0; i < allred_shim::TILE_ELEMENTS; i++) {
+        out[i] = float_to_bf16(dst[i]);
+    }
+}
+
+// Wall clock, for the --stats counters. One cycle is a nanosecond, as in the shim's profile log
+
+#define RISCV_DEBUG_REG_WALL_CLOCK_L 0x1F0
+inline uint32_t reg_read(uint32_t addr) {
+    if (addr != RISCV_DEBUG_REG_WALL_CLOCK_L) {
+        throw allred_shim::ShimError("reg_read(" + std::to_string(addr) + ")");
+    }
+    return static_cast<uint32_t>(allred_shim::current_risc->device->NowNs());
+}
+
+// Debug print and profiler zones
+
+inline allred_shim::DebugEndl ENDL() { return {}; }
+#define DPRINT allred_shim::DebugPrinter()
+#define DPRINT_MATH(x) x
+#define DPRINT_PACK(x) x
+#define DPRINT_UNPACK(x) x
+#define DPRINT_DATA0(x) x
+#define DPRINT_DATA1(x) x
+
+#define DeviceZoneScopedN(name) allred_shim::ScopedZone allred_shim_zone(name)
@@ -0,0 +1,4 @@
+#pragma once
+
+// Host shim of the tt-metal header, see allred_shim_api.hpp
+#include "../../../../allred_shim_api.hpp"
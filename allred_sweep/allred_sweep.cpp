@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <tt-metalium/device.hpp>
+#include "allred_helper.hpp"
+#include "allred_emulator.hpp"
+#include "allred_profile.hpp"
+
+// Runs a sweep of allreduce configurations with the device opened once, instead of timing_taker.py's process
+// per point. Programs come from an AllredProgramCache, like in allred_BO_2D/allred_mem_2D, so repeated runs of a
+// point only patch the DRAM args; the kernels only take --iterations/--warmup as compile time args, so after the
+// first point the JIT build cache serves them.
+// The ALL_RED_LOOP zones of all points are read from the profiler log at the end and written to one results
+// file, in the schema of timing_taker.py. With --syncs every point is also run with each of the given semaphore
+// sync counts, to find the best transfer/compute overlap of each size.
+namespace {
+
+struct SweepPoint {
+    // allred_BO_2D, allred_LO_2D (BO kernels in latency optimal mode), allred_LOO_2D (the same with the dataflow
+    // kernel for small vectors at any size) or allred_mem_2D
+    std::string mode;
+    int swing_algo;
+    int data_size;  // Number of tiles arg, see the README
+    int run_num;
+    int num_syncs;  // From --syncs, 0 for model_num_syncs' choice, -1 without --syncs (as the options set it)
+};
+
+// Mode (or the variant whose kernels ran, see kernel_variant) with the sync count of --syncs points. allred_tune
+// only reads the plain modes
+std::string point_name(const SweepPoint& point, const std::string& mode) {
+    return point.num_syncs < 0 ? mode : mode + ":syncs=" + std::to_string(point.num_syncs);
+}
+
+std::string point_name(const SweepPoint& point) { return point_name(point, point.mode); }
+
+bool latency_optimal_mode(const std::string& mode) { return mode == "allred_LO_2D" || mode == "allred_LOO_2D"; }
+
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::vector<int> int_list(const AllredOptions& options, const std::string& name, const std::string& default_value) {
+    std::vector<int> values;
+    for (const std::string& item : split_list(options.GetString(name, default_value))) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+// Same points, and in the same order, as timing_taker.py
+std::vector<SweepPoint> sweep_points(const AllredOptions& options) {
+    std::vector<SweepPoint> points;
+    int runs = options.GetInt("runs", 1);
+    for (int run_num = 0; run_num < runs; run_num++) {
+        for (const std::string& mode : split_list(options.GetString("modes", "allred_BO_2D,allred_LO_2D,allred_mem_2D"))) {
+            bool latency_optimal = latency_optimal_mode(mode);
+            std::vector<int> swing_algos = int_list(options, "swing", mode == "allred_mem_2D" ? "1" : "0,1");
+            std::vector<int> data_sizes = options.Has("sizes")        ? int_list(options, "sizes", "")
+                                          : latency_optimal ? int_list(options, "sizes-lo", "1,2,4,8,16,32,64,128,192,256,320")
+                                                            : int_list(options, "sizes-bo", "1,2,3,4,5");
+            // allred_mem_2D has no send loop to sync
+            std::vector<int> syncs = options.Has("syncs") && mode != "allred_mem_2D" ? int_list(options, "syncs", "")
+                                                                                    : std::vector<int>{-1};
+            for (int swing_algo : swing_algos) {
+                for (int data_size : data_sizes) {
+                    for (int num_syncs : syncs) {
+                        points.push_back(SweepPoint{mode, swing_algo, data_size, run_num, num_syncs});
+                    }
+                }
+            }
+        }
+    }
+    return points;
+}
+
+// Positional args of allred_BO_2D/allred_mem_2D for a point, AllredConfig reads its settings from them
+std::vector<std::string> point_args(const SweepPoint& point, int seed, int error) {
+    bool bandwidth_optimal = !latency_optimal_mode(point.mode);
+    return {
+        point.mode,
+        std::to_string(point.swing_algo),
+        "1",
+        "8",
+        std::to_string(seed),
+        std::to_string(point.data_size),
+        std::to_string(error),
+        "0",
+        bandwidth_optimal ? "1" : "0"};
+}
+
+// How AllredConfig splits the vector of a point, see plan_chunks
+ChunkPlan point_chunks(const SweepPoint& point, const AllredOptions& options) {
+    bool bandwidth_optimal = point.mode == "allred_mem_2D" || !latency_optimal_mode(point.mode);
+    uint32_t num_tiles = normalize_num_tiles(point.data_size, bandwidth_optimal, 64);
+    const SchedulePlan& plan = SchedulePlanner::Get(point.swing_algo == 1, 8);
+    bool compact_recv = point.mode == "allred_BO_2D";
+    return plan_chunks(plan, compact_recv, num_tiles, std::max(0, options.GetInt("chunk-tiles", 0)));
+}
+
+// Syncs per step the point asks the host for, 0 for model_num_syncs' choice. As AllredConfig reads them without
+// --syncs
+uint32_t point_num_syncs(const SweepPoint& point, const AllredOptions& options) {
+    if (point.num_syncs >= 0) {
+        return point.num_syncs;
+    }
+    if (options.Has("sync-bytes")) {
+        uint32_t chunk_bytes = point_chunks(point, options).chunk_tiles * 2048;
+        return std::max<uint32_t>(1, chunk_bytes / std::max(1, options.GetInt("sync-bytes", 1)));
+    }
+    return std::max(0, options.GetInt("num-syncs", 0));
+}
+
+// Sync counts of --syncs that the kernels can't use (not a power of two dividing the blocks) would be rounded
+// down to the count of another point
+bool point_syncs_valid(const SweepPoint& point, const AllredOptions& options) {
+    if (point.num_syncs <= 0) {
+        return true;
+    }
+    const SchedulePlan& plan = SchedulePlanner::Get(point.swing_algo == 1, 8);
+    return valid_num_syncs(plan, point_chunks(point, options).chunk_tiles, point.num_syncs) == (uint32_t)point.num_syncs;
+}
+
+// Only the BO dataflow kernel streams vectors larger than L1
+bool point_fits(const SweepPoint& point, const AllredOptions& options) {
+    return !point_chunks(point, options).streaming() || point.mode == "allred_BO_2D" || point.mode == "allred_LO_2D";
+}
+
+// Plans and fills the runtime args of every core without a device. BO/LO args are also checked by the
+// emulator (partners, masks and semaphore counts), mem args only use the plan for syncs
+bool dry_run_point(const SweepPoint& point, const AllredOptions& options, std::string& error) {
+    constexpr int SIDE_LENGTH = 8;
+    bool mem = point.mode == "allred_mem_2D";
+    bool bandwidth_optimal = !latency_optimal_mode(point.mode);
+    uint32_t total_nodes = SIDE_LENGTH * SIDE_LENGTH;
+    ChunkPlan chunks = point_chunks(point, options);
+    uint32_t num_tiles = chunks.chunk_tiles;
+    if (!point_fits(point, options)) {
+        error = "vector larger than L1, only allred_BO_2D and allred_LO_2D stream";
+        return false;
+    }
+    const SchedulePlan& plan = SchedulePlanner::Get(point.swing_algo == 1, SIDE_LENGTH);
+    PhysicalCoreFn physical_core = [](int core_i) {
+        return wormhole_worker_core(core_i % SIDE_LENGTH, core_i / SIDE_LENGTH);
+    };
+
+    if (mem) {
+        build_mem_arg_tables(plan, physical_core, num_tiles);
+        return true;
+    }
+
+    // Same tables as AllredProgramCache builds on the device
+    AllredArgTables args = build_BO_arg_tables(
+        plan, physical_core, bandwidth_optimal, num_tiles, chunks.num_chunks, point_num_syncs(point, options));
+    std::vector<std::pair<uint32_t, uint32_t>> physical_cores(total_nodes);
+    for (uint32_t core_i = 0; core_i < total_nodes; core_i++) {
+        physical_cores[core_i] = physical_core(core_i);
+    }
+    AllredEmulator emulator(physical_cores);
+    for (uint32_t core_i = 0; core_i < total_nodes; core_i++) {
+        emulator.SetCoreArgs(core_i, args.dataflow[core_i], args.compute[core_i]);
+        emulator.SetCoreInput(core_i, std::vector<uint32_t>(num_tiles * 2048 / sizeof(uint32_t), 0));
+    }
+
+    uint32_t runs = std::max(1, options.GetInt("iterations", 1)) + std::max(0, options.GetInt("warmup", 0));
+    EmulatorResult result = emulator.Run(runs * chunks.num_chunks);  // Each chunk is a run of the allreduce
+    if (!result.success) {
+        error = result.error;
+    } else if (!result.sync_errors.empty()) {
+        error = result.sync_errors.front();
+    }
+    return error.empty();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    --modes=LIST: comma separated allred_BO_2D, allred_LO_2D and allred_mem_2D, all by default. allred_LOO_2D
+                  runs the small vector dataflow kernel at every size, to measure the crossover for allred_tune
+    --swing=LIST: algorithms (1 = swing, 0 = recdub), 0,1 by default (1 for allred_mem_2D)
+    --sizes=LIST: data sizes (arg 5 of the programs) of every mode, by default those of timing_taker.py
+                  (--sizes-lo and --sizes-bo set the latency optimal and the BO/mem ones)
+    --runs=N: repeats of the whole sweep, 1 by default
+    --syncs=LIST: semaphore syncs per step of the BO/LO send loops, every point runs with each (0 for the host's
+                  default, model_num_syncs), skipping counts the point's blocks can't be split in. The results file
+                  gets the count in the mode (allred_BO_2D:syncs=8...) and the fastest count of each point is printed
+    --seed=N, --error=N: args 4 and 6 of the programs, 13 and 32 by default
+    --out=PATH: results file, appended to, allred_sweep_results.csv by default. Its mode is the variant whose
+                kernels ran, allred_LOO_2D for the allred_LO_2D points below the LOO crossover
+    --dry-run: only plan and generate the args of every point, without a device
+    Other named options (--iterations, --warmup, --inputs, --tuning, --chunk-tiles, --num-syncs) are passed on to
+    every point*/
+    std::vector<SweepPoint> points = sweep_points(options);
+    size_t swept_points = points.size();
+    points.erase(
+        std::remove_if(
+            points.begin(),
+            points.end(),
+            [&](const SweepPoint& point) { return !point_syncs_valid(point, options); }),
+        points.end());
+    if (points.size() < swept_points) {
+        printf("Skipping %zu points whose blocks can't be split in their --syncs count\n", swept_points - points.size());
+    }
+    int seed = options.GetInt("seed", 13);
+    int error = options.GetInt("error", 32);
+    using clock = std::chrono::steady_clock;
+
+    if (options.Has("dry-run")) {
+        int failures = 0;
+        auto start = clock::now();
+        for (const SweepPoint& point : points) {
+            std::string point_error;
+            if (!dry_run_point(point, options, point_error)) {
+                printf(
+                    "%s swing %d size %d: %s\n",
+                    point_name(point).c_str(),
+                    point.swing_algo,
+                    point.data_size,
+                    point_error.c_str());
+                failures++;
+            }
+        }
+        double elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        printf("Dry run of %zu points in %.1f ms, %d failed\n", points.size(), elapsed_ms, failures);
+        return failures == 0 ? 0 : 1;
+    }
+
+    for (const SweepPoint& point : points) {
+        if (!point_fits(point, options)) {
+            printf(
+                "%s size %d: vector larger than L1, only allred_BO_2D and allred_LO_2D stream\n",
+                point.mode.c_str(),
+                point.data_size);
+            return 1;
+        }
+    }
+
+    IDevice* device = CreateDevice(0);
+    CommandQueue& cq = device->command_queue();
+    CoreRange cores({0, 0}, {7, 7});
+    AllredProgramCache programs;  // Repeated runs of a point reuse its program
+
+    std::vector<bool> valid(points.size());
+    // Variant whose kernels ran each point, written as the mode of the results file: with --tuning, allred_LO_2D
+    // points below the table's crossover run allred_LOO_2D, which allred_tune can't tell from the size
+    std::vector<std::string> kernels(points.size());
+    auto sweep_start = clock::now();
+    for (size_t p = 0; p < points.size(); p++) {
+        const SweepPoint& point = points[p];
+        printf(
+            "Running: MODE=%s, SWING_ALGO=%d, DATA_SIZE=%d\n",
+            point_name(point).c_str(),
+            point.swing_algo,
+            point.data_size);
+        auto start = clock::now();
+
+        std::vector<std::string> args = point_args(point, seed, error);
+        std::vector<char*> point_argv;
+        for (std::string& arg : args) {
+            point_argv.push_back(arg.data());
+        }
+        point_argv.push_back(nullptr);
+        int point_argc = args.size();
+        bool mem = point.mode == "allred_mem_2D";
+        bool bandwidth_optimal = !latency_optimal_mode(point.mode);
+        AllredConfig arCfg(point_argc, point_argv.data(), device, cq, 8, mem || bandwidth_optimal, options);
+        arCfg.NUM_SYNCS = point_num_syncs(point, options);
+        kernels[p] = arCfg.KernelVariant(point.mode);
+        bool cached = programs.Contains(point.mode, arCfg);
+        valid[p] = arCfg.Execute(cq, programs.Get(point.mode, arCfg, device, cores), device).all_match();
+
+        double elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        printf("Point done in %.1f ms (%s program)\n\n", elapsed_ms, cached ? "cached" : "new");
+    }
+    CloseDevice(device);
+    double sweep_s = std::chrono::duration<double>(clock::now() - sweep_start).count();
+
+    // Every point enqueued one program, so the last runs of the log are those of the sweep, in order
+    std::ifstream log(default_profile_log_path());
+    ProfileLogReader reader;
+    std::string log_error;
+    std::vector<ProfileRun> runs;
+    if (log && reader.Read(log, log_error)) {
+        runs = reader.Runs();
+    }
+    if (runs.size() < points.size()) {
+        printf(
+            "Only %zu of %zu points have ALL_RED_LOOP zones in %s, was TT_METAL_DEVICE_PROFILER=1 set?\n",
+            runs.size(),
+            points.size(),
+            default_profile_log_path().c_str());
+    }
+
+    std::string out = options.GetString("out", "allred_sweep_results.csv");
+    uint32_t iterations = std::max(1, options.GetInt("iterations", 1));
+    size_t first_run = runs.size() >= points.size() ? runs.size() - points.size() : 0;
+    int failures = 0;
+    // --syncs: median cycles of every run of each sync count, by (mode, swing_algo, data_size)
+    std::map<std::tuple<std::string, int, int>, std::map<int, std::vector<double>>> sync_medians;
+    for (size_t p = 0; p < points.size(); p++) {
+        const SweepPoint& point = points[p];
+        failures += !valid[p];
+        if (runs.size() < points.size()) {
+            continue;
+        }
+        const ProfileRun& run = runs[first_run + p];
+        TimeStats stats = run.Durations();
+        printf(
+            "%s swing %d size %d run %d: %s, median %.0f max %.0f cycles\n",
+            point_name(point).c_str(),
+            point.swing_algo,
+            point.data_size,
+            point.run_num,
+            valid[p] ? "valid" : "INVALID",
+            stats.median,
+            stats.max);
+        append_timing_csv(
+            out,
+            run,
+            point_name(point, kernels[p]),
+            std::to_string(point.swing_algo),
+            std::to_string(point.data_size),
+            point.run_num * iterations);
+        if (point.num_syncs >= 0 && valid[p]) {
+            sync_medians[{point.mode, point.swing_algo, point.data_size}][point.num_syncs].push_back(stats.median);
+        }
+    }
+
+    for (const auto& [key, medians] : sync_medians) {
+        const auto& [mode, swing_algo, data_size] = key;
+        auto mean = [](const std::vector<double>& values) {
+            double sum = 0;
+            for (double value : values) {
+                sum += value;
+            }
+            return sum / values.size();
+        };
+        int fastest = medians.begin()->first;
+        for (const auto& [num_syncs, cycles] : medians) {
+            fastest = mean(cycles) < mean(medians.at(fastest)) ? num_syncs : fastest;
+        }
+        SweepPoint point{mode, swing_algo, data_size, 0, 0};
+        uint32_t model_syncs = model_num_syncs(
+            SchedulePlanner::Get(swing_algo == 1, 8), !latency_optimal_mode(mode), point_chunks(point, options).chunk_tiles);
+        std::string fastest_syncs = fastest == 0 ? "the default " + std::to_string(model_syncs) : std::to_string(fastest);
+        printf(
+            "%s swing %d size %d: fastest with %s syncs, %.0f cycles (the model picks %u",
+            mode.c_str(),
+            swing_algo,
+            data_size,
+            fastest_syncs.c_str(),
+            mean(medians.at(fastest)),
+            model_syncs);
+        if (medians.count(0)) {
+            printf(", %.0f cycles", mean(medians.at(0)));
+        }
+        printf(")\n");
+    }
+    printf("Swept %zu points in %.1f s, %d invalid. Results saved in %s\n", points.size(), sweep_s, failures, out.c_str());
+    return failures == 0 ? 0 : 1;
+}
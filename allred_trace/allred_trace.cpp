@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <fstream>
+#include "allred_options.hpp"
+#include "allred_placement.hpp"
+#include "allred_profile.hpp"
+#include "allred_schedule.hpp"
+#include "allred_trace.hpp"
+
+// Converts a device profiler log (or the --profile-log of allred_shim) into a Chrome trace, to look at a run in
+// ui.perfetto.dev or chrome://tracing with a track per core and RISC. Needs neither a device nor tt-metal.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Arg 1: Path of profile_log_device.csv, defaults to the one under $TT_METAL_HOME
+    --out=PATH: trace to write, allred_trace.json by default
+    --swing=0|1: algorithm of the run (1 = swing), 0 by default, to name the step zones and draw the semaphores
+    --side=N: size of node array 1,2,4,8 (arg 3 of the run), 8 by default
+    --placement=PATH: placement table the run was given, row major by default
+    --run=ID: only write the run with this run host ID, all runs by default
+    --freq-mhz=F: clock of the cycle counts, 1000 by default (the CHIP_FREQ of the log's first line)*/
+    std::string log_path = (argc >= 2) ? argv[1] : default_profile_log_path();
+    bool SWING_VERSION = options.GetInt("swing", 0) == 1;
+    int SIDE_LENGTH = highest_power_of_two(options.GetInt("side", 8));
+
+    std::ifstream log(log_path);
+    if (!log) {
+        printf("Could not open %s\n", log_path.c_str());
+        return 1;
+    }
+    std::vector<RiscZones> riscs;
+    std::string error;
+    if (!read_profile_zones(log, riscs, error)) {
+        printf("%s: %s\n", log_path.c_str(), error.c_str());
+        return 1;
+    }
+
+    Placement placement = row_major_placement(SIDE_LENGTH, SIDE_LENGTH);
+    if (options.Has("placement")) {
+        std::string placement_path = options.GetString("placement", "");
+        std::ifstream table(placement_path);
+        if (!table) {
+            printf("Could not open %s\n", placement_path.c_str());
+            return 1;
+        }
+        if (!read_placement(table, SIDE_LENGTH, SIDE_LENGTH, placement, error)) {
+            printf("%s: %s\n", placement_path.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    PhysicalCoreFn physical_core = [&](int core_i) {
+        return wormhole_worker_core(placement[core_i].first, placement[core_i].second);
+    };
+
+    TraceOptions trace_options;
+    trace_options.cycles_per_us = std::stod(options.GetString("freq-mhz", "1000"));
+    trace_options.all_runs = !options.Has("run");
+    trace_options.run_id = std::max(0, options.GetInt("run", 0));
+
+    std::string out = options.GetString("out", "allred_trace.json");
+    std::ofstream trace(out);
+    if (!trace) {
+        printf("Could not open %s\n", out.c_str());
+        return 1;
+    }
+    TraceSummary summary =
+        write_chrome_trace(trace, riscs, SchedulePlanner::Get(SWING_VERSION, SIDE_LENGTH), physical_core, trace_options);
+    printf(
+        "Wrote %zu zones (%zu of them step zones) and %zu semaphore arrows to %s\n",
+        summary.zones,
+        summary.step_zones,
+        summary.flows,
+        out.c_str());
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "allred_options.hpp"
+#include "allred_schedule.hpp"
+#include "allred_tuning.hpp"
+
+// Fits the cost model of every kernel to timing results (allred_sweep, or allred_profiler --csv), picks the
+// allred_LOO_2D crossover and writes the tuning table the drivers read for "auto". Needs neither a device nor
+// tt-metal.
+int main(int argc, char** argv) {
+    AllredOptions options = AllredOptions::Parse(argc, argv);
+    /*
+    Args: timing results files, allred_sweep_results.csv by default
+    --out=PATH: tuning table to write, allred_tuning.txt by default
+    --max-tiles=N: largest vector (in tiles) considered for the crossover, 320 by default*/
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        paths.push_back("allred_sweep_results.csv");
+    }
+
+    std::vector<TimingPoint> points;
+    for (const std::string& path : paths) {
+        std::ifstream csv(path);
+        std::string error;
+        if (!csv) {
+            printf("Could not open %s\n", path.c_str());
+            return 1;
+        }
+        if (!read_timing_points(csv, points, error)) {
+            printf("%s: %s\n", path.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    if (points.empty()) {
+        printf("No ALL_RED_LOOP timings found\n");
+        return 1;
+    }
+
+    TuningTable table;
+    printf("%-14s %8s %12s %12s %12s %16s %10s\n", "kernel", "points", "base", "per sync", "per hop", "per kB", "rms error");
+    for (const std::string& kernel : tuned_kernels()) {
+        CostModelParams params = fit_cost_model(points, kernel);
+        if (params.points == 0) {
+            printf("%-14s %8s, keeping the %s\n", kernel.c_str(), "none", table.kernels.count(kernel) ? "untuned model" : "kernel out of auto");
+            continue;
+        }
+        table.kernels[kernel] = params;
+        printf(
+            "%-14s %8u %12.0f %12.1f %12.2f %16.1f %10.0f\n",
+            kernel.c_str(),
+            params.points,
+            params.base_cycles,
+            params.sync_cycles,
+            params.hop_cycles,
+            params.cycles_per_byte * 1024,
+            params.rms_error);
+    }
+
+    printf("\n%-14s %6s %6s %8s %12s %12s\n", "kernel", "algo", "tiles", "samples", "measured", "predicted");
+    std::sort(points.begin(), points.end(), [](const TimingPoint& a, const TimingPoint& b) {
+        return std::tie(a.kernel, a.swing_version, a.num_tiles) < std::tie(b.kernel, b.swing_version, b.num_tiles);
+    });
+    for (const TimingPoint& point : points) {
+        printf(
+            "%-14s %6s %6u %8u %12.0f %12.0f\n",
+            point.kernel.c_str(),
+            point.swing_version ? "swing" : "recdub",
+            point.num_tiles,
+            point.samples,
+            point.cycles,
+            table.Predict(point.kernel, SchedulePlanner::Get(point.swing_version, 8), point.num_tiles));
+    }
+
+    uint32_t max_tiles = std::max(64, options.GetInt("max-tiles", 320));
+    table.loo_crossover_tiles = fit_loo_crossover(table, max_tiles);
+    printf("\nallred_LO_2D runs the allred_LOO_2D dataflow kernel below %u tiles\n", table.loo_crossover_tiles);
+
+    printf("\nChoices on 8x8 cores:\n%8s %-14s %-14s %6s %6s %12s\n", "kB", "variant", "kernel", "algo", "arg 5", "cycles");
+    for (uint32_t tiles : {1, 2, 4, 8, 16, 32, 64, 128, 192, 256, 320}) {
+        AlgorithmChoice choice = select_algorithm(table, (uint64_t)tiles * 2048, 8, 8);
+        printf(
+            "%8u %-14s %-14s %6s %6d %12.0f\n",
+            tiles * 2,
+            choice.variant.c_str(),
+            choice.kernel.c_str(),
+            choice.swing_version ? "swing" : "recdub",
+            choice.data_size,
+            choice.predicted_cycles);
+    }
+
+    std::string out = options.GetString("out", "allred_tuning.txt");
+    std::ofstream file(out);
+    if (!file) {
+        printf("Could not open %s\n", out.c_str());
+        return 1;
+    }
+    write_tuning_table(file, table);
+    printf("Tuning table saved in %s\n", out.c_str());
+    return 0;
+}
@@ -69,9 +69,10 @@ for run_num in range(0,20):
             workload_proc.wait()
 
             # Run results analyzer script
+            # allred_profiler prints the same core lines as profiler_results_analyzer_timing_distributions.py
             analyzer_cmd = [
-                "python3",
-                "/home/tenstorrent/tt-metal/tt_metal/programming_examples/charlie_work/python/profiler_results_analyzer_timing_distributions.py"
+                "/home/tenstorrent/tt-metal/build_Release_tracy/programming_examples/charlie_work/allred_profiler",
+                "/home/tenstorrent/tt-metal/generated/profiler/.logs/profile_log_device.csv"
             ]
             analyzer_output = subprocess.run(analyzer_cmd, capture_output=True, text=True).stdout
 